@@ -36,6 +36,15 @@ QAppearanceSettingsWidget::QAppearanceSettingsWidget(QWidget* pParent, QRenderSe
   m_RendererType.setCurrentIndex(1);
   m_MainLayout.addRow("Renderer", &m_RendererType);
 
+  m_InteractiveResolution.setStatusTip(tr("Render resolution while the camera is moving"));
+  m_InteractiveResolution.setToolTip(tr("Render resolution while the camera is moving"));
+  m_InteractiveResolution.addItem("Full", 1);
+  m_InteractiveResolution.addItem("1/2", 2);
+  m_InteractiveResolution.addItem("1/4", 4);
+  m_InteractiveResolution.setCurrentIndex(
+    std::max(0, m_InteractiveResolution.findData(rs->m_RenderSettings.m_InteractiveDownsample)));
+  m_MainLayout.addRow("Interactive Resolution", &m_InteractiveResolution);
+
   m_DensityScaleSlider.setStatusTip(tr("Set scattering density for volume"));
   m_DensityScaleSlider.setToolTip(tr("Set scattering density for volume"));
   m_DensityScaleSlider.setRange(0.001, 100.0);
@@ -58,6 +67,55 @@ QAppearanceSettingsWidget::QAppearanceSettingsWidget(QWidget* pParent, QRenderSe
   m_GradientFactorSlider.setValue(rs->m_RenderSettings.m_GradientFactor);
   m_MainLayout.addRow("Shading Type Mixture", &m_GradientFactorSlider);
 
+  m_precomputedGradientsCheckBox.setChecked(rs->m_RenderSettings.m_UsePrecomputedGradients);
+  m_precomputedGradientsCheckBox.setStatusTip(tr("Shade with gradients computed once per volume, not per sample"));
+  m_precomputedGradientsCheckBox.setToolTip(tr("Shade with gradients computed once per volume, not per sample"));
+  m_MainLayout.addRow("Precomputed Gradients", &m_precomputedGradientsCheckBox);
+  QObject::connect(&m_precomputedGradientsCheckBox, &QCheckBox::clicked, [this](const bool is_checked) {
+    this->OnPrecomputedGradientsChecked(is_checked);
+  });
+
+  m_cachedShadowsCheckBox.setChecked(rs->m_RenderSettings.m_CachedShadows);
+  m_cachedShadowsCheckBox.setStatusTip(tr("Faster, approximate shadows from a low resolution transmittance volume"));
+  m_cachedShadowsCheckBox.setToolTip(tr("Faster, approximate shadows from a low resolution transmittance volume"));
+  m_MainLayout.addRow("Cached Shadows", &m_cachedShadowsCheckBox);
+  QObject::connect(&m_cachedShadowsCheckBox, &QCheckBox::clicked, [this](const bool is_checked) {
+    this->OnCachedShadowsChecked(is_checked);
+  });
+
+  m_temporalReprojectionCheckBox.setChecked(rs->m_RenderSettings.m_TemporalReprojection);
+  m_temporalReprojectionCheckBox.setStatusTip(tr("Keep the samples that are still visible after a camera move"));
+  m_temporalReprojectionCheckBox.setToolTip(tr("Keep the samples that are still visible after a camera move"));
+  m_MainLayout.addRow("Temporal Reprojection", &m_temporalReprojectionCheckBox);
+  QObject::connect(&m_temporalReprojectionCheckBox, &QCheckBox::clicked, [this](const bool is_checked) {
+    this->OnTemporalReprojectionChecked(is_checked);
+  });
+
+  m_halfFloatAccumulationCheckBox.setChecked(rs->m_RenderSettings.m_HalfFloatAccumulation);
+  m_halfFloatAccumulationCheckBox.setStatusTip(tr("Accumulate samples at half precision, for less GPU memory"));
+  m_halfFloatAccumulationCheckBox.setToolTip(tr("Accumulate samples at half precision, for less GPU memory"));
+  m_MainLayout.addRow("Half Float Accumulation", &m_halfFloatAccumulationCheckBox);
+  QObject::connect(&m_halfFloatAccumulationCheckBox, &QCheckBox::clicked, [this](const bool is_checked) {
+    this->OnHalfFloatAccumulationChecked(is_checked);
+  });
+
+  m_gpuVolumeBudgetSpinBox.setStatusTip(tr("GPU memory for the volume before it is paged in bricks. Auto uses what "
+                                            "the driver reports as free"));
+  m_gpuVolumeBudgetSpinBox.setToolTip(tr("GPU memory for the volume before it is paged in bricks. Auto uses what "
+                                         "the driver reports as free"));
+  m_gpuVolumeBudgetSpinBox.setRange(0, 1024 * 1024);
+  m_gpuVolumeBudgetSpinBox.setSingleStep(256);
+  m_gpuVolumeBudgetSpinBox.setSuffix(" MB");
+  m_gpuVolumeBudgetSpinBox.setSpecialValueText(tr("Auto"));
+  // every change uploads the volume again, so not on every keystroke
+  m_gpuVolumeBudgetSpinBox.setKeyboardTracking(false);
+  m_gpuVolumeBudgetSpinBox.setValue(rs->m_RenderSettings.m_GpuVolumeBudgetMB);
+  m_MainLayout.addRow("GPU Volume Budget", &m_gpuVolumeBudgetSpinBox);
+  QObject::connect(&m_gpuVolumeBudgetSpinBox,
+                   QOverload<int>::of(&QSpinBox::valueChanged),
+                   this,
+                   &QAppearanceSettingsWidget::OnSetGpuVolumeBudget);
+
   QObject::connect(&m_DensityScaleSlider, SIGNAL(valueChanged(double)), this, SLOT(OnSetDensityScale(double)));
   QObject::connect(&m_GradientFactorSlider, SIGNAL(valueChanged(double)), this, SLOT(OnSetGradientFactor(double)));
 
@@ -182,6 +240,14 @@ QAppearanceSettingsWidget::QAppearanceSettingsWidget(QWidget* pParent, QRenderSe
   roiSectionLayout->addWidget(m_roiZ, 2, 1);
   QObject::connect(m_roiZ, &RangeWidget::firstValueChanged, this, &QAppearanceSettingsWidget::OnSetRoiZMin);
   QObject::connect(m_roiZ, &RangeWidget::secondValueChanged, this, &QAppearanceSettingsWidget::OnSetRoiZMax);
+  m_cropVolumeToRoiCheckBox.setText(tr("Crop GPU volume to ROI"));
+  m_cropVolumeToRoiCheckBox.setChecked(false);
+  m_cropVolumeToRoiCheckBox.setStatusTip(tr("Only upload the part of the volume inside the ROI to the GPU"));
+  m_cropVolumeToRoiCheckBox.setToolTip(tr("Only upload the part of the volume inside the ROI to the GPU"));
+  roiSectionLayout->addWidget(&m_cropVolumeToRoiCheckBox, 3, 0, 1, 2);
+  QObject::connect(&m_cropVolumeToRoiCheckBox, &QCheckBox::clicked, [this](const bool is_checked) {
+    this->OnCropVolumeToRoiChecked(is_checked);
+  });
 
   m_clipRoiSection->setContentLayout(*roiSectionLayout);
   m_MainLayout.addRow(m_clipRoiSection);
@@ -195,6 +261,8 @@ QAppearanceSettingsWidget::QAppearanceSettingsWidget(QWidget* pParent, QRenderSe
   m_MainLayout.addRow(lineA);
 
   QObject::connect(&m_RendererType, SIGNAL(currentIndexChanged(int)), this, SLOT(OnSetRendererType(int)));
+  QObject::connect(
+    &m_InteractiveResolution, SIGNAL(currentIndexChanged(int)), this, SLOT(OnSetInteractiveResolution(int)));
   QObject::connect(&m_ShadingType, SIGNAL(currentIndexChanged(int)), this, SLOT(OnSetShadingType(int)));
   // QObject::connect(&gStatus, SIGNAL(RenderBegin()), this, SLOT(OnRenderBegin()));
 
@@ -391,6 +459,12 @@ QAppearanceSettingsWidget::OnSetRoiZMin(int value)
   m_qrendersettings->renderSettings()->m_DirtyFlags.SetFlag(RoiDirty);
 }
 void
+QAppearanceSettingsWidget::OnCropVolumeToRoiChecked(bool isChecked)
+{
+  m_qrendersettings->renderSettings()->m_RenderSettings.m_CropVolumeToRoi = isChecked;
+  m_qrendersettings->renderSettings()->m_DirtyFlags.SetFlag(RoiDirty);
+}
+void
 QAppearanceSettingsWidget::OnSetRoiXMax(int value)
 {
   if (!m_scene)
@@ -510,6 +584,19 @@ QAppearanceSettingsWidget::OnRenderBegin(void)
   m_DensityScaleSlider.setValue(m_qrendersettings->GetDensityScale());
   m_ShadingType.setCurrentIndex(m_qrendersettings->GetShadingType());
   m_GradientFactorSlider.setValue(m_qrendersettings->renderSettings()->m_RenderSettings.m_GradientFactor);
+  m_precomputedGradientsCheckBox.setChecked(
+    m_qrendersettings->renderSettings()->m_RenderSettings.m_UsePrecomputedGradients);
+  m_cachedShadowsCheckBox.setChecked(m_qrendersettings->renderSettings()->m_RenderSettings.m_CachedShadows);
+  m_temporalReprojectionCheckBox.setChecked(
+    m_qrendersettings->renderSettings()->m_RenderSettings.m_TemporalReprojection);
+  m_halfFloatAccumulationCheckBox.setChecked(
+    m_qrendersettings->renderSettings()->m_RenderSettings.m_HalfFloatAccumulation);
+  m_gpuVolumeBudgetSpinBox.blockSignals(true);
+  m_gpuVolumeBudgetSpinBox.setValue(m_qrendersettings->renderSettings()->m_RenderSettings.m_GpuVolumeBudgetMB);
+  m_gpuVolumeBudgetSpinBox.blockSignals(false);
+  m_InteractiveResolution.setCurrentIndex(std::max(
+    0,
+    m_InteractiveResolution.findData(m_qrendersettings->renderSettings()->m_RenderSettings.m_InteractiveDownsample)));
 
   m_StepSizePrimaryRaySlider.setValue(m_qrendersettings->renderSettings()->m_RenderSettings.m_StepSizeFactor, true);
   m_StepSizeSecondaryRaySlider.setValue(m_qrendersettings->renderSettings()->m_RenderSettings.m_StepSizeFactorShadow,
@@ -529,12 +616,55 @@ QAppearanceSettingsWidget::OnSetShadingType(int Index)
   m_GradientFactorSlider.setEnabled(Index == 2);
 }
 
+void
+QAppearanceSettingsWidget::OnPrecomputedGradientsChecked(bool isChecked)
+{
+  m_qrendersettings->renderSettings()->m_RenderSettings.m_UsePrecomputedGradients = isChecked;
+  m_qrendersettings->renderSettings()->m_DirtyFlags.SetFlag(RenderParamsDirty);
+}
+
+void
+QAppearanceSettingsWidget::OnCachedShadowsChecked(bool isChecked)
+{
+  m_qrendersettings->renderSettings()->m_RenderSettings.m_CachedShadows = isChecked;
+  m_qrendersettings->renderSettings()->m_DirtyFlags.SetFlag(RenderParamsDirty);
+}
+
+void
+QAppearanceSettingsWidget::OnTemporalReprojectionChecked(bool isChecked)
+{
+  m_qrendersettings->renderSettings()->m_RenderSettings.m_TemporalReprojection = isChecked;
+  m_qrendersettings->renderSettings()->m_DirtyFlags.SetFlag(RenderParamsDirty);
+}
+
+void
+QAppearanceSettingsWidget::OnHalfFloatAccumulationChecked(bool isChecked)
+{
+  m_qrendersettings->renderSettings()->m_RenderSettings.m_HalfFloatAccumulation = isChecked;
+  m_qrendersettings->renderSettings()->m_DirtyFlags.SetFlag(RenderParamsDirty);
+}
+
+void
+QAppearanceSettingsWidget::OnSetGpuVolumeBudget(int megabytes)
+{
+  m_qrendersettings->renderSettings()->m_RenderSettings.m_GpuVolumeBudgetMB = megabytes;
+  m_qrendersettings->renderSettings()->m_DirtyFlags.SetFlag(VolumeDirty);
+}
+
 void
 QAppearanceSettingsWidget::OnSetRendererType(int Index)
 {
   m_qrendersettings->SetRendererType(Index);
 }
 
+void
+QAppearanceSettingsWidget::OnSetInteractiveResolution(int Index)
+{
+  // takes effect with the next camera change
+  m_qrendersettings->renderSettings()->m_RenderSettings.m_InteractiveDownsample =
+    m_InteractiveResolution.itemData(Index).toInt();
+}
+
 void
 QAppearanceSettingsWidget::OnSetGradientFactor(double GradientFactor)
 {
@@ -767,6 +897,7 @@ QAppearanceSettingsWidget::onNewImage(Scene* scene)
                                   m_scene->m_material.m_boundingBoxColor[2]);
   m_boundingBoxColorButton.SetColor(cbbox);
   m_showBoundingBoxCheckBox.setChecked(m_scene->m_material.m_showBoundingBox);
+  m_cropVolumeToRoiCheckBox.setChecked(m_qrendersettings->renderSettings()->m_RenderSettings.m_CropVolumeToRoi);
 
   initLightingControls(scene);
 
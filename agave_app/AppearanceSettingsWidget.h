@@ -8,6 +8,7 @@
 #include <QtWidgets/QComboBox>
 #include <QtWidgets/QGroupBox>
 #include <QtWidgets/QLabel>
+#include <QtWidgets/QSpinBox>
 
 #include <memory>
 
@@ -32,8 +33,14 @@ public slots:
   void OnSetDensityScale(double DensityScale);
   void OnTransferFunctionChanged(void);
   void OnSetRendererType(int Index);
+  void OnSetInteractiveResolution(int Index);
   void OnSetShadingType(int Index);
   void OnSetGradientFactor(double GradientFactor);
+  void OnPrecomputedGradientsChecked(bool isChecked);
+  void OnCachedShadowsChecked(bool isChecked);
+  void OnTemporalReprojectionChecked(bool isChecked);
+  void OnHalfFloatAccumulationChecked(bool isChecked);
+  void OnSetGpuVolumeBudget(int megabytes);
   void OnSetStepSizePrimaryRay(const double& StepSizePrimaryRay);
   void OnSetStepSizeSecondaryRay(const double& StepSizeSecondaryRay);
 
@@ -65,6 +72,7 @@ public:
   void OnSetRoiXMin(int value);
   void OnSetRoiYMin(int value);
   void OnSetRoiZMin(int value);
+  void OnCropVolumeToRoiChecked(bool isChecked);
 
   void OnSetScaleX(double value);
   void OnSetScaleY(double value);
@@ -76,8 +84,14 @@ private:
   QFormLayout m_MainLayout;
   QNumericSlider m_DensityScaleSlider;
   QComboBox m_RendererType;
+  QComboBox m_InteractiveResolution;
   QComboBox m_ShadingType;
   QNumericSlider m_GradientFactorSlider;
+  QCheckBox m_precomputedGradientsCheckBox;
+  QCheckBox m_cachedShadowsCheckBox;
+  QCheckBox m_temporalReprojectionCheckBox;
+  QCheckBox m_halfFloatAccumulationCheckBox;
+  QSpinBox m_gpuVolumeBudgetSpinBox;
   QNumericSlider m_StepSizePrimaryRaySlider;
   QNumericSlider m_StepSizeSecondaryRaySlider;
   QColorPushButton m_backgroundColorButton;
@@ -88,6 +102,7 @@ private:
   RangeWidget* m_roiX;
   RangeWidget* m_roiY;
   RangeWidget* m_roiZ;
+  QCheckBox m_cropVolumeToRoiCheckBox;
 
   Section* m_scaleSection;
   QDoubleSpinner* m_xscaleSpinner;
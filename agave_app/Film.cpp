@@ -6,6 +6,7 @@ QFilm::QFilm(QObject* pParent /*= NULL*/)
   , m_Height(600)
   , m_Exposure(0.75f)
   , m_ExposureIterations(1)
+  , m_NoiseReduction(false)
   , m_Dirty(false)
 {}
 
@@ -1,6 +1,7 @@
 #include "ViewerState.h"
 
 #include "command.h"
+#include "renderlib/CommandStream.h"
 #include "renderlib/Logging.h"
 #include "renderlib/version.h"
 
@@ -451,80 +452,59 @@ ViewerState::stateToJson() const
   return QJsonDocument(j);
 }
 
-QString
-ViewerState::stateToPythonScript() const
+void
+ViewerState::stateToCommands(CommandList& commands) const
 {
-  QFileInfo fi(m_volumeImageFile);
-  QString outFileName = fi.baseName();
-
-  std::ostringstream ss;
-  ss << "# pip install agave_pyclient" << std::endl;
-  ss << "# agave --server &" << std::endl;
-  ss << "# python myscript.py" << std::endl << std::endl;
-  ss << "import agave_pyclient as agave" << std::endl << std::endl;
-  ss << "r = agave.AgaveRenderer()" << std::endl;
-  std::string obj = "r.";
-  ss << obj
-     << LoadVolumeFromFileCommand({ m_volumeImageFile.toStdString(), m_currentScene, m_currentTime }).toPythonString()
-     << std::endl;
-  ss << obj << SetResolutionCommand({ m_resolutionX, m_resolutionY }).toPythonString() << std::endl;
-  ss << obj
-     << SetBackgroundColorCommand({ m_backgroundColor.x, m_backgroundColor.y, m_backgroundColor.z }).toPythonString()
-     << std::endl;
-  ss << obj << ShowBoundingBoxCommand({ m_showBoundingBox }).toPythonString() << std::endl;
-  ss
-    << obj
-    << SetBoundingBoxColorCommand({ m_boundingBoxColor.x, m_boundingBoxColor.y, m_boundingBoxColor.z }).toPythonString()
-    << std::endl;
-  ss << obj << SetRenderIterationsCommand({ m_renderIterations }).toPythonString() << std::endl;
-  ss << obj << SetPrimaryRayStepSizeCommand({ m_primaryStepSize }).toPythonString() << std::endl;
-  ss << obj << SetSecondaryRayStepSizeCommand({ m_secondaryStepSize }).toPythonString() << std::endl;
-  ss << obj << SetVoxelScaleCommand({ m_scaleX, m_scaleY, m_scaleZ }).toPythonString() << std::endl;
-  ss << obj
-     << SetClipRegionCommand({ m_roiXmin, m_roiXmax, m_roiYmin, m_roiYmax, m_roiZmin, m_roiZmax }).toPythonString()
-     << std::endl;
-  ss << obj << SetCameraPosCommand({ m_eyeX, m_eyeY, m_eyeZ }).toPythonString() << std::endl;
-  ss << obj << SetCameraTargetCommand({ m_targetX, m_targetY, m_targetZ }).toPythonString() << std::endl;
-  ss << obj << SetCameraUpCommand({ m_upX, m_upY, m_upZ }).toPythonString() << std::endl;
-  ss << obj
-     << SetCameraProjectionCommand({ m_projection, m_projection == Projection::PERSPECTIVE ? m_fov : m_orthoScale })
-          .toPythonString()
-     << std::endl;
-
-  ss << obj << SetCameraExposureCommand({ m_exposure }).toPythonString() << std::endl;
-  ss << obj << SetDensityCommand({ m_densityScale }).toPythonString() << std::endl;
-  ss << obj << SetCameraApertureCommand({ m_apertureSize }).toPythonString() << std::endl;
-  ss << obj << SetCameraFocalDistanceCommand({ m_focalDistance }).toPythonString() << std::endl;
+  commands.add<LoadVolumeFromFileCommand>(
+    LoadVolumeFromFileCommandD{ m_volumeImageFile.toStdString(), m_currentScene, m_currentTime });
+  commands.add<SetResolutionCommand>(SetResolutionCommandD{ m_resolutionX, m_resolutionY });
+  commands.add<SetBackgroundColorCommand>(
+    SetBackgroundColorCommandD{ m_backgroundColor.x, m_backgroundColor.y, m_backgroundColor.z });
+  commands.add<ShowBoundingBoxCommand>(ShowBoundingBoxCommandD{ m_showBoundingBox });
+  commands.add<SetBoundingBoxColorCommand>(
+    SetBoundingBoxColorCommandD{ m_boundingBoxColor.x, m_boundingBoxColor.y, m_boundingBoxColor.z });
+  commands.add<SetRenderIterationsCommand>(SetRenderIterationsCommandD{ m_renderIterations });
+  commands.add<SetPrimaryRayStepSizeCommand>(SetPrimaryRayStepSizeCommandD{ m_primaryStepSize });
+  commands.add<SetSecondaryRayStepSizeCommand>(SetSecondaryRayStepSizeCommandD{ m_secondaryStepSize });
+  commands.add<SetVoxelScaleCommand>(SetVoxelScaleCommandD{ m_scaleX, m_scaleY, m_scaleZ });
+  commands.add<SetClipRegionCommand>(
+    SetClipRegionCommandD{ m_roiXmin, m_roiXmax, m_roiYmin, m_roiYmax, m_roiZmin, m_roiZmax });
+  commands.add<SetCameraPosCommand>(SetCameraPosCommandD{ m_eyeX, m_eyeY, m_eyeZ });
+  commands.add<SetCameraTargetCommand>(SetCameraTargetCommandD{ m_targetX, m_targetY, m_targetZ });
+  commands.add<SetCameraUpCommand>(SetCameraUpCommandD{ m_upX, m_upY, m_upZ });
+  commands.add<SetCameraProjectionCommand>(
+    SetCameraProjectionCommandD{ m_projection, m_projection == Projection::PERSPECTIVE ? m_fov : m_orthoScale });
+
+  commands.add<SetCameraExposureCommand>(SetCameraExposureCommandD{ m_exposure });
+  commands.add<SetDensityCommand>(SetDensityCommandD{ m_densityScale });
+  commands.add<SetCameraApertureCommand>(SetCameraApertureCommandD{ m_apertureSize });
+  commands.add<SetCameraFocalDistanceCommand>(SetCameraFocalDistanceCommandD{ m_focalDistance });
 
   // per-channel
   for (std::int32_t i = 0; i < m_channels.size(); ++i) {
     const ChannelViewerState& ch = m_channels[i];
-    ss << obj << EnableChannelCommand({ i, ch.m_enabled ? 1 : 0 }).toPythonString() << std::endl;
-    ss << obj << SetDiffuseColorCommand({ i, ch.m_diffuse.x, ch.m_diffuse.y, ch.m_diffuse.z, 1.0f }).toPythonString()
-       << std::endl;
-    ss << obj
-       << SetSpecularColorCommand({ i, ch.m_specular.x, ch.m_specular.y, ch.m_specular.z, 0.0f }).toPythonString()
-       << std::endl;
-    ss << obj
-       << SetEmissiveColorCommand({ i, ch.m_emissive.x, ch.m_emissive.y, ch.m_emissive.z, 0.0f }).toPythonString()
-       << std::endl;
-    ss << obj << SetGlossinessCommand({ i, ch.m_glossiness }).toPythonString() << std::endl;
-    ss << obj << SetOpacityCommand({ i, ch.m_opacity }).toPythonString() << std::endl;
+    commands.add<EnableChannelCommand>(EnableChannelCommandD{ i, ch.m_enabled ? 1 : 0 });
+    commands.add<SetDiffuseColorCommand>(
+      SetDiffuseColorCommandD{ i, ch.m_diffuse.x, ch.m_diffuse.y, ch.m_diffuse.z, 1.0f });
+    commands.add<SetSpecularColorCommand>(
+      SetSpecularColorCommandD{ i, ch.m_specular.x, ch.m_specular.y, ch.m_specular.z, 0.0f });
+    commands.add<SetEmissiveColorCommand>(
+      SetEmissiveColorCommandD{ i, ch.m_emissive.x, ch.m_emissive.y, ch.m_emissive.z, 0.0f });
+    commands.add<SetGlossinessCommand>(SetGlossinessCommandD{ i, ch.m_glossiness });
+    commands.add<SetOpacityCommand>(SetOpacityCommandD{ i, ch.m_opacity });
     // depending on current mode:
     switch (LutParams::g_PermIdToGradientMode[ch.m_lutParams.m_mode]) {
       case GradientEditMode::WINDOW_LEVEL:
-        ss << obj << SetWindowLevelCommand({ i, ch.m_lutParams.m_window, ch.m_lutParams.m_level }).toPythonString()
-           << std::endl;
+        commands.add<SetWindowLevelCommand>(
+          SetWindowLevelCommandD{ i, ch.m_lutParams.m_window, ch.m_lutParams.m_level });
         break;
       case GradientEditMode::ISOVALUE:
-        ss << obj
-           << SetIsovalueThresholdCommand({ i, ch.m_lutParams.m_isovalue, ch.m_lutParams.m_isorange }).toPythonString()
-           << std::endl;
+        commands.add<SetIsovalueThresholdCommand>(
+          SetIsovalueThresholdCommandD{ i, ch.m_lutParams.m_isovalue, ch.m_lutParams.m_isorange });
         break;
       case GradientEditMode::PERCENTILE:
-        ss << obj
-           << SetPercentileThresholdCommand({ i, ch.m_lutParams.m_pctLow, ch.m_lutParams.m_pctHigh }).toPythonString()
-           << std::endl;
+        commands.add<SetPercentileThresholdCommand>(
+          SetPercentileThresholdCommandD{ i, ch.m_lutParams.m_pctLow, ch.m_lutParams.m_pctHigh });
         break;
       case GradientEditMode::CUSTOM:
         std::vector<float> v;
@@ -535,43 +515,53 @@ ViewerState::stateToPythonScript() const
           v.push_back(p.second);
           v.push_back(p.second);
         }
-        ss << obj << SetControlPointsCommand({ i, v }).toPythonString() << std::endl;
+        commands.add<SetControlPointsCommand>(SetControlPointsCommandD{ i, v });
         break;
     }
   }
 
   // lighting
-  ss << obj
-     << SetSkylightTopColorCommand({ m_light0.m_topColor.r * m_light0.m_topColorIntensity,
-                                     m_light0.m_topColor.g * m_light0.m_topColorIntensity,
-                                     m_light0.m_topColor.b * m_light0.m_topColorIntensity })
-          .toPythonString()
-     << std::endl;
-  ss << obj
-     << SetSkylightMiddleColorCommand({ m_light0.m_middleColor.r * m_light0.m_middleColorIntensity,
-                                        m_light0.m_middleColor.g * m_light0.m_middleColorIntensity,
-                                        m_light0.m_middleColor.b * m_light0.m_middleColorIntensity })
-          .toPythonString()
-     << std::endl;
-  ss << obj
-     << SetSkylightBottomColorCommand({ m_light0.m_bottomColor.r * m_light0.m_bottomColorIntensity,
-                                        m_light0.m_bottomColor.g * m_light0.m_bottomColorIntensity,
-                                        m_light0.m_bottomColor.b * m_light0.m_bottomColorIntensity })
-          .toPythonString()
-     << std::endl;
-  ss << obj << SetLightPosCommand({ 0, m_light1.m_distance, m_light1.m_theta, m_light1.m_phi }).toPythonString()
-     << std::endl;
-  ss << obj
-     << SetLightColorCommand({ 0,
-                               m_light1.m_color.r * m_light1.m_colorIntensity,
-                               m_light1.m_color.g * m_light1.m_colorIntensity,
-                               m_light1.m_color.b * m_light1.m_colorIntensity })
-          .toPythonString()
-     << std::endl;
-  ss << obj << SetLightSizeCommand({ 0, m_light1.m_width, m_light1.m_height }).toPythonString() << std::endl;
-
-  ss << obj << SessionCommand({ outFileName.toStdString() + ".png" }).toPythonString() << std::endl;
-  ss << obj << RequestRedrawCommand({}).toPythonString() << std::endl;
+  commands.add<SetSkylightTopColorCommand>(
+    SetSkylightTopColorCommandD{ m_light0.m_topColor.r * m_light0.m_topColorIntensity,
+                                 m_light0.m_topColor.g * m_light0.m_topColorIntensity,
+                                 m_light0.m_topColor.b * m_light0.m_topColorIntensity });
+  commands.add<SetSkylightMiddleColorCommand>(
+    SetSkylightMiddleColorCommandD{ m_light0.m_middleColor.r * m_light0.m_middleColorIntensity,
+                                    m_light0.m_middleColor.g * m_light0.m_middleColorIntensity,
+                                    m_light0.m_middleColor.b * m_light0.m_middleColorIntensity });
+  commands.add<SetSkylightBottomColorCommand>(
+    SetSkylightBottomColorCommandD{ m_light0.m_bottomColor.r * m_light0.m_bottomColorIntensity,
+                                    m_light0.m_bottomColor.g * m_light0.m_bottomColorIntensity,
+                                    m_light0.m_bottomColor.b * m_light0.m_bottomColorIntensity });
+  commands.add<SetLightPosCommand>(SetLightPosCommandD{ 0, m_light1.m_distance, m_light1.m_theta, m_light1.m_phi });
+  commands.add<SetLightColorCommand>(SetLightColorCommandD{ 0,
+                                                            m_light1.m_color.r * m_light1.m_colorIntensity,
+                                                            m_light1.m_color.g * m_light1.m_colorIntensity,
+                                                            m_light1.m_color.b * m_light1.m_colorIntensity });
+  commands.add<SetLightSizeCommand>(SetLightSizeCommandD{ 0, m_light1.m_width, m_light1.m_height });
+}
+
+QString
+ViewerState::stateToPythonScript() const
+{
+  QFileInfo fi(m_volumeImageFile);
+  QString outFileName = fi.baseName();
+
+  CommandList commands;
+  stateToCommands(commands);
+  commands.add<SessionCommand>(SessionCommandD{ outFileName.toStdString() + ".png" });
+  commands.add<RequestRedrawCommand>(RequestRedrawCommandD{});
+
+  std::ostringstream ss;
+  ss << "# pip install agave_pyclient" << std::endl;
+  ss << "# agave --server &" << std::endl;
+  ss << "# python myscript.py" << std::endl << std::endl;
+  ss << "import agave_pyclient as agave" << std::endl << std::endl;
+  ss << "r = agave.AgaveRenderer()" << std::endl;
+  std::string obj = "r.";
+  for (const Command* c : commands.commands()) {
+    ss << obj << c->toPythonString() << std::endl;
+  }
   std::string s(ss.str());
   // LOG_DEBUG << s;
   return QString::fromStdString(s);
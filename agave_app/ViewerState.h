@@ -11,6 +11,8 @@
 #include <map>
 #include <vector>
 
+class CommandList;
+
 struct LutParams
 {
   static std::map<GradientEditMode, int> g_GradientModeToPermId;
@@ -85,6 +87,8 @@ struct ViewerState
 
   QJsonDocument stateToJson() const;
   QString stateToPythonScript() const;
+  // the commands that set up this state on a renderer
+  void stateToCommands(CommandList& commands) const;
 
   void stateFromJson(QJsonDocument& jsonDoc);
 
@@ -7,18 +7,6 @@
 #include <assert.h>
 #include <vector>
 
-#if HAVE_BYTESWAP_H
-#include <byteswap.h>
-#else
-#define bswap_16(value) ((((value)&0xff) << 8) | ((value) >> 8))
-
-#define bswap_32(value)                                                                                                \
-  (((uint32_t)bswap_16((uint16_t)((value)&0xffff)) << 16) | (uint32_t)bswap_16((uint16_t)((value) >> 16)))
-
-#define bswap_64(value)                                                                                                \
-  (((uint64_t)bswap_32((uint32_t)((value)&0xffffffff)) << 32) | (uint64_t)bswap_32((uint32_t)((value) >> 32)))
-#endif
-
 commandBuffer::commandBuffer(size_t len, const uint8_t* buf)
   : _length(len)
   , _headPos(buf)
@@ -26,11 +14,6 @@ commandBuffer::commandBuffer(size_t len, const uint8_t* buf)
 
 commandBuffer::~commandBuffer() {}
 
-CommandBufferIterator::CommandBufferIterator(commandBuffer* buf)
-  : _commandBuffer(buf)
-  , _currentPos(const_cast<uint8_t*>(buf->head()))
-{}
-
 //////////////////
 // forward declare.
 
@@ -39,12 +22,23 @@ CommandBufferIterator::CommandBufferIterator(commandBuffer* buf)
     return CMDCLASS::parse(&iterator);                                                                                 \
     break;
 
-void
+bool
 commandBuffer::processBuffer()
 {
+  size_t offset = 0, length = 0;
+  std::string error;
+  if (!findCommandPayload(_headPos, _length, offset, length, error)) {
+    LOG_WARNING << "Rejected command message: " << error;
+    return false;
+  }
+
   int32_t previousCmd = -1;
-  CommandBufferIterator iterator(this);
+  CommandReader iterator(_headPos + offset, length, _commands);
   while (!iterator.end()) {
+    if (iterator.remaining() < sizeof(int32_t)) {
+      LOG_WARNING << "Command message ends with " << iterator.remaining() << " stray bytes";
+      break;
+    }
     // new command.
     // read its int32 enum value.
     int32_t cmd = iterator.parseInt32();
@@ -97,6 +91,18 @@ commandBuffer::processBuffer()
           CMD_CASE(SetBoundingBoxColorCommand);
           CMD_CASE(ShowBoundingBoxCommand);
           CMD_CASE(TrackballCameraCommand);
+          CMD_CASE(SetVolumeCropCommand);
+          CMD_CASE(SetErrorTargetCommand);
+          CMD_CASE(SetInteractiveDownsampleCommand);
+          CMD_CASE(SetTemporalReprojectionCommand);
+          CMD_CASE(SetDenoiseCommand);
+          CMD_CASE(SetTiledRenderingCommand);
+          CMD_CASE(SetStreamCodecCommand);
+          CMD_CASE(SetFrameDiffCommand);
+          CMD_CASE(SetStreamPacingCommand);
+          CMD_CASE(BatchRenderCommand);
+          CMD_CASE(SetHalfFloatAccumulationCommand);
+          CMD_CASE(SetGpuVolumeBudgetCommand);
           default:
             // ERROR UNRECOGNIZED COMMAND SIGNATURE.
             // PRINT OUT PREVIOUS! BAIL OUT! OR DO SOMETHING CLEVER AND CORRECT!
@@ -105,7 +111,7 @@ commandBuffer::processBuffer()
             break;
         }
       } catch (...) {
-        // buffer error?
+        // buffer error? the reader throws rather than read past the end of the message.
         LOG_WARNING << "Exception thrown when parsing command index: " << cmd;
         return nullptr;
       }
@@ -113,10 +119,8 @@ commandBuffer::processBuffer()
       return nullptr;
     }();
 
-    if (c) {
-      // good! add to list of commands
-      _commands.push_back(c);
-    } else {
+    // good! the command went to the end of the list as it was parsed
+    if (!c) {
       // error! do something.
       LOG_WARNING << "Previous parsed command :" << previousCmd;
       LOG_WARNING << "No further commands will be parsed for this batch.";
@@ -124,56 +128,14 @@ commandBuffer::processBuffer()
     }
     previousCmd = cmd;
   }
+  return true;
 }
 
 void
 commandBuffer::execute(ExecutionContext* c)
 {
   // let's run all the commands now
-  for (auto i = _commands.begin(); i != _commands.end(); ++i) {
+  for (auto i = _commands.commands().begin(); i != _commands.commands().end(); ++i) {
     (*i)->execute(c);
   }
 }
-
-bool
-CommandBufferIterator::end()
-{
-  return (_currentPos >= _commandBuffer->head() + _commandBuffer->length());
-}
-
-int32_t
-CommandBufferIterator::parseInt32()
-{
-  int32_t value = bswap_32(*((int32_t*)(_currentPos)));
-  _currentPos += sizeof(int32_t);
-  return value;
-}
-
-float
-CommandBufferIterator::parseFloat32()
-{
-  // assuming sizeof float == sizeof int32 == 4
-  // float value = (float)bswap_32(*((int32_t*)(_currentPos)));
-  float value = *((float*)(_currentPos));
-  _currentPos += sizeof(float);
-  return value;
-}
-
-std::string
-CommandBufferIterator::parseString()
-{
-  int32_t len = parseInt32();
-  std::string s(reinterpret_cast<char const*>(_currentPos), (size_t)len);
-  _currentPos += len;
-  return s;
-}
-
-std::vector<float>
-CommandBufferIterator::parseFloat32Array()
-{
-  int32_t len = parseInt32();
-  float* p = (float*)(_currentPos);
-  std::vector<float> v(p, p + len);
-  _currentPos += len * sizeof(float);
-  return v;
-}
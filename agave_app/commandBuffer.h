@@ -1,6 +1,7 @@
 #pragma once
 
 #include "command.h"
+#include "renderlib/CommandStream.h"
 
 #include <stdint.h>
 #include <string>
@@ -17,33 +18,20 @@ public:
   commandBuffer(size_t len, const uint8_t* buf);
   virtual ~commandBuffer();
 
-  void processBuffer();
+  // Parse the commands of the message, see findCommandPayload. Returns false if the message header is invalid, in
+  // which case there are no commands. A bad command ends the batch but keeps the ones before it.
+  bool processBuffer();
   void execute(ExecutionContext* c);
   const uint8_t* head() { return _headPos; }
   size_t length() { return _length; }
 
-  std::vector<Command*> getQueue() { return _commands; }
+  // hand the parsed commands over; the buffer is left empty
+  CommandList takeQueue() { return std::move(_commands); }
 
 private:
   size_t _length;
   const uint8_t* _headPos;
 
   // queue really.
-  std::vector<Command*> _commands;
-};
-
-class CommandBufferIterator : public ParseableStream
-{
-public:
-  CommandBufferIterator(commandBuffer* buf);
-
-  bool end();
-
-  virtual int32_t parseInt32();
-  virtual float parseFloat32();
-  virtual std::vector<float> parseFloat32Array();
-  virtual std::string parseString();
-
-  commandBuffer* _commandBuffer;
-  uint8_t* _currentPos;
+  CommandList _commands;
 };
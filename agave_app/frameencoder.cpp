@@ -0,0 +1,154 @@
+#include "frameencoder.h"
+
+#include "renderlib/Logging.h"
+
+#include <QBuffer>
+#include <QImageWriter>
+#include <QWebSocket>
+#include <QtEndian>
+
+#include <cstring>
+
+bool
+StreamCodec::fromName(const std::string& name, Type& type)
+{
+  if (name == "jpeg" || name == "jpg") {
+    type = JPEG;
+  } else if (name == "png") {
+    type = PNG;
+  } else if (name == "webp") {
+    // webp comes from an optional Qt image format plugin
+    if (!QImageWriter::supportedImageFormats().contains("webp")) {
+      return false;
+    }
+    type = WEBP;
+  } else if (name == "raw") {
+    type = RAW;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+QByteArray
+encodeFrame(const QImage& image, const StreamCodec& codec)
+{
+  QByteArray ba;
+  if (codec.m_type == StreamCodec::RAW) {
+    QImage rgba = image.convertToFormat(QImage::Format_RGBA8888);
+    const int rowBytes = rgba.width() * 4;
+    ba.resize(8 + rowBytes * rgba.height());
+    qToLittleEndian<quint32>(rgba.width(), ba.data());
+    qToLittleEndian<quint32>(rgba.height(), ba.data() + 4);
+    // rows of a 32 bit image are not padded
+    memcpy(ba.data() + 8, rgba.constBits(), rowBytes * rgba.height());
+    return ba;
+  }
+
+  static const char* formats[] = { "JPG", "PNG", "WEBP" };
+  QBuffer buffer(&ba);
+  buffer.open(QIODevice::WriteOnly);
+  QImageWriter writer(&buffer, formats[codec.m_type]);
+  // for png the quality would set the zlib compression level instead
+  if (codec.m_type != StreamCodec::PNG) {
+    writer.setQuality(codec.m_quality);
+  }
+  if (!writer.write(image)) {
+    LOG_ERROR << "Frame encoding failed: " << writer.errorString().toStdString();
+  }
+  return ba;
+}
+
+namespace {
+
+void
+appendUint32(QByteArray& ba, quint32 value)
+{
+  char bytes[4];
+  qToLittleEndian<quint32>(value, bytes);
+  ba.append(bytes, 4);
+}
+
+} // namespace
+
+QByteArray
+encodeDeltaFrame(const QImage& image, const std::vector<ImageTile>& tiles, const StreamCodec& codec)
+{
+  QByteArray ba("AGVD");
+  appendUint32(ba, image.width());
+  appendUint32(ba, image.height());
+  appendUint32(ba, (quint32)tiles.size());
+  for (const ImageTile& tile : tiles) {
+    QByteArray encoded = encodeFrame(image.copy(tile.m_x, tile.m_y, tile.m_w, tile.m_h), codec);
+    appendUint32(ba, tile.m_x);
+    appendUint32(ba, tile.m_y);
+    appendUint32(ba, tile.m_w);
+    appendUint32(ba, tile.m_h);
+    appendUint32(ba, encoded.size());
+    ba.append(encoded);
+  }
+  return ba;
+}
+
+FrameEncoder::FrameEncoder(int numThreads, QObject* parent)
+  : QObject(parent)
+  , m_nextConnection(0)
+{
+  m_pool.setMaxThreadCount(numThreads);
+  qRegisterMetaType<QWebSocket*>("QWebSocket*");
+}
+
+FrameEncoder::~FrameEncoder()
+{
+  m_pool.waitForDone();
+}
+
+void
+FrameEncoder::encode(QWebSocket* client,
+                     const QImage& image,
+                     const StreamCodec& codec,
+                     const std::vector<ImageTile>* tiles)
+{
+  auto it = m_clients.find(client);
+  if (it == m_clients.end()) {
+    it = m_clients.insert(client, ClientFrames());
+    it->m_connection = m_nextConnection++;
+  }
+  const quint64 connection = it->m_connection;
+  const quint64 sequence = it->m_nextSubmitted++;
+  const bool delta = tiles != nullptr;
+  std::vector<ImageTile> deltaTiles = delta ? *tiles : std::vector<ImageTile>();
+  // the image is implicitly shared, so the worker holds on to the pixels without a copy
+  m_pool.start([this, client, connection, sequence, image, codec, delta, deltaTiles]() {
+    QByteArray data = delta ? encodeDeltaFrame(image, deltaTiles, codec) : encodeFrame(image, codec);
+    QMetaObject::invokeMethod(this,
+                              "onEncoded",
+                              Qt::QueuedConnection,
+                              Q_ARG(QWebSocket*, client),
+                              Q_ARG(quint64, connection),
+                              Q_ARG(quint64, sequence),
+                              Q_ARG(QByteArray, data));
+  });
+}
+
+void
+FrameEncoder::removeClient(QWebSocket* client)
+{
+  m_clients.remove(client);
+}
+
+void
+FrameEncoder::onEncoded(QWebSocket* client, quint64 connection, quint64 sequence, QByteArray data)
+{
+  auto it = m_clients.find(client);
+  if (it == m_clients.end() || it->m_connection != connection) {
+    // the client went away while the frame was encoded
+    return;
+  }
+  ClientFrames& frames = it.value();
+  frames.m_done.insert(sequence, data);
+  while (!frames.m_done.isEmpty() && frames.m_done.firstKey() == frames.m_nextToSend) {
+    emit frameEncoded(client, frames.m_done.take(frames.m_nextToSend));
+    frames.m_nextToSend++;
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef FRAMEENCODER_H
+#define FRAMEENCODER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QMap>
+#include <QObject>
+#include <QThreadPool>
+
+#include "renderlib/TiledRender.h"
+
+#include <string>
+#include <vector>
+
+class QWebSocket;
+
+// How the frames of one session are compressed before they are sent.
+struct StreamCodec
+{
+  enum Type
+  {
+    JPEG = 0,
+    PNG,
+    WEBP,
+    // 8 byte header of little endian uint32 width and height, then 8 bit RGBA pixels
+    RAW
+  };
+  Type m_type = JPEG;
+  // 0-100, for the lossy codecs
+  int m_quality = 92;
+
+  // "jpeg", "png", "webp" or "raw". Returns false for names that this build can not encode.
+  static bool fromName(const std::string& name, Type& type);
+};
+
+QByteArray
+encodeFrame(const QImage& image, const StreamCodec& codec);
+
+// A frame that only holds the tiles of the image that changed, each encoded on its own:
+// "AGVD", then little endian uint32 image width, height and tile count, then per tile uint32 x, y, w, h (y = 0 is the
+// top row), the uint32 byte count of the encoded tile and the encoded tile.
+QByteArray
+encodeDeltaFrame(const QImage& image, const std::vector<ImageTile>& tiles, const StreamCodec& codec);
+
+// Encodes frames on a pool of worker threads, so that the server thread only hands images over and sends the results.
+// Frames of one client are delivered in the order they were submitted.
+class FrameEncoder : public QObject
+{
+  Q_OBJECT
+
+public:
+  FrameEncoder(int numThreads, QObject* parent = nullptr);
+  ~FrameEncoder();
+
+  // frameEncoded is emitted on the thread that owns the encoder. With tiles, only those are sent as a delta frame.
+  void encode(QWebSocket* client,
+              const QImage& image,
+              const StreamCodec& codec,
+              const std::vector<ImageTile>* tiles = nullptr);
+  // drop the frames of a client that went away
+  void removeClient(QWebSocket* client);
+
+signals:
+  void frameEncoded(QWebSocket* client, QByteArray data);
+
+private slots:
+  void onEncoded(QWebSocket* client, quint64 connection, quint64 sequence, QByteArray data);
+
+private:
+  QThreadPool m_pool;
+
+  struct ClientFrames
+  {
+    // a socket that is deleted after its client went away may come back at the same address for a new client; frames
+    // still being encoded for the old one are told apart by this number
+    quint64 m_connection = 0;
+    quint64 m_nextSubmitted = 0;
+    quint64 m_nextToSend = 0;
+    // encoded frames that finished ahead of an earlier one
+    QMap<quint64, QByteArray> m_done;
+  };
+  QMap<QWebSocket*, ClientFrames> m_clients;
+  quint64 m_nextConnection;
+};
+
+#endif // FRAMEENCODER_H
@@ -1,19 +1,27 @@
 #include "agaveGui.h"
 
 #include "mainwindow.h"
+#include "renderlib/CommandRecording.h"
 #include "renderlib/FileReader.h"
 #include "renderlib/Logging.h"
 #include "renderlib/renderlib.h"
 #include "renderlib/version.h"
+#include "renderscript.h"
+#include "replay.h"
 #include "streamserver.h"
 
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QDir>
+#include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
 struct ServerParams
 {
   int _port;
@@ -74,15 +82,42 @@ readConfig(QString configPath)
 void
 preloadFiles(QStringList preloadlist)
 {
+  std::vector<std::shared_ptr<ImageXYZC>> images;
   for (QString s : preloadlist) {
     QFileInfo info(s);
     if (info.exists()) {
-      auto img = FileReader::loadFromFile_4D(info.absoluteFilePath().toStdString(), nullptr, true);
-      renderlib::imageAllocGPU(img);
+      images.push_back(FileReader::loadFromFile_4D(info.absoluteFilePath().toStdString(), nullptr, true));
     } else {
       LOG_INFO << "Could not load " << s.toStdString();
     }
   }
+  // every device gets its own copy, so that sessions can be placed on any of them
+  for (int device = 0; device < renderlib::deviceCount(); ++device) {
+    renderlib::makeDeviceCurrent(device);
+    for (auto img : images) {
+      renderlib::imageAllocGPU(img);
+    }
+    // renderer contexts sample these textures without further synchronization
+    glFinish();
+  }
+  renderlib::makeDeviceCurrent(0);
+}
+
+// "all", or a comma separated list of device indices
+std::vector<int>
+parseGpuList(QString value)
+{
+  std::vector<int> gpus;
+  if (value.trimmed() == "all") {
+    return gpus;
+  }
+  for (QString s : value.split(',', Qt::SkipEmptyParts)) {
+    gpus.push_back(s.trimmed().toInt());
+  }
+  if (gpus.empty()) {
+    gpus.push_back(0);
+  }
+  return gpus;
 }
 
 int
@@ -108,12 +143,46 @@ main(int argc, char* argv[])
   QCommandLineOption serverOption("server",
                                   QCoreApplication::translate("main", "Run as websocket server without GUI."));
   parser.addOption(serverOption);
+  QCommandLineOption renderOption(
+    "render",
+    QCoreApplication::translate("main",
+                                "Render a viewer state, a recorded command stream, or a JSON list of jobs to image "
+                                "files without GUI, then exit."),
+    QCoreApplication::translate("main", "script"));
+  parser.addOption(renderOption);
+  QCommandLineOption recordOption(
+    "record",
+    QCoreApplication::translate("main",
+                                "Record every command message the server receives to a file, to replay it with "
+                                "--replay (only valid in --server mode)."),
+    QCoreApplication::translate("main", "recording"));
+  parser.addOption(recordOption);
+  QCommandLineOption replayOption(
+    "replay",
+    QCoreApplication::translate("main",
+                                "Replay a recording made with --record without GUI, and print the request latency, "
+                                "frame times and samples per second as JSON."),
+    QCoreApplication::translate("main", "recording"));
+  parser.addOption(replayOption);
+  QCommandLineOption replaySpeedOption(
+    "replay_speed",
+    QCoreApplication::translate("main",
+                                "Send the recorded messages this many times as fast as they came in. 0 sends each one "
+                                "once its session has caught up, for the same work on every run (only valid in "
+                                "--replay mode)."),
+    QCoreApplication::translate("main", "speed"),
+    "1");
+  parser.addOption(replaySpeedOption);
   QCommandLineOption listDevicesOption(
-    "list_devices", QCoreApplication::translate("main", "Log the known EGL devices (only valid in --server mode)."));
+    "list_devices",
+    QCoreApplication::translate("main", "Log the known EGL devices (only valid in --server and --render modes)."));
   parser.addOption(listDevicesOption);
   QCommandLineOption selectGpuOption(
     "gpu",
-    QCoreApplication::translate("main", "Select EGL device by index (only valid in --server mode)."),
+    QCoreApplication::translate(
+      "main",
+      "Select EGL devices by index, as a comma separated list or \"all\" (only valid in --server and --render modes). "
+      "Sessions and jobs are spread over the devices. An index may repeat, to use more than one context on it."),
     QCoreApplication::translate("main", "gpu"),
     "0");
   parser.addOption(selectGpuOption);
@@ -127,21 +196,51 @@ main(int argc, char* argv[])
   parser.process(a);
 
   bool isServer = parser.isSet(serverOption);
+  bool isRender = parser.isSet(renderOption);
+  bool isReplay = parser.isSet(replayOption);
   bool listDevices = parser.isSet(listDevicesOption);
-  int selectedGpu = parser.value(selectGpuOption).toInt();
+  std::vector<int> selectedGpus = parseGpuList(parser.value(selectGpuOption));
 
-  if (!renderlib::initialize(isServer, listDevices, selectedGpu)) {
+  if (!renderlib::initialize(isServer || isRender || isReplay, listDevices, selectedGpus)) {
     renderlib::cleanup();
     return 0;
   }
 
   int result = 0;
 
-  if (isServer) {
+  if (isRender) {
+    std::vector<RenderJob> jobs;
+    if (readRenderScript(parser.value(renderOption), jobs)) {
+      result = (runRenderJobs(jobs) == 0) ? 0 : 1;
+    } else {
+      result = 1;
+    }
+  } else if (isReplay) {
+    QFile file(parser.value(replayOption));
+    std::vector<RecordedMessage> messages;
+    std::string error;
+    if (!file.open(QIODevice::ReadOnly)) {
+      LOG_ERROR << "Can not open " << file.fileName().toStdString();
+      result = 1;
+    } else {
+      QByteArray data = file.readAll();
+      if (!readCommandRecording(reinterpret_cast<const uint8_t*>(data.constData()), data.size(), messages, error)) {
+        // replay what is there; a server that was killed leaves a partly written message at the end
+        LOG_WARNING << file.fileName().toStdString() << ": " << error;
+      }
+      ReplayBenchmark replay(messages, std::max(parser.value(replaySpeedOption).toDouble(), 0.0));
+      replay.start();
+      result = a.exec();
+      std::cout << replay.report().toStdString() << std::endl;
+    }
+  } else if (isServer) {
     QString configPath = parser.value(serverConfigOption);
     ServerParams p = readConfig(configPath);
 
     StreamServer* server = new StreamServer(p._port, false, 0);
+    if (parser.isSet(recordOption) && !server->startRecording(parser.value(recordOption))) {
+      result = 1;
+    }
 
     // set to true to show windows, or false to run as a console application
     static const bool gui = false;
@@ -512,6 +512,55 @@ OffscreenRenderer::ShowBoundingBox(int32_t on)
   return 1;
 }
 int
+OffscreenRenderer::SetVolumeCrop(int32_t on)
+{
+  SetVolumeCropCommand cmd({ on });
+  cmd.execute(&m_ec);
+  return 1;
+}
+int
+OffscreenRenderer::SetErrorTarget(float target)
+{
+  SetErrorTargetCommand cmd({ target });
+  cmd.execute(&m_ec);
+  return 1;
+}
+int
+OffscreenRenderer::SetInteractiveDownsample(int32_t factor)
+{
+  SetInteractiveDownsampleCommand cmd({ factor });
+  cmd.execute(&m_ec);
+  return 1;
+}
+int
+OffscreenRenderer::SetTemporalReprojection(int32_t enabled)
+{
+  SetTemporalReprojectionCommand cmd({ enabled });
+  cmd.execute(&m_ec);
+  return 1;
+}
+int
+OffscreenRenderer::SetDenoise(int32_t enabled)
+{
+  SetDenoiseCommand cmd({ enabled });
+  cmd.execute(&m_ec);
+  return 1;
+}
+int
+OffscreenRenderer::SetHalfFloatAccumulation(int32_t enabled)
+{
+  SetHalfFloatAccumulationCommand cmd({ enabled });
+  cmd.execute(&m_ec);
+  return 1;
+}
+int
+OffscreenRenderer::SetGpuVolumeBudget(int32_t megabytes)
+{
+  SetGpuVolumeBudgetCommand cmd({ megabytes });
+  cmd.execute(&m_ec);
+  return 1;
+}
+int
 OffscreenRenderer::SetIsovalueThreshold(int32_t channel, float isovalue, float isorange)
 {
   SetIsovalueThresholdCommand cmd({ channel, isovalue, isorange });
@@ -102,6 +102,13 @@ public:
   virtual int SetControlPoints(int32_t, std::vector<float>);
   virtual int SetBoundingBoxColor(float, float, float);
   virtual int ShowBoundingBox(int32_t);
+  virtual int SetVolumeCrop(int32_t);
+  virtual int SetErrorTarget(float);
+  virtual int SetInteractiveDownsample(int32_t);
+  virtual int SetTemporalReprojection(int32_t);
+  virtual int SetDenoise(int32_t);
+  virtual int SetHalfFloatAccumulation(int32_t);
+  virtual int SetGpuVolumeBudget(int32_t);
 
 protected:
   void init();
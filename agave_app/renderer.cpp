@@ -1,38 +1,97 @@
 #include "renderer.h"
 
+#include "renderlib/AppScene.h"
 #include "renderlib/CCamera.h"
+#include "renderlib/CameraPath.h"
 #include "renderlib/FileReader.h"
+#include "renderlib/FrameDiff.h"
 #include "renderlib/Logging.h"
 #include "renderlib/RenderGLPT.h"
 #include "renderlib/RenderSettings.h"
+#include "renderlib/TiledRender.h"
 
 #include "command.h"
 #include "commandBuffer.h"
 
 #include <QApplication>
+#include <QDir>
 #include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QMessageBox>
 #include <QOpenGLFramebufferObjectFormat>
+#include <QSemaphore>
+#include <QThreadPool>
 
-Renderer::Renderer(QString id, QObject* parent, QMutex& mutex)
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+// stream mode stops sending new frames once this many pixels have reached the adaptive sampling error target
+static const float CONVERGED_PIXEL_FRACTION = 0.999f;
+
+// How long a session keeps the renderer while others wait. Swapping sessions copies the images in and out and
+// re-uploads what the scenes do not share, so this is a lot longer than one frame.
+static const qint64 TIME_SLICE_MS = 500;
+
+// pixel samples of a frame of the session, for benchmarks; interactive downsampling is not taken into account
+static qint64
+frameSamples(const RenderSession* session)
+{
+  const int iterations =
+    (session->m_tileSize > 0) ? session->m_tileSamples : session->m_camera->m_Film.m_ExposureIterations;
+  return (qint64)session->m_width * session->m_height * iterations;
+}
+
+// Whether path, which need not exist yet, is root or below it once symbolic links are followed. Links can only
+// redirect the part of the path that exists.
+static bool
+isInsideDirectory(const QString& path, const QString& root)
+{
+  QString canonicalRoot = QFileInfo(root).canonicalFilePath();
+  if (canonicalRoot.isEmpty()) {
+    return false;
+  }
+  if (!canonicalRoot.endsWith('/')) {
+    canonicalRoot += '/';
+  }
+
+  QString existing = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+  while (!QFileInfo::exists(existing)) {
+    const QString parent = QFileInfo(existing).path();
+    if (parent == existing) {
+      return false;
+    }
+    existing = parent;
+  }
+  const QString canonical = QFileInfo(existing).canonicalFilePath() + '/';
+  return canonical.startsWith(canonicalRoot);
+}
+
+Renderer::Renderer(QString id, QObject* parent, QMutex& mutex, int device)
   : QThread(parent)
   , m_id(id)
-  , m_streamMode(0)
-  , m_fbo(nullptr)
-  , m_width(0)
-  , m_height(0)
   , m_openGLMutex(&mutex)
+  , m_device(device)
+  , m_gpuBytes(0)
+  , m_fbo(nullptr)
+  , m_readback(nullptr)
+  , m_session(nullptr)
+  , m_renderer(nullptr)
+  , m_idleRenderSettings(nullptr)
+  , m_fixedRandomSeed(-1)
+  , m_idle(false)
 {
-  this->m_totalQueueDuration = 0;
-
   LOG_DEBUG << "Renderer " << id.toStdString() << " -- Initializing rendering thread...";
   LOG_DEBUG << "Renderer " << id.toStdString() << " -- Done.";
 }
 
 Renderer::~Renderer()
 {
-  // delete all outstanding requests.
-  qDeleteAll(this->m_requests);
+  // delete all outstanding sessions and their requests.
+  qDeleteAll(this->m_sessions);
+  qDeleteAll(this->m_closedSessions);
 }
 
 void
@@ -40,19 +99,145 @@ Renderer::myVolumeInit()
 {
   static const int initWidth = 1024, initHeight = 1024;
 
-  m_myVolumeData.m_renderSettings = new RenderSettings();
+  m_idleRenderSettings = new RenderSettings();
+
+  m_renderer = new RenderGLPT(m_idleRenderSettings);
+  m_renderer->initialize(initWidth, initHeight);
+  m_renderer->setFixedRandomSeed(m_fixedRandomSeed);
+}
+
+void
+Renderer::addSession(RenderSession* session)
+{
+  QMutexLocker locker(&m_sessionsMutex);
+  m_sessions << session;
+  // the session may have collected requests before it got here
+  m_workAvailable.wakeAll();
+}
 
-  m_myVolumeData.m_camera = new CCamera();
-  m_myVolumeData.m_camera->m_Film.m_ExposureIterations = 1;
-  m_myVolumeData.m_camera->m_Film.m_Resolution.SetResX(initWidth);
-  m_myVolumeData.m_camera->m_Film.m_Resolution.SetResY(initHeight);
+void
+Renderer::removeSession(RenderSession* session)
+{
+  QMutexLocker locker(&m_sessionsMutex);
+  if (m_sessions.removeAll(session) > 0) {
+    m_closedSessions << session;
+    m_workAvailable.wakeAll();
+  }
+}
 
-  m_myVolumeData.m_scene = new Scene();
-  m_myVolumeData.m_scene->initLights();
+void
+Renderer::wake()
+{
+  // taking the lock makes sure the render thread is either before its check for work or already waiting
+  QMutexLocker locker(&m_sessionsMutex);
+  m_workAvailable.wakeAll();
+}
 
-  m_myVolumeData.m_renderer = new RenderGLPT(m_myVolumeData.m_renderSettings);
-  m_myVolumeData.m_renderer->initialize(initWidth, initHeight);
-  m_myVolumeData.m_renderer->setScene(m_myVolumeData.m_scene);
+void
+Renderer::stop()
+{
+  requestInterruption();
+  wake();
+}
+
+void
+Renderer::waitForWork()
+{
+  QMutexLocker locker(&m_sessionsMutex);
+  while (!isInterruptionRequested() && m_closedSessions.isEmpty()) {
+    foreach (RenderSession* session, m_sessions) {
+      if (session->hasRequests()) {
+        return;
+      }
+    }
+    m_idle = true;
+    m_workAvailable.wait(&m_sessionsMutex);
+    m_idle = false;
+  }
+}
+
+int
+Renderer::getSessionCount()
+{
+  QMutexLocker locker(&m_sessionsMutex);
+  return m_sessions.count();
+}
+
+int
+Renderer::getTotalQueueDuration()
+{
+  QMutexLocker locker(&m_sessionsMutex);
+  int duration = 0;
+  foreach (RenderSession* session, m_sessions) {
+    duration += session->getTotalQueueDuration();
+  }
+  return duration;
+}
+
+int
+Renderer::getRequestCount()
+{
+  QMutexLocker locker(&m_sessionsMutex);
+  int count = 0;
+  foreach (RenderSession* session, m_sessions) {
+    count += session->getRequestCount();
+  }
+  return count;
+}
+
+RenderSession*
+Renderer::nextSession()
+{
+  QMutexLocker locker(&m_sessionsMutex);
+
+  if (!m_closedSessions.isEmpty()) {
+    if (m_closedSessions.contains(m_session)) {
+      activateSession(nullptr);
+    }
+    foreach (RenderSession* session, m_closedSessions) {
+      m_renderer->forgetScene(session->m_renderSettings);
+    }
+    qDeleteAll(m_closedSessions);
+    m_closedSessions.clear();
+  }
+
+  if (m_session && m_session->hasRequests() && !m_sliceTimer.hasExpired(TIME_SLICE_MS)) {
+    return m_session;
+  }
+
+  // round robin, starting after the current session
+  const int n = m_sessions.count();
+  const int start = m_sessions.indexOf(m_session) + 1;
+  for (int i = 0; i < n; ++i) {
+    RenderSession* session = m_sessions[(start + i) % n];
+    if (session->hasRequests()) {
+      m_sliceTimer.start();
+      return session;
+    }
+  }
+  return nullptr;
+}
+
+void
+Renderer::activateSession(RenderSession* session)
+{
+  // frames still being read back belong to the session that drew them
+  if (m_readback) {
+#if HAS_EGL
+    this->m_glContext->makeCurrent();
+#else
+    this->m_glContext->makeCurrent(this->m_surface);
+#endif
+    m_readback->clear();
+  }
+
+  m_session = session;
+  if (session) {
+    m_renderer->swapScene(session->m_scene, session->m_renderSettings);
+  } else {
+    m_renderer->swapScene(nullptr, m_idleRenderSettings);
+  }
+  resizeRenderTargets();
 }
 
 void
@@ -62,8 +247,12 @@ Renderer::init()
   // QMessageBox::information(this, "Info:", "Application Directory: " + QApplication::applicationDirPath() + "\n" +
   // "Working Directory: " + QDir::currentPath());
 
+  // contexts join the share group of the preloaded volumes one at a time; after that each renderer
+  // draws in its own context without holding the lock.
+  m_openGLMutex->lock();
 #if HAS_EGL
-  this->m_glContext = new HeadlessGLContext();
+  this->m_glContext = new HeadlessGLContext(m_device);
+  m_openGLMutex->unlock();
   this->m_glContext->makeCurrent();
 #else
   this->m_glContext = renderlib::createOpenGLContext();
@@ -71,6 +260,7 @@ Renderer::init()
   this->m_surface = new QOffscreenSurface();
   this->m_surface->setFormat(this->m_glContext->format());
   this->m_surface->create();
+  m_openGLMutex->unlock();
 
   /*this->context->doneCurrent();
   this->context->moveToThread(this);*/
@@ -86,7 +276,8 @@ Renderer::init()
   // INIT THE RENDER LIB
   ///////////////////////////////////
 
-  this->resizeGL(1024, 1024);
+  m_readback = new GLPixelReadback();
+  resizeRenderTargets();
 
   int MaxSamples = 0;
   glGetIntegerv(GL_MAX_SAMPLES, &MaxSamples);
@@ -118,9 +309,11 @@ Renderer::run()
   myVolumeInit();
 
   while (!QThread::currentThread()->isInterruptionRequested()) {
-    this->processRequest();
-
-    QApplication::processEvents();
+    if (this->processRequest()) {
+      QApplication::processEvents();
+    } else {
+      waitForWork();
+    }
   }
 
 #if HAS_EGL
@@ -128,94 +321,104 @@ Renderer::run()
 #else
   this->m_glContext->makeCurrent(this->m_surface);
 #endif
-  m_myVolumeData.m_renderer->cleanUpResources();
+  activateSession(nullptr);
+  m_renderer->cleanUpResources();
   shutDown();
 }
 
-void
-Renderer::addRequest(RenderRequest* request)
-{
-  this->m_requests << request;
-  this->m_totalQueueDuration += request->getDuration();
-}
-
 bool
 Renderer::processRequest()
 {
-  if (this->m_requests.isEmpty()) {
+  RenderSession* session = nextSession();
+  if (!session) {
     return false;
   }
+  if (session != m_session) {
+    activateSession(session);
+  }
 
-  if (m_streamMode != 0) {
-    QElapsedTimer timer;
-    timer.start();
-
-    RenderRequest* lastReq = nullptr;
-
-    // eat requests until done, and then render
-    // note that any one request could change the streaming mode.
-    while (!this->m_requests.isEmpty() && m_streamMode != 0) {
-
-      RenderRequest* r = this->m_requests.takeFirst();
-      this->m_totalQueueDuration -= r->getDuration();
-
-      std::vector<Command*> cmds = r->getParameters();
-      if (cmds.size() > 0) {
-        this->processCommandBuffer(r);
-      }
-
-      // the true last request will be passed to "emit" and deleted later
-      if (!this->m_requests.isEmpty() && m_streamMode != 0) {
-        delete r;
-      } else {
-        lastReq = r;
-      }
-    }
+  QElapsedTimer timer;
+  timer.start();
+
+  // Coalesce: run the commands of all the requests queued so far in order, but render and send only one frame. A
+  // client that sends faster than frames are drawn gets the newest state instead of a backlog of stale frames.
+  // The first request carries the frame.
+  // Note that any one request could change the streaming mode; the batch ends there.
+  const bool streaming = session->m_streamMode != 0;
+  RenderRequest* frameReq = session->takeRequest();
+  this->processCommandBuffer(frameReq);
+  int merged = 0;
+  while ((session->m_streamMode != 0) == streaming && session->hasRequests()) {
+    RenderRequest* r = session->takeRequest();
+    this->processCommandBuffer(r);
+    delete r;
+    merged++;
+  }
+  if (merged > 0 && !streaming) {
+    LOG_DEBUG << "Coalesced " << merged + 1 << " requests into one frame";
+  }
 
-    QWebSocket* ws = lastReq->getClient();
+  if (streaming) {
+    QWebSocket* ws = frameReq->getClient();
     LOG_DEBUG << "RENDER for " << ws->peerName().toStdString() << "(" << ws->peerAddress().toString().toStdString()
               << ":" << QString::number(ws->peerPort()).toStdString() << ")";
 
-    QImage img = this->render();
+    // the frame read back while this one renders
+    QImage img = this->render(session->m_streamMode != 0);
 
-    lastReq->setActualDuration(timer.nsecsElapsed());
+    frameReq->setActualDuration(timer.nsecsElapsed());
+    frameReq->setSamples(frameSamples(session));
 
     // in stream mode:
     // if queue is empty, then keep firing redraws back to client.
-    // test about 100 frames as a convergence limit.
-    if (m_streamMode != 0 && m_myVolumeData.m_renderSettings->GetNoIterations() < 500) {
+    // test about 100 frames as a convergence limit, unless adaptive sampling says every pixel is done.
+    const RenderSettings* rs = session->m_renderSettings;
+    const bool converged =
+      rs->m_RenderSettings.m_ErrorTarget > 0.0f && rs->GetConvergence() >= CONVERGED_PIXEL_FRACTION;
+    // a tiled image is finished when it is returned.
+    const bool refining =
+      session->m_streamMode != 0 && session->m_tileSize == 0 && rs->GetNoIterations() < 500 && !converged;
+    if (refining) {
       // push another redraw request.
-      std::vector<Command*> cmd;
+      CommandList cmd;
       RequestRedrawCommandD data;
-      cmd.push_back(new RequestRedrawCommand(data));
-      this->addRequest(new RenderRequest(lastReq->getClient(), cmd, false));
+      cmd.add<RequestRedrawCommand>(data);
+      session->addRequest(new RenderRequest(frameReq->getClient(), std::move(cmd), false));
+    } else {
+      // the stream stops here, so send the newest frame instead of the one before it
+      QImage last = this->finishFrames();
+      if (!last.isNull()) {
+        img = last;
+      }
     }
 
-    // inform the server that we are done with r
-    emit requestProcessed(lastReq, img);
+    // the first frame of a stream may still be being read back; the next redraw sends it.
+    // Refinements are held back while the link is busy, but the image goes on converging, so the next one sent is
+    // the newest. Refinements that barely change the image are not sent at all.
+    if (img.isNull() || (refining && !session->canSendFrame()) || !prepareFrame(frameReq, img, refining)) {
+      delete frameReq;
+    } else {
+      // inform the server that we are done with r
+      session->frameSent();
+      emit requestProcessed(frameReq, img);
+    }
 
   } else {
-    // if not in stream mode, then process one request, then re-render.
-
-    // remove request from the queue
-    RenderRequest* r = this->m_requests.takeFirst();
-    this->m_totalQueueDuration -= r->getDuration();
-
-    // process it
-    QElapsedTimer timer;
-    timer.start();
-
-    std::vector<Command*> cmds = r->getParameters();
-    if (cmds.size() > 0) {
-      this->processCommandBuffer(r);
+    // if not in stream mode, then render once for the batch.
+    // The image is not refined after it is sent, so it has to be drawn from the full resolution bricks.
+    if (session->m_tileSize == 0) {
+      session->m_camera->Update();
+      m_renderer->pageInBricks(*session->m_camera);
     }
-
     QImage img = this->render();
 
-    r->setActualDuration(timer.nsecsElapsed());
+    frameReq->setActualDuration(timer.nsecsElapsed());
+    frameReq->setSamples(frameSamples(session));
 
     // inform the server that we are done with r
-    emit requestProcessed(r, img);
+    prepareFrame(frameReq, img, false);
+    session->frameSent();
+    emit requestProcessed(frameReq, img);
   }
 
   return true;
@@ -230,18 +433,18 @@ Renderer::processCommandBuffer(RenderRequest* rr)
   this->m_glContext->makeCurrent(this->m_surface);
 #endif
 
-  std::vector<Command*> cmds = rr->getParameters();
+  const std::vector<Command*>& cmds = rr->getParameters();
   if (cmds.size() > 0) {
-    m_ec.m_renderSettings = m_myVolumeData.m_renderSettings;
+    m_ec.m_renderSettings = m_session->m_renderSettings;
     m_ec.m_renderer = this;
-    m_ec.m_appScene = m_myVolumeData.m_scene;
-    m_ec.m_camera = m_myVolumeData.m_camera;
+    m_ec.m_appScene = m_session->m_scene;
+    m_ec.m_camera = m_session->m_camera;
     m_ec.m_message = "";
 
     for (auto i = cmds.begin(); i != cmds.end(); ++i) {
       (*i)->execute(&m_ec);
       if (!m_ec.m_message.empty()) {
-        emit sendString(rr, QString::fromStdString(m_ec.m_message));
+        emit sendString(rr->getClient(), QString::fromStdString(m_ec.m_message));
         m_ec.m_message = "";
       }
     }
@@ -249,42 +452,366 @@ Renderer::processCommandBuffer(RenderRequest* rr)
 }
 
 QImage
-Renderer::render()
+Renderer::render(bool pipelined)
 {
-  m_openGLMutex->lock();
 #if HAS_EGL
   this->m_glContext->makeCurrent();
 #else
   this->m_glContext->makeCurrent(this->m_surface);
 #endif
 
+  if (m_session->m_tileSize > 0) {
+    m_readback->clear();
+    QImage img = renderTiles();
+
+    this->m_glContext->doneCurrent();
+
+    return img;
+  }
+
   // DRAW
-  m_myVolumeData.m_camera->Update();
-  m_myVolumeData.m_renderer->doRender(*(m_myVolumeData.m_camera));
+  m_session->m_camera->Update();
+  m_renderer->doRender(*(m_session->m_camera));
+  m_gpuBytes = m_renderer->getGpuBytes();
 
   // COPY TO MY FBO
   this->m_fbo->bind();
   glViewport(0, 0, m_fbo->width(), m_fbo->height());
-  m_myVolumeData.m_renderer->drawImage();
+  m_renderer->drawImage();
   this->m_fbo->release();
 
-  std::unique_ptr<uint8_t> bytes(new uint8_t[m_fbo->width() * m_fbo->height() * 4]);
-  m_fbo->toImage(bytes.get());
-  QImage img = QImage(bytes.get(), m_fbo->width(), m_fbo->height(), QImage::Format_RGB32).copy().mirrored();
+  if (!pipelined) {
+    // never return a frame left over from stream mode
+    m_readback->clear();
+  }
+  m_readback->start(m_fbo);
+
+  // the pixels are copied once, from the mapped pack buffer straight into the image
+  QImage img;
+  if (!pipelined || m_readback->pending() > 1) {
+    img = QImage(m_readback->width(), m_readback->height(), QImage::Format_RGB32);
+    m_readback->finish(img.bits(), true);
+  }
 
   this->m_glContext->doneCurrent();
-  m_openGLMutex->unlock();
 
   return img;
 }
 
+QImage
+Renderer::finishFrames()
+{
+  if (m_readback->pending() == 0) {
+    return QImage();
+  }
+#if HAS_EGL
+  this->m_glContext->makeCurrent();
+#else
+  this->m_glContext->makeCurrent(this->m_surface);
+#endif
+
+  QImage img(m_readback->width(), m_readback->height(), QImage::Format_RGB32);
+  while (m_readback->pending() > 0) {
+    m_readback->finish(img.bits(), true);
+  }
+
+  this->m_glContext->doneCurrent();
+
+  return img;
+}
+
+QImage
+Renderer::renderTiles()
+{
+  RenderSettings* rs = m_session->m_renderSettings;
+  CCamera* camera = m_session->m_camera;
+  camera->Update();
+
+  const int width = m_session->m_width;
+  const int height = m_session->m_height;
+  const int samples = m_session->m_tileSamples;
+  const int tileW = m_fbo->width();
+  const int tileH = m_fbo->height();
+  std::unique_ptr<uint8_t[]> tileBytes(new uint8_t[tileW * tileH * 4]);
+  std::unique_ptr<uint8_t[]> bytes(new uint8_t[(size_t)width * (size_t)height * 4]);
+
+  // every tile is a new camera for the path tracer. Keep it from previewing it at reduced resolution or
+  // reprojecting the previous tile into it.
+  const int interactiveDownsample = rs->m_RenderSettings.m_InteractiveDownsample;
+  rs->m_RenderSettings.m_InteractiveDownsample = 1;
+
+  std::vector<ImageTile> tiles = makeImageTiles(width, height, (uint32_t)m_session->m_tileSize);
+  for (const ImageTile& tile : tiles) {
+    CCamera tileCamera = *camera;
+    tileCamera.m_Film = camera->m_Film.Tile(tile, tileW, tileH);
+
+    rs->m_DirtyFlags.SetFlag(CameraDirty | RenderParamsDirty);
+    rs->SetNoIterations(0);
+    m_renderer->pageInBricks(tileCamera);
+    // every pass adds at least one iteration
+    for (int i = 0; i < samples && rs->GetNoIterations() < samples; ++i) {
+      m_renderer->doRender(tileCamera);
+    }
+
+    this->m_fbo->bind();
+    glViewport(0, 0, tileW, tileH);
+    m_renderer->drawImage();
+    this->m_fbo->release();
+
+    // edge tiles only keep the part of the render target that lies inside the image
+    m_fbo->toImage(tileBytes.get());
+    copyTileToImage(tileBytes.get(), (uint32_t)tileW, tile, 4, bytes.get(), (uint32_t)width);
+  }
+  LOG_DEBUG << "Rendered " << tiles.size() << " tiles of " << tileW << "x" << tileH;
+
+  rs->m_RenderSettings.m_InteractiveDownsample = interactiveDownsample;
+  // the path tracer holds the last tile; the next untiled frame starts over with the whole camera
+  rs->m_DirtyFlags.SetFlag(CameraDirty | RenderParamsDirty);
+
+  // mirrored() makes the deep copy
+  return QImage(bytes.get(), width, height, QImage::Format_RGB32).mirrored();
+}
+
+bool
+Renderer::prepareFrame(RenderRequest* r, const QImage& img, bool canSkip)
+{
+  r->setCodec(m_session->m_codec);
+  if (!m_session->m_frameDiff) {
+    return true;
+  }
+
+  QImage& lastSentFrame = m_session->m_lastSentFrame;
+  std::vector<ImageTile> tiles;
+  if (lastSentFrame.size() != img.size()) {
+    // the client has nothing to apply changes to
+    lastSentFrame = img.copy();
+    tiles.push_back({ 0, 0, (uint32_t)img.width(), (uint32_t)img.height() });
+  } else {
+    diffFrameTiles(
+      img.constBits(), lastSentFrame.constBits(), img.width(), img.height(), m_session->m_frameDiffParams, tiles);
+    if (tiles.empty() && canSkip) {
+      return false;
+    }
+    // Only the sent tiles become the reference. Updating all of it would let slow changes creep by below the
+    // threshold forever.
+    for (const ImageTile& tile : tiles) {
+      for (uint32_t y = tile.m_y; y < tile.m_y + tile.m_h; ++y) {
+        memcpy(lastSentFrame.scanLine(y) + tile.m_x * 4, img.constScanLine(y) + tile.m_x * 4, tile.m_w * 4);
+      }
+    }
+  }
+  r->setFrameTiles(tiles);
+  return true;
+}
+
+void
+Renderer::setFrameDiff(bool enabled, float threshold)
+{
+  m_session->m_frameDiff = enabled;
+  m_session->m_frameDiffParams.m_meanThreshold = std::max(threshold, 0.0f);
+  // start over with a complete frame
+  m_session->m_lastSentFrame = QImage();
+}
+
+void
+Renderer::setStreamCodec(const std::string& codec, int32_t quality)
+{
+  StreamCodec::Type type;
+  if (!StreamCodec::fromName(codec, type)) {
+    LOG_WARNING << "Stream codec " << codec << " is not available, keeping the current one";
+    return;
+  }
+  m_session->m_codec.m_type = type;
+  m_session->m_codec.m_quality = std::min(std::max(quality, 0), 100);
+}
+
+void
+Renderer::setTiledRendering(int32_t tileSize, int32_t samples)
+{
+  m_session->m_tileSamples = samples;
+  if (tileSize == m_session->m_tileSize) {
+    return;
+  }
+  m_session->m_tileSize = tileSize;
+  resizeRenderTargets();
+}
+
+void
+Renderer::setStreamPacing(int32_t fps, int32_t latencyMs)
+{
+  m_session->m_maxFps = std::max(fps, 0);
+  m_session->m_maxLatencyMs = std::max(latencyMs, 0);
+}
+
+void
+Renderer::batchRender(int32_t path,
+                      int32_t frames,
+                      int32_t iterations,
+                      float angle,
+                      const std::vector<float>& keyframes,
+                      const std::string& outputDirectory)
+{
+  QWebSocket* client = m_session->getClient();
+  auto report = [this, client](QJsonObject j) {
+    j["commandId"] = (int)BatchRenderCommand::m_ID;
+    emit sendString(client, QString::fromUtf8(QJsonDocument(j).toJson(QJsonDocument::Compact)));
+  };
+  auto fail = [&report](const std::string& error) {
+    LOG_WARNING << "Batch render: " << error;
+    QJsonObject j;
+    j["done"] = true;
+    j["error"] = QString::fromStdString(error);
+    report(j);
+  };
+
+  if (frames <= 0) {
+    fail("batch render needs at least one frame");
+    return;
+  }
+  // clients only get to write below the server's working directory
+  const QString outputPath = QDir::cleanPath(QString::fromStdString(outputDirectory));
+  if (outputPath.isEmpty() || QDir::isAbsolutePath(outputPath) || outputPath == ".." || outputPath.startsWith("../")) {
+    fail("output directory " + outputDirectory + " must be a relative path inside the working directory");
+    return;
+  }
+  QDir dir(QDir::current().filePath(outputPath));
+  // the path may lead out through a symbolic link; check before creating anything and again once it all exists
+  if (!isInsideDirectory(dir.absolutePath(), QDir::currentPath())) {
+    fail("output directory " + outputDirectory + " must be a relative path inside the working directory");
+    return;
+  }
+  if (!dir.mkpath(".")) {
+    fail("can not create output directory " + dir.absolutePath().toStdString());
+    return;
+  }
+  if (!isInsideDirectory(dir.absolutePath(), QDir::currentPath())) {
+    fail("output directory " + outputDirectory + " must be a relative path inside the working directory");
+    return;
+  }
+  dir.setPath(QFileInfo(dir.absolutePath()).canonicalFilePath());
+  const CameraPath cameraPath = (CameraPath)path;
+  float pose[CAMERA_KEYFRAME_SIZE];
+  if (cameraPath == CameraPath::KEYFRAMES && !keyframePose(keyframes, 0, frames, pose)) {
+    fail("keyframes need 9 floats each");
+    return;
+  }
+  iterations = std::max(iterations, 1);
+
+  CCamera* camera = m_session->m_camera;
+  RenderSettings* rs = m_session->m_renderSettings;
+  const CCamera start = *camera;
+  // every frame is a new camera; keep it from previewing at reduced resolution
+  const int interactiveDownsample = rs->m_RenderSettings.m_InteractiveDownsample;
+  rs->m_RenderSettings.m_InteractiveDownsample = 1;
+  // tiled rendering renders all the iterations of a frame tile by tile
+  const int32_t tileSamples = m_session->m_tileSamples;
+  m_session->m_tileSamples = iterations;
+
+  // png encoding and disk writes overlap rendering the next frames. Only a few images wait for a writer at a time.
+  QThreadPool writers;
+  writers.setMaxThreadCount(std::max(QThread::idealThreadCount() / 2, 1));
+  QSemaphore freeSlots(2 * writers.maxThreadCount());
+  std::atomic<int> failures(0);
+
+  QElapsedTimer timer;
+  timer.start();
+  int rendered = 0;
+  for (int i = 0; i < frames && !isInterruptionRequested(); ++i) {
+    *camera = start;
+    if (cameraPath == CameraPath::KEYFRAMES) {
+      keyframePose(keyframes, i, frames, pose);
+      camera->m_From = glm::vec3(pose[0], pose[1], pose[2]);
+      camera->m_Target = glm::vec3(pose[3], pose[4], pose[5]);
+      camera->m_Up = glm::normalize(glm::vec3(pose[6], pose[7], pose[8]));
+    }
+    camera->Update();
+    const float orbit = cameraPathAngle(cameraPath, i, frames, angle);
+    if (orbit != 0.0f) {
+      camera->Trackball(0.0f, orbit);
+      camera->Update();
+    }
+    rs->m_DirtyFlags.SetFlag(CameraDirty);
+    rs->SetNoIterations(0);
+
+    // render() adds the last iteration and reads the image back
+    if (m_session->m_tileSize == 0) {
+#if HAS_EGL
+      this->m_glContext->makeCurrent();
+#else
+      this->m_glContext->makeCurrent(this->m_surface);
+#endif
+      m_renderer->pageInBricks(*camera);
+      for (int k = 0; k < iterations - 1 && rs->GetNoIterations() < iterations - 1; ++k) {
+        m_renderer->doRender(*camera);
+      }
+    }
+    QImage img = this->render();
+
+    const QString file = dir.filePath(QString("frame_%1.png").arg(i, 4, 10, QChar('0')));
+    freeSlots.acquire();
+    writers.start([img, file, &freeSlots, &failures]() {
+      // nor through a link in place of the frame
+      if (QFileInfo(file).isSymLink() || !img.save(file)) {
+        failures++;
+      }
+      freeSlots.release();
+    });
+    rendered++;
+
+    QJsonObject j;
+    j["frame"] = rendered;
+    j["frames"] = frames;
+    report(j);
+  }
+  writers.waitForDone();
+
+  *camera = start;
+  camera->Update();
+  rs->m_RenderSettings.m_InteractiveDownsample = interactiveDownsample;
+  m_session->m_tileSamples = tileSamples;
+  rs->m_DirtyFlags.SetFlag(CameraDirty | RenderParamsDirty);
+  rs->SetNoIterations(0);
+  // the commands after this one expect the context that processCommandBuffer made current
+#if HAS_EGL
+  this->m_glContext->makeCurrent();
+#else
+  this->m_glContext->makeCurrent(this->m_surface);
+#endif
+
+  LOG_INFO << "Batch rendered " << rendered << " frames to " << dir.absolutePath().toStdString() << " in "
+           << timer.elapsed() / 1000.0 << " s";
+  QJsonObject j;
+  j["done"] = true;
+  j["frames"] = rendered;
+  j["failed"] = (int)failures;
+  j["seconds"] = timer.elapsed() / 1000.0;
+  report(j);
+}
+
 void
 Renderer::resizeGL(int width, int height)
 {
-  if ((width == m_width) && (height == m_height)) {
+  if ((width == m_session->m_width) && (height == m_session->m_height)) {
+    return;
+  }
+  m_session->m_width = width;
+  m_session->m_height = height;
+  resizeRenderTargets();
+}
+
+void
+Renderer::resizeRenderTargets()
+{
+  // in tiled mode the gpu only holds one tile
+  int width = 1024, height = 1024;
+  if (m_session) {
+    const int tileSize = m_session->m_tileSize;
+    width = (tileSize > 0) ? std::min(tileSize, m_session->m_width) : m_session->m_width;
+    height = (tileSize > 0) ? std::min(tileSize, m_session->m_height) : m_session->m_height;
+  }
+  if (m_fbo && m_fbo->width() == width && m_fbo->height() == height) {
     return;
   }
-  m_openGLMutex->lock();
 
 #if HAS_EGL
   this->m_glContext->makeCurrent();
@@ -292,26 +819,19 @@ Renderer::resizeGL(int width, int height)
   this->m_glContext->makeCurrent(this->m_surface);
 #endif
   // RESIZE THE RENDER INTERFACE
-  if (m_myVolumeData.m_renderer) {
-    m_myVolumeData.m_renderer->resize(width, height);
+  if (m_renderer) {
+    m_renderer->resize(width, height);
   }
 
   delete this->m_fbo;
   this->m_fbo = new GLFramebufferObject(width, height, GL_RGBA8);
 
   glViewport(0, 0, width, height);
-
-  m_width = width;
-  m_height = height;
-
-  m_openGLMutex->unlock();
 }
 
 void
 Renderer::reset(int from)
 {
-  m_openGLMutex->lock();
-
 #if HAS_EGL
   this->m_glContext->makeCurrent();
 #else
@@ -325,8 +845,6 @@ Renderer::reset(int from)
   glEnable(GL_LINE_SMOOTH);
 
   this->m_time.start();
-
-  m_openGLMutex->unlock();
 }
 
 int
@@ -344,15 +862,12 @@ Renderer::shutDown()
   this->m_glContext->makeCurrent(this->m_surface);
 #endif
   delete this->m_fbo;
+  delete m_readback;
 
-  delete m_myVolumeData.m_renderSettings;
-  delete m_myVolumeData.m_camera;
-  delete m_myVolumeData.m_scene;
-  delete m_myVolumeData.m_renderer;
-  m_myVolumeData.m_camera = nullptr;
-  m_myVolumeData.m_scene = nullptr;
-  m_myVolumeData.m_renderSettings = nullptr;
-  m_myVolumeData.m_renderer = nullptr;
+  delete m_renderer;
+  delete m_idleRenderSettings;
+  m_renderer = nullptr;
+  m_idleRenderSettings = nullptr;
 
   m_glContext->doneCurrent();
   delete m_glContext;
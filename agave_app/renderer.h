@@ -7,6 +7,7 @@
 #include "renderlib/gl/Util.h"
 #include "renderlib/renderlib.h"
 #include "renderrequest.h"
+#include "rendersession.h"
 
 #include <QList>
 #include <QMutex>
@@ -15,8 +16,10 @@
 #include <QOpenGLContext>
 #include <QOpenGLTexture>
 #include <QThread>
+#include <QWaitCondition>
 #include <QtCore/QElapsedTimer>
 
+#include <atomic>
 #include <memory>
 
 class commandBuffer;
@@ -26,6 +29,8 @@ class RenderGLPT;
 class RenderSettings;
 class Scene;
 
+// A render thread with its own gl context. It serves any number of sessions, drawing the ones with pending requests
+// in turn, and sleeps while none of them has anything to draw.
 class Renderer
   : public QThread
   , public RendererCommandInterface
@@ -33,42 +38,97 @@ class Renderer
   Q_OBJECT
 
 public:
-  Renderer(QString id, QObject* parent, QMutex& mutex);
+  // device is the index of the gpu to render on, see renderlib::deviceCount
+  Renderer(QString id, QObject* parent, QMutex& mutex, int device = 0);
   virtual ~Renderer();
 
   void init();
   void run();
 
-  void addRequest(RenderRequest* request);
+  // The renderer takes ownership of the session. Sessions can be added and removed from any thread; a removed
+  // session is deleted on the render thread once it is no longer drawn.
+  void addSession(RenderSession* session);
+  void removeSession(RenderSession* session);
+  int getSessionCount();
+
+  // call after adding requests to one of the sessions, so that a sleeping renderer picks them up
+  void wake();
+  // requestInterruption and wake, for the thread to finish
+  void stop();
+  // asleep with nothing to draw
+  inline bool isIdle() const { return m_idle; }
+  // before start: every image starts from this random seed, see RenderGLPT::setFixedRandomSeed
+  inline void setFixedRandomSeed(int seed) { m_fixedRandomSeed = seed; }
+
   bool processRequest();
 
-  inline int getTotalQueueDuration() { return this->m_totalQueueDuration; }
+  int getTotalQueueDuration();
+
+  int getRequestCount();
 
-  inline int getRequestCount() { return this->m_requests.count(); }
+  inline int getDevice() { return this->m_device; }
+
+  // gpu memory held by this renderer as of its last frame
+  inline size_t getGpuBytes() { return this->m_gpuBytes; }
 
   // 1 = continuous re-render, 0 = only wait for redraw commands
-  virtual void setStreamMode(int32_t mode) { m_streamMode = mode; }
+  virtual void setStreamMode(int32_t mode) { m_session->m_streamMode = mode; }
+
+  virtual void setStreamCodec(const std::string& codec, int32_t quality);
+
+  virtual void setFrameDiff(bool enabled, float threshold);
 
   virtual void resizeGL(int internalWidth, int internalHeight);
 
+  // render the image in tiles of at most tileSize x tileSize pixels with samples iterations each; 0 = off
+  virtual void setTiledRendering(int32_t tileSize, int32_t samples);
+
+  virtual void setStreamPacing(int32_t fps, int32_t latencyMs);
+
+  // Renders every frame with the session's settings and saves them as png files, while the next ones render. The
+  // session's camera is back where it started afterwards.
+  virtual void batchRender(int32_t path,
+                           int32_t frames,
+                           int32_t iterations,
+                           float angle,
+                           const std::vector<float>& keyframes,
+                           const std::string& outputDirectory);
+
 protected:
   QString m_id;
 
+  // the next session to draw: the current one until its time slice is used up, then the next one with requests
+  RenderSession* nextSession();
+  // swap the session's state into the renderer; nullptr leaves the renderer with no scene
+  void activateSession(RenderSession* session);
+  // block until there is a request or closed session to handle, or the thread is interrupted
+  void waitForWork();
+
   void processCommandBuffer(RenderRequest* rr);
-  QImage render();
+  // Draw a frame and read it back. When pipelined, return the frame started by the previous call instead, or a null
+  // image if there is none, so that reading this frame overlaps rendering the next.
+  QImage render(bool pipelined = false);
+  // wait for the frames still being read back and return the newest, or a null image if there are none
+  QImage finishFrames();
+  // Attach the codec and, in frame diff mode, the tiles that changed since the last frame sent.
+  // Returns false when canSkip is set and nothing changed enough to send.
+  bool prepareFrame(RenderRequest* r, const QImage& img, bool canSkip);
+  // assemble the image from tiles rendered one at a time into m_fbo
+  QImage renderTiles();
 
   void reset(int from = 0);
 
   int getTime();
 
-  QList<RenderRequest*> m_requests;
-  int m_totalQueueDuration;
-
   void shutDown();
 
 private:
+  // held only while creating the gl context, see StreamServer::_openGLMutex
   QMutex* m_openGLMutex;
 
+  int m_device;
+  std::atomic<size_t> m_gpuBytes;
+
 #if HAS_EGL
   HeadlessGLContext* m_glContext;
 #else
@@ -77,9 +137,20 @@ private:
 #endif
 
   GLFramebufferObject* m_fbo;
+  GLPixelReadback* m_readback;
 
-  int32_t m_streamMode;
-  int32_t m_width, m_height;
+  QMutex m_sessionsMutex;
+  // signalled with m_sessionsMutex when there may be work, see wake
+  QWaitCondition m_workAvailable;
+  QList<RenderSession*> m_sessions;
+  // removed sessions waiting to be deleted on the render thread
+  QList<RenderSession*> m_closedSessions;
+  // the session swapped in, or nullptr
+  RenderSession* m_session;
+  QElapsedTimer m_sliceTimer;
+
+  // the gpu buffers are only as big as a tile when tiled rendering is on
+  void resizeRenderTargets();
 
   QElapsedTimer m_time;
 
@@ -101,27 +172,19 @@ private:
 
   // TODO move this info.  This class only knows about some abstract renderer and a scene object.
   void myVolumeInit();
-  struct myVolumeData
-  {
-    RenderSettings* m_renderSettings;
-    RenderGLPT* m_renderer;
-    Scene* m_scene;
-    CCamera* m_camera;
-
-    myVolumeData()
-      : m_camera(nullptr)
-      , m_scene(nullptr)
-      , m_renderSettings(nullptr)
-      , m_renderer(nullptr)
-    {}
-  } m_myVolumeData;
+  RenderGLPT* m_renderer;
+  // what m_renderer refers to while no session is swapped in
+  RenderSettings* m_idleRenderSettings;
+  int m_fixedRandomSeed;
+  std::atomic<bool> m_idle;
 
   ExecutionContext m_ec;
 
 signals:
   void kill();
   void requestProcessed(RenderRequest* request, QImage img);
-  void sendString(RenderRequest* request, QString s);
+  // the reply of a command; the request may be gone by the time it is sent
+  void sendString(QWebSocket* client, QString s);
 };
 
 #endif // RENDERER_H
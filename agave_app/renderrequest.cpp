@@ -2,16 +2,21 @@
 
 #include "command.h"
 
-RenderRequest::RenderRequest(QWebSocket* client, std::vector<Command*> parameters, bool debug)
+RenderRequest::RenderRequest(QWebSocket* client, CommandList&& parameters, bool debug)
   : client(client)
-  , parameters(parameters)
+  , parameters(std::move(parameters))
   , debug(debug)
+  , delta(false)
 {
   this->actualDuration = 0;
+  this->samples = 0;
   this->estimatedDuration = 10;
 }
 
-RenderRequest::~RenderRequest()
+RenderRequest::~RenderRequest() {}
+
+void
+RenderRequest::append(RenderRequest* later)
 {
-  qDeleteAll(parameters);
+  parameters.append(std::move(later->parameters));
 }
@@ -1,40 +1,71 @@
 #ifndef RENDERREQUEST_H
 #define RENDERREQUEST_H
 
+#include "frameencoder.h"
+#include "renderlib/CommandStream.h"
+#include "renderlib/TiledRender.h"
+
 #include <QMatrix4x4>
 #include <QWebSocket>
 
-class Command;
-
 class RenderRequest
 {
 public:
-  RenderRequest(QWebSocket* client, std::vector<Command*> parameters, bool debug = false);
+  RenderRequest(QWebSocket* client, CommandList&& parameters, bool debug = false);
   ~RenderRequest();
 
   inline QWebSocket* getClient() { return client; }
 
-  inline std::vector<Command*> getParameters() { return parameters; }
+  inline const std::vector<Command*>& getParameters() const { return parameters.commands(); }
+
+  // take over the commands of a later request, to be run after this one's; later is left empty
+  void append(RenderRequest* later);
 
   inline int getDuration() { return this->estimatedDuration; }
 
   inline bool isDebug() { return debug; }
 
-  inline void setActualDuration(int actualDuration) { this->actualDuration = actualDuration; }
+  inline void setActualDuration(qint64 actualDuration) { this->actualDuration = actualDuration; }
+
+  inline qint64 getActualDuration() { return actualDuration; }
+
+  // pixel samples drawn for the frame of this request
+  inline void setSamples(qint64 samples) { this->samples = samples; }
+
+  inline qint64 getSamples() const { return samples; }
 
-  inline int getActualDuration() { return actualDuration; }
+  // how the image of this request is sent back
+  inline void setCodec(const StreamCodec& codec) { this->codec = codec; }
+
+  inline const StreamCodec& getCodec() const { return codec; }
+
+  // send only these tiles of the image, to be applied over the previous frame
+  inline void setFrameTiles(const std::vector<ImageTile>& tiles)
+  {
+    this->frameTiles = tiles;
+    this->delta = true;
+  }
+
+  inline bool isDelta() const { return delta; }
+
+  inline const std::vector<ImageTile>& getFrameTiles() const { return frameTiles; }
 
 private:
   QWebSocket* client;
-  std::vector<Command*> parameters;
+  CommandList parameters;
 
   // an estimation of how many miliseconds will this request take to process
   int estimatedDuration;
 
   // how many nanoseconds did it actually take
-  int actualDuration;
+  qint64 actualDuration;
+  qint64 samples;
 
   bool debug;
+
+  StreamCodec codec;
+  bool delta;
+  std::vector<ImageTile> frameTiles;
 };
 
 #endif // RENDERREQUEST_H
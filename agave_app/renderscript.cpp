@@ -0,0 +1,430 @@
+#include "renderscript.h"
+
+#include "glad/glad.h"
+
+#include "ViewerState.h"
+#include "commandBuffer.h"
+
+#include "renderlib/AppScene.h"
+#include "renderlib/CCamera.h"
+#include "renderlib/CommandRecording.h"
+#include "renderlib/Logging.h"
+#include "renderlib/RenderGLPT.h"
+#include "renderlib/RenderSettings.h"
+#include "renderlib/command.h"
+#include "renderlib/gl/Util.h"
+#include "renderlib/renderlib.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+
+static const int INITIAL_SIZE = 1024;
+
+namespace {
+// Jobs go to the threads as they become free.
+struct JobQueue
+{
+  JobQueue(std::vector<RenderJob>& jobs)
+    : m_jobs(jobs)
+    , m_next(0)
+    , m_failed(0)
+  {}
+
+  RenderJob* take()
+  {
+    size_t i = m_next++;
+    return (i < m_jobs.size()) ? &m_jobs[i] : nullptr;
+  }
+
+  std::vector<RenderJob>& m_jobs;
+  std::atomic<size_t> m_next;
+  std::atomic<int> m_failed;
+};
+
+// A thread with its own gl context that runs jobs until there are none left.
+class ScriptRenderer
+  : public QThread
+  , public RendererCommandInterface
+{
+public:
+  ScriptRenderer(JobQueue& queue, QMutex& openGLMutex, int device)
+    : m_queue(queue)
+    , m_openGLMutex(openGLMutex)
+    , m_device(device)
+    , m_fbo(nullptr)
+    , m_renderer(nullptr)
+    , m_idleRenderSettings(nullptr)
+  {}
+
+  virtual void run();
+
+  // RendererCommandInterface; there is no client to stream to
+  virtual void setStreamMode(int32_t) {}
+  virtual void setStreamCodec(const std::string&, int32_t) {}
+  virtual void setFrameDiff(bool, float) {}
+  virtual void resizeGL(int width, int height);
+  virtual void setTiledRendering(int32_t, int32_t) {}
+  virtual void setStreamPacing(int32_t, int32_t) {}
+  virtual void batchRender(int32_t, int32_t, int32_t, float, const std::vector<float>&, const std::string&)
+  {
+    LOG_WARNING << "Batch render commands are only run by the server";
+  }
+
+private:
+  void init();
+  void shutDown();
+  bool runJob(RenderJob& job);
+  bool renderTo(const RenderJob& job, CCamera& camera, const QString& file);
+
+  JobQueue& m_queue;
+  QMutex& m_openGLMutex;
+  int m_device;
+
+#if HAS_EGL
+  HeadlessGLContext* m_glContext;
+#else
+  QOpenGLContext* m_glContext;
+  QOffscreenSurface* m_surface;
+#endif
+  GLFramebufferObject* m_fbo;
+  RenderGLPT* m_renderer;
+  RenderSettings* m_idleRenderSettings;
+};
+
+void
+ScriptRenderer::init()
+{
+  // contexts join the share group of their device one at a time, as in Renderer::init
+  m_openGLMutex.lock();
+#if HAS_EGL
+  m_glContext = new HeadlessGLContext(m_device);
+  m_openGLMutex.unlock();
+  m_glContext->makeCurrent();
+#else
+  m_glContext = renderlib::createOpenGLContext();
+
+  m_surface = new QOffscreenSurface();
+  m_surface->setFormat(m_glContext->format());
+  m_surface->create();
+  m_openGLMutex.unlock();
+
+  m_glContext->makeCurrent(m_surface);
+#endif
+
+  if (!gladLoadGL()) {
+    LOG_ERROR << "Could not load GL for device " << m_device;
+  }
+
+  glClearColor(0.0, 0.0, 0.0, 1.0);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glEnable(GL_BLEND);
+  glEnable(GL_LINE_SMOOTH);
+  glEnable(GL_MULTISAMPLE);
+
+  m_idleRenderSettings = new RenderSettings();
+  m_renderer = new RenderGLPT(m_idleRenderSettings);
+  m_renderer->initialize(INITIAL_SIZE, INITIAL_SIZE);
+  resizeGL(INITIAL_SIZE, INITIAL_SIZE);
+}
+
+void
+ScriptRenderer::shutDown()
+{
+  m_renderer->cleanUpResources();
+  delete m_fbo;
+  delete m_renderer;
+  delete m_idleRenderSettings;
+  m_fbo = nullptr;
+  m_renderer = nullptr;
+  m_idleRenderSettings = nullptr;
+
+  m_glContext->doneCurrent();
+  delete m_glContext;
+#if HAS_EGL
+#else
+  m_surface->deleteLater();
+#endif
+}
+
+void
+ScriptRenderer::run()
+{
+  init();
+  // the context stays current: nothing else draws on this thread
+  while (RenderJob* job = m_queue.take()) {
+    if (!runJob(*job)) {
+      m_queue.m_failed++;
+    }
+  }
+  shutDown();
+}
+
+void
+ScriptRenderer::resizeGL(int width, int height)
+{
+  if (m_fbo && m_fbo->width() == width && m_fbo->height() == height) {
+    return;
+  }
+  m_renderer->resize(width, height);
+  delete m_fbo;
+  m_fbo = new GLFramebufferObject(width, height, GL_RGBA8);
+  glViewport(0, 0, width, height);
+}
+
+bool
+ScriptRenderer::runJob(RenderJob& job)
+{
+  QElapsedTimer timer;
+  timer.start();
+  LOG_INFO << "Rendering " << job.m_input.toStdString() << " on device " << m_device;
+
+  // every job starts from a new scene, as a new client session would
+  RenderSettings renderSettings;
+  Scene scene;
+  scene.initLights();
+  CCamera camera;
+  camera.m_Film.m_ExposureIterations = 1;
+  camera.m_Film.m_Resolution.SetResX(INITIAL_SIZE);
+  camera.m_Film.m_Resolution.SetResY(INITIAL_SIZE);
+  m_renderer->swapScene(&scene, &renderSettings);
+  resizeGL(INITIAL_SIZE, INITIAL_SIZE);
+
+  ExecutionContext ec;
+  ec.m_renderer = this;
+  ec.m_renderSettings = &renderSettings;
+  ec.m_appScene = &scene;
+  ec.m_camera = &camera;
+  ec.m_message = "";
+
+  const QDir outputDir = QFileInfo(job.m_output).absoluteDir();
+  QString output = job.m_output;
+  int images = 0;
+  bool ok = true;
+  for (Command* c : job.m_commands.commands()) {
+    if (SessionCommand* session = dynamic_cast<SessionCommand*>(c)) {
+      output = outputDir.filePath(QString::fromStdString(session->m_data.m_name));
+    } else if (dynamic_cast<RequestRedrawCommand*>(c)) {
+      ok = renderTo(job, camera, output) && ok;
+      images++;
+    }
+    c->execute(&ec);
+    if (!ec.m_message.empty()) {
+      LOG_DEBUG << ec.m_message;
+      ec.m_message = "";
+    }
+  }
+  if (images == 0) {
+    ok = renderTo(job, camera, output);
+    images++;
+  }
+
+  m_renderer->swapScene(nullptr, m_idleRenderSettings);
+  m_renderer->forgetScene(&renderSettings);
+  LOG_INFO << "Rendered " << images << " image(s) from " << job.m_input.toStdString() << " in "
+           << timer.elapsed() / 1000.0 << " s";
+  return ok;
+}
+
+bool
+ScriptRenderer::renderTo(const RenderJob& job, CCamera& camera, const QString& file)
+{
+  if (job.m_width > 0 && job.m_height > 0) {
+    camera.m_Film.m_Resolution.SetResX(job.m_width);
+    camera.m_Film.m_Resolution.SetResY(job.m_height);
+    resizeGL(job.m_width, job.m_height);
+  }
+  if (job.m_iterations > 0) {
+    // one call of doRender runs all the exposure iterations
+    camera.m_Film.m_ExposureIterations = job.m_iterations;
+  }
+
+  camera.Update();
+  m_renderer->pageInBricks(camera);
+  m_renderer->doRender(camera);
+
+  m_fbo->bind();
+  const int vw = m_fbo->width();
+  const int vh = m_fbo->height();
+  glViewport(0, 0, vw, vh);
+  m_renderer->drawImage();
+  m_fbo->release();
+
+  std::unique_ptr<uint8_t[]> bytes(new uint8_t[vw * vh * 4]);
+  m_fbo->toImage(bytes.get());
+  QImage img = QImage(bytes.get(), vw, vh, QImage::Format_RGB32).copy().mirrored();
+
+  if (!img.save(file)) {
+    LOG_ERROR << "Could not save " << file.toStdString();
+    return false;
+  }
+  LOG_INFO << "Saved " << file.toStdString();
+  return true;
+}
+
+// Command messages, back to back
+bool
+readCommandStream(const QString& path, const uint8_t* bytes, size_t length, CommandList& commands)
+{
+  size_t pos = 0;
+  while (pos < length) {
+    const size_t size = commandMessageSize(bytes + pos, length - pos);
+    if (size == 0) {
+      LOG_ERROR << path.toStdString() << " ends in a cut off message";
+      return false;
+    }
+    commandBuffer b(size, bytes + pos);
+    if (!b.processBuffer()) {
+      LOG_ERROR << path.toStdString() << " is neither a viewer state nor a command stream";
+      return false;
+    }
+    commands.append(b.takeQueue());
+    pos += size;
+  }
+  return true;
+}
+
+// Add the jobs of a viewer state, a command stream, or a server recording with one job per session. settings holds
+// the output and overrides for them.
+bool
+readJobInput(const QString& path, const RenderJob& settings, std::vector<RenderJob>& jobs)
+{
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    LOG_ERROR << "Can not open " << path.toStdString();
+    return false;
+  }
+  QByteArray data = file.readAll();
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.constData());
+
+  auto newJob = [&](const QString& output) {
+    RenderJob job;
+    job.m_input = path;
+    job.m_output = output;
+    job.m_iterations = settings.m_iterations;
+    job.m_width = settings.m_width;
+    job.m_height = settings.m_height;
+    return job;
+  };
+
+  if (isCommandRecording(bytes, data.size())) {
+    std::vector<RecordedMessage> messages;
+    std::string error;
+    if (!readCommandRecording(bytes, data.size(), messages, error)) {
+      LOG_ERROR << path.toStdString() << ": " << error;
+      return false;
+    }
+    std::map<uint32_t, CommandList> sessions;
+    for (const RecordedMessage& m : messages) {
+      if (!m.m_data.empty() && !readCommandStream(path, m.m_data.data(), m.m_data.size(), sessions[m.m_session])) {
+        return false;
+      }
+    }
+    const QFileInfo output(settings.m_output);
+    for (auto& session : sessions) {
+      // every session draws its own images
+      RenderJob job = newJob((sessions.size() == 1) ? settings.m_output
+                                                    : output.dir().filePath(output.completeBaseName() + "_" +
+                                                                            QString::number(session.first) + "." +
+                                                                            output.suffix()));
+      job.m_commands = std::move(session.second);
+      jobs.push_back(std::move(job));
+    }
+    return true;
+  }
+
+  RenderJob job = newJob(settings.m_output);
+  QJsonParseError error;
+  QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+  if (error.error == QJsonParseError::NoError && doc.isObject()) {
+    ViewerState state;
+    state.stateFromJson(doc);
+    state.stateToCommands(job.m_commands);
+  } else if (!readCommandStream(path, bytes, data.size(), job.m_commands)) {
+    return false;
+  }
+  jobs.push_back(std::move(job));
+  return true;
+}
+}
+
+bool
+readRenderScript(const QString& path, std::vector<RenderJob>& jobs)
+{
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    LOG_ERROR << "Can not open render script " << path.toStdString();
+    return false;
+  }
+  const QFileInfo info(path);
+  const QDir dir = info.absoluteDir();
+  QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+  file.close();
+
+  if (!doc.isObject() || !doc.object()["jobs"].isArray()) {
+    // the script is a single input, saved next to it
+    RenderJob settings;
+    settings.m_output = dir.filePath(info.completeBaseName() + ".png");
+    return readJobInput(info.absoluteFilePath(), settings, jobs);
+  }
+
+  QJsonArray entries = doc.object()["jobs"].toArray();
+  for (int i = 0; i < entries.size(); ++i) {
+    QJsonObject entry = entries[i].toObject();
+    const QString input = entry["input"].toString();
+    if (input.isEmpty()) {
+      LOG_ERROR << "Job " << i << " of " << path.toStdString() << " has no input";
+      return false;
+    }
+    RenderJob settings;
+    const QFileInfo inputInfo(dir.filePath(input));
+    settings.m_output = dir.filePath(entry["output"].toString(inputInfo.completeBaseName() + ".png"));
+    settings.m_iterations = entry["iterations"].toInt(0);
+    QJsonArray resolution = entry["resolution"].toArray();
+    if (resolution.size() == 2) {
+      settings.m_width = resolution[0].toInt(0);
+      settings.m_height = resolution[1].toInt(0);
+    }
+    if (!readJobInput(inputInfo.absoluteFilePath(), settings, jobs)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int
+runRenderJobs(std::vector<RenderJob>& jobs)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  JobQueue queue(jobs);
+  QMutex openGLMutex;
+  const int threadCount = std::max(std::min((int)jobs.size(), renderlib::deviceCount()), 1);
+  std::vector<std::unique_ptr<ScriptRenderer>> threads;
+  for (int i = 0; i < threadCount; ++i) {
+    threads.emplace_back(new ScriptRenderer(queue, openGLMutex, i));
+    threads.back()->start();
+  }
+  for (auto& t : threads) {
+    t->wait();
+  }
+
+  LOG_INFO << "Rendered " << jobs.size() << " job(s) on " << threadCount << " thread(s) in " << timer.elapsed() / 1000.0
+           << " s, " << queue.m_failed << " failed";
+  return queue.m_failed;
+}
@@ -0,0 +1,39 @@
+#ifndef RENDERSCRIPT_H
+#define RENDERSCRIPT_H
+
+#include "renderlib/CommandStream.h"
+
+#include <QString>
+
+#include <vector>
+
+// Images to render without a client: the commands of a saved viewer state or of a recorded command stream.
+// Like the python OffscreenRenderer, every RequestRedrawCommand saves an image under the name of the last
+// SessionCommand; a job without one saves a single image at the end.
+struct RenderJob
+{
+  // the file the commands came from
+  QString m_input;
+  CommandList m_commands;
+  // where images go until a SessionCommand names them. Session names are relative to its directory.
+  QString m_output;
+  // 0 = as the commands set them
+  int32_t m_iterations = 0;
+  int32_t m_width = 0, m_height = 0;
+};
+
+// Read the script given to --render. It is a viewer state as saved by the gui, a command stream, a server recording
+// (see CommandRecording.h) with a job for each of its sessions, or a JSON list of jobs with paths relative to the
+// script:
+// { "jobs": [ { "input": "cell.json", "output": "cell.png", "iterations": 256, "resolution": [2048, 2048] },
+//             { "input": "session.agvc", "output": "session.png" } ] }
+// Returns false, and logs why, if the script or one of its inputs can not be read.
+bool
+readRenderScript(const QString& path, std::vector<RenderJob>& jobs);
+
+// Render the jobs on one thread per selected device; repeat a device in --gpu to run more than one job on it at a
+// time. Returns the number of jobs that failed.
+int
+runRenderJobs(std::vector<RenderJob>& jobs);
+
+#endif // RENDERSCRIPT_H
@@ -0,0 +1,128 @@
+#include "rendersession.h"
+
+#include "renderrequest.h"
+
+#include "renderlib/AppScene.h"
+#include "renderlib/CCamera.h"
+#include "renderlib/RenderSettings.h"
+
+#include <algorithm>
+
+static const int INITIAL_SIZE = 1024;
+
+RenderSession::RenderSession(QWebSocket* client)
+  : m_renderSettings(new RenderSettings())
+  , m_scene(new Scene())
+  , m_camera(new CCamera())
+  , m_streamMode(0)
+  , m_frameDiff(false)
+  , m_width(INITIAL_SIZE)
+  , m_height(INITIAL_SIZE)
+  , m_tileSize(0)
+  , m_tileSamples(1)
+  , m_backPressure(false)
+  , m_maxFps(0)
+  , m_maxLatencyMs(0)
+  , m_framesWritten(0)
+  , m_clientAcks(false)
+  , m_client(client)
+  , m_totalQueueDuration(0)
+  , m_framesInFlight(0)
+{
+  m_camera->m_Film.m_ExposureIterations = 1;
+  m_camera->m_Film.m_Resolution.SetResX(INITIAL_SIZE);
+  m_camera->m_Film.m_Resolution.SetResY(INITIAL_SIZE);
+
+  m_scene->initLights();
+}
+
+RenderSession::~RenderSession()
+{
+  // delete all outstanding requests.
+  qDeleteAll(m_requests);
+
+  delete m_renderSettings;
+  delete m_scene;
+  delete m_camera;
+}
+
+void
+RenderSession::addRequest(RenderRequest* request)
+{
+  QMutexLocker locker(&m_requestsMutex);
+  if (m_requests.count() >= MAX_QUEUED_REQUESTS) {
+    // the merged request still renders only one frame, so the queue duration stays the same
+    m_requests.last()->append(request);
+    delete request;
+    return;
+  }
+  m_requests << request;
+  m_totalQueueDuration += request->getDuration();
+}
+
+RenderRequest*
+RenderSession::takeRequest()
+{
+  QMutexLocker locker(&m_requestsMutex);
+  if (m_requests.isEmpty()) {
+    return nullptr;
+  }
+  RenderRequest* r = m_requests.takeFirst();
+  m_totalQueueDuration -= r->getDuration();
+  return r;
+}
+
+bool
+RenderSession::hasRequests()
+{
+  QMutexLocker locker(&m_requestsMutex);
+  return !m_requests.isEmpty();
+}
+
+int
+RenderSession::getRequestCount()
+{
+  QMutexLocker locker(&m_requestsMutex);
+  return m_requests.count();
+}
+
+int
+RenderSession::getTotalQueueDuration()
+{
+  QMutexLocker locker(&m_requestsMutex);
+  return m_totalQueueDuration;
+}
+
+int
+RenderSession::getMaxFramesInFlight() const
+{
+  if (m_maxFps <= 0 || m_maxLatencyMs <= 0) {
+    return DEFAULT_FRAMES_IN_FLIGHT;
+  }
+  return std::max(1, m_maxLatencyMs * m_maxFps / 1000);
+}
+
+bool
+RenderSession::canSendFrame() const
+{
+  if (m_framesInFlight >= getMaxFramesInFlight()) {
+    return false;
+  }
+  return m_maxFps <= 0 || !m_frameTimer.isValid() || m_frameTimer.elapsed() * m_maxFps >= 1000;
+}
+
+void
+RenderSession::frameSent()
+{
+  m_framesInFlight++;
+  m_frameTimer.start();
+}
+
+void
+RenderSession::framesDelivered(int count)
+{
+  // acknowledgements may cover frames the socket already released
+  int inFlight = m_framesInFlight;
+  while (!m_framesInFlight.compare_exchange_weak(inFlight, std::max(inFlight - count, 0))) {
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef RENDERSESSION_H
+#define RENDERSESSION_H
+
+#include "frameencoder.h"
+#include "renderlib/FrameDiff.h"
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+
+#include <atomic>
+
+// Requests arriving while this many are queued are merged into the newest one, see RenderSession::addRequest
+#define MAX_QUEUED_REQUESTS 16
+// Stream mode frames that may be on their way to a client that has not set a frame rate and latency
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+
+class CCamera;
+class QWebSocket;
+class RenderRequest;
+class RenderSettings;
+class Scene;
+
+// Everything one client has set up, apart from the gpu resources to draw it.
+// There can be many more sessions than render threads: a Renderer draws each of its sessions in turn by swapping in
+// their scene, render settings and camera.
+class RenderSession
+{
+public:
+  RenderSession(QWebSocket* client);
+  ~RenderSession();
+
+  inline QWebSocket* getClient() { return m_client; }
+
+  // The request queue is filled by the server thread and drained by the render thread. After adding a request, wake
+  // the session's renderer with Renderer::wake.
+  // Once MAX_QUEUED_REQUESTS are waiting, the commands of a new request are appended to the newest queued one and the
+  // new request is deleted, so a client that sends faster than it is served does not make the queue grow.
+  void addRequest(RenderRequest* request);
+  // remove and return the oldest request, or nullptr
+  RenderRequest* takeRequest();
+
+  bool hasRequests();
+
+  int getRequestCount();
+
+  int getTotalQueueDuration();
+
+  // Stream pacing. A frame is in flight from when the renderer hands it to the server until the socket has written it
+  // out or, for clients that acknowledge frames, until the client says it got it.
+  // At the target frame rate, this many frames fit into the latency target.
+  int getMaxFramesInFlight() const;
+  // whether another refinement may be sent now; render thread
+  bool canSendFrame() const;
+  // a frame was handed to the server; render thread
+  void frameSent();
+  // frames reached the client; server thread
+  void framesDelivered(int count);
+
+  RenderSettings* m_renderSettings;
+  Scene* m_scene;
+  CCamera* m_camera;
+
+  // 1 = continuous re-render, 0 = only wait for redraw commands
+  int32_t m_streamMode;
+  StreamCodec m_codec;
+  // send only the tiles that changed since m_lastSentFrame
+  bool m_frameDiff;
+  FrameDiffParams m_frameDiffParams;
+  QImage m_lastSentFrame;
+  int32_t m_width, m_height;
+  // render in tiles of this size with m_tileSamples iterations each; 0 = off
+  int32_t m_tileSize;
+  int32_t m_tileSamples;
+  // the client has been told to slow down, see StreamServer::updateBackPressure
+  bool m_backPressure;
+  // see SetStreamPacingCommand; 0 = no limit / the default
+  int32_t m_maxFps;
+  int32_t m_maxLatencyMs;
+  // server thread: frames given to the socket since it last had nothing left to write
+  int m_framesWritten;
+  // server thread: the client acknowledges frames, so only those count as delivered
+  bool m_clientAcks;
+
+private:
+  QWebSocket* m_client;
+  QMutex m_requestsMutex;
+  QList<RenderRequest*> m_requests;
+  int m_totalQueueDuration;
+
+  std::atomic<int> m_framesInFlight;
+  // since the last frame sent
+  QElapsedTimer m_frameTimer;
+};
+
+#endif // RENDERSESSION_H
@@ -0,0 +1,248 @@
+#include "replay.h"
+
+#include "commandBuffer.h"
+#include "renderer.h"
+#include "renderrequest.h"
+#include "rendersession.h"
+#include "streamserver.h"
+
+#include "renderlib/Logging.h"
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QWebSocket>
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+// any fixed value will do; it only has to be the same from run to run
+static const int REPLAY_RANDOM_SEED = 1;
+// how often to look whether the renderers have drawn everything, once all messages are sent
+static const int DONE_CHECK_MS = 100;
+
+namespace {
+QJsonObject
+distribution(std::vector<double> values)
+{
+  QJsonObject j;
+  j["count"] = (int)values.size();
+  if (values.empty()) {
+    return j;
+  }
+  std::sort(values.begin(), values.end());
+  // nearest rank
+  auto percentile = [&values](double p) {
+    size_t rank = (size_t)std::max(std::ceil(p * values.size()), 1.0);
+    return values[std::min(rank, values.size()) - 1];
+  };
+  double sum = 0.0;
+  for (double v : values) {
+    sum += v;
+  }
+  j["mean"] = sum / values.size();
+  j["p50"] = percentile(0.5);
+  j["p90"] = percentile(0.9);
+  j["p99"] = percentile(0.99);
+  j["max"] = values.back();
+  return j;
+}
+}
+
+ReplayBenchmark::ReplayBenchmark(const std::vector<RecordedMessage>& messages, double speed, QObject* parent)
+  : QObject(parent)
+  , m_messages(messages)
+  , m_next(0)
+  , m_speed(speed)
+  , m_idleOnce(false)
+  , m_seconds(0.0)
+  , m_lastFrameUs(0)
+  , m_requests(0)
+  , m_samples(0)
+{
+  m_feedTimer.setSingleShot(true);
+  connect(&m_feedTimer, &QTimer::timeout, this, &ReplayBenchmark::feed);
+  connect(&m_doneTimer, &QTimer::timeout, this, &ReplayBenchmark::checkDone);
+}
+
+ReplayBenchmark::~ReplayBenchmark()
+{
+  // the renderers delete their sessions
+  foreach (Renderer* r, m_renderers) {
+    r->stop();
+    r->wait();
+    delete r;
+  }
+  qDeleteAll(m_clients);
+}
+
+void
+ReplayBenchmark::start()
+{
+  // as many render threads as the server would have started for these sessions
+  std::set<uint32_t> sessions;
+  for (const RecordedMessage& m : m_messages) {
+    sessions.insert(m.m_session);
+  }
+  const int devices = std::max(renderlib::deviceCount(), 1);
+  const int count = std::max(std::min((int)sessions.size(), THREAD_COUNT * devices), 1);
+  for (int i = 0; i < count; ++i) {
+    Renderer* r = new Renderer("Replay " + QString::number(i), this, m_openGLMutex, i % devices);
+    r->setFixedRandomSeed(REPLAY_RANDOM_SEED);
+    connect(r,
+            SIGNAL(requestProcessed(RenderRequest*, QImage)),
+            this,
+            SLOT(onRequestProcessed(RenderRequest*, QImage)),
+            Qt::QueuedConnection);
+    connect(r, SIGNAL(sendString(QWebSocket*, QString)), this, SLOT(onSendString(QWebSocket*, QString)));
+    r->start();
+    m_renderers << r;
+  }
+
+  LOG_INFO << "Replaying " << m_messages.size() << " messages of " << sessions.size() << " sessions on " << count
+           << " render threads";
+  m_clock.start();
+  feed();
+}
+
+void
+ReplayBenchmark::feed()
+{
+  while (m_next < m_messages.size()) {
+    const RecordedMessage& m = m_messages[m_next];
+    if (m_speed > 0.0) {
+      const qint64 waitMs = (qint64)(m.m_timeUs / 1000.0 / m_speed) - m_clock.elapsed();
+      if (waitMs > 0) {
+        m_feedTimer.start((int)waitMs);
+        return;
+      }
+    } else {
+      RenderSession* session = m_sessions.value(m_clients.value(m.m_session, nullptr), nullptr);
+      if (session && session->hasRequests()) {
+        m_feedTimer.start(1);
+        return;
+      }
+    }
+    send(m);
+    m_next++;
+  }
+
+  LOG_INFO << "Sent all messages after " << m_clock.elapsed() / 1000.0 << " s, waiting for the renderers";
+  m_doneTimer.start(DONE_CHECK_MS);
+}
+
+void
+ReplayBenchmark::send(const RecordedMessage& m)
+{
+  if (m.m_data.empty()) {
+    endSession(m.m_session);
+    return;
+  }
+
+  QWebSocket* client = m_clients.value(m.m_session, nullptr);
+  if (!client) {
+    client = new QWebSocket();
+    RenderSession* session = new RenderSession(client);
+    Renderer* r = m_renderers[m.m_session % m_renderers.length()];
+    r->addSession(session);
+    m_clients[m.m_session] = client;
+    m_sessions[client] = session;
+    m_sessionRenderers[session] = r;
+  }
+  RenderSession* session = m_sessions[client];
+
+  commandBuffer b(m.m_data.size(), m.m_data.data());
+  if (!b.processBuffer()) {
+    return;
+  }
+  session->addRequest(new RenderRequest(client, b.takeQueue()));
+  m_waiting[session].push_back(m_clock.nsecsElapsed() / 1000);
+  m_requests++;
+  m_sessionRenderers[session]->wake();
+}
+
+void
+ReplayBenchmark::endSession(uint32_t recordedSession)
+{
+  QWebSocket* client = m_clients.take(recordedSession);
+  if (!client) {
+    return;
+  }
+  RenderSession* session = m_sessions.take(client);
+  m_waiting.remove(session);
+  m_sessionRenderers.take(session)->removeSession(session);
+  client->deleteLater();
+}
+
+void
+ReplayBenchmark::onRequestProcessed(RenderRequest* request, QImage image)
+{
+  const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+  m_lastFrameUs = nowUs;
+  const qint64 frameStartUs = nowUs - request->getActualDuration() / 1000;
+  m_frameMs.push_back(request->getActualDuration() / 1.0e6);
+  m_samples += request->getSamples();
+
+  RenderSession* session = m_sessions.value(request->getClient(), nullptr);
+  if (session) {
+    // no socket to write to, so the frame is delivered right away
+    session->framesDelivered(1);
+    // the requests sent before the frame started went into it
+    std::deque<qint64>& waiting = m_waiting[session];
+    while (!waiting.empty() && waiting.front() <= frameStartUs) {
+      m_latenciesMs.push_back((nowUs - waiting.front()) / 1000.0);
+      waiting.pop_front();
+    }
+  }
+  delete request;
+}
+
+void
+ReplayBenchmark::onSendString(QWebSocket*, QString s)
+{
+  LOG_DEBUG << "Replay reply: " << s.toStdString();
+}
+
+void
+ReplayBenchmark::checkDone()
+{
+  bool idle = true;
+  foreach (Renderer* r, m_renderers) {
+    idle = idle && r->isIdle();
+  }
+  foreach (RenderSession* session, m_sessions) {
+    idle = idle && !session->hasRequests();
+  }
+  // frames handed over just before the renderers went to sleep may still be on their way; wait for one more check
+  if (!idle || !m_idleOnce) {
+    m_idleOnce = idle;
+    return;
+  }
+
+  m_doneTimer.stop();
+  // the replay ends with its last frame, not with the check that noticed
+  m_seconds = ((m_lastFrameUs > 0) ? m_lastFrameUs : m_clock.nsecsElapsed() / 1000) / 1.0e6;
+  LOG_INFO << "Replay done: " << report().toStdString();
+  QCoreApplication::exit(0);
+}
+
+QString
+ReplayBenchmark::report() const
+{
+  int unanswered = 0;
+  for (const std::deque<qint64>& waiting : m_waiting) {
+    unanswered += (int)waiting.size();
+  }
+
+  QJsonObject j;
+  j["messages"] = (int)m_messages.size();
+  j["requests"] = m_requests;
+  j["unansweredRequests"] = unanswered;
+  j["frames"] = (int)m_frameMs.size();
+  j["seconds"] = m_seconds;
+  j["samplesPerSecond"] = (m_seconds > 0.0) ? m_samples / m_seconds : 0.0;
+  j["requestLatencyMs"] = distribution(m_latenciesMs);
+  j["frameMs"] = distribution(m_frameMs);
+  return QString::fromUtf8(QJsonDocument(j).toJson(QJsonDocument::Compact));
+}
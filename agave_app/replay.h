@@ -0,0 +1,77 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "renderlib/CommandRecording.h"
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QTimer>
+
+#include <deque>
+#include <vector>
+
+class QWebSocket;
+class RenderRequest;
+class RenderSession;
+class Renderer;
+
+// Feeds a server recording (see StreamServer::startRecording) into render threads as the server would, and reports
+// how long requests waited for their frame, how long frames took and how many samples per second were drawn.
+// Every recorded session gets a session of its own, with a stand-in socket that is never connected. The renderers
+// start every image from a fixed random seed, so the same messages draw the same samples.
+class ReplayBenchmark : public QObject
+{
+  Q_OBJECT
+
+public:
+  // speed scales the recorded timing: 2 sends the messages twice as fast. 0 sends each message once everything sent
+  // before it to its session has been drawn, so every run does the same work, for comparing releases.
+  ReplayBenchmark(const std::vector<RecordedMessage>& messages, double speed, QObject* parent = nullptr);
+  ~ReplayBenchmark();
+
+  // start the render threads and the replay; the application quits when it is done
+  void start();
+
+  // the report, as a JSON object
+  QString report() const;
+
+private slots:
+  void feed();
+  void checkDone();
+  void onRequestProcessed(RenderRequest* request, QImage image);
+  void onSendString(QWebSocket* client, QString s);
+
+private:
+  void send(const RecordedMessage& m);
+  void endSession(uint32_t recordedSession);
+
+  std::vector<RecordedMessage> m_messages;
+  size_t m_next;
+  double m_speed;
+
+  QMutex m_openGLMutex;
+  QList<Renderer*> m_renderers;
+  QMap<uint32_t, QWebSocket*> m_clients;
+  QMap<QWebSocket*, RenderSession*> m_sessions;
+  QMap<RenderSession*, Renderer*> m_sessionRenderers;
+  // when the requests of a session that no frame has answered yet were sent, in microseconds
+  QMap<RenderSession*, std::deque<qint64>> m_waiting;
+
+  QElapsedTimer m_clock;
+  QTimer m_feedTimer;
+  QTimer m_doneTimer;
+  bool m_idleOnce;
+  double m_seconds;
+  qint64 m_lastFrameUs;
+
+  int m_requests;
+  std::vector<double> m_latenciesMs;
+  std::vector<double> m_frameMs;
+  qint64 m_samples;
+};
+
+#endif // REPLAY_H
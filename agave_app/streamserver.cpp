@@ -9,34 +9,157 @@
 #include <QSslConfiguration>
 #include <QSslKey>
 
+#include <algorithm>
+
 #include "commandBuffer.h"
+#include "renderlib/DeviceLoad.h"
 #include "renderlib/Logging.h"
 
 QT_USE_NAMESPACE
 
-const char* DEFAULT_IMAGE_FORMAT = "JPG";
+// the session length assumed for queue estimates until sessions have ended
+static const double DEFAULT_SESSION_SECONDS = 300.0;
 
-void
-StreamServer::createNewRenderer(QWebSocket* client)
+// text message of a client that acknowledges the frames it got: {"msgtype": 3, "frames": n}, n defaults to 1
+static const int MSGTYPE_FRAME_ACK = 3;
+
+int
+StreamServer::getLeastBusyDevice()
+{
+  std::vector<DeviceLoad> devices(renderlib::deviceCount());
+  for (int i = 0; i < (int)devices.size(); ++i) {
+    devices[i].m_gpuBytes = renderlib::gpuCacheBytes(i);
+    devices[i].m_freeMemoryBytes = renderlib::deviceFreeMemoryBytes(i);
+  }
+  foreach (Renderer* renderer, this->_renderers) {
+    DeviceLoad& d = devices[renderer->getDevice()];
+    d.m_sessions++;
+    d.m_queuedRequests += renderer->getRequestCount();
+    d.m_queueDurationMs += renderer->getTotalQueueDuration();
+    d.m_gpuBytes += renderer->getGpuBytes();
+  }
+  return std::max(leastLoadedDevice(devices), 0);
+}
+
+Renderer*
+StreamServer::createNewRenderer()
 {
   int i = this->_renderers.length();
-  Renderer* r = new Renderer("Thread " + QString::number(i), this, _openGLMutex);
+  int device = getLeastBusyDevice();
+  Renderer* r = new Renderer("Thread " + QString::number(i), this, _openGLMutex, device);
   this->_renderers << r;
 
   // queued across thread boundary.  typically requestProcessed is called from another thread.
-  // BlockingQueuedConnection forces send to happen immediately after render.  Default (QueuedConnection) will be fully
-  // async.
+  // The images are encoded on the encoder's threads, so the renderer can go on with the next frame while the previous
+  // one is encoded and sent.
   connect(r,
           SIGNAL(requestProcessed(RenderRequest*, QImage)),
           this,
           SLOT(sendImage(RenderRequest*, QImage)),
-          Qt::BlockingQueuedConnection);
-  connect(r, SIGNAL(sendString(RenderRequest*, QString)), this, SLOT(sendString(RenderRequest*, QString)));
+          Qt::QueuedConnection);
+  connect(r, SIGNAL(sendString(QWebSocket*, QString)), this, SLOT(sendString(QWebSocket*, QString)));
 
-  LOG_INFO << "Starting thread" << i << "...";
+  LOG_INFO << "Starting thread" << i << " on device " << device << "...";
   r->start();
 
-  _clientRenderers[client] = r;
+  return r;
+}
+
+Renderer*
+StreamServer::getLeastBusyRenderer()
+{
+  if (_renderers.length() < maxRenderers()) {
+    return createNewRenderer();
+  }
+
+  // the same policy that places renderers on devices places sessions on renderers
+  std::vector<DeviceLoad> loads;
+  QList<Renderer*> candidates;
+  foreach (Renderer* renderer, this->_renderers) {
+    const int sessions = renderer->getSessionCount();
+    if (sessions >= SESSIONS_PER_THREAD) {
+      continue;
+    }
+    DeviceLoad load;
+    load.m_sessions = sessions;
+    load.m_queuedRequests = renderer->getRequestCount();
+    load.m_queueDurationMs = renderer->getTotalQueueDuration();
+    load.m_gpuBytes = renderer->getGpuBytes();
+    load.m_freeMemoryBytes = renderlib::deviceFreeMemoryBytes(renderer->getDevice());
+    loads.push_back(load);
+    candidates << renderer;
+  }
+  int best = leastLoadedDevice(loads);
+  return (best < 0) ? nullptr : candidates[best];
+}
+
+bool
+StreamServer::admitSession(RenderSession* session)
+{
+  Renderer* r = getLeastBusyRenderer();
+  if (!r) {
+    return false;
+  }
+  r->addSession(session);
+  _sessionRenderers[session] = r;
+  _sessionStart[session] = _clock.elapsed();
+  return true;
+}
+
+void
+StreamServer::admitWaitingSessions()
+{
+  bool admitted = false;
+  while (!_admissionQueue.isEmpty() && admitSession(_admissionQueue.first())) {
+    RenderSession* session = _admissionQueue.takeFirst();
+    sendQueuePosition(session, 0);
+    admitted = true;
+  }
+  if (admitted) {
+    for (int i = 0; i < _admissionQueue.length(); ++i) {
+      sendQueuePosition(_admissionQueue[i], i + 1);
+    }
+  }
+}
+
+void
+StreamServer::sendQueuePosition(RenderSession* session, int position)
+{
+  QWebSocket* client = session->getClient();
+  if (!client->isValid() || client->state() != QAbstractSocket::ConnectedState) {
+    return;
+  }
+  // sessions end at a rate of about maxSessions per mean session length
+  QJsonObject j;
+  j["queuePosition"] = position;
+  j["queueEta"] = qRound(position * _meanSessionSeconds / maxSessions());
+  client->sendTextMessage(QString::fromUtf8(QJsonDocument(j).toJson(QJsonDocument::Compact)));
+}
+
+void
+StreamServer::updateBackPressure(RenderSession* session)
+{
+  // the queue has to drain well below its limit before the client may speed up again, so the messages don't flap
+  const int queued = session->getRequestCount();
+  bool backPressure = session->m_backPressure;
+  if (queued >= MAX_QUEUED_REQUESTS) {
+    backPressure = true;
+  } else if (queued <= MAX_QUEUED_REQUESTS / 4) {
+    backPressure = false;
+  }
+  if (backPressure == session->m_backPressure) {
+    return;
+  }
+  session->m_backPressure = backPressure;
+
+  QWebSocket* client = session->getClient();
+  if (!client->isValid() || client->state() != QAbstractSocket::ConnectedState) {
+    return;
+  }
+  QJsonObject j;
+  j["backPressure"] = backPressure ? 1 : 0;
+  j["queuedRequests"] = queued;
+  client->sendTextMessage(QString::fromUtf8(QJsonDocument(j).toJson(QJsonDocument::Compact)));
 }
 
 StreamServer::StreamServer(quint16 port, bool debug, QObject* parent)
@@ -44,11 +167,17 @@ StreamServer::StreamServer(quint16 port, bool debug, QObject* parent)
   , _webSocketServer(new QWebSocketServer(QStringLiteral("AICS RENDERSERVER"), QWebSocketServer::NonSecureMode, this))
   , _clients()
   , _renderers()
+  , _meanSessionSeconds(DEFAULT_SESSION_SECONDS)
   , debug(debug)
+  , _encoder(new FrameEncoder(THREAD_COUNT, this))
+  , _nextRecordedSession(0)
 {
   connect(this, &StreamServer::closed, qApp, &QApplication::quit);
+  connect(_encoder, &FrameEncoder::frameEncoded, this, &StreamServer::sendFrame);
+  _clock.start();
 
-  LOG_INFO << "Server is starting up with " << THREAD_COUNT << " max threads, listening on port " << port << " ...";
+  LOG_INFO << "Server is starting up with " << maxRenderers() << " max threads on " << renderlib::deviceCount()
+           << " devices for " << maxSessions() << " sessions, listening on port " << port << " ...";
 
   QSslConfiguration sslConfiguration;
   QFile certFile(QStringLiteral("mr.crt"));
@@ -84,6 +213,20 @@ StreamServer::~StreamServer()
   _webSocketServer->close();
   qDeleteAll(_clients.begin(), _clients.end());
   qDeleteAll(_renderers.begin(), _renderers.end());
+  qDeleteAll(_admissionQueue.begin(), _admissionQueue.end());
+}
+
+bool
+StreamServer::startRecording(const QString& path)
+{
+  _recorder.reset(new CommandRecorder(path.toStdString()));
+  if (!_recorder->isOpen()) {
+    LOG_ERROR << "Can not record to " << path.toStdString();
+    _recorder.reset();
+    return false;
+  }
+  LOG_INFO << "Recording command messages to " << path.toStdString();
+  return true;
 }
 
 void
@@ -99,9 +242,8 @@ StreamServer::onNewConnection()
 {
   QWebSocket* pSocket = _webSocketServer->nextPendingConnection();
 
-  // fire up new renderer?
-  if (_renderers.length() >= THREAD_COUNT) {
-    // handle this better.
+  // every renderer is full and the queue is long enough
+  if (_sessions.count() >= maxSessions() + MAX_WAITING_SESSIONS) {
     pSocket->abort();
     LOG_DEBUG << "TOO MANY CONNECTIONS.";
     return;
@@ -110,6 +252,7 @@ StreamServer::onNewConnection()
   connect(pSocket, &QWebSocket::textMessageReceived, this, &StreamServer::processTextMessage);
   connect(pSocket, &QWebSocket::binaryMessageReceived, this, &StreamServer::processBinaryMessage);
   connect(pSocket, &QWebSocket::disconnected, this, &StreamServer::socketDisconnected);
+  connect(pSocket, &QWebSocket::bytesWritten, this, &StreamServer::onBytesWritten);
   //	QObject::connect(pSocket, &QWebSocket::error, [pSocket](QAbstractSocket::SocketError e)
   //	{
   //		// Handle error here...
@@ -117,7 +260,14 @@ StreamServer::onNewConnection()
   //	});
 
   _clients << pSocket;
-  createNewRenderer(pSocket);
+  RenderSession* session = new RenderSession(pSocket);
+  _sessions[pSocket] = session;
+  if (!admitSession(session)) {
+    // commands sent while waiting are kept and run once a renderer has room
+    _admissionQueue << session;
+    sendQueuePosition(session, _admissionQueue.length());
+    LOG_INFO << "All renderers are full, " << _admissionQueue.length() << " sessions waiting";
+  }
 
   // if (m_debug)
   LOG_DEBUG << "new client! " << pSocket->resourceName().toStdString() << "; "
@@ -125,10 +275,10 @@ StreamServer::onNewConnection()
             << pSocket->peerName().toStdString();
 }
 
-Renderer*
-StreamServer::getRendererForClient(QWebSocket* client)
+RenderSession*
+StreamServer::getSessionForClient(QWebSocket* client)
 {
-  return _clientRenderers[client];
+  return _sessions.value(client, nullptr);
 }
 
 void
@@ -161,6 +311,15 @@ StreamServer::processTextMessage(QString message)
       case 2: {
         break;
       }
+      case MSGTYPE_FRAME_ACK: {
+        RenderSession* session = getSessionForClient(pClient);
+        if (session) {
+          // from now on only the client says when a frame has arrived
+          session->m_clientAcks = true;
+          session->framesDelivered(std::max(json["frames"].toInt(1), 1));
+        }
+        break;
+      }
 
         // default:
         // break;
@@ -175,18 +334,37 @@ StreamServer::processBinaryMessage(QByteArray message)
   //	if (debug)
   //		qDebug() << "Binary Message received:" << message;
   if (pClient) {
-    // the message had better be an encoded command stream.  check a header perhaps?
+    if (_recorder) {
+      if (!_recordedSessions.contains(pClient)) {
+        _recordedSessions[pClient] = _nextRecordedSession++;
+      }
+      _recorder->record(
+        _recordedSessions[pClient], reinterpret_cast<const uint8_t*>(message.constData()), message.length());
+    }
+
+    // the message had better be an encoded command stream, with or without the header of findCommandPayload.
+    // The commands are parsed straight out of the message, which is not copied.
     commandBuffer b(message.length(), reinterpret_cast<const uint8_t*>(message.constData()));
-    b.processBuffer();
+    if (!b.processBuffer()) {
+      return;
+    }
 
     // one message is a list of commands to run before rendering.
     // the complete message amounts to a single render request and an image is expected to come out of it.
 
-    // hand the commands over to the RenderRequest.
+    // move the commands over to the RenderRequest.
     // RenderRequest will assume ownership and delete them
 
-    RenderRequest* request = new RenderRequest(pClient, b.getQueue());
-    this->getRendererForClient(pClient)->addRequest(request);
+    RenderSession* session = this->getSessionForClient(pClient);
+    if (session) {
+      session->addRequest(new RenderRequest(pClient, b.takeQueue()));
+      updateBackPressure(session);
+      // a waiting session has no renderer yet, and is woken up when it gets one
+      Renderer* r = _sessionRenderers.value(session, nullptr);
+      if (r) {
+        r->wake();
+      }
+    }
   }
 }
 
@@ -202,14 +380,32 @@ StreamServer::socketDisconnected()
             << QString::number(pClient->peerPort()).toStdString() << ") "
             << "code: (" << pClient->closeCode() << ":" << pClient->closeReason().toStdString() + ")";
   if (pClient) {
-    Renderer* r = getRendererForClient(pClient);
-    QObject::connect(r, &Renderer::finished, r, &QObject::deleteLater);
-    if (r) {
-      r->requestInterruption();
+    if (_recorder && _recordedSessions.contains(pClient)) {
+      _recorder->endSession(_recordedSessions.take(pClient));
+    }
+    RenderSession* session = _sessions.take(pClient);
+    if (session && _admissionQueue.removeAll(session) > 0) {
+      delete session;
+      for (int i = 0; i < _admissionQueue.length(); ++i) {
+        sendQueuePosition(_admissionQueue[i], i + 1);
+      }
+    } else if (session) {
+      const double seconds = (_clock.elapsed() - _sessionStart.take(session)) / 1000.0;
+      _meanSessionSeconds = 0.8 * _meanSessionSeconds + 0.2 * seconds;
+
+      // the renderer deletes the session
+      Renderer* r = _sessionRenderers.take(session);
+      r->removeSession(session);
+      admitWaitingSessions();
+
+      if (r->getSessionCount() == 0) {
+        QObject::connect(r, &Renderer::finished, r, &QObject::deleteLater);
+        r->stop();
+        _renderers.removeAll(r);
+      }
     }
     _clients.removeAll(pClient);
-    _renderers.removeAll(r);
-    _clientRenderers.remove(pClient);
+    _encoder->removeClient(pClient);
     pClient->deleteLater();
   }
 }
@@ -224,30 +420,53 @@ StreamServer::sendImage(RenderRequest* request, QImage image)
   }
 
   QWebSocket* client = request->getClient();
+  if (client != 0 && _clients.contains(client)) {
+    _encoder->encode(client, image, request->getCodec(), request->isDelta() ? &request->getFrameTiles() : nullptr);
+
+    RenderSession* session = getSessionForClient(client);
+    if (session) {
+      updateBackPressure(session);
+    }
+  }
+
+  // this is the end of the line for a request.
+  delete request;
+}
+
+void
+StreamServer::sendFrame(QWebSocket* client, QByteArray data)
+{
   if (client != 0 && _clients.contains(client) && client->isValid() &&
       client->state() == QAbstractSocket::ConnectedState) {
-    QByteArray ba;
-    QBuffer buffer(&ba);
-    buffer.open(QIODevice::WriteOnly);
-    image.save(&buffer, DEFAULT_IMAGE_FORMAT, 92);
-    LOG_DEBUG << "Send Image " << buffer.size() << " bytes to " << client->peerName().toStdString() << "("
+    LOG_DEBUG << "Send Image " << data.size() << " bytes to " << client->peerName().toStdString() << "("
               << client->peerAddress().toString().toStdString() << ":"
               << QString::number(client->peerPort()).toStdString() << ")";
-    client->sendBinaryMessage(ba);
+    client->sendBinaryMessage(data);
+
+    RenderSession* session = getSessionForClient(client);
+    if (session) {
+      session->m_framesWritten++;
+    }
   }
+}
 
-  // this is the end of the line for a request.
-  delete request;
+void
+StreamServer::onBytesWritten(qint64)
+{
+  QWebSocket* pClient = qobject_cast<QWebSocket*>(sender());
+  RenderSession* session = getSessionForClient(pClient);
+  // every frame written so far has left the socket
+  if (session && !session->m_clientAcks && session->m_framesWritten > 0 && pClient->bytesToWrite() == 0) {
+    session->framesDelivered(session->m_framesWritten);
+    session->m_framesWritten = 0;
+  }
 }
 
 void
-StreamServer::sendString(RenderRequest* request, QString s)
+StreamServer::sendString(QWebSocket* client, QString s)
 {
-  QWebSocket* client = request->getClient();
   if (client != 0 && _clients.contains(client) && client->isValid() &&
       client->state() == QAbstractSocket::ConnectedState) {
     client->sendTextMessage(s);
   }
-  // do not dispose of request here.
-  // see requestProcessed<-->sendImage from Renderer.
 }
@@ -15,14 +15,25 @@
 #include <QWidget>
 #include <QtDebug>
 
+#include <QElapsedTimer>
 #include <QSslError>
 
+#include "frameencoder.h"
 #include "renderer.h"
+#include "renderlib/CommandRecording.h"
+#include "rendersession.h"
+
+#include <memory>
 
 QT_FORWARD_DECLARE_CLASS(QWebSocketServer)
 QT_FORWARD_DECLARE_CLASS(QWebSocket)
 
+// renderer threads per device
 #define THREAD_COUNT 4
+// sessions that one renderer thread takes turns drawing
+#define SESSIONS_PER_THREAD 8
+// connections beyond this many waiting for a renderer are refused
+#define MAX_WAITING_SESSIONS 64
 
 class StreamServer : public QObject
 {
@@ -37,6 +48,12 @@ public:
 
   inline int getThreadsCount() { return _renderers.length(); }
 
+  inline int maxRenderers() { return THREAD_COUNT * renderlib::deviceCount(); }
+
+  inline int maxSessions() { return SESSIONS_PER_THREAD * maxRenderers(); }
+
+  inline int getWaitingCount() { return _admissionQueue.length(); }
+
   inline QList<int> getThreadsLoad()
   {
     QList<int> loads;
@@ -57,6 +74,10 @@ public:
     return requests;
   }
 
+  // Record every binary message from now on, with its time and session, to replay with agave --replay. Returns false
+  // if the file can not be written.
+  bool startRecording(const QString& path);
+
 signals:
   void closed();
 
@@ -67,23 +88,55 @@ private slots:
   void processBinaryMessage(QByteArray message);
   void socketDisconnected();
   void sendImage(RenderRequest* request, QImage image);
-  void sendString(RenderRequest* request, QString s);
+  void sendFrame(QWebSocket* client, QByteArray data);
+  void sendString(QWebSocket* client, QString s);
+  void onBytesWritten(qint64 bytes);
 
 private:
-  // Renderer *getLeastBusyRenderer();
-  Renderer* getRendererForClient(QWebSocket* client);
+  // a new renderer while there are fewer than maxRenderers, else the least busy one with room for another session
+  Renderer* getLeastBusyRenderer();
+  RenderSession* getSessionForClient(QWebSocket* client);
+  // the device to place a new renderer on, by the load of its renderers and its gpu memory use
+  int getLeastBusyDevice();
+
+  // hand the session to a renderer; false if they are all full
+  bool admitSession(RenderSession* session);
+  // admit waiting sessions in order while there is room, and tell the rest where they are in the queue
+  void admitWaitingSessions();
+  // position 0 means the session is being rendered
+  void sendQueuePosition(RenderSession* session, int position);
+  // Tell the client to hold back its requests when its queue is full, and when it may go on. Called whenever the
+  // session's queue grows or a frame of it is sent.
+  void updateBackPressure(RenderSession* session);
 
   QWebSocketServer* _webSocketServer;
 
   QList<QWebSocket*> _clients;
   QList<Renderer*> _renderers;
-  QMap<QWebSocket*, Renderer*> _clientRenderers;
+  QMap<QWebSocket*, RenderSession*> _sessions;
+  // the renderer of every admitted session
+  QMap<RenderSession*, Renderer*> _sessionRenderers;
+  // sessions waiting for room on a renderer, first come first served
+  QList<RenderSession*> _admissionQueue;
+
+  // how long sessions tend to last, for estimating the wait in the admission queue
+  QElapsedTimer _clock;
+  QMap<RenderSession*, qint64> _sessionStart;
+  double _meanSessionSeconds;
 
   bool debug;
 
-  void createNewRenderer(QWebSocket* client);
+  Renderer* createNewRenderer();
 
+  // serializes renderer gl context creation into the share group; rendering itself runs unlocked
   QMutex _openGLMutex;
+
+  FrameEncoder* _encoder;
+
+  std::unique_ptr<CommandRecorder> _recorder;
+  // the number of every client in the recording
+  QMap<QWebSocket*, quint32> _recordedSessions;
+  quint32 _nextRecordedSession;
 };
 
 #endif // STREAMSERVER_H
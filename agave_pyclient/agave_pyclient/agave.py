@@ -6,6 +6,7 @@ import json
 import math
 import numpy
 import queue
+import struct
 from PIL import Image
 from typing import List
 
@@ -166,6 +167,8 @@ class AgaveRenderer:
     def __init__(self) -> None:
         self.cb = CommandBuffer()
         self.session_name = ""
+        # the image that delta frames are applied to
+        self.last_image = None
         self.ws = AgaveClient("ws://localhost:1235/", protocols=["http-only", "chat"])
         # self.ws.onOpened = self.onOpen
         self.ws.connect()
@@ -174,6 +177,34 @@ class AgaveRenderer:
         #     print("keyboard")
         #     ws.close()
 
+    def _decode_image(self, data: bytes):
+        # go by what the payload is, since the server keeps its codec when it
+        # does not support the one that was asked for
+        is_jpeg = data[:2] == b"\xff\xd8"
+        is_png = data[:8] == b"\x89PNG\r\n\x1a\n"
+        is_webp = data[:4] == b"RIFF" and data[8:12] == b"WEBP"
+        if is_jpeg or is_png or is_webp:
+            return Image.open(io.BytesIO(data))
+        width, height = struct.unpack_from("<II", data, 0)
+        return Image.frombytes("RGBA", (width, height), data[8:])
+
+    def _decode_frame(self, data: bytes):
+        if data[:4] != b"AGVD":
+            self.last_image = self._decode_image(data)
+            return self.last_image
+        # a delta frame: paint the changed tiles over the previous image
+        width, height, count = struct.unpack_from("<III", data, 4)
+        if self.last_image is None or self.last_image.size != (width, height):
+            self.last_image = Image.new("RGBA", (width, height))
+        offset = 16
+        for i in range(count):
+            x, y, w, h, size = struct.unpack_from("<IIIII", data, offset)
+            offset += 20
+            tile = self._decode_image(data[offset : offset + size])
+            offset += size
+            self.last_image.paste(tile, (x, y))
+        return self.last_image
+
     def session(self, name: str):
         """
         Set the current session name.  Use the full path to the name of the output
@@ -419,7 +450,7 @@ class AgaveRenderer:
         #  and then WAIT for render to be completed
         binarydata = self.ws.wait_for_image()
         # and save image
-        im = Image.open(binarydata)
+        im = self._decode_frame(binarydata.getvalue())
         print(self.session_name)
         im.save(self.session_name)
         # ready for next frame
@@ -871,6 +902,226 @@ class AgaveRenderer:
         # 42
         self.cb.add_command("SHOW_BOUNDING_BOX", on)
 
+    def set_volume_crop(self, on: int):
+        """
+        Crop the volume held on the gpu to the clip region (see set_clip_region).
+        This saves gpu memory and upload time when the clip region is much smaller
+        than the volume. Changing the clip region later may cause a re-upload.
+
+        Parameters
+        ----------
+        on: int
+            0 to upload the whole volume, 1 to upload only the part
+            of the volume around the clip region
+        """
+        # 44
+        self.cb.add_command("SET_VOLUME_CROP", on)
+
+    def set_error_target(self, target: float):
+        """
+        Adaptive sampling: stop rendering pixels once their noise is below a target.
+        Background and smooth regions converge early, so the renderer spends its
+        samples where the image is still noisy, and stops streaming new frames once
+        every pixel has converged.
+        The server replies with a json message holding the fraction of converged
+        pixels ("convergence") and the number of iterations so far. Sending the
+        current target again only queries these.
+
+        Parameters
+        ----------
+        target: float
+            Relative standard error of a pixel's luminance at which it stops
+            taking samples, e.g. 0.02. 0 disables adaptive sampling.
+        """
+        # 45
+        self.cb.add_command("SET_ERROR_TARGET", target)
+
+    def set_interactive_downsample(self, factor: int):
+        """
+        While the camera is changing, render at a reduced resolution and upsample,
+        so that interaction stays responsive. Full resolution rendering resumes
+        once the camera stops moving.
+
+        Parameters
+        ----------
+        factor: int
+            1 to always render at full resolution, 2 for half or 4 for quarter
+            resolution while moving.
+        """
+        # 46
+        self.cb.add_command("SET_INTERACTIVE_DOWNSAMPLE", factor)
+
+    def set_temporal_reprojection(self, enabled: int):
+        """
+        After a camera change, start from the previous image warped into the new
+        view instead of from nothing. Pixels that were hidden before, or that moved
+        too far, start over. Small orbit steps, e.g. in batch_render_turntable,
+        reach a clean image in fewer iterations.
+
+        Parameters
+        ----------
+        enabled: int
+            0 to restart from nothing on every camera change, 1 to reproject.
+        """
+        # 47
+        self.cb.add_command("SET_TEMPORAL_REPROJECTION", enabled)
+
+    def set_denoise(self, enabled: int):
+        """
+        Filter the image of the first iterations with an edge preserving denoiser,
+        guided by the depth, normal and color of the volume at each pixel. The
+        filter fades out as samples accumulate. Off by default.
+
+        Parameters
+        ----------
+        enabled: int
+            0 to show the raw accumulation, 1 to denoise early iterations.
+        """
+        # 48
+        self.cb.add_command("SET_DENOISE", enabled)
+
+    def set_tiled_rendering(self, tile_size: int, samples: int):
+        """
+        Render each image in square tiles, accumulating the given number of samples
+        in one tile before moving on to the next. The gpu only holds the buffers for
+        one tile, which makes resolutions possible that would not fit in gpu memory at
+        once. Each redraw returns the complete image.
+
+        Parameters
+        ----------
+        tile_size: int
+            Width and height of a tile in pixels. 0 renders the whole image at once.
+        samples: int
+            Number of path tracing iterations accumulated in each tile.
+        """
+        # 49
+        self.cb.add_command("SET_TILED_RENDERING", tile_size, samples)
+
+    def set_stream_codec(self, codec: str, quality: int):
+        """
+        Choose how the images of this session are compressed. "raw" sends
+        uncompressed RGBA pixels after an 8 byte little endian width and height,
+        which costs bandwidth but no encoding time. "webp" is only available if the
+        server has the Qt webp image plugin.
+
+        Parameters
+        ----------
+        codec: str
+            One of "jpeg", "png", "webp" or "raw". Default is "jpeg".
+        quality: int
+            0-100, for jpeg and webp. Default is 92.
+        """
+        # 50
+        self.cb.add_command("SET_STREAM_CODEC", codec, quality)
+
+    def set_frame_diff(self, enabled: int, threshold: float):
+        """
+        Send only the parts of each image that changed since the previous one.
+        The image is compared in tiles against the last image sent, and only the
+        tiles that changed visibly are encoded and sent, with their coordinates. In
+        stream mode, refinements that change no tile are not sent at all.
+
+        Parameters
+        ----------
+        enabled: int
+            0 to send complete frames, 1 to send changed tiles only.
+        threshold: float
+            Mean change of a tile in 8 bit luma levels below which it is
+            not sent again. Default is 0.5.
+        """
+        # 51
+        self.cb.add_command("SET_FRAME_DIFF", enabled, threshold)
+
+    def set_stream_pacing(self, fps: int, latency: int):
+        """
+        Pace the images sent in stream mode to what the connection can take.
+        The server goes on refining the image while earlier images are still on
+        their way, and sends the newest one when there is room again. The final
+        image of a stream is always sent.
+
+        Parameters
+        ----------
+        fps: int
+            Most images to send per second. 0 for no limit, the default.
+        latency: int
+            How many milliseconds an image may take to reach the client.
+            Together with fps this sets how many images can be on their way
+            at once. 0 for the default of two images.
+        """
+        # 52
+        self.cb.add_command("SET_STREAM_PACING", fps, latency)
+
+    def batch_render(
+        self,
+        path: int,
+        frames: int,
+        iterations: int,
+        angle: float,
+        keyframes: List[float],
+        output_directory: str,
+    ):
+        """
+        Render an animation on the server and save its images there, instead of
+        sending each one back. The camera starts where it is and follows the path;
+        frames are rendered back to back while earlier ones are saved. Progress is
+        reported with JSON messages holding commandId, frame and frames, and a last
+        one with done set to true.
+
+        Parameters
+        ----------
+        path: int
+            0 for a turntable, 1 for a rocker, 2 to move through keyframes.
+        frames: int
+            How many images to render.
+        iterations: int
+            Path tracing iterations for each image.
+        angle: float
+            Turntable: degrees to turn over the whole animation, 360 for a
+            loop; negative turns the other way. Rocker: the largest angle to
+            rock out to.
+        keyframes: List[float]
+            For keyframes: eye, target and up vectors, 9 floats per keyframe.
+            The keyframes are spread evenly over the frames.
+        output_directory: str
+            Where on the server to save frame_0000.png and onward. It must
+            be a relative path, without "..", and is taken relative to the
+            server's working directory.
+        """
+        # 53
+        self.cb.add_command(
+            "BATCH_RENDER", path, frames, iterations, angle, keyframes, output_directory
+        )
+
+    def set_half_float_accumulation(self, enabled: int):
+        """
+        Accumulate samples in half float buffers instead of full floats. This
+        halves the memory and bandwidth of the accumulation, at the cost of
+        precision once very many samples are averaged. The image restarts when
+        this changes. Off by default.
+
+        Parameters
+        ----------
+        enabled: int
+            0 for full float accumulation, 1 for half float.
+        """
+        # 54
+        self.cb.add_command("SET_HALF_FLOAT_ACCUMULATION", enabled)
+
+    def set_gpu_volume_budget(self, megabytes: int):
+        """
+        Set how much gpu memory the volume may take before it is split into
+        bricks that are paged in as the view needs them. The volume is uploaded
+        again when this changes.
+
+        Parameters
+        ----------
+        megabytes: int
+            The budget in MB. 0 to use what the driver reports as free; drivers
+            that do not report it only page volumes too large for one texture.
+        """
+        # 55
+        self.cb.add_command("SET_GPU_VOLUME_BUDGET", megabytes)
+
     def batch_render_turntable(
         self, number_of_frames=90, direction=1, output_name="frame", first_frame=0
     ):
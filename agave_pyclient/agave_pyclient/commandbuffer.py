@@ -71,9 +71,28 @@ COMMANDS = {
     "SET_BOUNDING_BOX_COLOR": [41, "F32", "F32", "F32"],
     "SHOW_BOUNDING_BOX": [42, "I32"],
     "TRACKBALL_CAMERA": [43, "F32", "F32"],
+    "SET_VOLUME_CROP": [44, "I32"],
+    "SET_ERROR_TARGET": [45, "F32"],
+    "SET_INTERACTIVE_DOWNSAMPLE": [46, "I32"],
+    "SET_TEMPORAL_REPROJECTION": [47, "I32"],
+    "SET_DENOISE": [48, "I32"],
+    "SET_TILED_RENDERING": [49, "I32", "I32"],
+    "SET_STREAM_CODEC": [50, "S", "I32"],
+    "SET_FRAME_DIFF": [51, "I32", "F32"],
+    "SET_STREAM_PACING": [52, "I32", "I32"],
+    "BATCH_RENDER": [53, "I32", "I32", "I32", "F32", "F32A", "S"],
+    "SET_HALF_FLOAT_ACCUMULATION": [54, "I32"],
+    "SET_GPU_VOLUME_BUDGET": [55, "I32"],
 }
 
 
+# every buffer starts with the bytes "AGVC", then the big endian uint32 format
+# version and byte length of the commands that follow
+HEADER_MAGIC = b"AGVC"
+HEADER_VERSION = 1
+HEADER_SIZE = 12
+
+
 # strategy: add elements to prebuffer,
 # and then traverse prebuffer to convert to binary before sending?
 class CommandBuffer:
@@ -127,12 +146,15 @@ class CommandBuffer:
         return bytesize
 
     def make_buffer(self):
-        bytesize = self.compute_size()
+        payloadsize = self.compute_size()
 
         # allocate arraybuffer and then fill it.
-        self.buffer = bytearray(bytesize)
+        self.buffer = bytearray(HEADER_SIZE + payloadsize)
+        struct.pack_into(
+            ">4sII", self.buffer, 0, HEADER_MAGIC, HEADER_VERSION, payloadsize
+        )
 
-        offset = 0
+        offset = HEADER_SIZE
         for cmd in self.prebuffer:
             commandCode = cmd[0]
 
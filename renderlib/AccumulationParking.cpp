@@ -0,0 +1,82 @@
+#include "AccumulationParking.h"
+
+#include "RenderSettings.h"
+
+const int ParkedAccumulation::NUM_TARGETS;
+
+bool
+ParkedAccumulation::fits(uint32_t w, uint32_t h, uint32_t format, const uint32_t targets[NUM_TARGETS]) const
+{
+  if (w != m_w || h != m_h || format != m_format) {
+    return false;
+  }
+  for (int i = 0; i < NUM_TARGETS; ++i) {
+    if ((targets[i] != 0) != (m_textures[i] != 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+AccumulationParking::worthParking(const RenderSettings& rs)
+{
+  return rs.GetNoIterations() > 0 && rs.m_DirtyFlags.Get() == 0;
+}
+
+void
+AccumulationParking::park(const RenderSettings* rs, const ParkedAccumulation& parked)
+{
+  m_parked[rs] = parked;
+}
+
+bool
+AccumulationParking::take(const RenderSettings* rs, ParkedAccumulation& parked)
+{
+  auto it = m_parked.find(rs);
+  if (it == m_parked.end()) {
+    return false;
+  }
+  parked = it->second;
+  m_parked.erase(it);
+  return true;
+}
+
+std::vector<ParkedAccumulation>
+AccumulationParking::takeAll()
+{
+  std::vector<ParkedAccumulation> all;
+  for (const auto& parked : m_parked) {
+    all.push_back(parked.second);
+  }
+  m_parked.clear();
+  return all;
+}
+
+void
+AccumulationParking::swapIn(long flags)
+{
+  m_swapDirtyFlags = flags;
+}
+
+bool
+AccumulationParking::beginFrame(RenderSettings& rs)
+{
+  if (m_swapDirtyFlags == 0) {
+    return false;
+  }
+  const bool resume = rs.m_DirtyFlags.Get() == 0 && m_parked.count(&rs) > 0;
+  rs.m_DirtyFlags.SetFlag(m_swapDirtyFlags);
+  m_swapDirtyFlags = 0;
+  return resume;
+}
+
+size_t
+AccumulationParking::gpuBytes() const
+{
+  size_t bytes = 0;
+  for (const auto& parked : m_parked) {
+    bytes += parked.second.m_gpuBytes;
+  }
+  return bytes;
+}
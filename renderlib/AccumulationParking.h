@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <inttypes.h>
+#include <unordered_map>
+#include <vector>
+
+class RenderSettings;
+
+// The latest accumulation of a scene that was swapped out of a renderer: gpu copies of the render targets of the
+// accumulation buffer, indexed by color attachment. A texture is 0 where the target was not in use.
+struct ParkedAccumulation
+{
+  static const int NUM_TARGETS = 6;
+
+  uint32_t m_fbo = 0;
+  uint32_t m_textures[NUM_TARGETS] = { 0, 0, 0, 0, 0, 0 };
+  // format of the color target
+  uint32_t m_format = 0;
+  uint32_t m_w = 0, m_h = 0;
+  int m_iterations = 0;
+  int m_randSeed = 0;
+  size_t m_gpuBytes = 0;
+
+  // whether the copies can go back into accumulation buffers of this size and format, with these targets in use
+  bool fits(uint32_t w, uint32_t h, uint32_t format, const uint32_t targets[NUM_TARGETS]) const;
+};
+
+// Lets several scenes take turns on one renderer without starting their images over on every turn.
+// The renderer makes and frees the gpu copies; this keeps them per scene and decides when a scene that is swapped
+// back in may continue its image.
+class AccumulationParking
+{
+public:
+  // whether the outgoing scene's image is worth keeping: it has samples, and no changes are pending that restart it
+  static bool worthParking(const RenderSettings& rs);
+
+  void park(const RenderSettings* rs, const ParkedAccumulation& parked);
+  // remove the scene's parked accumulation and return true, or return false if it has none
+  bool take(const RenderSettings* rs, ParkedAccumulation& parked);
+  // remove and return all of them, to free them
+  std::vector<ParkedAccumulation> takeAll();
+
+  // a scene was swapped in; flags are what has to be uploaded for it
+  void swapIn(long flags);
+  // Call at the start of each frame. After a swap, this adds the upload flags to the scene's dirty flags and returns
+  // true if the scene may continue its parked accumulation, which it can unless it changed since it was swapped in.
+  bool beginFrame(RenderSettings& rs);
+
+  size_t gpuBytes() const;
+
+private:
+  std::unordered_map<const RenderSettings*, ParkedAccumulation> m_parked;
+  long m_swapDirtyFlags = 0;
+};
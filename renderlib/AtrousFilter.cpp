@@ -0,0 +1,146 @@
+#include "AtrousFilter.h"
+
+#include "threading.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace {
+const float KERNEL[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+struct Features
+{
+  float m_color[3];
+  float m_normal[3];
+  float m_normalLength;
+  float m_albedo[3];
+  float m_depth;
+  bool m_hit;
+};
+
+Features
+getFeatures(const float* color, const float* normals, const float* albedoDepth, size_t i)
+{
+  Features f;
+  for (int c = 0; c < 3; ++c) {
+    f.m_color[c] = color[4 * i + c] / (1.0f + std::max(color[4 * i + c], 0.0f));
+  }
+  const float hits = normals[4 * i + 3];
+  f.m_hit = hits > 0.0f;
+  const float inv = f.m_hit ? 1.0f / hits : 0.0f;
+  for (int c = 0; c < 3; ++c) {
+    f.m_normal[c] = normals[4 * i + c] * inv;
+    f.m_albedo[c] = albedoDepth[4 * i + c] * inv;
+  }
+  f.m_depth = albedoDepth[4 * i + 3] * inv;
+  f.m_normalLength =
+    std::sqrt(f.m_normal[0] * f.m_normal[0] + f.m_normal[1] * f.m_normal[1] + f.m_normal[2] * f.m_normal[2]);
+  return f;
+}
+
+float
+squaredDistance(const float a[3], const float b[3])
+{
+  const float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+  return d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+}
+
+float
+edgeStoppingWeight(const Features& p,
+                   const Features& q,
+                   int stepWidth,
+                   float colorSigma,
+                   const AtrousFilterParams& params)
+{
+  // volume and empty space do not mix
+  if (p.m_hit != q.m_hit) {
+    return 0.0f;
+  }
+  float w = std::exp(-squaredDistance(p.m_color, q.m_color) / (colorSigma * colorSigma));
+  if (!p.m_hit) {
+    return w;
+  }
+  // averaged normals of inconsistent gradients are short and say little about the surface
+  if (p.m_normalLength > 0.1f && q.m_normalLength > 0.1f) {
+    const float dot = p.m_normal[0] * q.m_normal[0] + p.m_normal[1] * q.m_normal[1] + p.m_normal[2] * q.m_normal[2];
+    const float cosine = dot / (p.m_normalLength * q.m_normalLength);
+    w *= std::pow(std::max(cosine, 0.0f), params.m_normalPower);
+  }
+  const float depthScale = params.m_depthSigma * (float)stepWidth * std::max(std::max(p.m_depth, q.m_depth), 1e-4f);
+  w *= std::exp(-std::fabs(p.m_depth - q.m_depth) / depthScale);
+  w *= std::exp(-squaredDistance(p.m_albedo, q.m_albedo) / (params.m_albedoSigma * params.m_albedoSigma));
+  return w;
+}
+} // namespace
+
+void
+atrousFilterPass(const float* color,
+                 const float* normals,
+                 const float* albedoDepth,
+                 uint32_t w,
+                 uint32_t h,
+                 int pass,
+                 const AtrousFilterParams& params,
+                 float* out)
+{
+  const int stepWidth = 1 << pass;
+  const float colorSigma = params.m_colorSigma / (float)stepWidth;
+
+  parallel_for(h, [&](size_t s, size_t e) {
+    for (size_t y = s; y < e; ++y) {
+      for (size_t x = 0; x < w; ++x) {
+        const size_t i = x + y * w;
+        const Features p = getFeatures(color, normals, albedoDepth, i);
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float sumWeights = 0.0f;
+        for (int ky = 0; ky < 5; ++ky) {
+          const long qy = (long)y + (ky - 2) * stepWidth;
+          if (qy < 0 || qy >= (long)h) {
+            continue;
+          }
+          for (int kx = 0; kx < 5; ++kx) {
+            const long qx = (long)x + (kx - 2) * stepWidth;
+            if (qx < 0 || qx >= (long)w) {
+              continue;
+            }
+            const size_t j = (size_t)qx + (size_t)qy * w;
+            const Features q = getFeatures(color, normals, albedoDepth, j);
+            const float weight = KERNEL[kx] * KERNEL[ky] * edgeStoppingWeight(p, q, stepWidth, colorSigma, params);
+            for (int c = 0; c < 4; ++c) {
+              sum[c] += weight * color[4 * j + c];
+            }
+            sumWeights += weight;
+          }
+        }
+        // the center tap always has weight, so sumWeights > 0
+        for (int c = 0; c < 4; ++c) {
+          out[4 * i + c] = sum[c] / sumWeights;
+        }
+      }
+    }
+  });
+}
+
+void
+atrousFilter(const float* color,
+             const float* normals,
+             const float* albedoDepth,
+             uint32_t w,
+             uint32_t h,
+             const AtrousFilterParams& params,
+             float lerpC,
+             float* out)
+{
+  const size_t n = (size_t)w * (size_t)h * 4;
+  std::vector<float> ping(color, color + n);
+  std::vector<float> pong(n);
+  for (int pass = 0; pass < params.m_numPasses; ++pass) {
+    atrousFilterPass(ping.data(), normals, albedoDepth, w, h, pass, params, pong.data());
+    ping.swap(pong);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = ping[i] + (color[i] - ping[i]) * lerpC;
+  }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <inttypes.h>
+
+// Edge avoiding a-trous wavelet filter (Dammertz et al. 2010) for denoising early path trace iterations.
+// Neighbors only contribute while their color and the features of their first scattering event (normal, view depth,
+// albedo) are similar. This is the cpu reference of the denoise passes that RenderGLPT runs in GLSL; keep the two in
+// sync.
+//
+// All images are w*h rgba float, row major:
+// color: the accumulated radiance.
+// normals: xyz = sum of the unit gradient normals at the first scattering events of the pixel, w = number of events.
+// albedoDepth: rgb = sum of the diffuse colors, w = sum of the view depths, over the same events.
+struct AtrousFilterParams
+{
+  int m_numPasses = 4;
+  // color difference, after x/(1+x) compression, at which a neighbor's weight falls to 1/e. Halved every pass.
+  float m_colorSigma = 0.5f;
+  // exponent on the cosine between the normals
+  float m_normalPower = 16.0f;
+  // view depth difference relative to the depth, per pixel of distance
+  float m_depthSigma = 0.02f;
+  float m_albedoSigma = 0.2f;
+};
+
+// One pass with a 5x5 B3 spline kernel whose taps are 2^pass pixels apart.
+void
+atrousFilterPass(const float* color,
+                 const float* normals,
+                 const float* albedoDepth,
+                 uint32_t w,
+                 uint32_t h,
+                 int pass,
+                 const AtrousFilterParams& params,
+                 float* out);
+
+// All passes, then out = mix(filtered, color, lerpC).
+void
+atrousFilter(const float* color,
+             const float* normals,
+             const float* albedoDepth,
+             uint32_t w,
+             uint32_t h,
+             const AtrousFilterParams& params,
+             float lerpC,
+             float* out);
@@ -0,0 +1,129 @@
+#include "BrickCache.h"
+
+#include <algorithm>
+
+const uint32_t BrickLayout::APRON;
+const int32_t BrickResidencyManager::NOT_RESIDENT;
+
+BrickLayout::BrickLayout(uint32_t x, uint32_t y, uint32_t z, uint32_t brickSize)
+  : m_brickSize(std::max(brickSize, 1u))
+{
+  m_volumeSize[0] = x;
+  m_volumeSize[1] = y;
+  m_volumeSize[2] = z;
+  for (int i = 0; i < 3; ++i) {
+    m_gridSize[i] = (m_volumeSize[i] + m_brickSize - 1) / m_brickSize;
+  }
+}
+
+uint32_t
+BrickLayout::brickIndex(uint32_t bx, uint32_t by, uint32_t bz) const
+{
+  return bx + m_gridSize[0] * (by + m_gridSize[1] * bz);
+}
+
+void
+BrickLayout::brickCoords(uint32_t index, uint32_t& bx, uint32_t& by, uint32_t& bz) const
+{
+  bx = index % m_gridSize[0];
+  by = (index / m_gridSize[0]) % m_gridSize[1];
+  bz = index / (m_gridSize[0] * m_gridSize[1]);
+}
+
+void
+BrickLayout::brickOrigin(uint32_t index, uint32_t& x, uint32_t& y, uint32_t& z) const
+{
+  brickCoords(index, x, y, z);
+  x *= m_brickSize;
+  y *= m_brickSize;
+  z *= m_brickSize;
+}
+
+void
+BrickResidencyManager::init(uint32_t numBricks, uint32_t numSlots)
+{
+  m_brickToSlot.assign(numBricks, NOT_RESIDENT);
+  m_slotToBrick.assign(numSlots, NOT_RESIDENT);
+  m_lruPosition.assign(numSlots, m_lru.end());
+  m_slotFrame.assign(numSlots, 0);
+  clear();
+}
+
+void
+BrickResidencyManager::clear()
+{
+  std::fill(m_brickToSlot.begin(), m_brickToSlot.end(), NOT_RESIDENT);
+  std::fill(m_slotToBrick.begin(), m_slotToBrick.end(), NOT_RESIDENT);
+  m_lru.clear();
+  std::fill(m_lruPosition.begin(), m_lruPosition.end(), m_lru.end());
+  std::fill(m_slotFrame.begin(), m_slotFrame.end(), 0);
+  // hand out low slots first
+  m_freeSlots.resize(m_slotToBrick.size());
+  for (size_t i = 0; i < m_freeSlots.size(); ++i) {
+    m_freeSlots[i] = (uint32_t)(m_freeSlots.size() - 1 - i);
+  }
+}
+
+int32_t
+BrickResidencyManager::slotOf(uint32_t brick) const
+{
+  if (brick >= m_brickToSlot.size()) {
+    return NOT_RESIDENT;
+  }
+  return m_brickToSlot[brick];
+}
+
+void
+BrickResidencyManager::touch(uint32_t brick)
+{
+  int32_t slot = slotOf(brick);
+  if (slot == NOT_RESIDENT) {
+    return;
+  }
+  m_lru.splice(m_lru.begin(), m_lru, m_lruPosition[slot]);
+  m_slotFrame[slot] = m_frame;
+}
+
+void
+BrickResidencyManager::request(const std::vector<uint32_t>& bricks,
+                               size_t maxAssignments,
+                               std::vector<SlotAssignment>& assigned,
+                               std::vector<uint32_t>& evicted)
+{
+  // never cycle the whole pool in one go, or we would evict bricks assigned in this same call.
+  maxAssignments = std::min(maxAssignments, m_slotToBrick.size());
+
+  size_t numAssigned = 0;
+  for (uint32_t brick : bricks) {
+    if (numAssigned >= maxAssignments) {
+      break;
+    }
+    if (brick >= m_brickToSlot.size() || m_brickToSlot[brick] != NOT_RESIDENT) {
+      continue;
+    }
+
+    uint32_t slot;
+    if (!m_freeSlots.empty()) {
+      slot = m_freeSlots.back();
+      m_freeSlots.pop_back();
+    } else {
+      // touched slots are at the front, so if the least recently used one is pinned they all are
+      if (m_slotFrame[m_lru.back()] == m_frame) {
+        break;
+      }
+      slot = m_lru.back();
+      m_lru.pop_back();
+      int32_t victim = m_slotToBrick[slot];
+      m_brickToSlot[victim] = NOT_RESIDENT;
+      evicted.push_back((uint32_t)victim);
+    }
+
+    m_slotToBrick[slot] = (int32_t)brick;
+    m_brickToSlot[brick] = (int32_t)slot;
+    m_lru.push_front(slot);
+    m_lruPosition[slot] = m_lru.begin();
+
+    assigned.push_back({ brick, slot });
+    numAssigned++;
+  }
+}
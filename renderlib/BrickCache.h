@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <inttypes.h>
+#include <list>
+#include <vector>
+
+// Partition of a volume into fixed size cubic bricks.
+// Bricks are stored in the gpu pool with a one voxel apron on every side so that
+// trilinear filtering at a brick boundary reads the true neighbor voxels.
+struct BrickLayout
+{
+  static const uint32_t APRON = 1;
+
+  uint32_t m_volumeSize[3] = { 0, 0, 0 };
+  uint32_t m_brickSize = 32;
+  uint32_t m_gridSize[3] = { 0, 0, 0 };
+
+  BrickLayout() {}
+  BrickLayout(uint32_t x, uint32_t y, uint32_t z, uint32_t brickSize);
+
+  uint32_t paddedBrickSize() const { return m_brickSize + 2 * APRON; }
+  uint32_t brickCount() const { return m_gridSize[0] * m_gridSize[1] * m_gridSize[2]; }
+
+  uint32_t brickIndex(uint32_t bx, uint32_t by, uint32_t bz) const;
+  void brickCoords(uint32_t index, uint32_t& bx, uint32_t& by, uint32_t& bz) const;
+  // first voxel of the brick interior (the apron starts one voxel before this)
+  void brickOrigin(uint32_t index, uint32_t& x, uint32_t& y, uint32_t& z) const;
+};
+
+// Bookkeeping for a fixed number of pool slots holding bricks.
+// Slots are recycled in least recently used order. Bricks touched since the last beginFrame are pinned: when the
+// visible working set is larger than the pool, evicting them would only page them back in on the next frame.
+class BrickResidencyManager
+{
+public:
+  static const int32_t NOT_RESIDENT = -1;
+
+  struct SlotAssignment
+  {
+    uint32_t m_brick;
+    uint32_t m_slot;
+  };
+
+  void init(uint32_t numBricks, uint32_t numSlots);
+  // drop all bricks; every slot becomes free.
+  void clear();
+
+  bool isResident(uint32_t brick) const { return slotOf(brick) != NOT_RESIDENT; }
+  int32_t slotOf(uint32_t brick) const;
+
+  uint32_t numBricks() const { return (uint32_t)m_brickToSlot.size(); }
+  uint32_t numSlots() const { return (uint32_t)m_slotToBrick.size(); }
+  uint32_t numResident() const { return numSlots() - (uint32_t)m_freeSlots.size(); }
+  bool isFull() const { return m_freeSlots.empty(); }
+
+  // unpin the bricks touched during the previous frame
+  void beginFrame() { m_frame++; }
+  // mark a resident brick as recently used and pin it until the next beginFrame. Non-resident bricks are ignored.
+  void touch(uint32_t brick);
+
+  // Assign slots to the requested bricks, evicting the least recently used bricks when the pool is full.
+  // Already resident and duplicate requests are skipped. At most maxAssignments bricks are assigned, and none once
+  // only pinned bricks are left to evict; the remainder is expected to be requested again by later feedback.
+  // evicted receives the bricks that lost their slot so their page table entries can be cleared.
+  void request(const std::vector<uint32_t>& bricks,
+               size_t maxAssignments,
+               std::vector<SlotAssignment>& assigned,
+               std::vector<uint32_t>& evicted);
+
+private:
+  std::vector<int32_t> m_brickToSlot;
+  std::vector<int32_t> m_slotToBrick;
+  // slots in use, most recently used at the front
+  std::list<uint32_t> m_lru;
+  std::vector<std::list<uint32_t>::iterator> m_lruPosition;
+  std::vector<uint32_t> m_freeSlots;
+  // the frame in which each slot was last touched
+  std::vector<uint64_t> m_slotFrame;
+  uint64_t m_frame = 1;
+};
@@ -2,6 +2,7 @@
 
 #include "BoundingBox.h"
 #include "Defines.h"
+#include "TiledRender.h"
 #include "glm.h"
 
 #define DEF_FOCUS_TYPE CenterScreen
@@ -286,6 +287,19 @@ public:
   int GetWidth(void) const { return m_Resolution.GetResX(); }
 
   int GetHeight(void) const { return m_Resolution.GetResY(); }
+
+  // The film that renders one tile of this film into a tileW x tileH target.
+  // Call after Update; updating the returned film would recompute the screen window for the whole tile.
+  Film Tile(const ImageTile& tile, int tileW, int tileH) const
+  {
+    Film t;
+    t = *this;
+    t.m_Resolution.SetResX(tileW);
+    t.m_Resolution.SetResY(tileH);
+    const float invScreen[2] = { m_InvScreen.x, m_InvScreen.y };
+    tileScreenWindow(m_Screen, invScreen, tile, (uint32_t)tileW, (uint32_t)tileH, t.m_Screen);
+    return t;
+  }
 };
 
 #define FPS1 30.0f
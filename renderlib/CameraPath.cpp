@@ -0,0 +1,48 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+
+float
+cameraPathAngle(CameraPath path, int frame, int frameCount, float angle)
+{
+  if (frameCount <= 0) {
+    return 0.0f;
+  }
+  switch (path) {
+    case CameraPath::TURNTABLE:
+      return angle * (float)frame / (float)frameCount;
+    case CameraPath::ROCKER: {
+      // a quarter of the frames for each swing out or back
+      const float step = 4.0f * angle / (float)frameCount;
+      float a = 0.0f;
+      for (int i = 0; i < frame; ++i) {
+        const int quadrant = (i * 4) / frameCount;
+        a += (quadrant == 0 || quadrant == 3) ? step : -step;
+      }
+      return a;
+    }
+    default:
+      return 0.0f;
+  }
+}
+
+bool
+keyframePose(const std::vector<float>& keys, int frame, int frameCount, float pose[CAMERA_KEYFRAME_SIZE])
+{
+  const int keyCount = (int)keys.size() / CAMERA_KEYFRAME_SIZE;
+  if (keyCount < 1 || keys.size() % CAMERA_KEYFRAME_SIZE != 0) {
+    return false;
+  }
+
+  // where the frame falls between the first and last keyframe
+  const float t = (frameCount > 1) ? (float)(keyCount - 1) * (float)frame / (float)(frameCount - 1) : 0.0f;
+  const int key = std::min(std::max((int)t, 0), std::max(keyCount - 2, 0));
+  const float f = (keyCount > 1) ? std::min(std::max(t - (float)key, 0.0f), 1.0f) : 0.0f;
+
+  const float* a = &keys[key * CAMERA_KEYFRAME_SIZE];
+  const float* b = (keyCount > 1) ? a + CAMERA_KEYFRAME_SIZE : a;
+  for (int i = 0; i < CAMERA_KEYFRAME_SIZE; ++i) {
+    pose[i] = a[i] + (b[i] - a[i]) * f;
+  }
+  return true;
+}
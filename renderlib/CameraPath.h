@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+// Camera paths for rendering an animation on the server, see BatchRenderCommand.
+enum class CameraPath
+{
+  // orbit about the vertical axis by angle degrees over the animation, one step short of the end so that a 360
+  // degree turn loops
+  TURNTABLE = 0,
+  // orbit out to angle degrees and back, then to -angle and back
+  ROCKER = 1,
+  // move through keyframes spread evenly over the animation, see keyframePose
+  KEYFRAMES = 2
+};
+
+// Floats per keyframe: the eye, target and up vectors.
+static const int CAMERA_KEYFRAME_SIZE = 9;
+
+// How far the camera has orbited about the vertical axis at frame of frameCount, in degrees. The same sequence as the
+// python client's batch_render_turntable and batch_render_rocker.
+float
+cameraPathAngle(CameraPath path, int frame, int frameCount, float angle);
+
+// The eye, target and up of frame of frameCount, interpolated linearly between the nearest keyframes.
+// Returns false if keys does not hold at least one whole keyframe.
+bool
+keyframePose(const std::vector<float>& keys, int frame, int frameCount, float pose[CAMERA_KEYFRAME_SIZE]);
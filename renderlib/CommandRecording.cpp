@@ -0,0 +1,95 @@
+#include "CommandRecording.h"
+
+#include <cstring>
+
+static const uint8_t COMMAND_RECORDING_MAGIC[4] = { 'A', 'G', 'V', 'R' };
+
+namespace {
+void
+putBigEndian(uint8_t* p, uint64_t v, int bytes)
+{
+  for (int i = bytes - 1; i >= 0; --i) {
+    p[i] = (uint8_t)v;
+    v >>= 8;
+  }
+}
+
+uint64_t
+getBigEndian(const uint8_t* p, int bytes)
+{
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+}
+
+CommandRecorder::CommandRecorder(const std::string& path)
+  : m_file(path, std::ios::binary | std::ios::trunc)
+  , m_start(std::chrono::steady_clock::now())
+{
+  uint8_t header[COMMAND_RECORDING_HEADER_SIZE];
+  memcpy(header, COMMAND_RECORDING_MAGIC, sizeof(COMMAND_RECORDING_MAGIC));
+  putBigEndian(header + 4, COMMAND_RECORDING_VERSION, 4);
+  m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+  m_file.flush();
+}
+
+void
+CommandRecorder::record(uint32_t session, const uint8_t* data, size_t size)
+{
+  const uint64_t timeUs =
+    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+  uint8_t header[RECORDED_MESSAGE_HEADER_SIZE];
+  putBigEndian(header, timeUs, 8);
+  putBigEndian(header + 8, session, 4);
+  putBigEndian(header + 12, size, 4);
+  m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+  if (size > 0) {
+    m_file.write(reinterpret_cast<const char*>(data), size);
+  }
+  m_file.flush();
+}
+
+bool
+isCommandRecording(const uint8_t* data, size_t size)
+{
+  return size >= sizeof(COMMAND_RECORDING_MAGIC) &&
+         memcmp(data, COMMAND_RECORDING_MAGIC, sizeof(COMMAND_RECORDING_MAGIC)) == 0;
+}
+
+bool
+readCommandRecording(const uint8_t* data, size_t size, std::vector<RecordedMessage>& messages, std::string& error)
+{
+  if (size < COMMAND_RECORDING_HEADER_SIZE || !isCommandRecording(data, size)) {
+    error = "not a command recording";
+    return false;
+  }
+  const uint32_t version = (uint32_t)getBigEndian(data + 4, 4);
+  if (version != COMMAND_RECORDING_VERSION) {
+    error = "unsupported recording version " + std::to_string(version);
+    return false;
+  }
+
+  size_t pos = COMMAND_RECORDING_HEADER_SIZE;
+  while (pos < size) {
+    if (size - pos < RECORDED_MESSAGE_HEADER_SIZE) {
+      error = "recording ends in a cut off message header";
+      return false;
+    }
+    RecordedMessage m;
+    m.m_timeUs = getBigEndian(data + pos, 8);
+    m.m_session = (uint32_t)getBigEndian(data + pos + 8, 4);
+    const size_t length = (size_t)getBigEndian(data + pos + 12, 4);
+    pos += RECORDED_MESSAGE_HEADER_SIZE;
+    if (length > size - pos) {
+      error = "recording ends in a cut off message";
+      return false;
+    }
+    m.m_data.assign(data + pos, data + pos + length);
+    pos += length;
+    messages.push_back(std::move(m));
+  }
+  return true;
+}
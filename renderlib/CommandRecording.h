@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+// A recording of the command messages a server received, to replay them later: the bytes "AGVR" and the big endian
+// uint32 format version, then for every message its big endian uint64 arrival time in microseconds since the
+// recording started, uint32 session number and uint32 byte length, followed by the message as it was received.
+// An empty message marks the end of a session.
+static const uint32_t COMMAND_RECORDING_VERSION = 1;
+static const size_t COMMAND_RECORDING_HEADER_SIZE = 8;
+static const size_t RECORDED_MESSAGE_HEADER_SIZE = 16;
+
+struct RecordedMessage
+{
+  uint64_t m_timeUs;
+  uint32_t m_session;
+  std::vector<uint8_t> m_data;
+};
+
+// Appends messages to a new recording file. Every message is flushed as it is recorded, so that a server that is
+// killed still leaves everything up to its last message.
+class CommandRecorder
+{
+public:
+  CommandRecorder(const std::string& path);
+
+  inline bool isOpen() const { return m_file.is_open() && m_file.good(); }
+
+  void record(uint32_t session, const uint8_t* data, size_t size);
+  // the session will not send anything more
+  inline void endSession(uint32_t session) { record(session, nullptr, 0); }
+
+private:
+  std::ofstream m_file;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+bool
+isCommandRecording(const uint8_t* data, size_t size);
+
+// Returns false, with the reason in error, for an unknown version or a message that is cut off. The messages before
+// the bad one are kept.
+bool
+readCommandRecording(const uint8_t* data, size_t size, std::vector<RecordedMessage>& messages, std::string& error);
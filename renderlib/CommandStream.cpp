@@ -0,0 +1,221 @@
+#include "CommandStream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// small enough for the one command of a redraw request, doubling from there
+static const size_t FIRST_BLOCK_SIZE = 256;
+static const size_t MAX_BLOCK_SIZE = 64 * 1024;
+
+static const uint8_t COMMAND_MESSAGE_MAGIC[4] = { 'A', 'G', 'V', 'C' };
+
+namespace {
+uint32_t
+readBigEndian32(const uint8_t* p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+uint32_t
+readLittleEndian32(const uint8_t* p)
+{
+  return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | (uint32_t)p[0];
+}
+
+float
+bitsToFloat(uint32_t bits)
+{
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+}
+
+CommandList::CommandList(CommandList&& other) noexcept
+  : m_blocks(std::move(other.m_blocks))
+  , m_blockSize(other.m_blockSize)
+  , m_used(other.m_used)
+  , m_commands(std::move(other.m_commands))
+{
+  other.m_blocks.clear();
+  other.m_commands.clear();
+  other.m_blockSize = 0;
+  other.m_used = 0;
+}
+
+CommandList&
+CommandList::operator=(CommandList&& other) noexcept
+{
+  if (this != &other) {
+    clear();
+    m_blocks = std::move(other.m_blocks);
+    m_commands = std::move(other.m_commands);
+    m_blockSize = other.m_blockSize;
+    m_used = other.m_used;
+    other.m_blocks.clear();
+    other.m_commands.clear();
+    other.m_blockSize = 0;
+    other.m_used = 0;
+  }
+  return *this;
+}
+
+CommandList::~CommandList()
+{
+  clear();
+}
+
+void
+CommandList::clear()
+{
+  for (Command* c : m_commands) {
+    c->~Command();
+  }
+  m_commands.clear();
+  m_blocks.clear();
+  m_blockSize = 0;
+  m_used = 0;
+}
+
+void
+CommandList::append(CommandList&& later)
+{
+  if (this == &later || later.m_commands.empty()) {
+    return;
+  }
+  m_commands.insert(m_commands.end(), later.m_commands.begin(), later.m_commands.end());
+  for (auto& block : later.m_blocks) {
+    m_blocks.push_back(std::move(block));
+  }
+  // new commands go after the later list's
+  m_blockSize = later.m_blockSize;
+  m_used = later.m_used;
+
+  later.m_commands.clear();
+  later.m_blocks.clear();
+  later.m_blockSize = 0;
+  later.m_used = 0;
+}
+
+void*
+CommandList::allocate(size_t size, size_t alignment)
+{
+  // blocks come from new[], which aligns them for any fundamental type
+  if (alignment > alignof(std::max_align_t)) {
+    throw std::bad_alloc();
+  }
+  size_t offset = (m_used + alignment - 1) / alignment * alignment;
+  if (m_blocks.empty() || offset + size > m_blockSize) {
+    size_t blockSize = m_blocks.empty() ? FIRST_BLOCK_SIZE : std::min(m_blockSize * 2, MAX_BLOCK_SIZE);
+    blockSize = std::max(blockSize, size);
+    m_blocks.emplace_back(new uint8_t[blockSize]);
+    m_blockSize = blockSize;
+    offset = 0;
+  }
+  m_used = offset + size;
+  return m_blocks.back().get() + offset;
+}
+
+bool
+findCommandPayload(const uint8_t* data, size_t size, size_t& offset, size_t& length, std::string& error)
+{
+  if (size < sizeof(COMMAND_MESSAGE_MAGIC) || memcmp(data, COMMAND_MESSAGE_MAGIC, sizeof(COMMAND_MESSAGE_MAGIC))) {
+    offset = 0;
+    length = size;
+    return true;
+  }
+  if (size < COMMAND_MESSAGE_HEADER_SIZE) {
+    error = "message header is cut off";
+    return false;
+  }
+  uint32_t version = readBigEndian32(data + 4);
+  if (version != COMMAND_MESSAGE_VERSION) {
+    error = "unsupported message version " + std::to_string(version);
+    return false;
+  }
+  uint32_t payload = readBigEndian32(data + 8);
+  if (payload != size - COMMAND_MESSAGE_HEADER_SIZE) {
+    error = "message holds " + std::to_string(size - COMMAND_MESSAGE_HEADER_SIZE) + " bytes of commands, header says " +
+            std::to_string(payload);
+    return false;
+  }
+  offset = COMMAND_MESSAGE_HEADER_SIZE;
+  length = payload;
+  return true;
+}
+
+size_t
+commandMessageSize(const uint8_t* data, size_t size)
+{
+  if (size < sizeof(COMMAND_MESSAGE_MAGIC) || memcmp(data, COMMAND_MESSAGE_MAGIC, sizeof(COMMAND_MESSAGE_MAGIC))) {
+    return size;
+  }
+  if (size < COMMAND_MESSAGE_HEADER_SIZE) {
+    return 0;
+  }
+  uint32_t payload = readBigEndian32(data + 8);
+  if (payload > size - COMMAND_MESSAGE_HEADER_SIZE) {
+    return 0;
+  }
+  return COMMAND_MESSAGE_HEADER_SIZE + payload;
+}
+
+CommandReader::CommandReader(const uint8_t* data, size_t size, CommandList& commands)
+  : m_data(data)
+  , m_size(size)
+  , m_pos(0)
+  , m_commands(commands)
+{}
+
+const uint8_t*
+CommandReader::take(size_t n)
+{
+  if (n > m_size - m_pos) {
+    throw std::out_of_range("command reads past the end of the message");
+  }
+  const uint8_t* p = m_data + m_pos;
+  m_pos += n;
+  return p;
+}
+
+size_t
+CommandReader::parseCount(size_t elementSize)
+{
+  int32_t count = parseInt32();
+  if (count < 0 || (size_t)count > (m_size - m_pos) / elementSize) {
+    throw std::out_of_range("element count does not fit in the message");
+  }
+  return (size_t)count;
+}
+
+int32_t
+CommandReader::parseInt32()
+{
+  return (int32_t)readBigEndian32(take(sizeof(int32_t)));
+}
+
+float
+CommandReader::parseFloat32()
+{
+  return bitsToFloat(readLittleEndian32(take(sizeof(float))));
+}
+
+std::string
+CommandReader::parseString()
+{
+  size_t len = parseCount(1);
+  return std::string(reinterpret_cast<const char*>(take(len)), len);
+}
+
+std::vector<float>
+CommandReader::parseFloat32Array()
+{
+  size_t len = parseCount(sizeof(float));
+  const uint8_t* p = take(len * sizeof(float));
+  std::vector<float> v(len);
+  for (size_t i = 0; i < len; ++i) {
+    v[i] = bitsToFloat(readLittleEndian32(p + i * sizeof(float)));
+  }
+  return v;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "command.h"
+
+#include <cstddef>
+#include <inttypes.h>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Commands placed one after the other in a few blocks of memory instead of a heap allocation each, so that a high
+// rate camera stream or a large batch of SET_CONTROL_POINTS parses without per command churn.
+// The list owns its commands and destroys them in order. It can be moved but not copied.
+class CommandList
+{
+public:
+  CommandList() = default;
+  CommandList(CommandList&& other) noexcept;
+  CommandList& operator=(CommandList&& other) noexcept;
+  CommandList(const CommandList&) = delete;
+  CommandList& operator=(const CommandList&) = delete;
+  ~CommandList();
+
+  template<typename T, typename... Args>
+  T* add(Args&&... args)
+  {
+    T* c = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    m_commands.push_back(c);
+    return c;
+  }
+
+  // move the commands of a later list to the end of this one; later is left empty
+  void append(CommandList&& later);
+  void clear();
+
+  inline const std::vector<Command*>& commands() const { return m_commands; }
+  inline size_t size() const { return m_commands.size(); }
+  inline bool empty() const { return m_commands.empty(); }
+
+private:
+  void* allocate(size_t size, size_t alignment);
+
+  std::vector<std::unique_ptr<uint8_t[]>> m_blocks;
+  // size of the last block and how much of it is used
+  size_t m_blockSize = 0;
+  size_t m_used = 0;
+  std::vector<Command*> m_commands;
+};
+
+// A binary command message may start with a header: the bytes "AGVC", then the big endian uint32 format version and
+// the byte length of the commands that follow. Messages without one are all commands, as older clients send them.
+static const uint32_t COMMAND_MESSAGE_VERSION = 1;
+static const size_t COMMAND_MESSAGE_HEADER_SIZE = 12;
+
+// Find the commands in a message. Returns false, with the reason in error, for an unknown version or a length that
+// does not match the message.
+bool
+findCommandPayload(const uint8_t* data, size_t size, size_t& offset, size_t& length, std::string& error);
+
+// The size of the first message of a recording, where messages with headers follow one another. Without a header the
+// message is everything that is left. Returns 0 if the message is cut off.
+size_t
+commandMessageSize(const uint8_t* data, size_t size);
+
+// Reads the commands of a message into a CommandList. Ints are big endian and floats little endian, as the clients
+// write them; strings and float arrays are an int32 count followed by the elements.
+// A read past the end of the buffer, or a count that does not fit in it, throws std::out_of_range. Values are copied
+// out byte by byte, so the buffer needs no alignment.
+class CommandReader : public ParseableStream
+{
+public:
+  CommandReader(const uint8_t* data, size_t size, CommandList& commands);
+
+  inline bool end() const { return m_pos >= m_size; }
+
+  inline size_t remaining() const { return m_size - m_pos; }
+
+  virtual int32_t parseInt32();
+  virtual float parseFloat32();
+  virtual std::vector<float> parseFloat32Array();
+  virtual std::string parseString();
+  virtual CommandList& commandList() { return m_commands; }
+
+private:
+  // the next n bytes, or throw
+  const uint8_t* take(size_t n);
+  // an element count of elementSize byte elements that the rest of the buffer can hold, or throw
+  size_t parseCount(size_t elementSize);
+
+  const uint8_t* m_data;
+  size_t m_size;
+  size_t m_pos;
+  CommandList& m_commands;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <inttypes.h>
+
 class DenoiseParams
 {
 public:
@@ -15,7 +17,8 @@ public:
 public:
   DenoiseParams(void)
   {
-    m_Enabled = true;
+    // opt in: the feature and filter buffers take up to 64 more bytes of gpu memory per pixel
+    m_Enabled = false;
     m_Noise = 0.05f;
     m_LerpC = 0.01f;
     m_WindowRadius = 6;
@@ -56,6 +59,27 @@ struct PathTraceRenderSettings
   float m_GradientDelta;
   float m_GradientFactor;
   bool m_ShowLightsBackground;
+  // gpu memory allowed for the volume texture before switching to bricked paging. 0 = use what the driver reports
+  // as free.
+  uint32_t m_GpuVolumeBudgetMB;
+  // upload only the part of the volume around the region of interest
+  bool m_CropVolumeToRoi;
+  // accumulate samples in half float buffers: half the bandwidth and memory, but the running average of very many
+  // samples loses precision
+  bool m_HalfFloatAccumulation;
+  // shade with gradients precomputed on the cpu whenever the volume data changes, instead of six extra volume
+  // lookups per scattering event
+  bool m_UsePrecomputedGradients;
+  // approximate shadow rays with a lookup into a low resolution transmittance volume per light, rebuilt when the
+  // lights or the volume appearance change. Off means the exact ray march.
+  bool m_CachedShadows;
+  // adaptive sampling: a pixel stops taking samples once the relative standard error of its luminance is below this.
+  // 0 samples every pixel every iteration.
+  float m_ErrorTarget;
+  // while the camera moves, path trace only every n-th pixel in x and y and upsample. 1 = always full resolution.
+  int m_InteractiveDownsample;
+  // after a camera move, start from the previous image warped into the new view instead of from nothing
+  bool m_TemporalReprojection;
 
   PathTraceRenderSettings()
     : m_DensityScale(8.5f)
@@ -65,5 +89,13 @@ struct PathTraceRenderSettings
     , m_GradientDelta(4.0f)
     , m_GradientFactor(0.5f)
     , m_ShowLightsBackground(false)
+    , m_GpuVolumeBudgetMB(0)
+    , m_CropVolumeToRoi(false)
+    , m_HalfFloatAccumulation(false)
+    , m_UsePrecomputedGradients(false)
+    , m_CachedShadows(false)
+    , m_ErrorTarget(0.0f)
+    , m_InteractiveDownsample(1)
+    , m_TemporalReprojection(false)
   {}
 };
@@ -0,0 +1,38 @@
+#include "DeviceLoad.h"
+
+namespace {
+double
+loadScore(const DeviceLoad& d)
+{
+  double memoryUse = (d.m_freeMemoryBytes > 0) ? (double)d.m_gpuBytes / (double)d.m_freeMemoryBytes : 0.0;
+  return (double)d.m_sessions + (double)d.m_queuedRequests + DEVICE_MEMORY_WEIGHT * memoryUse;
+}
+
+bool
+lessLoaded(const DeviceLoad& a, const DeviceLoad& b)
+{
+  if (a.isFull() != b.isFull()) {
+    return !a.isFull();
+  }
+  double sa = loadScore(a), sb = loadScore(b);
+  if (sa != sb) {
+    return sa < sb;
+  }
+  if (a.m_queueDurationMs != b.m_queueDurationMs) {
+    return a.m_queueDurationMs < b.m_queueDurationMs;
+  }
+  return a.m_gpuBytes < b.m_gpuBytes;
+}
+}
+
+int
+leastLoadedDevice(const std::vector<DeviceLoad>& devices)
+{
+  int best = -1;
+  for (size_t i = 0; i < devices.size(); ++i) {
+    if (best < 0 || lessLoaded(devices[i], devices[best])) {
+      best = (int)i;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <inttypes.h>
+#include <vector>
+
+// What one gpu is busy with, for placing a new render session on the least loaded device.
+struct DeviceLoad
+{
+  // render sessions bound to the device
+  uint32_t m_sessions = 0;
+  // requests waiting in those sessions' queues
+  uint32_t m_queuedRequests = 0;
+  // total time the sessions spent rendering, in ms
+  int64_t m_queueDurationMs = 0;
+  // gpu memory held by the sessions and the preloaded volumes
+  size_t m_gpuBytes = 0;
+  // gpu memory that was free on the device at startup, or 0 when the driver does not report it (e.g. Mesa)
+  size_t m_freeMemoryBytes = 0;
+
+  bool isFull() const { return m_freeMemoryBytes > 0 && m_gpuBytes >= m_freeMemoryBytes; }
+};
+
+// A full device counts as this many extra sessions.
+static const double DEVICE_MEMORY_WEIGHT = 4.0;
+
+// The index of the device to place a new session on, or -1 if there are none.
+// Devices whose memory is full are only chosen when all of them are. Otherwise the device with the fewest sessions
+// and queued requests wins, weighing in the fraction of its memory in use; ties go to the least rendering time, then
+// the least memory, then the lowest index.
+int
+leastLoadedDevice(const std::vector<DeviceLoad>& devices);
@@ -25,7 +25,7 @@ public:
 
   void SetFlag(const long Flag) { m_Bits |= Flag; };
 
-  long Get(void) { return m_Bits; };
+  long Get(void) const { return m_Bits; };
 
   void ClearFlag(const long Flag) { m_Bits &= ~Flag; };
 
@@ -0,0 +1,44 @@
+#include "FrameDiff.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// Rec. 709 weights scaled to sum to 256
+inline int
+luma(const uint8_t* bgra)
+{
+  return (18 * bgra[0] + 183 * bgra[1] + 55 * bgra[2]) >> 8;
+}
+
+} // namespace
+
+void
+diffFrameTiles(const uint8_t* frame,
+               const uint8_t* reference,
+               uint32_t w,
+               uint32_t h,
+               const FrameDiffParams& params,
+               std::vector<ImageTile>& changed)
+{
+  const int maxThreshold = (int)params.m_maxThreshold;
+  for (const ImageTile& tile : makeImageTiles(w, h, params.m_tileSize)) {
+    uint64_t sum = 0;
+    bool marked = false;
+    for (uint32_t y = tile.m_y; y < tile.m_y + tile.m_h && !marked; ++y) {
+      const size_t row = (size_t)y * w;
+      for (uint32_t x = tile.m_x; x < tile.m_x + tile.m_w; ++x) {
+        const int d = std::abs(luma(frame + (row + x) * 4) - luma(reference + (row + x) * 4));
+        sum += d;
+        if (d > maxThreshold) {
+          marked = true;
+          break;
+        }
+      }
+    }
+    if (marked || (float)sum > params.m_meanThreshold * (float)(tile.m_w * tile.m_h)) {
+      changed.push_back(tile);
+    }
+  }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "TiledRender.h"
+
+#include <inttypes.h>
+#include <vector>
+
+// When a tile of a streamed frame counts as changed since the frame the client already has.
+// Changes are measured on the 8 bit luma of the encoded pixels, so they are roughly perceptual.
+struct FrameDiffParams
+{
+  uint32_t m_tileSize = 64;
+  // mean absolute luma change over the tile, in 8 bit levels. Sampling noise moves every pixel a little.
+  float m_meanThreshold = 0.5f;
+  // any single pixel changing by this much marks its tile, so that small features are not averaged away
+  float m_maxThreshold = 24.0f;
+};
+
+// Append the tiles of frame that changed against reference. Both are w x h, 32 bits per pixel with rows of w pixels,
+// blue in the first byte and red in the third as in QImage::Format_RGB32.
+void
+diffFrameTiles(const uint8_t* frame,
+               const uint8_t* reference,
+               uint32_t w,
+               uint32_t h,
+               const FrameDiffParams& params,
+               std::vector<ImageTile>& changed);
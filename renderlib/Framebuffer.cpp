@@ -65,6 +65,9 @@ Framebuffer::resize(uint32_t w, uint32_t h)
     glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTextureId, 0);
   }
   check_glfb("resized fb");
+
+  m_w = w;
+  m_h = h;
 }
 
 void
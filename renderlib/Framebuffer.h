@@ -14,6 +14,8 @@ public:
 
   GLuint id() const { return m_id; }
   GLuint colorTextureId() const { return m_colorTextureId; }
+  uint32_t width() const { return m_w; }
+  uint32_t height() const { return m_h; }
 
 private:
   void destroyFb();
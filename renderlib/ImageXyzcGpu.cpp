@@ -2,11 +2,24 @@
 
 #include "ImageXYZC.h"
 #include "Logging.h"
+#include "VolumeGradient.h"
 #include "threading.h"
 
 #include "gl/Util.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+
+// the low resolution stand-in volume used while bricks are paged in is at most this size on any axis
+static const uint32_t COARSE_VOLUME_MAX_DIM = 128;
+
+static uint32_t
+coarseVolumeFactor(ImageXYZC* img)
+{
+  uint32_t maxDim = std::max(img->sizeX(), std::max(img->sizeY(), img->sizeZ()));
+  return std::max(1u, (maxDim + COARSE_VOLUME_MAX_DIM - 1) / COARSE_VOLUME_MAX_DIM);
+}
 
 void
 ChannelGpu::allocGpu(ImageXYZC* img, int channel)
@@ -84,9 +97,12 @@ ImageGpu::createVolumeTextureFusedRGBA8(ImageXYZC* img)
 }
 
 void
-ImageGpu::createVolumeTexture4x16(ImageXYZC* img)
+ImageGpu::createVolumeTexture4x16(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ)
 {
-  m_gpuBytes += (16 * 4) / 8 * img->sizeX() * img->sizeY() * img->sizeZ();
+  m_gpuBytes += (16 * 4) / 8 * (size_t)sizeX * (size_t)sizeY * (size_t)sizeZ;
+  m_volumeTextureSize[0] = sizeX;
+  m_volumeTextureSize[1] = sizeY;
+  m_volumeTextureSize[2] = sizeZ;
 
   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
   glGenTextures(1, &m_VolumeGLTexture);
@@ -99,30 +115,130 @@ ImageGpu::createVolumeTexture4x16(ImageXYZC* img)
   glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-  glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA16, img->sizeX(), img->sizeY(), img->sizeZ());
+  glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA16, sizeX, sizeY, sizeZ);
   glBindTexture(GL_TEXTURE_3D, 0);
   check_gl("volume texture creation");
 }
 
+void
+ImageGpu::createCoarseVolumeTexture4x16(ImageXYZC* img)
+{
+  uint32_t f = coarseVolumeFactor(img);
+  m_volumeTextureOffset[0] = m_volumeTextureOffset[1] = m_volumeTextureOffset[2] = 0;
+  createVolumeTexture4x16((img->sizeX() + f - 1) / f, (img->sizeY() + f - 1) / f, (img->sizeZ() + f - 1) / f);
+}
+
+void
+ImageGpu::updateCoarseVolumeData4x16(ImageXYZC* img, int c0, int c1, int c2, int c3)
+{
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  const int N = 4;
+  const uint16_t* src[4] = {
+    img->channel(c0)->m_ptr, img->channel(c1)->m_ptr, img->channel(c2)->m_ptr, img->channel(c3)->m_ptr
+  };
+  const int ch[4] = { c0, c1, c2, c3 };
+  for (int j = 0; j < N; ++j) {
+    m_volumeChannels[j] = ch[j];
+  }
+  const uint32_t f = coarseVolumeFactor(img);
+  const uint32_t sx = img->sizeX(), sy = img->sizeY(), sz = img->sizeZ();
+  const uint32_t cx = m_volumeTextureSize[0], cy = m_volumeTextureSize[1], cz = m_volumeTextureSize[2];
+  uint16_t* v = new uint16_t[(size_t)cx * cy * cz * N];
+
+  // keep the max of each block rather than the average, so that small bright structures still show up
+  // in the stand-in volume and get their bricks requested by the ray marcher.
+  parallel_for(cz, [&](size_t s, size_t e) {
+    for (size_t z = s; z < e; ++z) {
+      for (uint32_t y = 0; y < cy; ++y) {
+        for (uint32_t x = 0; x < cx; ++x) {
+          uint16_t* dest = v + N * ((size_t)x + (size_t)cx * ((size_t)y + (size_t)cy * z));
+          for (int j = 0; j < N; ++j) {
+            uint16_t m = 0;
+            for (size_t zz = z * f; zz < std::min((size_t)(z + 1) * f, (size_t)sz); ++zz) {
+              for (size_t yy = y * f; yy < std::min((size_t)(y + 1) * f, (size_t)sy); ++yy) {
+                const uint16_t* row = src[j] + (size_t)sx * (yy + (size_t)sy * zz);
+                for (size_t xx = x * f; xx < std::min((size_t)(x + 1) * f, (size_t)sx); ++xx) {
+                  m = std::max(m, row[xx]);
+                }
+              }
+            }
+            dest[j] = m;
+          }
+        }
+      }
+    }
+  });
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindTexture(GL_TEXTURE_3D, m_VolumeGLTexture);
+  glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, cx, cy, cz, GL_RGBA, GL_UNSIGNED_SHORT, v);
+  glBindTexture(GL_TEXTURE_3D, 0);
+  check_gl("update coarse volume texture");
+
+  delete[] v;
+
+  auto endTime = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = endTime - startTime;
+  LOG_DEBUG << "Coarse volume " << cx << "x" << cy << "x" << cz << " to gpu: " << (elapsed.count() * 1000.0) << "ms";
+}
+
 void
 ImageGpu::updateVolumeData4x16(ImageXYZC* img, int c0, int c1, int c2, int c3)
 {
+  if (m_bricks) {
+    updateCoarseVolumeData4x16(img, c0, c1, c2, c3);
+    m_bricks->setChannels(c0, c1, c2, c3);
+    return;
+  }
+
+  if (m_volumeOwner) {
+    // never write to a texture that other renderers are reading
+    m_volumeOwner.reset();
+    createVolumeTexture4x16(m_volumeTextureSize[0], m_volumeTextureSize[1], m_volumeTextureSize[2]);
+  }
+
   auto startTime = std::chrono::high_resolution_clock::now();
 
   const int N = 4;
   int ch[4] = { c0, c1, c2, c3 };
+  for (int j = 0; j < N; ++j) {
+    m_volumeChannels[j] = ch[j];
+  }
   // interleaved all channels.
   // first 4.
-  size_t xyz = img->sizeX() * img->sizeY() * img->sizeZ();
+  const uint32_t sx = m_volumeTextureSize[0], sy = m_volumeTextureSize[1], sz = m_volumeTextureSize[2];
+  const uint32_t ox = m_volumeTextureOffset[0], oy = m_volumeTextureOffset[1], oz = m_volumeTextureOffset[2];
+  size_t xyz = (size_t)sx * (size_t)sy * (size_t)sz;
   uint16_t* v = new uint16_t[xyz * N];
 
-  parallel_for(xyz, [&N, &v, &img, &ch](size_t s, size_t e) {
-    for (size_t i = s; i < e; ++i) {
-      for (int j = 0; j < N; ++j) {
-        v[N * (i) + j] = img->channel(ch[j])->m_ptr[(i)];
+  if (!isCropped(img)) {
+    parallel_for(xyz, [&N, &v, &img, &ch](size_t s, size_t e) {
+      for (size_t i = s; i < e; ++i) {
+        for (int j = 0; j < N; ++j) {
+          v[N * (i) + j] = img->channel(ch[j])->m_ptr[(i)];
+        }
       }
-    }
-  });
+    });
+  } else {
+    // gather the region one row at a time
+    const size_t imgX = img->sizeX(), imgY = img->sizeY();
+    parallel_for((size_t)sy * sz, [&](size_t s, size_t e) {
+      for (size_t row = s; row < e; ++row) {
+        size_t y = row % sy, z = row / sy;
+        size_t srcOffset = ox + imgX * ((oy + y) + imgY * (oz + z));
+        uint16_t* dest = v + N * row * sx;
+        for (int j = 0; j < N; ++j) {
+          const uint16_t* src = img->channel(ch[j])->m_ptr + srcOffset;
+          for (size_t x = 0; x < sx; ++x) {
+            dest[N * x + j] = src[x];
+          }
+        }
+      }
+    });
+  }
 
   auto endTime = std::chrono::high_resolution_clock::now();
   std::chrono::duration<double> elapsed = endTime - startTime;
@@ -134,7 +250,7 @@ ImageGpu::updateVolumeData4x16(ImageXYZC* img, int c0, int c1, int c2, int c3)
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, 0);
   glBindTexture(GL_TEXTURE_3D, m_VolumeGLTexture);
-  glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, img->sizeX(), img->sizeY(), img->sizeZ(), GL_RGBA, GL_UNSIGNED_SHORT, v);
+  glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, sx, sy, sz, GL_RGBA, GL_UNSIGNED_SHORT, v);
   glBindTexture(GL_TEXTURE_3D, 0);
   check_gl("update volume texture");
 
@@ -145,15 +261,137 @@ ImageGpu::updateVolumeData4x16(ImageXYZC* img, int c0, int c1, int c2, int c3)
   delete[] v;
 }
 
+bool
+ImageGpu::canAllocGradients(int numChannels, size_t budgetBytes) const
+{
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+  for (int i = 0; i < 3; ++i) {
+    if (maxSize > 0 && m_volumeTextureSize[i] > (uint32_t)maxSize) {
+      return false;
+    }
+  }
+
+  const size_t voxels =
+    (size_t)m_volumeTextureSize[0] * (size_t)m_volumeTextureSize[1] * (size_t)m_volumeTextureSize[2];
+  const size_t gradientBytes = (16 * 4) / 8 * voxels * numChannels;
+  if (budgetBytes > 0) {
+    return (16 * 4) / 8 * voxels + gradientBytes <= budgetBytes;
+  }
+  // the volume texture is already allocated, so what is free is what the gradients can have
+  const size_t freeBytes = queryFreeVideoMemory();
+  return freeBytes == 0 || gradientBytes <= freeBytes / 4 * 3;
+}
+
+bool
+ImageGpu::updateGradientData(ImageXYZC* img, int numChannels, int c0, int c1, int c2, int c3)
+{
+  if (m_bricks) {
+    LOG_WARNING << "updateGradientData: no precomputed gradients for bricked volumes";
+    return false;
+  }
+  numChannels = std::min(std::max(numChannels, 1), 4);
+
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  const uint32_t sx = m_volumeTextureSize[0], sy = m_volumeTextureSize[1], sz = m_volumeTextureSize[2];
+  if (m_gradientChannels != numChannels) {
+    deallocGradients();
+  }
+  if (!m_gradientChannels) {
+    // drop earlier errors so that only an allocation failure is caught below
+    check_gl("before gradient texture creation");
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glGenTextures(numChannels, m_GradientGLTextures);
+    glActiveTexture(GL_TEXTURE0);
+    for (int i = 0; i < numChannels; ++i) {
+      glBindTexture(GL_TEXTURE_3D, m_GradientGLTextures[i]);
+      glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+      glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA16F, sx, sy, sz);
+    }
+    glBindTexture(GL_TEXTURE_3D, 0);
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR) {
+      LOG_WARNING << "Could not allocate gradient textures for " << numChannels << " channels (GL error " << err
+                  << "), computing gradients while rendering";
+      glDeleteTextures(numChannels, m_GradientGLTextures);
+      std::fill(m_GradientGLTextures, m_GradientGLTextures + 4, 0);
+      return false;
+    }
+    m_gradientChannels = numChannels;
+    m_gpuBytes += (16 * 4) / 8 * (size_t)sx * (size_t)sy * (size_t)sz * numChannels;
+  }
+
+  const uint32_t size[3] = { img->sizeX(), img->sizeY(), img->sizeZ() };
+  const glm::vec3 dims = img->getDimensions();
+  const float spacing[3] = { dims.x / size[0], dims.y / size[1], dims.z / size[2] };
+  const uint32_t boxMax[3] = {
+    m_volumeTextureOffset[0] + sx, m_volumeTextureOffset[1] + sy, m_volumeTextureOffset[2] + sz
+  };
+  const int ch[4] = { c0, c1, c2, c3 };
+  float* g = new float[(size_t)sx * sy * sz * 4];
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glActiveTexture(GL_TEXTURE0);
+  for (int i = 0; i < numChannels; ++i) {
+    computeGradientVolume(img->channel(ch[i])->m_ptr, size, spacing, m_volumeTextureOffset, boxMax, g);
+    glBindTexture(GL_TEXTURE_3D, m_GradientGLTextures[i]);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, sx, sy, sz, GL_RGBA, GL_FLOAT, g);
+  }
+  glBindTexture(GL_TEXTURE_3D, 0);
+  check_gl("update gradient texture");
+
+  delete[] g;
+
+  auto endTime = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = endTime - startTime;
+  LOG_DEBUG << "Gradients of " << numChannels << " channels to gpu: " << (elapsed.count() * 1000.0) << "ms";
+  return true;
+}
+
+void
+ImageGpu::deallocGradients()
+{
+  if (!m_gradientChannels) {
+    return;
+  }
+  glDeleteTextures(m_gradientChannels, m_GradientGLTextures);
+  std::fill(m_GradientGLTextures, m_GradientGLTextures + 4, 0);
+  m_gpuBytes -= (16 * 4) / 8 * (size_t)m_volumeTextureSize[0] * (size_t)m_volumeTextureSize[1] *
+                (size_t)m_volumeTextureSize[2] * m_gradientChannels;
+  m_gradientChannels = 0;
+}
+
 void
 ImageGpu::allocGpuInterleaved(ImageXYZC* img, uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3)
+{
+  const uint32_t regionMin[3] = { 0, 0, 0 };
+  const uint32_t regionMax[3] = { img->sizeX(), img->sizeY(), img->sizeZ() };
+  allocGpuInterleavedRegion(img, regionMin, regionMax, c0, c1, c2, c3);
+}
+
+void
+ImageGpu::allocGpuInterleavedRegion(ImageXYZC* img,
+                                    const uint32_t regionMin[3],
+                                    const uint32_t regionMax[3],
+                                    uint32_t c0,
+                                    uint32_t c1,
+                                    uint32_t c2,
+                                    uint32_t c3)
 {
   deallocGpu();
   m_channels.clear();
 
   auto startTime = std::chrono::high_resolution_clock::now();
 
-  createVolumeTexture4x16(img);
+  for (int i = 0; i < 3; ++i) {
+    m_volumeTextureOffset[i] = regionMin[i];
+  }
+  createVolumeTexture4x16(regionMax[0] - regionMin[0], regionMax[1] - regionMin[1], regionMax[2] - regionMin[2]);
   uint32_t numChannels = img->sizeC();
   updateVolumeData4x16(img,
                        std::min(c0, numChannels - 1),
@@ -161,7 +399,56 @@ ImageGpu::allocGpuInterleaved(ImageXYZC* img, uint32_t c0, uint32_t c1, uint32_t
                        std::min(c2, numChannels - 1),
                        std::min(c3, numChannels - 1));
 
-  for (uint32_t i = 0; i < numChannels; ++i) {
+  allocChannels(img);
+
+  auto endTime = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> elapsed = endTime - startTime;
+  LOG_DEBUG << "allocGPUinterleaved: Image to GPU in " << (elapsed.count() * 1000.0) << "ms";
+  LOG_DEBUG << "allocGPUinterleaved: GPU bytes: " << m_gpuBytes;
+}
+
+void
+ImageGpu::allocGpuShared(ImageXYZC* img, std::shared_ptr<ImageGpu> owner)
+{
+  deallocGpu();
+  m_channels.clear();
+
+  m_volumeOwner = owner;
+  m_VolumeGLTexture = owner->m_VolumeGLTexture;
+  for (int i = 0; i < 3; ++i) {
+    m_volumeTextureSize[i] = owner->m_volumeTextureSize[i];
+    m_volumeTextureOffset[i] = owner->m_volumeTextureOffset[i];
+  }
+  for (int i = 0; i < 4; ++i) {
+    m_volumeChannels[i] = owner->m_volumeChannels[i];
+  }
+
+  // the lookup tables follow each renderer's own transfer functions
+  allocChannels(img);
+
+  LOG_DEBUG << "allocGpuShared: borrowed the preloaded volume texture, GPU bytes: " << m_gpuBytes;
+}
+
+bool
+ImageGpu::canShareVolume(ImageXYZC* img, uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3) const
+{
+  const uint32_t last = img->sizeC() - 1;
+  const uint32_t ch[4] = { std::min(c0, last), std::min(c1, last), std::min(c2, last), std::min(c3, last) };
+  if (m_VolumeGLTexture == 0 || m_bricks || isCropped(img)) {
+    return false;
+  }
+  for (int i = 0; i < 4; ++i) {
+    if (m_volumeChannels[i] != (int)ch[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void
+ImageGpu::allocChannels(ImageXYZC* img)
+{
+  for (uint32_t i = 0; i < img->sizeC(); ++i) {
     ChannelGpu c;
     c.m_index = i;
     c.allocGpu(img, i);
@@ -169,11 +456,96 @@ ImageGpu::allocGpuInterleaved(ImageXYZC* img, uint32_t c0, uint32_t c1, uint32_t
 
     m_gpuBytes += c.m_gpuBytes;
   }
+}
+
+void
+ImageGpu::allocGpuBricked(ImageXYZC* img, size_t poolBytes, uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3)
+{
+  deallocGpu();
+  m_channels.clear();
+
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  uint32_t numChannels = img->sizeC();
+  c0 = std::min(c0, numChannels - 1);
+  c1 = std::min(c1, numChannels - 1);
+  c2 = std::min(c2, numChannels - 1);
+  c3 = std::min(c3, numChannels - 1);
+
+  m_bricks.reset(new BrickPoolGpu());
+  m_bricks->alloc(img, poolBytes, c0, c1, c2, c3);
+  m_gpuBytes += m_bricks->m_gpuBytes;
+
+  createCoarseVolumeTexture4x16(img);
+  updateCoarseVolumeData4x16(img, c0, c1, c2, c3);
+
+  allocChannels(img);
 
   auto endTime = std::chrono::high_resolution_clock::now();
   std::chrono::duration<double> elapsed = endTime - startTime;
-  LOG_DEBUG << "allocGPUinterleaved: Image to GPU in " << (elapsed.count() * 1000.0) << "ms";
-  LOG_DEBUG << "allocGPUinterleaved: GPU bytes: " << m_gpuBytes;
+  LOG_DEBUG << "allocGpuBricked: Image to GPU in " << (elapsed.count() * 1000.0) << "ms";
+  LOG_DEBUG << "allocGpuBricked: GPU bytes: " << m_gpuBytes;
+}
+
+void
+ImageGpu::setVolumeRegion(ImageXYZC* img,
+                          const uint32_t regionMin[3],
+                          const uint32_t regionMax[3],
+                          int c0,
+                          int c1,
+                          int c2,
+                          int c3)
+{
+  if (m_bricks) {
+    LOG_WARNING << "setVolumeRegion: bricked volumes are not cropped";
+    return;
+  }
+
+  // the gradients have to cover the same region; the renderer builds them again if they fit
+  deallocGradients();
+
+  if (!m_volumeOwner) {
+    glDeleteTextures(1, &m_VolumeGLTexture);
+    m_gpuBytes -= (16 * 4) / 8 * (size_t)m_volumeTextureSize[0] * (size_t)m_volumeTextureSize[1] *
+                  (size_t)m_volumeTextureSize[2];
+  }
+  m_volumeOwner.reset();
+  m_VolumeGLTexture = 0;
+
+  for (int i = 0; i < 3; ++i) {
+    m_volumeTextureOffset[i] = regionMin[i];
+  }
+  createVolumeTexture4x16(regionMax[0] - regionMin[0], regionMax[1] - regionMin[1], regionMax[2] - regionMin[2]);
+  updateVolumeData4x16(img, c0, c1, c2, c3);
+
+  LOG_DEBUG << "Volume texture region " << regionMin[0] << "," << regionMin[1] << "," << regionMin[2] << " size "
+            << m_volumeTextureSize[0] << "x" << m_volumeTextureSize[1] << "x" << m_volumeTextureSize[2];
+}
+
+bool
+ImageGpu::isCropped(ImageXYZC* img) const
+{
+  return !m_bricks && (m_volumeTextureOffset[0] != 0 || m_volumeTextureOffset[1] != 0 ||
+                       m_volumeTextureOffset[2] != 0 || m_volumeTextureSize[0] != img->sizeX() ||
+                       m_volumeTextureSize[1] != img->sizeY() || m_volumeTextureSize[2] != img->sizeZ());
+}
+
+bool
+ImageGpu::needsBricking(ImageXYZC* img, size_t budgetBytes)
+{
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+  if (maxSize > 0 &&
+      (img->sizeX() > (uint32_t)maxSize || img->sizeY() > (uint32_t)maxSize || img->sizeZ() > (uint32_t)maxSize)) {
+    return true;
+  }
+
+  if (budgetBytes == 0) {
+    // leave some headroom for framebuffers and whatever else is sharing the device
+    budgetBytes = queryFreeVideoMemory() / 4 * 3;
+  }
+  size_t volumeBytes = (16 * 4) / 8 * (size_t)img->sizeX() * (size_t)img->sizeY() * (size_t)img->sizeZ();
+  return budgetBytes > 0 && volumeBytes > budgetBytes;
 }
 
 void
@@ -183,13 +555,27 @@ ImageGpu::deallocGpu()
     m_channels[i].deallocGpu();
   }
 
+  if (m_bricks) {
+    m_bricks->dealloc();
+    m_bricks.reset();
+  }
+
+  deallocGradients();
+
   // needs current gl context.
 
   check_gl("pre-destroy gl volume texture");
   //  glBindTexture(GL_TEXTURE_3D, 0);
-  glDeleteTextures(1, &m_VolumeGLTexture);
+  if (!m_volumeOwner) {
+    glDeleteTextures(1, &m_VolumeGLTexture);
+  }
+  m_volumeOwner.reset();
   check_gl("destroy gl volume texture");
   m_VolumeGLTexture = 0;
+  for (int i = 0; i < 3; ++i) {
+    m_volumeTextureSize[i] = 0;
+    m_volumeTextureOffset[i] = 0;
+  }
 
   m_gpuBytes = 0;
 }
@@ -199,3 +585,227 @@ ImageGpu::updateLutGpu(int channel, ImageXYZC* img)
 {
   m_channels[channel].updateLutGpu(channel, img);
 }
+
+void
+BrickPoolGpu::alloc(ImageXYZC* img, size_t poolBytes, int c0, int c1, int c2, int c3)
+{
+  dealloc();
+
+  m_img = img;
+  m_channels[0] = c0;
+  m_channels[1] = c1;
+  m_channels[2] = c2;
+  m_channels[3] = c3;
+
+  m_layout = BrickLayout(img->sizeX(), img->sizeY(), img->sizeZ(), BRICK_SIZE);
+  const uint32_t padded = m_layout.paddedBrickSize();
+  const size_t brickBytes = (size_t)padded * padded * padded * 4 * sizeof(uint16_t);
+
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+  // slot coordinates are stored as 8 bit integers in the page table
+  uint32_t maxSlotsPerAxis = std::min(255u, std::max((uint32_t)maxSize, padded) / padded);
+  // no point in a pool bigger than the whole volume
+  uint32_t neededSlotsPerAxis = (uint32_t)std::ceil(std::cbrt((double)m_layout.brickCount()) - 1e-6);
+  uint32_t slotsPerAxis = (uint32_t)(std::cbrt((double)(poolBytes / brickBytes)) + 1e-6);
+  slotsPerAxis = std::max(1u, std::min(slotsPerAxis, std::min(neededSlotsPerAxis, maxSlotsPerAxis)));
+  m_poolSlots[0] = m_poolSlots[1] = m_poolSlots[2] = slotsPerAxis;
+
+  m_residency.init(m_layout.brickCount(), slotsPerAxis * slotsPerAxis * slotsPerAxis);
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenTextures(1, &m_poolTexture);
+  glBindTexture(GL_TEXTURE_3D, m_poolTexture);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glTexStorage3D(GL_TEXTURE_3D,
+                 1,
+                 GL_RGBA16,
+                 m_poolSlots[0] * padded,
+                 m_poolSlots[1] * padded,
+                 m_poolSlots[2] * padded);
+  m_gpuBytes += brickBytes * m_residency.numSlots();
+  check_gl("brick pool texture creation");
+
+  glGenTextures(1, &m_pageTableTexture);
+  glBindTexture(GL_TEXTURE_3D, m_pageTableTexture);
+  // integer textures can not be filtered
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA8UI, m_layout.m_gridSize[0], m_layout.m_gridSize[1], m_layout.m_gridSize[2]);
+  m_gpuBytes += 4 * (size_t)m_layout.brickCount();
+  glBindTexture(GL_TEXTURE_3D, 0);
+  check_gl("brick page table texture creation");
+
+  clearPageTable();
+
+  LOG_DEBUG << "Brick pool: " << m_layout.brickCount() << " bricks of " << m_layout.m_brickSize << "^3, "
+            << m_residency.numSlots() << " slots, " << m_gpuBytes << " GPU bytes";
+}
+
+void
+BrickPoolGpu::dealloc()
+{
+  glDeleteTextures(1, &m_poolTexture);
+  m_poolTexture = 0;
+  glDeleteTextures(1, &m_pageTableTexture);
+  m_pageTableTexture = 0;
+  check_gl("destroy brick pool textures");
+
+  m_img = nullptr;
+  m_gpuBytes = 0;
+}
+
+void
+BrickPoolGpu::setChannels(int c0, int c1, int c2, int c3)
+{
+  m_channels[0] = c0;
+  m_channels[1] = c1;
+  m_channels[2] = c2;
+  m_channels[3] = c3;
+
+  m_residency.clear();
+  clearPageTable();
+}
+
+void
+BrickPoolGpu::clearPageTable()
+{
+  std::vector<uint8_t> entries(4 * (size_t)m_layout.brickCount(), 0);
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_3D, m_pageTableTexture);
+  glTexSubImage3D(GL_TEXTURE_3D,
+                  0,
+                  0,
+                  0,
+                  0,
+                  m_layout.m_gridSize[0],
+                  m_layout.m_gridSize[1],
+                  m_layout.m_gridSize[2],
+                  GL_RGBA_INTEGER,
+                  GL_UNSIGNED_BYTE,
+                  entries.data());
+  glBindTexture(GL_TEXTURE_3D, 0);
+  check_gl("clear brick page table");
+}
+
+void
+BrickPoolGpu::setPageEntry(uint32_t brick, int32_t slot)
+{
+  uint8_t entry[4] = { 0, 0, 0, 0 };
+  if (slot != BrickResidencyManager::NOT_RESIDENT) {
+    entry[0] = (uint8_t)(slot % m_poolSlots[0]);
+    entry[1] = (uint8_t)((slot / m_poolSlots[0]) % m_poolSlots[1]);
+    entry[2] = (uint8_t)(slot / (m_poolSlots[0] * m_poolSlots[1]));
+    entry[3] = 1;
+  }
+  uint32_t bx, by, bz;
+  m_layout.brickCoords(brick, bx, by, bz);
+  glTexSubImage3D(GL_TEXTURE_3D, 0, bx, by, bz, 1, 1, 1, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entry);
+}
+
+void
+BrickPoolGpu::fillBrick(uint32_t brick, uint16_t* dest) const
+{
+  const int N = 4;
+  const uint16_t* src[4] = { m_img->channel(m_channels[0])->m_ptr,
+                             m_img->channel(m_channels[1])->m_ptr,
+                             m_img->channel(m_channels[2])->m_ptr,
+                             m_img->channel(m_channels[3])->m_ptr };
+  const int64_t sx = m_img->sizeX(), sy = m_img->sizeY(), sz = m_img->sizeZ();
+  const int64_t padded = m_layout.paddedBrickSize();
+  uint32_t ox, oy, oz;
+  m_layout.brickOrigin(brick, ox, oy, oz);
+
+  // the apron and any part of the brick past the edge of the volume repeat the edge voxels (clamp to edge)
+  for (int64_t z = 0; z < padded; ++z) {
+    int64_t vz = std::min(std::max((int64_t)oz + z - (int64_t)BrickLayout::APRON, (int64_t)0), sz - 1);
+    for (int64_t y = 0; y < padded; ++y) {
+      int64_t vy = std::min(std::max((int64_t)oy + y - (int64_t)BrickLayout::APRON, (int64_t)0), sy - 1);
+      size_t rowOffset = (size_t)(sx * (vy + sy * vz));
+      for (int64_t x = 0; x < padded; ++x) {
+        int64_t vx = std::min(std::max((int64_t)ox + x - (int64_t)BrickLayout::APRON, (int64_t)0), sx - 1);
+        uint16_t* d = dest + N * (x + padded * (y + padded * z));
+        for (int j = 0; j < N; ++j) {
+          d[j] = src[j][rowOffset + vx];
+        }
+      }
+    }
+  }
+}
+
+size_t
+BrickPoolGpu::update(const std::vector<uint32_t>& missing, const std::vector<uint32_t>& used)
+{
+  // the bricks this frame used can not make room for the ones it missed
+  m_residency.beginFrame();
+  for (uint32_t brick : used) {
+    m_residency.touch(brick);
+  }
+
+  std::vector<BrickResidencyManager::SlotAssignment> assigned;
+  std::vector<uint32_t> evicted;
+  m_residency.request(missing, MAX_UPLOADS_PER_FRAME, assigned, evicted);
+  if (assigned.empty()) {
+    return 0;
+  }
+
+  const uint32_t padded = m_layout.paddedBrickSize();
+  const size_t brickValues = (size_t)padded * padded * padded * 4;
+  std::vector<uint16_t> staging(assigned.size() * brickValues);
+  parallel_for(assigned.size(), [&](size_t s, size_t e) {
+    for (size_t i = s; i < e; ++i) {
+      fillBrick(assigned[i].m_brick, staging.data() + i * brickValues);
+    }
+  });
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glBindTexture(GL_TEXTURE_3D, m_pageTableTexture);
+  for (uint32_t brick : evicted) {
+    setPageEntry(brick, BrickResidencyManager::NOT_RESIDENT);
+  }
+
+  glBindTexture(GL_TEXTURE_3D, m_poolTexture);
+  for (size_t i = 0; i < assigned.size(); ++i) {
+    uint32_t slot = assigned[i].m_slot;
+    uint32_t px = (slot % m_poolSlots[0]) * padded;
+    uint32_t py = ((slot / m_poolSlots[0]) % m_poolSlots[1]) * padded;
+    uint32_t pz = (slot / (m_poolSlots[0] * m_poolSlots[1])) * padded;
+    glTexSubImage3D(GL_TEXTURE_3D,
+                    0,
+                    px,
+                    py,
+                    pz,
+                    padded,
+                    padded,
+                    padded,
+                    GL_RGBA,
+                    GL_UNSIGNED_SHORT,
+                    staging.data() + i * brickValues);
+  }
+
+  glBindTexture(GL_TEXTURE_3D, m_pageTableTexture);
+  for (size_t i = 0; i < assigned.size(); ++i) {
+    setPageEntry(assigned[i].m_brick, (int32_t)assigned[i].m_slot);
+  }
+  glBindTexture(GL_TEXTURE_3D, 0);
+  check_gl("upload bricks");
+
+  LOG_DEBUG << "Paged in " << assigned.size() << " bricks, evicted " << evicted.size() << ", resident "
+            << m_residency.numResident() << "/" << m_layout.brickCount();
+  return assigned.size();
+}
@@ -2,6 +2,9 @@
 
 #include <glad/glad.h>
 
+#include "BrickCache.h"
+
+#include <memory>
 #include <vector>
 
 class ImageXYZC;
@@ -18,26 +21,141 @@ struct ChannelGpu
   void updateLutGpu(int channel, ImageXYZC* img);
 };
 
+// Out-of-core storage for volumes that do not fit in one gpu texture.
+// A pool texture holds a limited number of padded bricks and a page table texture maps every brick
+// of the volume to its pool slot. Bricks are uploaded on demand, driven by ray marcher feedback.
+struct BrickPoolGpu
+{
+  static const uint32_t BRICK_SIZE = 32;
+  // cap on bricks uploaded per frame so that interaction stays responsive while paging
+  static const size_t MAX_UPLOADS_PER_FRAME = 64;
+
+  BrickLayout m_layout;
+  BrickResidencyManager m_residency;
+
+  // RGBA16 pool of padded bricks, 4 interleaved channels like the full resolution volume texture
+  GLuint m_poolTexture = 0;
+  // RGBA8UI, one texel per brick: xyz = pool slot coordinates, w = 1 if resident
+  GLuint m_pageTableTexture = 0;
+  uint32_t m_poolSlots[3] = { 0, 0, 0 };
+
+  size_t m_gpuBytes = 0;
+
+  void alloc(ImageXYZC* img, size_t poolBytes, int c0, int c1, int c2, int c3);
+  void dealloc();
+
+  // change which channels are paged in. All resident bricks are invalidated.
+  void setChannels(int c0, int c1, int c2, int c3);
+
+  // Feed back the bricks the ray marcher needed but did not find, and the resident bricks it used, which are kept
+  // until the next update. Returns the number of bricks that were uploaded.
+  size_t update(const std::vector<uint32_t>& missing, const std::vector<uint32_t>& used);
+
+private:
+  ImageXYZC* m_img = nullptr;
+  int m_channels[4] = { 0, 0, 0, 0 };
+
+  void clearPageTable();
+  // expects m_pageTableTexture to be bound to GL_TEXTURE_3D
+  void setPageEntry(uint32_t brick, int32_t slot);
+  void fillBrick(uint32_t brick, uint16_t* dest) const;
+};
+
 struct ImageGpu
 {
+  // brick pool size used when no explicit gpu memory budget is given
+  static const size_t DEFAULT_BRICK_POOL_BYTES = (size_t)1024 * 1024 * 1024;
+
   std::vector<ChannelGpu> m_channels;
 
+  // full resolution volume, or a low resolution version of it that stands in for missing bricks when paging.
   GLuint m_VolumeGLTexture = 0;
+  // the image channels in the 4 components of m_VolumeGLTexture
+  int m_volumeChannels[4] = { 0, 0, 0, 0 };
+  // Set when m_VolumeGLTexture is borrowed from a preloaded image in the gl context share group. A borrowed texture
+  // is never written or deleted here; changing its channels or region switches to a texture of our own.
+  std::shared_ptr<ImageGpu> m_volumeOwner;
+
+  // only allocated when the volume is paged in bricks
+  std::unique_ptr<BrickPoolGpu> m_bricks;
+
+  // optional precomputed shading gradients for the region of m_VolumeGLTexture. One RGBA16F texture per channel, the
+  // size of the volume texture, with the unit gradient direction in xyz and the magnitude in w.
+  GLuint m_GradientGLTextures[4] = { 0, 0, 0, 0 };
+  int m_gradientChannels = 0;
 
   size_t m_gpuBytes = 0;
 
   // put first 4 channels into gpu array
   void allocGpuInterleaved(ImageXYZC* img, uint32_t c0 = 0u, uint32_t c1 = 1u, uint32_t c2 = 2u, uint32_t c3 = 3u);
+  // like allocGpuInterleaved, but only the voxels in [regionMin, regionMax) go into the volume texture
+  void allocGpuInterleavedRegion(ImageXYZC* img,
+                                 const uint32_t regionMin[3],
+                                 const uint32_t regionMax[3],
+                                 uint32_t c0 = 0u,
+                                 uint32_t c1 = 1u,
+                                 uint32_t c2 = 2u,
+                                 uint32_t c3 = 3u);
+  // replace only the volume texture with a different region of the image. LUTs are kept, precomputed gradients are
+  // freed.
+  void setVolumeRegion(ImageXYZC* img,
+                       const uint32_t regionMin[3],
+                       const uint32_t regionMax[3],
+                       int c0,
+                       int c1,
+                       int c2,
+                       int c3);
+
+  // like allocGpuInterleaved, but borrow the volume texture of owner, which must hold the whole image
+  void allocGpuShared(ImageXYZC* img, std::shared_ptr<ImageGpu> owner);
+  // true if the whole image is in the volume texture with these channels, so that other renderers can borrow it
+  bool canShareVolume(ImageXYZC* img, uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3) const;
+
+  // like allocGpuInterleaved, but page the volume through a brick pool of at most poolBytes
+  void allocGpuBricked(ImageXYZC* img,
+                       size_t poolBytes,
+                       uint32_t c0 = 0u,
+                       uint32_t c1 = 1u,
+                       uint32_t c2 = 2u,
+                       uint32_t c3 = 3u);
+
+  bool isBricked() const { return m_bricks != nullptr; }
+  // true if the volume texture holds less than the whole image
+  bool isCropped(ImageXYZC* img) const;
+
+  // true if the full resolution 4 channel volume can not be held in a single texture within budgetBytes
+  // (0 means use the free video memory reported by the driver, if any)
+  static bool needsBricking(ImageXYZC* img, size_t budgetBytes);
 
   void deallocGpu();
 
   void updateLutGpu(int channel, ImageXYZC* img);
 
-  void createVolumeTexture4x16(ImageXYZC* img);
+  void createVolumeTexture4x16(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ);
   void createVolumeTextureFusedRGBA8(ImageXYZC* img);
+  void createCoarseVolumeTexture4x16(ImageXYZC* img);
 
   // similar to allocGpuInterleaved, change which channels are in the gpu volume buffer.
   void updateVolumeData4x16(ImageXYZC* img, int c0, int c1, int c2, int c3);
 
+  // Whether gradients of numChannels can be allocated: each texture within GL_MAX_3D_TEXTURE_SIZE, and the volume and
+  // its gradients within budgetBytes, or the gradients within the free gpu memory when budgetBytes is 0.
+  bool canAllocGradients(int numChannels, size_t budgetBytes) const;
+  // compute the gradients of the first numChannels of c0..c3 over the volume texture region, and upload them to
+  // m_GradientGLTextures. Returns false, with no gradients allocated, if the textures could not be created.
+  // Not available for bricked volumes.
+  bool updateGradientData(ImageXYZC* img, int numChannels, int c0, int c1, int c2, int c3);
+  void deallocGradients();
+
+  // dimensions of m_VolumeGLTexture, and the voxel of the image at its origin.
+  // The texture covers less than the whole image when cropped to a region.
+  uint32_t m_volumeTextureSize[3] = { 0, 0, 0 };
+  uint32_t m_volumeTextureOffset[3] = { 0, 0, 0 };
+
   ~ImageGpu() { deallocGpu(); }
+
+private:
+  void updateCoarseVolumeData4x16(ImageXYZC* img, int c0, int c1, int c2, int c3);
+  // the per channel lookup tables
+  void allocChannels(ImageXYZC* img);
 };
@@ -3,24 +3,41 @@
 #include "glad/glad.h"
 #include "glm.h"
 
+#include "AtrousFilter.h"
 #include "Framebuffer.h"
 #include "ImageXYZC.h"
 #include "Logging.h"
 #include "gl/FSQ.h"
 #include "gl/Image3D.h"
 #include "gl/Util.h"
-#include "glsl/GLCopyShader.h"
+#include "glsl/GLDenoiseShader.h"
 #include "glsl/GLImageShader2DnoLut.h"
 #include "glsl/GLPTVolumeShader.h"
 #include "glsl/GLToneMapShader.h"
+#include "renderlib.h"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <unordered_map>
+
+// the brick feedback buffer is read back at this fraction of the render resolution
+static const uint32_t BRICK_FEEDBACK_DOWNSAMPLE = 4;
+// the cached shadow transmittance volume is at most this size on any axis
+static const uint32_t TRANSMITTANCE_VOLUME_MAX_DIM = 64;
+// the adaptive sampling moments are read back at this fraction of the render resolution, every few iterations
+static const uint32_t CONVERGENCE_DOWNSAMPLE = 8;
+static const int CONVERGENCE_CHECK_INTERVAL = 8;
+// enough single iteration passes to fill the default brick pool, at BrickPoolGpu::MAX_UPLOADS_PER_FRAME each
+static const int MAX_BRICK_PAGING_PASSES = 128;
 
 RenderGLPT::RenderGLPT(RenderSettings* rs)
-  : m_fbF32(nullptr)
-  , m_fbF32Accum(nullptr)
-  , m_renderBufferShader(nullptr)
-  , m_copyShader(nullptr)
+  : m_fbAccum{ nullptr, nullptr }
+  , m_accumIndex(0)
+  , m_accumFormat(GL_RGBA32F)
+  , m_renderScale(1)
+  , m_renderBufferShaders(nullptr)
+  , m_renderUniforms(nullptr)
   , m_toneMapShader(nullptr)
   , m_fsq(nullptr)
   , m_randomSeeds1(nullptr)
@@ -33,7 +50,20 @@ RenderGLPT::RenderGLPT(RenderSettings* rs)
   , m_gpuBytes(0)
   , m_imagequad(nullptr)
   , m_boundingBoxDrawable(nullptr)
+  , m_brickFeedbackTexture(0)
+  , m_brickFeedbackFb(nullptr)
+  , m_bricksPagedIn(false)
+  , m_transmittanceTexture(0)
+  , m_transmittanceFbo(0)
+  , m_transmittanceSize{ 0, 0, 0 }
+  , m_momentsTexture{ 0, 0 }
+  , m_convergenceFb(nullptr)
+  , m_historyTexture{ 0, 0 }
+  , m_denoiseFeatureTexture{ 0, 0 }
+  , m_fbDenoise{ nullptr, nullptr }
+  , m_denoiseShader(nullptr)
   , m_RandSeed(0)
+  , m_fixedRandSeed(-1)
   , m_devicePixelRatio(1.0f)
   , m_status(new CStatus)
 {}
@@ -43,19 +73,16 @@ RenderGLPT::~RenderGLPT() {}
 void
 RenderGLPT::cleanUpFB()
 {
+  cleanUpBrickFeedback();
+  cleanUpMoments();
+  cleanUpHistory();
+  cleanUpDenoise();
+
   delete m_fb;
   m_fb = nullptr;
 
-  delete m_fbF32;
-  m_fbF32 = nullptr;
-
-  delete m_fbF32Accum;
-  m_fbF32Accum = nullptr;
+  cleanUpAccumulationBuffers();
 
-  delete m_renderBufferShader;
-  m_renderBufferShader = 0;
-  delete m_copyShader;
-  m_copyShader = 0;
   delete m_toneMapShader;
   m_toneMapShader = 0;
   delete m_fsq;
@@ -69,27 +96,11 @@ RenderGLPT::initFB(uint32_t w, uint32_t h)
 {
   cleanUpFB();
 
-  m_fbF32 = new Framebuffer(w, h, GL_RGBA32F);
-  m_gpuBytes += w * h * 4 * sizeof(float);
-  check_glfb("resized float pathtrace sample fb");
-
-  // clear the newly created FB
-  glClearColor(0.0, 0.0, 0.0, 0.0);
-  glClear(GL_COLOR_BUFFER_BIT);
-
-  m_fbF32Accum = new Framebuffer(w, h, GL_RGBA32F);
-  m_gpuBytes += w * h * 4 * sizeof(float);
-  check_glfb("resized float accumulation fb");
-
-  // clear the newly created FB
-  glClearColor(0.0, 0.0, 0.0, 0.0);
-  glClear(GL_COLOR_BUFFER_BIT);
+  initAccumulationBuffers(w, h, m_renderSettings->m_RenderSettings.m_HalfFloatAccumulation ? GL_RGBA16F : GL_RGBA32F);
 
   m_fsq = new FSQ();
   m_fsq->setSize(glm::vec2(-1, 1), glm::vec2(-1, 1));
   m_fsq->create();
-  m_renderBufferShader = new GLPTVolumeShader();
-  m_copyShader = new GLCopyShader();
   m_toneMapShader = new GLToneMapShader();
 
   {
@@ -109,12 +120,40 @@ RenderGLPT::initFB(uint32_t w, uint32_t h)
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
+void
+RenderGLPT::initAccumulationBuffers(uint32_t w, uint32_t h, GLenum format)
+{
+  m_accumFormat = format;
+  const size_t bytesPerPixel = (format == GL_RGBA16F) ? 4 * 2 : 4 * sizeof(float);
+  for (int i = 0; i < 2; ++i) {
+    m_fbAccum[i] = new Framebuffer(w, h, format);
+    m_gpuBytes += (size_t)w * (size_t)h * bytesPerPixel;
+    check_glfb("resized float accumulation fb");
+
+    // clear the newly created FB
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+  }
+  m_accumIndex = 0;
+}
+
+void
+RenderGLPT::cleanUpAccumulationBuffers()
+{
+  for (int i = 0; i < 2; ++i) {
+    delete m_fbAccum[i];
+    m_fbAccum[i] = nullptr;
+  }
+}
+
 void
 RenderGLPT::initVolumeTextureGpu()
 {
 
   // free the gpu resources of the old image.
   m_imgGpu.deallocGpu();
+  cleanUpTransmittance();
+  m_gradientsFailedChannels = 0;
 
   if (!m_scene || !m_scene->m_volume) {
     return;
@@ -123,7 +162,713 @@ RenderGLPT::initVolumeTextureGpu()
   uint32_t c0, c1, c2, c3;
   m_scene->getFirst4EnabledChannels(c0, c1, c2, c3);
 
-  m_imgGpu.allocGpuInterleaved(m_scene->m_volume.get(), c0, c1, c2, c3);
+  size_t budgetBytes = (size_t)m_renderSettings->m_RenderSettings.m_GpuVolumeBudgetMB * 1024 * 1024;
+  if (ImageGpu::needsBricking(m_scene->m_volume.get(), budgetBytes)) {
+    // leave a bit of the budget for the low resolution stand-in volume
+    size_t poolBytes = (budgetBytes > 0) ? (budgetBytes / 4 * 3) : ImageGpu::DEFAULT_BRICK_POOL_BYTES;
+    LOG_INFO << "Volume does not fit in gpu memory, paging bricks through a " << (poolBytes / (1024 * 1024))
+             << " MB pool";
+    m_imgGpu.allocGpuBricked(m_scene->m_volume.get(), poolBytes, c0, c1, c2, c3);
+  } else {
+    cleanUpBrickFeedback();
+    uint32_t regionMin[3], regionMax[3];
+    bool crop = getVolumeRegion(regionMin, regionMax);
+    // a preloaded volume already on the gpu is read through the context share group instead of uploading a copy
+    std::shared_ptr<ImageGpu> preloaded = renderlib::findCachedGpuImage(m_scene->m_volume);
+    if (!crop && preloaded && preloaded->canShareVolume(m_scene->m_volume.get(), c0, c1, c2, c3)) {
+      m_imgGpu.allocGpuShared(m_scene->m_volume.get(), preloaded);
+    } else {
+      m_imgGpu.allocGpuInterleavedRegion(m_scene->m_volume.get(), regionMin, regionMax, c0, c1, c2, c3);
+    }
+  }
+}
+
+bool
+RenderGLPT::getVolumeRegion(uint32_t regionMin[3], uint32_t regionMax[3])
+{
+  ImageXYZC* img = m_scene->m_volume.get();
+  const uint32_t size[3] = { img->sizeX(), img->sizeY(), img->sizeZ() };
+  const glm::vec3 roiMin = m_scene->m_roi.GetMinP();
+  const glm::vec3 roiMax = m_scene->m_roi.GetMaxP();
+
+  size_t fullVoxels = 1, regionVoxels = 1;
+  for (int i = 0; i < 3; ++i) {
+    regionMin[i] = 0;
+    regionMax[i] = size[i];
+    if (m_renderSettings->m_RenderSettings.m_CropVolumeToRoi) {
+      // pad the roi so that trilinear and gradient lookups at its faces stay inside the region
+      const int64_t margin = 2 + size[i] / 16;
+      const int64_t lo = (int64_t)std::floor(roiMin[i] * size[i]) - margin;
+      const int64_t hi = (int64_t)std::ceil(roiMax[i] * size[i]) + margin;
+      regionMin[i] = (uint32_t)std::min(std::max(lo, (int64_t)0), (int64_t)size[i] - 1);
+      regionMax[i] = (uint32_t)std::max(std::min(hi, (int64_t)size[i]), (int64_t)regionMin[i] + 1);
+    }
+    fullVoxels *= size[i];
+    regionVoxels *= regionMax[i] - regionMin[i];
+  }
+
+  // not worth a re-upload for a small saving
+  if (regionVoxels * 2 > fullVoxels) {
+    for (int i = 0; i < 3; ++i) {
+      regionMin[i] = 0;
+      regionMax[i] = size[i];
+    }
+    return false;
+  }
+  return true;
+}
+
+void
+RenderGLPT::updateVolumeRegion()
+{
+  if (m_imgGpu.isBricked()) {
+    return;
+  }
+
+  uint32_t regionMin[3], regionMax[3];
+  bool crop = getVolumeRegion(regionMin, regionMax);
+
+  // keep the current texture while it still contains the roi and is not much larger than needed,
+  // so that dragging the roi sliders does not re-upload on every step.
+  const uint32_t* curMin = m_imgGpu.m_volumeTextureOffset;
+  const uint32_t* curSize = m_imgGpu.m_volumeTextureSize;
+  bool contained = true;
+  size_t curVoxels = 1, regionVoxels = 1;
+  for (int i = 0; i < 3; ++i) {
+    contained = contained && regionMin[i] >= curMin[i] && regionMax[i] <= curMin[i] + curSize[i];
+    curVoxels *= curSize[i];
+    regionVoxels *= regionMax[i] - regionMin[i];
+  }
+  if (crop && contained && curVoxels <= regionVoxels * 2) {
+    return;
+  }
+  if (!crop && !m_imgGpu.isCropped(m_scene->m_volume.get())) {
+    return;
+  }
+
+  uint32_t c0, c1, c2, c3;
+  m_scene->getFirst4EnabledChannels(c0, c1, c2, c3);
+  m_imgGpu.setVolumeRegion(m_scene->m_volume.get(), regionMin, regionMax, c0, c1, c2, c3);
+  m_gradientsFailedChannels = 0;
+}
+
+void
+RenderGLPT::updateGradients(int numChannels, bool volumeDataChanged)
+{
+  if (!m_renderSettings->m_RenderSettings.m_UsePrecomputedGradients || m_imgGpu.isBricked() || numChannels == 0) {
+    m_imgGpu.deallocGradients();
+    m_gradientsFailedChannels = 0;
+    return;
+  }
+  if (m_imgGpu.m_gradientChannels == numChannels && !volumeDataChanged) {
+    return;
+  }
+  if (m_gradientsFailedChannels == numChannels) {
+    return;
+  }
+
+  // the shader differences the volume on the fly when there are no gradients for its channel count
+  if (m_imgGpu.m_gradientChannels != numChannels) {
+    m_imgGpu.deallocGradients();
+    const size_t budgetBytes = (size_t)m_renderSettings->m_RenderSettings.m_GpuVolumeBudgetMB * 1024 * 1024;
+    if (!m_imgGpu.canAllocGradients(numChannels, budgetBytes)) {
+      LOG_INFO << "Precomputed gradients of " << numChannels
+               << " channels do not fit in gpu memory, computing gradients while rendering";
+      m_gradientsFailedChannels = numChannels;
+      return;
+    }
+  }
+
+  uint32_t c0, c1, c2, c3;
+  m_scene->getFirst4EnabledChannels(c0, c1, c2, c3);
+  if (!m_imgGpu.updateGradientData(m_scene->m_volume.get(), numChannels, c0, c1, c2, c3)) {
+    m_gradientsFailedChannels = numChannels;
+  }
+}
+
+void
+RenderGLPT::initBrickFeedback()
+{
+  if (m_brickFeedbackTexture) {
+    return;
+  }
+
+  glGenTextures(1, &m_brickFeedbackTexture);
+  glBindTexture(GL_TEXTURE_2D, m_brickFeedbackTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, m_w, m_h, 0, GL_RG, GL_FLOAT, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  check_gl("create brick feedback texture");
+
+  // both accumulation buffers write the same feedback texture
+  for (int i = 0; i < 2; ++i) {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbAccum[i]->id());
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, m_brickFeedbackTexture, 0);
+    check_glfb("attach brick feedback texture");
+  }
+  setAccumulationDrawBuffers();
+
+  m_brickFeedbackFb = new Framebuffer((m_w + BRICK_FEEDBACK_DOWNSAMPLE - 1) / BRICK_FEEDBACK_DOWNSAMPLE,
+                                      (m_h + BRICK_FEEDBACK_DOWNSAMPLE - 1) / BRICK_FEEDBACK_DOWNSAMPLE,
+                                      GL_RG32F);
+  m_gpuBytes += (size_t)m_w * (size_t)m_h * 2 * sizeof(float);
+}
+
+void
+RenderGLPT::cleanUpBrickFeedback()
+{
+  if (!m_brickFeedbackTexture) {
+    return;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    if (m_fbAccum[i]) {
+      glBindFramebuffer(GL_FRAMEBUFFER, m_fbAccum[i]->id());
+      glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, 0, 0);
+    }
+  }
+  glDeleteTextures(1, &m_brickFeedbackTexture);
+  m_brickFeedbackTexture = 0;
+  setAccumulationDrawBuffers();
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  delete m_brickFeedbackFb;
+  m_brickFeedbackFb = nullptr;
+  m_gpuBytes -= (size_t)m_w * (size_t)m_h * 2 * sizeof(float);
+  check_gl("destroy brick feedback texture");
+}
+
+// copy one render target between framebuffers that have it at the same color attachment
+static void
+blitColorAttachment(GLuint readFbo, GLuint drawFbo, int attachment, uint32_t w, uint32_t h)
+{
+  const GLenum buffer = GL_COLOR_ATTACHMENT0 + attachment;
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+  glReadBuffer(buffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFbo);
+  glDrawBuffers(1, &buffer);
+  glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  check_glfb("copy accumulation render target");
+}
+
+void
+RenderGLPT::getAccumulationTargets(GLuint targets[ParkedAccumulation::NUM_TARGETS])
+{
+  targets[0] = m_fbAccum[m_accumIndex]->colorTextureId();
+  targets[1] = 0;
+  targets[2] = m_momentsTexture[m_accumIndex];
+  targets[3] = m_historyTexture[m_accumIndex];
+  targets[4] = m_denoiseFeatureTexture[0];
+  targets[5] = m_denoiseFeatureTexture[1];
+}
+
+void
+RenderGLPT::parkAccumulation()
+{
+  forgetScene(m_renderSettings);
+  // an upsampled preview is not worth keeping
+  if (!m_fbAccum[m_accumIndex] || m_renderScale > 1 || !AccumulationParking::worthParking(*m_renderSettings)) {
+    return;
+  }
+
+  GLuint sources[ParkedAccumulation::NUM_TARGETS];
+  getAccumulationTargets(sources);
+  ParkedAccumulation parked;
+  parked.m_format = m_accumFormat;
+  parked.m_w = m_w;
+  parked.m_h = m_h;
+  parked.m_iterations = m_renderSettings->GetNoIterations();
+  parked.m_randSeed = m_RandSeed;
+  glGenFramebuffers(1, &parked.m_fbo);
+  for (int i = 0; i < ParkedAccumulation::NUM_TARGETS; ++i) {
+    if (!sources[i]) {
+      continue;
+    }
+    const GLenum format = (i == 0) ? m_accumFormat : GL_RGBA32F;
+    glGenTextures(1, &parked.m_textures[i]);
+    glBindTexture(GL_TEXTURE_2D, parked.m_textures[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, m_w, m_h, 0, GL_RGBA, GL_FLOAT, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, parked.m_fbo);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, parked.m_textures[i], 0);
+
+    blitColorAttachment(m_fbAccum[m_accumIndex]->id(), parked.m_fbo, i, m_w, m_h);
+    const size_t bytesPerPixel = (format == GL_RGBA16F) ? 4 * 2 : 4 * sizeof(float);
+    parked.m_gpuBytes += (size_t)m_w * (size_t)m_h * bytesPerPixel;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  m_parking.park(m_renderSettings, parked);
+}
+
+int
+RenderGLPT::resumeAccumulation()
+{
+  ParkedAccumulation parked;
+  if (!m_parking.take(m_renderSettings, parked)) {
+    return 0;
+  }
+
+  // the render targets the current variant writes have to be the ones that were kept
+  GLuint targets[ParkedAccumulation::NUM_TARGETS];
+  getAccumulationTargets(targets);
+  int iterations = 0;
+  if (parked.fits(m_w, m_h, m_accumFormat, targets)) {
+    for (int i = 0; i < ParkedAccumulation::NUM_TARGETS; ++i) {
+      if (parked.m_textures[i]) {
+        blitColorAttachment(parked.m_fbo, m_fbAccum[m_accumIndex]->id(), i, m_w, m_h);
+      }
+    }
+    setAccumulationDrawBuffers();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    iterations = parked.m_iterations;
+    m_RandSeed = parked.m_randSeed;
+  }
+  freeParkedAccumulation(parked);
+  return iterations;
+}
+
+void
+RenderGLPT::freeParkedAccumulation(ParkedAccumulation& parked)
+{
+  for (int i = 0; i < ParkedAccumulation::NUM_TARGETS; ++i) {
+    if (parked.m_textures[i]) {
+      glDeleteTextures(1, &parked.m_textures[i]);
+      parked.m_textures[i] = 0;
+    }
+  }
+  glDeleteFramebuffers(1, &parked.m_fbo);
+  parked.m_fbo = 0;
+  check_gl("destroy parked accumulation");
+}
+
+void
+RenderGLPT::forgetScene(const RenderSettings* rs)
+{
+  ParkedAccumulation parked;
+  if (m_parking.take(rs, parked)) {
+    freeParkedAccumulation(parked);
+  }
+}
+
+void
+RenderGLPT::setAccumulationDrawBuffers()
+{
+  // the draw buffer index of each target is its attachment number, so unused targets in between are GL_NONE
+  const GLenum drawBuffers[6] = { GL_COLOR_ATTACHMENT0,
+                                  m_brickFeedbackTexture ? (GLenum)GL_COLOR_ATTACHMENT1 : (GLenum)GL_NONE,
+                                  m_momentsTexture[0] ? (GLenum)GL_COLOR_ATTACHMENT2 : (GLenum)GL_NONE,
+                                  m_historyTexture[0] ? (GLenum)GL_COLOR_ATTACHMENT3 : (GLenum)GL_NONE,
+                                  m_denoiseFeatureTexture[0] ? (GLenum)GL_COLOR_ATTACHMENT4 : (GLenum)GL_NONE,
+                                  m_denoiseFeatureTexture[1] ? (GLenum)GL_COLOR_ATTACHMENT5 : (GLenum)GL_NONE };
+  GLsizei count = 6;
+  while (count > 1 && drawBuffers[count - 1] == GL_NONE) {
+    count--;
+  }
+  for (int i = 0; i < 2; ++i) {
+    if (m_fbAccum[i]) {
+      glBindFramebuffer(GL_FRAMEBUFFER, m_fbAccum[i]->id());
+      glDrawBuffers(count, drawBuffers);
+      check_glfb("accumulation draw buffers");
+    }
+  }
+}
+
+void
+RenderGLPT::initMoments()
+{
+  if (m_momentsTexture[0]) {
+    return;
+  }
+
+  glGenTextures(2, m_momentsTexture);
+  for (int i = 0; i < 2; ++i) {
+    glBindTexture(GL_TEXTURE_2D, m_momentsTexture[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, m_w, m_h, 0, GL_RGBA, GL_FLOAT, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbAccum[i]->id());
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, m_momentsTexture[i], 0);
+    check_glfb("attach moments texture");
+  }
+  setAccumulationDrawBuffers();
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  m_convergenceFb = new Framebuffer((m_w + CONVERGENCE_DOWNSAMPLE - 1) / CONVERGENCE_DOWNSAMPLE,
+                                    (m_h + CONVERGENCE_DOWNSAMPLE - 1) / CONVERGENCE_DOWNSAMPLE,
+                                    GL_RGBA32F);
+  m_gpuBytes += 2 * (size_t)m_w * (size_t)m_h * 4 * sizeof(float);
+}
+
+void
+RenderGLPT::cleanUpMoments()
+{
+  if (!m_momentsTexture[0]) {
+    return;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    if (m_fbAccum[i]) {
+      glBindFramebuffer(GL_FRAMEBUFFER, m_fbAccum[i]->id());
+      glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, 0, 0);
+    }
+  }
+  glDeleteTextures(2, m_momentsTexture);
+  m_momentsTexture[0] = m_momentsTexture[1] = 0;
+  setAccumulationDrawBuffers();
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  delete m_convergenceFb;
+  m_convergenceFb = nullptr;
+  m_gpuBytes -= 2 * (size_t)m_w * (size_t)m_h * 4 * sizeof(float);
+  m_renderSettings->SetConvergence(0.0f);
+  check_gl("destroy moments textures");
+}
+
+void
+RenderGLPT::initHistory()
+{
+  if (m_historyTexture[0]) {
+    return;
+  }
+
+  glGenTextures(2, m_historyTexture);
+  for (int i = 0; i < 2; ++i) {
+    glBindTexture(GL_TEXTURE_2D, m_historyTexture[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, m_w, m_h, 0, GL_RGBA, GL_FLOAT, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbAccum[i]->id());
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, m_historyTexture[i], 0);
+    check_glfb("attach history texture");
+  }
+  setAccumulationDrawBuffers();
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  m_gpuBytes += 2 * (size_t)m_w * (size_t)m_h * 4 * sizeof(float);
+}
+
+void
+RenderGLPT::cleanUpHistory()
+{
+  if (!m_historyTexture[0]) {
+    return;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    if (m_fbAccum[i]) {
+      glBindFramebuffer(GL_FRAMEBUFFER, m_fbAccum[i]->id());
+      glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, 0, 0);
+    }
+  }
+  glDeleteTextures(2, m_historyTexture);
+  m_historyTexture[0] = m_historyTexture[1] = 0;
+  setAccumulationDrawBuffers();
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  m_gpuBytes -= 2 * (size_t)m_w * (size_t)m_h * 4 * sizeof(float);
+  check_gl("destroy history textures");
+}
+
+void
+RenderGLPT::reproject(const GLPTVolumeShaderVariant& variant)
+{
+  GLPTVolumeShaderVariant passVariant = variant;
+  passVariant.m_reprojectionPass = true;
+  GLPTVolumeShader* shader = m_renderBufferShaders->get(passVariant);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_fbAccum[1 - m_accumIndex]->id());
+  glViewport(0, 0, m_w, m_h);
+  shader->bind();
+  shader->setShadingUniforms(m_scene, 1, m_RandSeed, m_imgGpu, m_fbAccum[m_accumIndex]->colorTextureId());
+  shader->setTemporalReprojection(m_historyTexture[m_accumIndex]);
+  glm::mat4 m(1.0);
+  m_fsq->render(m);
+  shader->release();
+  check_glfb("reprojection pass");
+
+  glActiveTexture(GL_TEXTURE0 + 1);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0 + 11);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  m_accumIndex = 1 - m_accumIndex;
+}
+
+void
+RenderGLPT::initDenoise()
+{
+  if (m_denoiseFeatureTexture[0]) {
+    return;
+  }
+
+  glGenTextures(2, m_denoiseFeatureTexture);
+  for (int i = 0; i < 2; ++i) {
+    glBindTexture(GL_TEXTURE_2D, m_denoiseFeatureTexture[i]);
+    // sums over many iterations need full floats
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, m_w, m_h, 0, GL_RGBA, GL_FLOAT, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  // both accumulation buffers add into the same feature textures
+  for (int i = 0; i < 2; ++i) {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbAccum[i]->id());
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, m_denoiseFeatureTexture[0], 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT5, m_denoiseFeatureTexture[1], 0);
+    check_glfb("attach denoise feature textures");
+  }
+  setAccumulationDrawBuffers();
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  clearDenoiseFeatures();
+
+  const size_t bytesPerPixel = (m_accumFormat == GL_RGBA16F) ? 4 * 2 : 4 * sizeof(float);
+  for (int i = 0; i < 2; ++i) {
+    m_fbDenoise[i] = new Framebuffer(m_w, m_h, m_accumFormat);
+  }
+  m_denoiseShader = new GLDenoiseShader();
+  m_gpuBytes += 2 * (size_t)m_w * (size_t)m_h * (4 * sizeof(float) + bytesPerPixel);
+}
+
+void
+RenderGLPT::cleanUpDenoise()
+{
+  if (!m_denoiseFeatureTexture[0]) {
+    return;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    if (m_fbAccum[i]) {
+      glBindFramebuffer(GL_FRAMEBUFFER, m_fbAccum[i]->id());
+      glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, 0, 0);
+      glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT5, 0, 0);
+    }
+  }
+  glDeleteTextures(2, m_denoiseFeatureTexture);
+  m_denoiseFeatureTexture[0] = m_denoiseFeatureTexture[1] = 0;
+  setAccumulationDrawBuffers();
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  const size_t bytesPerPixel = (m_accumFormat == GL_RGBA16F) ? 4 * 2 : 4 * sizeof(float);
+  for (int i = 0; i < 2; ++i) {
+    delete m_fbDenoise[i];
+    m_fbDenoise[i] = nullptr;
+  }
+  delete m_denoiseShader;
+  m_denoiseShader = nullptr;
+  m_gpuBytes -= 2 * (size_t)m_w * (size_t)m_h * (4 * sizeof(float) + bytesPerPixel);
+  check_gl("destroy denoise buffers");
+}
+
+void
+RenderGLPT::clearDenoiseFeatures()
+{
+  const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  glBindFramebuffer(GL_FRAMEBUFFER, m_fbAccum[0]->id());
+  glClearBufferfv(GL_COLOR, 4, zero);
+  glClearBufferfv(GL_COLOR, 5, zero);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  check_glfb("clear denoise features");
+}
+
+GLuint
+RenderGLPT::denoise(float lerpC)
+{
+  GLTimer tmr;
+
+  const AtrousFilterParams params;
+  const GLuint original = m_fbAccum[m_accumIndex]->colorTextureId();
+  glActiveTexture(GL_TEXTURE0 + 1);
+  glBindTexture(GL_TEXTURE_2D, m_denoiseFeatureTexture[0]);
+  glActiveTexture(GL_TEXTURE0 + 2);
+  glBindTexture(GL_TEXTURE_2D, m_denoiseFeatureTexture[1]);
+  glActiveTexture(GL_TEXTURE0 + 3);
+  glBindTexture(GL_TEXTURE_2D, original);
+
+  glViewport(0, 0, m_w, m_h);
+  m_denoiseShader->bind();
+  glm::mat4 m(1.0);
+  GLuint source = original;
+  for (int pass = 0; pass < params.m_numPasses; ++pass) {
+    Framebuffer* target = m_fbDenoise[pass % 2];
+    glBindFramebuffer(GL_FRAMEBUFFER, target->id());
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, source);
+    m_denoiseShader->setShadingUniforms(params, pass, (pass == params.m_numPasses - 1) ? lerpC : 0.0f);
+    m_fsq->render(m);
+    source = target->colorTextureId();
+  }
+  m_denoiseShader->release();
+  check_glfb("denoise passes");
+
+  for (int i = 3; i >= 0; --i) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  m_timingDenoise.AddDuration(tmr.ElapsedTime());
+  return source;
+}
+
+float
+RenderGLPT::measureConvergence()
+{
+  const uint32_t fw = m_convergenceFb->width();
+  const uint32_t fh = m_convergenceFb->height();
+
+  // nearest neighbor downsample: a regular subset of the pixels is a fair sample of the whole image
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbAccum[m_accumIndex]->id());
+  glReadBuffer(GL_COLOR_ATTACHMENT2);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_convergenceFb->id());
+  glBlitFramebuffer(0, 0, m_w, m_h, 0, 0, fw, fh, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+  std::vector<float> moments((size_t)fw * fh * 4);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_convergenceFb->id());
+  glReadPixels(0, 0, fw, fh, GL_RGBA, GL_FLOAT, moments.data());
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  check_gl("read back moments");
+
+  size_t converged = 0;
+  for (size_t i = 0; i < (size_t)fw * fh; ++i) {
+    if (moments[4 * i + 3] > 0.0f) {
+      converged++;
+    }
+  }
+  return (fw * fh > 0) ? (float)converged / (float)(fw * fh) : 0.0f;
+}
+
+void
+RenderGLPT::initTransmittance()
+{
+  if (m_transmittanceTexture) {
+    return;
+  }
+
+  ImageXYZC* img = m_scene->m_volume.get();
+  const uint32_t size[3] = { img->sizeX(), img->sizeY(), img->sizeZ() };
+  const uint32_t maxDim = std::max(img->maxPixelDimension(), TRANSMITTANCE_VOLUME_MAX_DIM);
+  for (int i = 0; i < 3; ++i) {
+    m_transmittanceSize[i] = std::max(1u, (uint32_t)((uint64_t)size[i] * TRANSMITTANCE_VOLUME_MAX_DIM / maxDim));
+  }
+
+  glGenTextures(1, &m_transmittanceTexture);
+  glBindTexture(GL_TEXTURE_3D, m_transmittanceTexture);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glTexStorage3D(GL_TEXTURE_3D, 1, GL_RG16F, m_transmittanceSize[0], m_transmittanceSize[1], m_transmittanceSize[2]);
+  glBindTexture(GL_TEXTURE_3D, 0);
+
+  glGenFramebuffers(1, &m_transmittanceFbo);
+  check_gl("create transmittance volume");
+}
+
+void
+RenderGLPT::cleanUpTransmittance()
+{
+  if (!m_transmittanceTexture) {
+    return;
+  }
+  glDeleteFramebuffers(1, &m_transmittanceFbo);
+  m_transmittanceFbo = 0;
+  glDeleteTextures(1, &m_transmittanceTexture);
+  m_transmittanceTexture = 0;
+  for (int i = 0; i < 3; ++i) {
+    m_transmittanceSize[i] = 0;
+  }
+  check_gl("destroy transmittance volume");
+}
+
+void
+RenderGLPT::updateTransmittance(const GLPTVolumeShaderVariant& variant)
+{
+  GLTimer tmr;
+
+  GLPTVolumeShaderVariant passVariant = variant;
+  passVariant.m_cachedTransmittance = false;
+  passVariant.m_transmittancePass = true;
+  passVariant.m_adaptiveSampling = false;
+  passVariant.m_reprojection = false;
+  passVariant.m_denoiseFeatures = false;
+  GLPTVolumeShader* shader = m_renderBufferShaders->get(passVariant);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, m_transmittanceFbo);
+  glViewport(0, 0, m_transmittanceSize[0], m_transmittanceSize[1]);
+  shader->bind();
+  shader->setShadingUniforms(m_scene, 0, m_RandSeed, m_imgGpu, 0);
+
+  glm::mat4 m(1.0);
+  for (uint32_t z = 0; z < m_transmittanceSize[2]; ++z) {
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_transmittanceTexture, 0, z);
+    shader->setTransmittanceSlice(((float)z + 0.5f) / (float)m_transmittanceSize[2]);
+    m_fsq->render(m);
+  }
+  shader->release();
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  check_glfb("transmittance pass");
+
+  LOG_DEBUG << "Transmittance volume " << m_transmittanceSize[0] << "x" << m_transmittanceSize[1] << "x"
+            << m_transmittanceSize[2] << " in " << tmr.ElapsedTime() << "ms";
+}
+
+bool
+RenderGLPT::updateBrickResidency()
+{
+  const uint32_t fw = m_brickFeedbackFb->width();
+  const uint32_t fh = m_brickFeedbackFb->height();
+
+  // nearest neighbor downsample: every frame different pixels carry different random ray samples,
+  // so over a few frames a sparse subset of pixels still covers all the bricks that matter.
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbAccum[m_accumIndex]->id());
+  glReadBuffer(GL_COLOR_ATTACHMENT1);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_brickFeedbackFb->id());
+  glBlitFramebuffer(0, 0, m_w, m_h, 0, 0, fw, fh, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+  std::vector<float> feedback((size_t)fw * (size_t)fh * 2);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_brickFeedbackFb->id());
+  glReadPixels(0, 0, fw, fh, GL_RG, GL_FLOAT, feedback.data());
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  check_gl("read brick feedback");
+
+  // request the most wanted bricks first
+  std::unordered_map<uint32_t, uint32_t> missingCounts;
+  std::vector<uint32_t> used;
+  for (size_t i = 0; i < feedback.size(); i += 2) {
+    if (feedback[i] > 0.0f) {
+      missingCounts[(uint32_t)feedback[i] - 1]++;
+    }
+    if (feedback[i + 1] > 0.0f) {
+      used.push_back((uint32_t)feedback[i + 1] - 1);
+    }
+  }
+  if (missingCounts.empty() && used.empty()) {
+    return false;
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> ranked(missingCounts.begin(), missingCounts.end());
+  std::sort(ranked.begin(),
+            ranked.end(),
+            [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) {
+              return a.second > b.second;
+            });
+  std::vector<uint32_t> missing;
+  missing.reserve(ranked.size());
+  for (const auto& r : ranked) {
+    missing.push_back(r.first);
+  }
+
+  std::sort(used.begin(), used.end());
+  used.erase(std::unique(used.begin(), used.end()), used.end());
+
+  return m_imgGpu.m_bricks->update(missing, used) > 0;
 }
 
 void
@@ -131,6 +876,8 @@ RenderGLPT::initialize(uint32_t w, uint32_t h, float devicePixelRatio)
 {
   m_imagequad = new RectImage2D();
   m_boundingBoxDrawable = new BoundingBoxDrawable();
+  m_renderBufferShaders = new GLPTVolumeShaderCache();
+  m_renderUniforms = new GLPTVolumeUniforms();
 
   initVolumeTextureGpu();
   check_gl("init gl volume");
@@ -152,6 +899,12 @@ RenderGLPT::doRender(const CCamera& camera)
     return;
   }
 
+  // a scene swapped back in continues its parked image, unless it changed since
+  const bool resume = m_parking.beginFrame(*m_renderSettings);
+  if (!resume) {
+    forgetScene(m_renderSettings);
+  }
+
   if (!m_imgGpu.m_VolumeGLTexture || m_renderSettings->m_DirtyFlags.HasFlag(VolumeDirty)) {
     initVolumeTextureGpu();
     // we have set up everything there is to do before rendering
@@ -163,6 +916,23 @@ RenderGLPT::doRender(const CCamera& camera)
     m_renderSettings->SetNoIterations(0);
   }
 
+  const GLenum accumFormat = m_renderSettings->m_RenderSettings.m_HalfFloatAccumulation ? GL_RGBA16F : GL_RGBA32F;
+  if (accumFormat != m_accumFormat) {
+    // the feedback, moments, history and denoise feature textures are attached to the accumulation buffers
+    cleanUpBrickFeedback();
+    cleanUpMoments();
+    cleanUpHistory();
+    cleanUpDenoise();
+    const size_t bytesPerPixel = (m_accumFormat == GL_RGBA16F) ? 4 * 2 : 4 * sizeof(float);
+    m_gpuBytes -= 2 * (size_t)m_w * (size_t)m_h * bytesPerPixel;
+    cleanUpAccumulationBuffers();
+    initAccumulationBuffers(m_w, m_h, accumFormat);
+    m_renderSettings->SetNoIterations(0);
+  }
+
+  // what the reprojection can start from, if only the camera changes
+  const int previousIterations = m_renderSettings->GetNoIterations();
+
   // Restart the rendering when when the camera, lights and render params are dirty
   if (m_renderSettings->m_DirtyFlags.HasFlag(CameraDirty | LightsDirty | RenderParamsDirty | TransferFunctionDirty |
                                              RoiDirty)) {
@@ -174,6 +944,10 @@ RenderGLPT::doRender(const CCamera& camera)
       }
     }
 
+    if (m_renderSettings->m_DirtyFlags.HasFlag(RoiDirty)) {
+      updateVolumeRegion();
+    }
+
     //		ResetRenderCanvasView();
 
     // Reset no. iterations
@@ -193,6 +967,23 @@ RenderGLPT::doRender(const CCamera& camera)
     m_imgGpu.updateVolumeData4x16(m_scene->m_volume.get(), c0, c1, c2, c3);
     m_renderSettings->SetNoIterations(0);
   }
+  GLPTVolumeShaderVariant variant =
+    GLPTVolumeShaderVariant::select(m_scene, camera, m_renderSettings->m_RenderSettings);
+  updateGradients(variant.m_numChannels, m_renderSettings->m_DirtyFlags.HasFlag(VolumeDataDirty));
+  variant.m_precomputedGradient = variant.m_numChannels > 0 && m_imgGpu.m_gradientChannels == variant.m_numChannels;
+  variant.m_cachedTransmittance = m_renderSettings->m_RenderSettings.m_CachedShadows;
+  variant.m_denoiseFeatures = m_renderSettings->m_DenoiseParams.m_Enabled;
+  // the path trace uniform blocks are re-uploaded based on what changed. Anything else that restarted the
+  // accumulation without saying what changed refreshes all of them.
+  long uniformDirtyFlags = m_renderSettings->m_DirtyFlags.Get();
+  if (uniformDirtyFlags == 0 && m_renderSettings->GetNoIterations() == 0) {
+    uniformDirtyFlags = ~0L;
+  }
+  // preview a moving camera at reduced resolution
+  const int renderScale = (m_renderSettings->m_DirtyFlags.HasFlag(CameraDirty) && !resume)
+                            ? std::max(m_renderSettings->m_RenderSettings.m_InteractiveDownsample, 1)
+                            : 1;
+
   // At this point, all dirty flags should have been taken care of, since the flags in the original scene are now
   // cleared
   m_renderSettings->m_DirtyFlags.ClearAllFlags();
@@ -231,73 +1022,167 @@ RenderGLPT::doRender(const CCamera& camera)
 
   glm::mat4 m(1.0);
 
-  GLuint accumTargetTex = m_fbF32->colorTextureId(); // the texture of m_fbF32
-  GLuint prevAccumTargetTex =
-    m_fbF32Accum->colorTextureId(); // the texture that will be tonemapped to screen, a copy of m_fbF32
-
   GLint drawFboId = 0;
   glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFboId);
 
   glDisable(GL_DEPTH_TEST);
   glDisable(GL_BLEND);
 
-  for (int i = 0; i < camera.m_Film.m_ExposureIterations; ++i) {
+  if (m_imgGpu.isBricked()) {
+    initBrickFeedback();
+  }
+
+  GLPTVolumeShader* renderBufferShader = m_renderBufferShaders->get(variant);
+  m_renderUniforms->update(
+    m_scene, camera, b, m_renderSettings->m_RenderSettings, m_w, m_h, m_imgGpu, uniformDirtyFlags);
+  m_renderUniforms->bind();
+
+  if (variant.m_cachedTransmittance) {
+    const bool rebuild =
+      !m_transmittanceTexture || (uniformDirtyFlags & (LightsDirty | TransferFunctionDirty | VolumeDataDirty |
+                                                        RenderParamsDirty | RoiDirty | VolumeDirty)) != 0;
+    initTransmittance();
+    if (rebuild) {
+      updateTransmittance(variant);
+    }
+    glActiveTexture(GL_TEXTURE0 + 10);
+    glBindTexture(GL_TEXTURE_3D, m_transmittanceTexture);
+  } else {
+    cleanUpTransmittance();
+  }
+
+  if (variant.m_adaptiveSampling && !m_momentsTexture[0]) {
+    initMoments();
+    // the moments start out undefined
+    numIterations = 0;
+  } else if (!variant.m_adaptiveSampling) {
+    cleanUpMoments();
+  }
+  bool reprojected = false;
+  if (variant.m_reprojection && !m_historyTexture[0]) {
+    initHistory();
+    // nothing to reproject from yet
+    numIterations = 0;
+  } else if (!variant.m_reprojection) {
+    cleanUpHistory();
+  } else if (uniformDirtyFlags == CameraDirty && numIterations == 0 && previousIterations > 0 && renderScale == 1 &&
+             m_renderScale == 1) {
+    // a camera move alone keeps the samples that are still visible
+    reproject(variant);
+    numIterations = 1;
+    reprojected = true;
+  }
+  if (variant.m_denoiseFeatures && !m_denoiseFeatureTexture[0]) {
+    initDenoise();
+    // the features have to cover the same samples as the color
+    numIterations = 0;
+  } else if (!variant.m_denoiseFeatures) {
+    cleanUpDenoise();
+  }
+  if (renderScale == 1 && m_renderScale > 1) {
+    // the camera came to rest: replace the upsampled preview instead of accumulating over it
+    numIterations = 0;
+  }
+  m_renderScale = renderScale;
+  const int renderWidth = std::max(m_w / renderScale, 1);
+  const int renderHeight = std::max(m_h / renderScale, 1);
+  const int exposureIterations = (renderScale > 1) ? 1 : camera.m_Film.m_ExposureIterations;
+
+  if (resume) {
+    // after the render targets for this variant are set up, so that they are the ones filled in
+    numIterations = resumeAccumulation();
+  }
+  if (numIterations == 0) {
+    m_renderSettings->SetConvergence(0.0f);
+    if (m_fixedRandSeed >= 0) {
+      m_RandSeed = m_fixedRandSeed;
+    }
+  }
+  if (variant.m_denoiseFeatures) {
+    // reprojection only carries over the color, so the features start over with it too
+    if (numIterations == 0 || reprojected) {
+      clearDenoiseFeatures();
+    }
+    // the features are summed in place instead of ping-ponged
+    glEnablei(GL_BLEND, 4);
+    glEnablei(GL_BLEND, 5);
+    glBlendFunci(4, GL_ONE, GL_ONE);
+    glBlendFunci(5, GL_ONE, GL_ONE);
+  }
+
+  for (int i = 0; i < exposureIterations; ++i) {
     GLTimer TmrRender;
 
-    // 1. draw pathtrace pass and accumulate, using prevAccumTargetTex as previous accumulation
-    glBindFramebuffer(GL_FRAMEBUFFER, m_fbF32->id());
-    glViewport(0, 0, m_w, m_h);
+    // draw pathtrace pass and accumulate into the other buffer, using the latest accumulation as previous
+    Framebuffer* prevAccum = m_fbAccum[m_accumIndex];
+    Framebuffer* accumTarget = m_fbAccum[1 - m_accumIndex];
+    glBindFramebuffer(GL_FRAMEBUFFER, accumTarget->id());
+    // uResolution stays at full size, so a smaller viewport traces every renderScale-th pixel of the full image
+    glViewport(0, 0, renderWidth, renderHeight);
 
     check_glfb("bind framebuffer for pathtrace iteration");
 
-    m_renderBufferShader->bind();
-
-    m_renderBufferShader->setShadingUniforms(m_scene,
-                                             m_renderSettings->m_DenoiseParams,
-                                             camera,
-                                             b,
-                                             m_renderSettings->m_RenderSettings,
-                                             numIterations,
-                                             m_RandSeed,
-                                             m_w,
-                                             m_h,
-                                             m_imgGpu,
-                                             prevAccumTargetTex);
+    renderBufferShader->bind();
+    renderBufferShader->setShadingUniforms(m_scene, numIterations, m_RandSeed, m_imgGpu, prevAccum->colorTextureId());
+    if (variant.m_adaptiveSampling) {
+      renderBufferShader->setAdaptiveSampling(m_renderSettings->m_RenderSettings.m_ErrorTarget,
+                                              m_momentsTexture[m_accumIndex]);
+    }
+    if (variant.m_reprojection) {
+      renderBufferShader->setTemporalReprojection(m_historyTexture[m_accumIndex]);
+    }
 
     m_fsq->render(m);
 
     m_timingRender.AddDuration(TmrRender.ElapsedTime());
 
-    // unbind the prevAccumTargetTex
+    // unbind the previous accumulation so it can be rendered into next iteration
     glActiveTexture(GL_TEXTURE0 + 1);
     glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0 + 2);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0 + 11);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-    // 2. copy to accumTargetTex texture that will be used as accumulator for next pass
-
-    glBindFramebuffer(GL_FRAMEBUFFER, m_fbF32Accum->id());
-    check_glfb("bind framebuffer for accumulator");
-
-    // the sample
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_fbF32->colorTextureId());
-
-    m_copyShader->bind();
-    m_copyShader->setShadingUniforms();
-
-    m_fsq->render(m);
-
-    m_copyShader->release();
-    //_timingPostProcess.AddDuration(TmrPostProcess.ElapsedTime());
-
-    // ping pong accum buffer. this will stall till previous accum render is done.
+    // ping pong accum buffer
+    m_accumIndex = 1 - m_accumIndex;
 
     numIterations++;
     m_RandSeed++;
   }
+  glDisable(GL_BLEND);
+
+  if (renderScale > 1) {
+    // stretch the reduced resolution image over the whole accumulation buffer
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbAccum[m_accumIndex]->id());
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbAccum[1 - m_accumIndex]->id());
+    const GLenum colorOnly = GL_COLOR_ATTACHMENT0;
+    glDrawBuffers(1, &colorOnly);
+    glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, m_w, m_h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    check_glfb("upsample reduced resolution frame");
+    setAccumulationDrawBuffers();
+    m_accumIndex = 1 - m_accumIndex;
+  }
 
   m_renderSettings->SetNoIterations(numIterations);
 
-  // TODO do denoising in GLSL
+  if (variant.m_adaptiveSampling && numIterations % CONVERGENCE_CHECK_INTERVAL == 0) {
+    m_renderSettings->SetConvergence(measureConvergence());
+  }
+
+  if (m_imgGpu.isBricked()) {
+    // Samples so far were partly taken from the low resolution stand-in volume, so restart while the pool fills up.
+    // Once it is full, bricks only come in by evicting others. When the view needs more bricks than fit, that goes
+    // on forever, so from then on new bricks blend into the image instead of restarting it.
+    const bool poolFull = m_imgGpu.m_bricks->m_residency.isFull();
+    m_bricksPagedIn = updateBrickResidency();
+    if (m_bricksPagedIn && !poolFull) {
+      m_renderSettings->SetNoIterations(0);
+    }
+  } else {
+    m_bricksPagedIn = false;
+  }
 
   // set the lerpC here because the Render call is incrementing the number of iterations.
   // m_renderSettings->m_DenoiseParams.m_LerpC = 0.33f * (max((float)m_renderSettings->GetNoIterations(), 1.0f)
@@ -309,14 +1194,12 @@ RenderGLPT::doRender(const CCamera& camera)
   // (float)gScene.GetNoIterations());
   //	LOG_DEBUG << "Window " << _w << " " << _h << " Cam " << m_renderSettings->m_Camera.m_Film.m_Resolution.GetResX()
   //<< " " << m_renderSettings->m_Camera.m_Film.m_Resolution.GetResY();
-  if (m_renderSettings->m_DenoiseParams.m_Enabled && m_renderSettings->m_DenoiseParams.m_LerpC > 0.0f &&
+  GLuint displayTexture = m_fbAccum[m_accumIndex]->colorTextureId();
+  // the reduced resolution preview only wrote features into a corner of the buffers
+  if (variant.m_denoiseFeatures && renderScale == 1 && m_renderSettings->m_DenoiseParams.m_LerpC > 0.0f &&
       m_renderSettings->m_DenoiseParams.m_LerpC < 1.0f) {
-    // draw from accum buffer into fbtex
-    // Denoise(_F32AccumBuffer, _fbTex, _w, _h, m_renderSettings->m_DenoiseParams.m_LerpC);
-  } else {
-    // ToneMap(_F32AccumBuffer, _fbTex, _w, _h);
+    displayTexture = denoise(m_renderSettings->m_DenoiseParams.m_LerpC);
   }
-  //_timingDenoise.AddDuration(TmrDenoise.ElapsedTime());
 
   // Composite into final frame:
   // draw back of bounding box
@@ -325,6 +1208,7 @@ RenderGLPT::doRender(const CCamera& camera)
 
   glBindFramebuffer(GL_FRAMEBUFFER, m_fb->id());
   check_glfb("bind framebuffer for tone map");
+  glViewport(0, 0, m_w, m_h);
 
   glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
   glDepthMask(GL_FALSE);
@@ -358,7 +1242,7 @@ RenderGLPT::doRender(const CCamera& camera)
   }
 
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, m_fbF32Accum->colorTextureId());
+  glBindTexture(GL_TEXTURE_2D, displayTexture);
 
   // Tonemap into opengl display buffer
   m_toneMapShader->bind();
@@ -411,6 +1295,10 @@ RenderGLPT::doRender(const CCamera& camera)
   m_status->SetStatisticChanged("Performance", "De-noise Image", m_timingDenoise.filteredDurationAsString(), "ms.");
 
   m_status->SetStatisticChanged("Performance", "No. Iterations", std::to_string(m_renderSettings->GetNoIterations()));
+  if (m_momentsTexture[0]) {
+    m_status->SetStatisticChanged(
+      "Performance", "Converged Pixels", std::to_string((int)(100.0f * m_renderSettings->GetConvergence())), "%");
+  }
 
   // restore prior framebuffer
   glBindFramebuffer(GL_FRAMEBUFFER, drawFboId);
@@ -421,6 +1309,34 @@ RenderGLPT::doRender(const CCamera& camera)
   glDepthMask(GL_TRUE);
 }
 
+void
+RenderGLPT::pageInBricks(const CCamera& camera)
+{
+  if (!m_scene || !m_scene->m_volume) {
+    return;
+  }
+  // decided the same way as in initVolumeTextureGpu, which may not have run for this volume yet
+  const size_t budgetBytes = (size_t)m_renderSettings->m_RenderSettings.m_GpuVolumeBudgetMB * 1024 * 1024;
+  if (!m_imgGpu.isBricked() && !ImageGpu::needsBricking(m_scene->m_volume.get(), budgetBytes)) {
+    return;
+  }
+
+  CCamera pass = camera;
+  pass.m_Film.m_ExposureIterations = 1;
+  bool pagedIn = false;
+  for (int i = 0; i < MAX_BRICK_PAGING_PASSES; ++i) {
+    doRender(pass);
+    pagedIn = pagedIn || m_bricksPagedIn;
+    if (!m_imgGpu.isBricked() || !m_bricksPagedIn || m_imgGpu.m_bricks->m_residency.isFull()) {
+      break;
+    }
+  }
+  if (pagedIn) {
+    // samples were taken before all the bricks were there
+    m_renderSettings->SetNoIterations(0);
+  }
+}
+
 void
 RenderGLPT::render(const CCamera& camera)
 {
@@ -473,11 +1389,19 @@ void
 RenderGLPT::cleanUpResources()
 {
   m_imgGpu.deallocGpu();
+  cleanUpTransmittance();
+  for (ParkedAccumulation& parked : m_parking.takeAll()) {
+    freeParkedAccumulation(parked);
+  }
 
   delete m_imagequad;
   m_imagequad = nullptr;
   delete m_boundingBoxDrawable;
   m_boundingBoxDrawable = nullptr;
+  delete m_renderBufferShaders;
+  m_renderBufferShaders = nullptr;
+  delete m_renderUniforms;
+  m_renderUniforms = nullptr;
 
   cleanUpFB();
 }
@@ -500,8 +1424,38 @@ RenderGLPT::setScene(Scene* s)
   m_scene = s;
 }
 
+void
+RenderGLPT::swapScene(Scene* s, RenderSettings* rs)
+{
+  if (rs != m_renderSettings) {
+    parkAccumulation();
+  }
+  const bool sameVolume = m_scene && s && m_scene->m_volume == s->m_volume;
+  m_scene = s;
+  m_renderSettings = rs;
+
+  // everything that is uploaded from the scene or the settings, and no reprojection of the other scene's image
+  long dirty = CameraDirty | LightsDirty | RenderParamsDirty | TransferFunctionDirty | RoiDirty;
+  if (!sameVolume) {
+    dirty |= VolumeDirty;
+  } else if (s && s->m_volume) {
+    uint32_t c0, c1, c2, c3;
+    s->getFirst4EnabledChannels(c0, c1, c2, c3);
+    const uint32_t last = s->m_volume->sizeC() - 1;
+    const uint32_t ch[4] = { std::min(c0, last), std::min(c1, last), std::min(c2, last), std::min(c3, last) };
+    for (int i = 0; i < 4; ++i) {
+      if (m_imgGpu.m_volumeChannels[i] != (int)ch[i]) {
+        dirty |= VolumeDataDirty;
+      }
+    }
+  }
+  m_parking.swapIn(dirty);
+}
+
 size_t
 RenderGLPT::getGpuBytes()
 {
-  return m_gpuBytes + m_imgGpu.m_gpuBytes;
+  const size_t transmittanceBytes =
+    2 * 2 * (size_t)m_transmittanceSize[0] * (size_t)m_transmittanceSize[1] * (size_t)m_transmittanceSize[2];
+  return m_gpuBytes + m_imgGpu.m_gpuBytes + transmittanceBytes + m_parking.gpuBytes();
 }
@@ -3,6 +3,7 @@
 
 #include <glad/glad.h>
 
+#include "AccumulationParking.h"
 #include "AppScene.h"
 #include "RenderSettings.h"
 
@@ -18,9 +19,11 @@ class FSQ;
 class ImageXYZC;
 class Image3D;
 class RectImage2D;
-class GLCopyShader;
-class GLPTVolumeShader;
+class GLPTVolumeShaderCache;
+class GLPTVolumeUniforms;
+struct GLPTVolumeShaderVariant;
 class GLToneMapShader;
+class GLDenoiseShader;
 
 class RenderGLPT : public IRenderWindow
 {
@@ -35,6 +38,12 @@ public:
   virtual RenderParams& renderParams();
   virtual Scene* scene();
   virtual void setScene(Scene* s);
+  // Draw another scene with its own render settings, e.g. to serve several sessions from one gl context.
+  // Gpu state that the scenes have in common is kept. The outgoing scene's image is kept too, and a scene that is
+  // swapped back in continues it unless its settings changed in the meantime.
+  void swapScene(Scene* s, RenderSettings* rs);
+  // free the image kept by swapScene; call before the render settings are deleted
+  void forgetScene(const RenderSettings* rs);
 
   virtual std::shared_ptr<CStatus> getStatusInterface() { return m_status; }
 
@@ -43,11 +52,19 @@ public:
 
   // just draw into my own fbo.
   void doRender(const CCamera& camera);
+  // Before an image that is saved as it is: render single iteration passes until the bricks the view needs are paged
+  // in or the pool is full, so that the image is not drawn from the low resolution stand-in. The image starts over
+  // if any came in. Does nothing when the volume is not bricked.
+  void pageInBricks(const CCamera& camera);
   // draw my fbo texture into the current render target
   void drawImage();
 
   size_t getGpuBytes();
 
+  // Start every image from this random seed instead of where the last one left off, so that replaying the same
+  // commands draws the same samples. -1 = off.
+  void setFixedRandomSeed(int seed) { m_fixedRandSeed = seed; }
+
 private:
   RenderSettings* m_renderSettings;
   RenderParams m_renderParams;
@@ -57,7 +74,60 @@ private:
   void initVolumeTextureGpu();
   void cleanUpFB();
 
+  // voxel region of the volume that has to be on the gpu to render the current roi.
+  // returns false when the whole volume should be uploaded.
+  bool getVolumeRegion(uint32_t regionMin[3], uint32_t regionMax[3]);
+  // re-upload the volume texture if the roi moved outside of the uploaded region
+  void updateVolumeRegion();
+  // build, refresh or free the precomputed gradient textures to match the render settings
+  void updateGradients(int numChannels, bool volumeDataChanged);
+
+  // cached shadow ray transmittance toward each light, see PathTraceRenderSettings::m_CachedShadows
+  void initTransmittance();
+  void cleanUpTransmittance();
+  // render the transmittance pass of the given path trace variant into every slice of the cache
+  void updateTransmittance(const GLPTVolumeShaderVariant& variant);
+
+  // bricked volume paging: read back which bricks the ray marcher wanted and page them in.
+  void initBrickFeedback();
+  void cleanUpBrickFeedback();
+  // returns true if new bricks were made resident
+  bool updateBrickResidency();
+
+  // adaptive sampling: per pixel luminance moments, attached to the accumulation buffers as a third render target
+  void initMoments();
+  void cleanUpMoments();
+  // read back a subset of the moments and return the fraction of pixels that reached the error target
+  float measureConvergence();
+  // temporal reprojection: per pixel depth and sample counts, attached to the accumulation buffers as a fourth
+  // render target
+  void initHistory();
+  void cleanUpHistory();
+  // warp the latest accumulation into the current camera, keeping the samples that are still visible
+  void reproject(const GLPTVolumeShaderVariant& variant);
+  // denoising: feature sums attached to both accumulation buffers as fifth and sixth render targets, and the
+  // filter's own ping-pong buffers
+  void initDenoise();
+  void cleanUpDenoise();
+  // zero the feature sums when the accumulation starts over
+  void clearDenoiseFeatures();
+  // filter the latest accumulation and return the texture that holds the result
+  GLuint denoise(float lerpC);
+  // select the render targets of the accumulation buffers that the path trace shader writes
+  void setAccumulationDrawBuffers();
+
+  // the render targets of the latest accumulation buffer, indexed by color attachment; the brick feedback is left out
+  void getAccumulationTargets(GLuint targets[ParkedAccumulation::NUM_TARGETS]);
+  // copy the latest accumulation of the current scene into m_parking
+  void parkAccumulation();
+  // copy the parked accumulation of the current scene back into the latest accumulation buffer, if it fits.
+  // Returns its iteration count, or 0 if the image has to start over.
+  int resumeAccumulation();
+  void freeParkedAccumulation(ParkedAccumulation& parked);
+
   ImageGpu m_imgGpu;
+  // the channel count that precomputed gradients did not fit for; not tried again until the volume texture changes
+  int m_gradientsFailedChannels = 0;
 
   RectImage2D* m_imagequad;
 
@@ -66,22 +136,56 @@ private:
 
   FSQ* m_fsq;
 
-  // the rgbaf32 buffer for rendering
-  Framebuffer* m_fbF32;
-  GLPTVolumeShader* m_renderBufferShader;
-
-  // the rgbaf32 accumulation buffer that holds the progressively rendered image
-  Framebuffer* m_fbF32Accum;
-  GLCopyShader* m_copyShader;
+  // float accumulation buffers that hold the progressively rendered image.
+  // Each iteration reads one and renders into the other, then they swap roles.
+  Framebuffer* m_fbAccum[2];
+  // index of the buffer holding the latest accumulated image
+  int m_accumIndex;
+  // GL_RGBA32F or GL_RGBA16F
+  GLenum m_accumFormat;
+  // 1 at full resolution, n when the last frame was path traced at 1/n resolution while the camera moved
+  int m_renderScale;
+  // path trace shader variants and the uniform buffers they share
+  GLPTVolumeShaderCache* m_renderBufferShaders;
+  GLPTVolumeUniforms* m_renderUniforms;
   GLToneMapShader* m_toneMapShader;
 
+  void initAccumulationBuffers(uint32_t w, uint32_t h, GLenum format);
+  void cleanUpAccumulationBuffers();
+
   BoundingBoxDrawable* m_boundingBoxDrawable;
 
+  // second render target of the accumulation buffers when the volume is bricked,
+  // and its downsampled copy for cpu readback
+  GLuint m_brickFeedbackTexture;
+  Framebuffer* m_brickFeedbackFb;
+  // whether the last frame made new bricks resident
+  bool m_bricksPagedIn;
+
+  // RG16F, transmittance toward light 0 and light 1 over a low resolution grid of the volume
+  GLuint m_transmittanceTexture;
+  GLuint m_transmittanceFbo;
+  uint32_t m_transmittanceSize[3];
+
+  // ping-pong like m_fbAccum; m_momentsTexture[i] is attached to m_fbAccum[i]
+  GLuint m_momentsTexture[2];
+  // downsampled copy of the moments for cpu readback
+  Framebuffer* m_convergenceFb;
+
+  // ping-pong like m_fbAccum; m_historyTexture[i] is attached to m_fbAccum[i]
+  GLuint m_historyTexture[2];
+
+  // normals and hit count, albedo and depth. See AtrousFilter.h
+  GLuint m_denoiseFeatureTexture[2];
+  Framebuffer* m_fbDenoise[2];
+  GLDenoiseShader* m_denoiseShader;
+
   // screen size auxiliary buffers for rendering
   unsigned int* m_randomSeeds1;
   unsigned int* m_randomSeeds2;
   // incrementing integer to give to shader
   int m_RandSeed;
+  int m_fixedRandSeed;
 
   int m_w, m_h;
   float m_devicePixelRatio;
@@ -90,4 +194,7 @@ private:
   std::shared_ptr<CStatus> m_status;
 
   size_t m_gpuBytes;
+
+  // images of the scenes that swapScene swapped out
+  AccumulationParking m_parking;
 };
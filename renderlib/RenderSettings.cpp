@@ -5,6 +5,7 @@ RenderSettings::RenderSettings(void)
   : m_DirtyFlags()
   , m_DenoiseParams()
   , m_NoIterations(0)
+  , m_Convergence(0.0f)
 {}
 
 RenderSettings::RenderSettings(const RenderSettings& Other)
@@ -18,6 +19,7 @@ RenderSettings::operator=(const RenderSettings& Other)
   m_DirtyFlags = Other.m_DirtyFlags;
   m_DenoiseParams = Other.m_DenoiseParams;
   m_NoIterations = Other.m_NoIterations;
+  m_Convergence = Other.m_Convergence;
   m_RenderSettings = Other.m_RenderSettings;
 
   return *this;
@@ -16,7 +16,11 @@ public:
 
   int GetNoIterations(void) const { return m_NoIterations; }
   void SetNoIterations(const int& NoIterations) { m_NoIterations = NoIterations; }
+  // fraction of pixels that reached PathTraceRenderSettings::m_ErrorTarget, as last measured by the renderer
+  float GetConvergence(void) const { return m_Convergence; }
+  void SetConvergence(const float& Convergence) { m_Convergence = Convergence; }
 
 private:
   int m_NoIterations;
+  float m_Convergence;
 };
@@ -0,0 +1,49 @@
+#include "TiledRender.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+std::vector<ImageTile>
+makeImageTiles(uint32_t w, uint32_t h, uint32_t tileSize)
+{
+  std::vector<ImageTile> tiles;
+  if (tileSize == 0) {
+    return tiles;
+  }
+  for (uint32_t y = 0; y < h; y += tileSize) {
+    for (uint32_t x = 0; x < w; x += tileSize) {
+      tiles.push_back({ x, y, std::min(tileSize, w - x), std::min(tileSize, h - y) });
+    }
+  }
+  return tiles;
+}
+
+void
+tileScreenWindow(const float screen[2][2],
+                 const float invScreen[2],
+                 const ImageTile& tile,
+                 uint32_t tileW,
+                 uint32_t tileH,
+                 float tileScreen[2][2])
+{
+  tileScreen[0][0] = screen[0][0] + invScreen[0] * (float)tile.m_x;
+  tileScreen[0][1] = tileScreen[0][0] + invScreen[0] * (float)tileW;
+  tileScreen[1][0] = screen[1][0] + invScreen[1] * (float)tile.m_y;
+  tileScreen[1][1] = tileScreen[1][0] + invScreen[1] * (float)tileH;
+}
+
+void
+copyTileToImage(const uint8_t* tilePixels,
+                uint32_t tileStride,
+                const ImageTile& tile,
+                uint32_t bytesPerPixel,
+                uint8_t* image,
+                uint32_t imageWidth)
+{
+  for (uint32_t row = 0; row < tile.m_h; ++row) {
+    const size_t src = (size_t)row * tileStride * bytesPerPixel;
+    const size_t dst = ((size_t)(tile.m_y + row) * imageWidth + tile.m_x) * bytesPerPixel;
+    memcpy(image + dst, tilePixels + src, (size_t)tile.m_w * bytesPerPixel);
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <inttypes.h>
+#include <vector>
+
+// Rendering an image in tiles bounds the gpu memory to what one tile needs, for output resolutions whose full size
+// buffers would not fit.
+struct ImageTile
+{
+  uint32_t m_x, m_y;
+  uint32_t m_w, m_h;
+};
+
+// Split a w x h image into tiles of at most tileSize x tileSize pixels, row by row from pixel (0, 0).
+std::vector<ImageTile>
+makeImageTiles(uint32_t w, uint32_t h, uint32_t tileSize);
+
+// The screen window for rendering a tile with a tileW x tileH render target, in the layout of Film::m_Screen:
+// [0] = left, right, [1] = the y of pixel row 0 and of row h. invScreen is the per pixel step of the whole image,
+// which the tile keeps, so that pixel (i, j) of the tile sees what pixel (tile.m_x + i, tile.m_y + j) of the whole
+// image sees. Render targets larger than the tile cover pixels past its edge, which are cropped.
+void
+tileScreenWindow(const float screen[2][2],
+                 const float invScreen[2],
+                 const ImageTile& tile,
+                 uint32_t tileW,
+                 uint32_t tileH,
+                 float tileScreen[2][2]);
+
+// Copy the tile's pixels out of a render target of tileStride pixels per row into the whole image.
+void
+copyTileToImage(const uint8_t* tilePixels,
+                uint32_t tileStride,
+                const ImageTile& tile,
+                uint32_t bytesPerPixel,
+                uint8_t* image,
+                uint32_t imageWidth);
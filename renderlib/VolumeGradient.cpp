@@ -0,0 +1,49 @@
+#include "VolumeGradient.h"
+
+#include "threading.h"
+
+#include <cmath>
+#include <cstddef>
+
+void
+computeGradientVolume(const uint16_t* data,
+                      const uint32_t size[3],
+                      const float spacing[3],
+                      const uint32_t boxMin[3],
+                      const uint32_t boxMax[3],
+                      float* out)
+{
+  const size_t bx = boxMax[0] - boxMin[0], by = boxMax[1] - boxMin[1], bz = boxMax[2] - boxMin[2];
+  const size_t stride[3] = { 1, (size_t)size[0], (size_t)size[0] * (size_t)size[1] };
+  const float scale = 1.0f / 65535.0f;
+
+  parallel_for(bz, [&](size_t s, size_t e) {
+    for (size_t z = s; z < e; ++z) {
+      for (size_t y = 0; y < by; ++y) {
+        float* dest = out + 4 * bx * (y + by * z);
+        for (size_t x = 0; x < bx; ++x, dest += 4) {
+          const uint32_t p[3] = { (uint32_t)(boxMin[0] + x), (uint32_t)(boxMin[1] + y), (uint32_t)(boxMin[2] + z) };
+          const uint16_t* center = data + p[0] + stride[1] * p[1] + stride[2] * p[2];
+          float g[3];
+          for (int i = 0; i < 3; ++i) {
+            const uint32_t lo = (p[i] > 0) ? 1 : 0;
+            const uint32_t hi = (p[i] + 1 < size[i]) ? 1 : 0;
+            if (lo + hi == 0) {
+              g[i] = 0.0f;
+              continue;
+            }
+            // the shader differences across one voxel on either side: twice the derivative per voxel
+            const float d = (float)center[hi * stride[i]] - (float)center[-(ptrdiff_t)(lo * stride[i])];
+            g[i] = d * scale * 2.0f / ((float)(lo + hi) * spacing[i]);
+          }
+          const float mag = std::sqrt(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+          const float inv = (mag > 0.0f) ? 1.0f / mag : 0.0f;
+          dest[0] = g[0] * inv;
+          dest[1] = g[1] * inv;
+          dest[2] = g[2] * inv;
+          dest[3] = mag;
+        }
+      }
+    }
+  });
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <inttypes.h>
+
+// Central difference gradients of one channel of a volume, for shading with a precomputed gradient texture.
+// The box [boxMin, boxMax) selects the voxels to compute; neighbors outside the box are still read from the
+// volume, and one sided differences are used at the volume faces.
+// spacing is the size of one voxel along each axis in normalized world space (largest volume extent = 1).
+// out receives 4 floats per voxel of the box, x fastest: the unit gradient direction and the gradient magnitude,
+// in intensity (0..1 over the uint16 range) per voxel spacing, the same scale as the shader's own finite differences.
+void
+computeGradientVolume(const uint16_t* data,
+                      const uint32_t size[3],
+                      const float spacing[3],
+                      const uint32_t boxMin[3],
+                      const uint32_t boxMax[3],
+                      float* out);
@@ -2,6 +2,7 @@
 
 #include "AppScene.h"
 #include "CCamera.h"
+#include "CommandStream.h"
 #include "FileReader.h"
 #include "ImageXYZC.h"
 #include "Logging.h"
@@ -10,6 +11,7 @@
 
 #include "json/json.hpp"
 
+#include <algorithm>
 #include <errno.h>
 #include <sys/stat.h>
 
@@ -179,6 +181,7 @@ SetDiffuseColorCommand::execute(ExecutionContext* c)
   c->m_appScene->m_material.m_diffuse[m_data.m_channel * 3 + 1] = m_data.m_g;
   c->m_appScene->m_material.m_diffuse[m_data.m_channel * 3 + 2] = m_data.m_b;
   c->m_renderSettings->SetNoIterations(0);
+  c->m_renderSettings->m_DirtyFlags.SetFlag(RenderParamsDirty);
 }
 void
 SetSpecularColorCommand::execute(ExecutionContext* c)
@@ -188,6 +191,7 @@ SetSpecularColorCommand::execute(ExecutionContext* c)
   c->m_appScene->m_material.m_specular[m_data.m_channel * 3 + 1] = m_data.m_g;
   c->m_appScene->m_material.m_specular[m_data.m_channel * 3 + 2] = m_data.m_b;
   c->m_renderSettings->SetNoIterations(0);
+  c->m_renderSettings->m_DirtyFlags.SetFlag(RenderParamsDirty);
 }
 void
 SetEmissiveColorCommand::execute(ExecutionContext* c)
@@ -197,6 +201,7 @@ SetEmissiveColorCommand::execute(ExecutionContext* c)
   c->m_appScene->m_material.m_emissive[m_data.m_channel * 3 + 1] = m_data.m_g;
   c->m_appScene->m_material.m_emissive[m_data.m_channel * 3 + 2] = m_data.m_b;
   c->m_renderSettings->SetNoIterations(0);
+  c->m_renderSettings->m_DirtyFlags.SetFlag(RenderParamsDirty);
 }
 void
 SetRenderIterationsCommand::execute(ExecutionContext* c)
@@ -235,6 +240,7 @@ SetDensityCommand::execute(ExecutionContext* c)
   LOG_DEBUG << "SetDensity " << m_data.m_x;
   c->m_renderSettings->m_RenderSettings.m_DensityScale = m_data.m_x;
   c->m_renderSettings->SetNoIterations(0);
+  c->m_renderSettings->m_DirtyFlags.SetFlag(RenderParamsDirty);
 }
 
 void
@@ -398,6 +404,7 @@ SetOpacityCommand::execute(ExecutionContext* c)
   LOG_DEBUG << "SetOpacity " << m_data.m_channel << " " << m_data.m_opacity;
   c->m_appScene->m_material.m_opacity[m_data.m_channel] = m_data.m_opacity;
   c->m_renderSettings->SetNoIterations(0);
+  c->m_renderSettings->m_DirtyFlags.SetFlag(RenderParamsDirty);
 }
 void
 SetPrimaryRayStepSizeCommand::execute(ExecutionContext* c)
@@ -611,19 +618,142 @@ TrackballCameraCommand::execute(ExecutionContext* c)
   c->m_renderSettings->m_DirtyFlags.SetFlag(CameraDirty);
 }
 
+void
+SetVolumeCropCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "SetVolumeCrop " << m_data.m_on;
+  c->m_renderSettings->m_RenderSettings.m_CropVolumeToRoi = (m_data.m_on != 0);
+  c->m_renderSettings->m_DirtyFlags.SetFlag(RoiDirty);
+}
+
+void
+SetErrorTargetCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "SetErrorTarget " << m_data.m_target;
+  float target = std::max(m_data.m_target, 0.0f);
+  if (target != c->m_renderSettings->m_RenderSettings.m_ErrorTarget) {
+    c->m_renderSettings->m_RenderSettings.m_ErrorTarget = target;
+    // pixels that already stopped have to be measured against the new target
+    c->m_renderSettings->m_DirtyFlags.SetFlag(RenderParamsDirty);
+  }
+
+  // report how far the current image is
+  nlohmann::json j;
+  j["commandId"] = (int)SetErrorTargetCommand::m_ID;
+  j["iterations"] = c->m_renderSettings->GetNoIterations();
+  j["convergence"] = c->m_renderSettings->GetConvergence();
+  c->m_message = j.dump();
+}
+
+void
+SetInteractiveDownsampleCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "SetInteractiveDownsample " << m_data.m_factor;
+  // the current frame is unaffected; the next camera change picks this up
+  c->m_renderSettings->m_RenderSettings.m_InteractiveDownsample = std::max(m_data.m_factor, 1);
+}
+
+void
+SetTemporalReprojectionCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "SetTemporalReprojection " << m_data.m_enabled;
+  c->m_renderSettings->m_RenderSettings.m_TemporalReprojection = (m_data.m_enabled != 0);
+  c->m_renderSettings->m_DirtyFlags.SetFlag(RenderParamsDirty);
+}
+
+void
+SetDenoiseCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "SetDenoise " << m_data.m_enabled;
+  c->m_renderSettings->m_DenoiseParams.m_Enabled = (m_data.m_enabled != 0);
+  c->m_renderSettings->m_DirtyFlags.SetFlag(RenderParamsDirty);
+}
+
+void
+SetHalfFloatAccumulationCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "SetHalfFloatAccumulation " << m_data.m_enabled;
+  // the renderer reallocates its accumulation buffers, and restarts the image, when the format changes
+  c->m_renderSettings->m_RenderSettings.m_HalfFloatAccumulation = (m_data.m_enabled != 0);
+  c->m_renderSettings->m_DirtyFlags.SetFlag(RenderParamsDirty);
+}
+
+void
+SetGpuVolumeBudgetCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "SetGpuVolumeBudget " << m_data.m_megabytes;
+  const uint32_t megabytes = (uint32_t)std::max(m_data.m_megabytes, 0);
+  // the volume is uploaded again, whole or into a brick pool, so only do it for a new value
+  if (c->m_renderSettings->m_RenderSettings.m_GpuVolumeBudgetMB != megabytes) {
+    c->m_renderSettings->m_RenderSettings.m_GpuVolumeBudgetMB = megabytes;
+    c->m_renderSettings->m_DirtyFlags.SetFlag(VolumeDirty);
+  }
+}
+
+void
+SetTiledRenderingCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "SetTiledRendering " << m_data.m_tileSize << " " << m_data.m_samples;
+  if (c->m_renderer) {
+    c->m_renderer->setTiledRendering(std::max(m_data.m_tileSize, 0), std::max(m_data.m_samples, 1));
+  }
+}
+
+void
+SetStreamCodecCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "SetStreamCodec " << m_data.m_codec << " " << m_data.m_quality;
+  if (c->m_renderer) {
+    c->m_renderer->setStreamCodec(m_data.m_codec, m_data.m_quality);
+  }
+}
+
+void
+SetFrameDiffCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "SetFrameDiff " << m_data.m_enabled << " " << m_data.m_threshold;
+  if (c->m_renderer) {
+    c->m_renderer->setFrameDiff(m_data.m_enabled != 0, m_data.m_threshold);
+  }
+}
+
+void
+SetStreamPacingCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "SetStreamPacing " << m_data.m_fps << " " << m_data.m_latency;
+  if (c->m_renderer) {
+    c->m_renderer->setStreamPacing(m_data.m_fps, m_data.m_latency);
+  }
+}
+
+void
+BatchRenderCommand::execute(ExecutionContext* c)
+{
+  LOG_DEBUG << "BatchRender " << m_data.m_path << " " << m_data.m_frames << " frames, " << m_data.m_iterations
+            << " iterations to " << m_data.m_outputDirectory;
+  if (c->m_renderer) {
+    c->m_renderer->batchRender(m_data.m_path,
+                               m_data.m_frames,
+                               m_data.m_iterations,
+                               m_data.m_angle,
+                               m_data.m_keyframes,
+                               m_data.m_outputDirectory);
+  }
+}
+
 SessionCommand*
 SessionCommand::parse(ParseableStream* c)
 {
   SessionCommandD data;
   data.m_name = c->parseString();
-  return new SessionCommand(data);
+  return c->commandList().add<SessionCommand>(std::move(data));
 }
 AssetPathCommand*
 AssetPathCommand::parse(ParseableStream* c)
 {
   AssetPathCommandD data;
   data.m_name = c->parseString();
-  return new AssetPathCommand(data);
+  return c->commandList().add<AssetPathCommand>(std::move(data));
 }
 LoadOmeTifCommand*
 LoadOmeTifCommand::parse(ParseableStream* c)
@@ -631,7 +761,7 @@ LoadOmeTifCommand::parse(ParseableStream* c)
   LOG_WARNING << "LoadOmeTif command is deprecated. Prefer LoadVolumeFromFile command.";
   LoadOmeTifCommandD data;
   data.m_name = c->parseString();
-  return new LoadOmeTifCommand(data);
+  return c->commandList().add<LoadOmeTifCommand>(std::move(data));
 }
 SetCameraPosCommand*
 SetCameraPosCommand::parse(ParseableStream* c)
@@ -640,7 +770,7 @@ SetCameraPosCommand::parse(ParseableStream* c)
   data.m_x = c->parseFloat32();
   data.m_y = c->parseFloat32();
   data.m_z = c->parseFloat32();
-  return new SetCameraPosCommand(data);
+  return c->commandList().add<SetCameraPosCommand>(std::move(data));
 }
 SetCameraUpCommand*
 SetCameraUpCommand::parse(ParseableStream* c)
@@ -649,7 +779,7 @@ SetCameraUpCommand::parse(ParseableStream* c)
   data.m_x = c->parseFloat32();
   data.m_y = c->parseFloat32();
   data.m_z = c->parseFloat32();
-  return new SetCameraUpCommand(data);
+  return c->commandList().add<SetCameraUpCommand>(std::move(data));
 }
 SetCameraTargetCommand*
 SetCameraTargetCommand::parse(ParseableStream* c)
@@ -658,14 +788,14 @@ SetCameraTargetCommand::parse(ParseableStream* c)
   data.m_x = c->parseFloat32();
   data.m_y = c->parseFloat32();
   data.m_z = c->parseFloat32();
-  return new SetCameraTargetCommand(data);
+  return c->commandList().add<SetCameraTargetCommand>(std::move(data));
 }
 SetCameraApertureCommand*
 SetCameraApertureCommand::parse(ParseableStream* c)
 {
   SetCameraApertureCommandD data;
   data.m_x = c->parseFloat32();
-  return new SetCameraApertureCommand(data);
+  return c->commandList().add<SetCameraApertureCommand>(std::move(data));
 }
 SetCameraProjectionCommand*
 SetCameraProjectionCommand::parse(ParseableStream* c)
@@ -673,21 +803,21 @@ SetCameraProjectionCommand::parse(ParseableStream* c)
   SetCameraProjectionCommandD data;
   data.m_projectionType = c->parseInt32();
   data.m_x = c->parseFloat32();
-  return new SetCameraProjectionCommand(data);
+  return c->commandList().add<SetCameraProjectionCommand>(std::move(data));
 }
 SetCameraFocalDistanceCommand*
 SetCameraFocalDistanceCommand::parse(ParseableStream* c)
 {
   SetCameraFocalDistanceCommandD data;
   data.m_x = c->parseFloat32();
-  return new SetCameraFocalDistanceCommand(data);
+  return c->commandList().add<SetCameraFocalDistanceCommand>(std::move(data));
 }
 SetCameraExposureCommand*
 SetCameraExposureCommand::parse(ParseableStream* c)
 {
   SetCameraExposureCommandD data;
   data.m_x = c->parseFloat32();
-  return new SetCameraExposureCommand(data);
+  return c->commandList().add<SetCameraExposureCommand>(std::move(data));
 }
 SetDiffuseColorCommand*
 SetDiffuseColorCommand::parse(ParseableStream* c)
@@ -698,7 +828,7 @@ SetDiffuseColorCommand::parse(ParseableStream* c)
   data.m_g = c->parseFloat32();
   data.m_b = c->parseFloat32();
   data.m_a = c->parseFloat32();
-  return new SetDiffuseColorCommand(data);
+  return c->commandList().add<SetDiffuseColorCommand>(std::move(data));
 }
 SetSpecularColorCommand*
 SetSpecularColorCommand::parse(ParseableStream* c)
@@ -709,7 +839,7 @@ SetSpecularColorCommand::parse(ParseableStream* c)
   data.m_g = c->parseFloat32();
   data.m_b = c->parseFloat32();
   data.m_a = c->parseFloat32();
-  return new SetSpecularColorCommand(data);
+  return c->commandList().add<SetSpecularColorCommand>(std::move(data));
 }
 SetEmissiveColorCommand*
 SetEmissiveColorCommand::parse(ParseableStream* c)
@@ -720,27 +850,27 @@ SetEmissiveColorCommand::parse(ParseableStream* c)
   data.m_g = c->parseFloat32();
   data.m_b = c->parseFloat32();
   data.m_a = c->parseFloat32();
-  return new SetEmissiveColorCommand(data);
+  return c->commandList().add<SetEmissiveColorCommand>(std::move(data));
 }
 SetRenderIterationsCommand*
 SetRenderIterationsCommand::parse(ParseableStream* c)
 {
   SetRenderIterationsCommandD data;
   data.m_x = c->parseInt32();
-  return new SetRenderIterationsCommand(data);
+  return c->commandList().add<SetRenderIterationsCommand>(std::move(data));
 }
 SetStreamModeCommand*
 SetStreamModeCommand::parse(ParseableStream* c)
 {
   SetStreamModeCommandD data;
   data.m_x = c->parseInt32();
-  return new SetStreamModeCommand(data);
+  return c->commandList().add<SetStreamModeCommand>(std::move(data));
 }
 RequestRedrawCommand*
 RequestRedrawCommand::parse(ParseableStream* c)
 {
   RequestRedrawCommandD data;
-  return new RequestRedrawCommand(data);
+  return c->commandList().add<RequestRedrawCommand>(std::move(data));
 }
 SetResolutionCommand*
 SetResolutionCommand::parse(ParseableStream* c)
@@ -748,20 +878,20 @@ SetResolutionCommand::parse(ParseableStream* c)
   SetResolutionCommandD data;
   data.m_x = c->parseInt32();
   data.m_y = c->parseInt32();
-  return new SetResolutionCommand(data);
+  return c->commandList().add<SetResolutionCommand>(std::move(data));
 }
 SetDensityCommand*
 SetDensityCommand::parse(ParseableStream* c)
 {
   SetDensityCommandD data;
   data.m_x = c->parseFloat32();
-  return new SetDensityCommand(data);
+  return c->commandList().add<SetDensityCommand>(std::move(data));
 }
 FrameSceneCommand*
 FrameSceneCommand::parse(ParseableStream* c)
 {
   FrameSceneCommandD data;
-  return new FrameSceneCommand(data);
+  return c->commandList().add<FrameSceneCommand>(std::move(data));
 }
 SetGlossinessCommand*
 SetGlossinessCommand::parse(ParseableStream* c)
@@ -769,7 +899,7 @@ SetGlossinessCommand::parse(ParseableStream* c)
   SetGlossinessCommandD data;
   data.m_channel = c->parseInt32();
   data.m_glossiness = c->parseFloat32();
-  return new SetGlossinessCommand(data);
+  return c->commandList().add<SetGlossinessCommand>(std::move(data));
 }
 EnableChannelCommand*
 EnableChannelCommand::parse(ParseableStream* c)
@@ -777,7 +907,7 @@ EnableChannelCommand::parse(ParseableStream* c)
   EnableChannelCommandD data;
   data.m_channel = c->parseInt32();
   data.m_enabled = c->parseInt32();
-  return new EnableChannelCommand(data);
+  return c->commandList().add<EnableChannelCommand>(std::move(data));
 }
 SetWindowLevelCommand*
 SetWindowLevelCommand::parse(ParseableStream* c)
@@ -786,7 +916,7 @@ SetWindowLevelCommand::parse(ParseableStream* c)
   data.m_channel = c->parseInt32();
   data.m_window = c->parseFloat32();
   data.m_level = c->parseFloat32();
-  return new SetWindowLevelCommand(data);
+  return c->commandList().add<SetWindowLevelCommand>(std::move(data));
 }
 OrbitCameraCommand*
 OrbitCameraCommand::parse(ParseableStream* c)
@@ -794,7 +924,7 @@ OrbitCameraCommand::parse(ParseableStream* c)
   OrbitCameraCommandD data;
   data.m_theta = c->parseFloat32();
   data.m_phi = c->parseFloat32();
-  return new OrbitCameraCommand(data);
+  return c->commandList().add<OrbitCameraCommand>(std::move(data));
 }
 SetSkylightTopColorCommand*
 SetSkylightTopColorCommand::parse(ParseableStream* c)
@@ -803,7 +933,7 @@ SetSkylightTopColorCommand::parse(ParseableStream* c)
   data.m_r = c->parseFloat32();
   data.m_g = c->parseFloat32();
   data.m_b = c->parseFloat32();
-  return new SetSkylightTopColorCommand(data);
+  return c->commandList().add<SetSkylightTopColorCommand>(std::move(data));
 }
 SetSkylightMiddleColorCommand*
 SetSkylightMiddleColorCommand::parse(ParseableStream* c)
@@ -812,7 +942,7 @@ SetSkylightMiddleColorCommand::parse(ParseableStream* c)
   data.m_r = c->parseFloat32();
   data.m_g = c->parseFloat32();
   data.m_b = c->parseFloat32();
-  return new SetSkylightMiddleColorCommand(data);
+  return c->commandList().add<SetSkylightMiddleColorCommand>(std::move(data));
 }
 SetSkylightBottomColorCommand*
 SetSkylightBottomColorCommand::parse(ParseableStream* c)
@@ -821,7 +951,7 @@ SetSkylightBottomColorCommand::parse(ParseableStream* c)
   data.m_r = c->parseFloat32();
   data.m_g = c->parseFloat32();
   data.m_b = c->parseFloat32();
-  return new SetSkylightBottomColorCommand(data);
+  return c->commandList().add<SetSkylightBottomColorCommand>(std::move(data));
 }
 
 SetLightPosCommand*
@@ -832,7 +962,7 @@ SetLightPosCommand::parse(ParseableStream* c)
   data.m_r = c->parseFloat32();
   data.m_theta = c->parseFloat32();
   data.m_phi = c->parseFloat32();
-  return new SetLightPosCommand(data);
+  return c->commandList().add<SetLightPosCommand>(std::move(data));
 }
 SetLightColorCommand*
 SetLightColorCommand::parse(ParseableStream* c)
@@ -842,7 +972,7 @@ SetLightColorCommand::parse(ParseableStream* c)
   data.m_r = c->parseFloat32();
   data.m_g = c->parseFloat32();
   data.m_b = c->parseFloat32();
-  return new SetLightColorCommand(data);
+  return c->commandList().add<SetLightColorCommand>(std::move(data));
 }
 SetLightSizeCommand*
 SetLightSizeCommand::parse(ParseableStream* c)
@@ -851,7 +981,7 @@ SetLightSizeCommand::parse(ParseableStream* c)
   data.m_index = c->parseInt32();
   data.m_x = c->parseFloat32();
   data.m_y = c->parseFloat32();
-  return new SetLightSizeCommand(data);
+  return c->commandList().add<SetLightSizeCommand>(std::move(data));
 }
 
 float
@@ -876,7 +1006,7 @@ SetClipRegionCommand::parse(ParseableStream* c)
   data.m_minz = clamp(data.m_minz, 0.0, 1.0);
   data.m_maxz = c->parseFloat32();
   data.m_maxz = clamp(data.m_maxz, 0.0, 1.0);
-  return new SetClipRegionCommand(data);
+  return c->commandList().add<SetClipRegionCommand>(std::move(data));
 }
 
 SetVoxelScaleCommand*
@@ -886,7 +1016,7 @@ SetVoxelScaleCommand::parse(ParseableStream* c)
   data.m_x = c->parseFloat32();
   data.m_y = c->parseFloat32();
   data.m_z = c->parseFloat32();
-  return new SetVoxelScaleCommand(data);
+  return c->commandList().add<SetVoxelScaleCommand>(std::move(data));
 }
 AutoThresholdCommand*
 AutoThresholdCommand::parse(ParseableStream* c)
@@ -894,7 +1024,7 @@ AutoThresholdCommand::parse(ParseableStream* c)
   AutoThresholdCommandD data;
   data.m_channel = c->parseInt32();
   data.m_method = c->parseInt32();
-  return new AutoThresholdCommand(data);
+  return c->commandList().add<AutoThresholdCommand>(std::move(data));
 }
 SetPercentileThresholdCommand*
 SetPercentileThresholdCommand::parse(ParseableStream* c)
@@ -903,7 +1033,7 @@ SetPercentileThresholdCommand::parse(ParseableStream* c)
   data.m_channel = c->parseInt32();
   data.m_pctLow = c->parseFloat32();
   data.m_pctHigh = c->parseFloat32();
-  return new SetPercentileThresholdCommand(data);
+  return c->commandList().add<SetPercentileThresholdCommand>(std::move(data));
 }
 SetOpacityCommand*
 SetOpacityCommand::parse(ParseableStream* c)
@@ -911,21 +1041,21 @@ SetOpacityCommand::parse(ParseableStream* c)
   SetOpacityCommandD data;
   data.m_channel = c->parseInt32();
   data.m_opacity = c->parseFloat32();
-  return new SetOpacityCommand(data);
+  return c->commandList().add<SetOpacityCommand>(std::move(data));
 }
 SetPrimaryRayStepSizeCommand*
 SetPrimaryRayStepSizeCommand::parse(ParseableStream* c)
 {
   SetPrimaryRayStepSizeCommandD data;
   data.m_stepSize = c->parseFloat32();
-  return new SetPrimaryRayStepSizeCommand(data);
+  return c->commandList().add<SetPrimaryRayStepSizeCommand>(std::move(data));
 }
 SetSecondaryRayStepSizeCommand*
 SetSecondaryRayStepSizeCommand::parse(ParseableStream* c)
 {
   SetSecondaryRayStepSizeCommandD data;
   data.m_stepSize = c->parseFloat32();
-  return new SetSecondaryRayStepSizeCommand(data);
+  return c->commandList().add<SetSecondaryRayStepSizeCommand>(std::move(data));
 }
 SetBackgroundColorCommand*
 SetBackgroundColorCommand::parse(ParseableStream* c)
@@ -934,7 +1064,7 @@ SetBackgroundColorCommand::parse(ParseableStream* c)
   data.m_r = c->parseFloat32();
   data.m_g = c->parseFloat32();
   data.m_b = c->parseFloat32();
-  return new SetBackgroundColorCommand(data);
+  return c->commandList().add<SetBackgroundColorCommand>(std::move(data));
 }
 SetIsovalueThresholdCommand*
 SetIsovalueThresholdCommand::parse(ParseableStream* c)
@@ -943,7 +1073,7 @@ SetIsovalueThresholdCommand::parse(ParseableStream* c)
   data.m_channel = c->parseInt32();
   data.m_isovalue = c->parseFloat32();
   data.m_isorange = c->parseFloat32();
-  return new SetIsovalueThresholdCommand(data);
+  return c->commandList().add<SetIsovalueThresholdCommand>(std::move(data));
 }
 SetControlPointsCommand*
 SetControlPointsCommand::parse(ParseableStream* c)
@@ -951,7 +1081,7 @@ SetControlPointsCommand::parse(ParseableStream* c)
   SetControlPointsCommandD data;
   data.m_channel = c->parseInt32();
   data.m_data = c->parseFloat32Array();
-  return new SetControlPointsCommand(data);
+  return c->commandList().add<SetControlPointsCommand>(std::move(data));
 }
 
 LoadVolumeFromFileCommand*
@@ -961,7 +1091,7 @@ LoadVolumeFromFileCommand::parse(ParseableStream* c)
   data.m_path = c->parseString();
   data.m_scene = c->parseInt32();
   data.m_time = c->parseInt32();
-  return new LoadVolumeFromFileCommand(data);
+  return c->commandList().add<LoadVolumeFromFileCommand>(std::move(data));
 }
 
 SetTimeCommand*
@@ -969,7 +1099,7 @@ SetTimeCommand::parse(ParseableStream* c)
 {
   SetTimeCommandD data;
   data.m_time = c->parseInt32();
-  return new SetTimeCommand(data);
+  return c->commandList().add<SetTimeCommand>(std::move(data));
 }
 SetBoundingBoxColorCommand*
 SetBoundingBoxColorCommand::parse(ParseableStream* c)
@@ -978,14 +1108,14 @@ SetBoundingBoxColorCommand::parse(ParseableStream* c)
   data.m_r = c->parseFloat32();
   data.m_g = c->parseFloat32();
   data.m_b = c->parseFloat32();
-  return new SetBoundingBoxColorCommand(data);
+  return c->commandList().add<SetBoundingBoxColorCommand>(std::move(data));
 }
 ShowBoundingBoxCommand*
 ShowBoundingBoxCommand::parse(ParseableStream* c)
 {
   ShowBoundingBoxCommandD data;
   data.m_on = c->parseInt32();
-  return new ShowBoundingBoxCommand(data);
+  return c->commandList().add<ShowBoundingBoxCommand>(std::move(data));
 }
 TrackballCameraCommand*
 TrackballCameraCommand::parse(ParseableStream* c)
@@ -993,7 +1123,112 @@ TrackballCameraCommand::parse(ParseableStream* c)
   TrackballCameraCommandD data;
   data.m_theta = c->parseFloat32();
   data.m_phi = c->parseFloat32();
-  return new TrackballCameraCommand(data);
+  return c->commandList().add<TrackballCameraCommand>(std::move(data));
+}
+
+SetVolumeCropCommand*
+SetVolumeCropCommand::parse(ParseableStream* c)
+{
+  SetVolumeCropCommandD data;
+  data.m_on = c->parseInt32();
+  return c->commandList().add<SetVolumeCropCommand>(std::move(data));
+}
+
+SetErrorTargetCommand*
+SetErrorTargetCommand::parse(ParseableStream* c)
+{
+  SetErrorTargetCommandD data;
+  data.m_target = c->parseFloat32();
+  return c->commandList().add<SetErrorTargetCommand>(std::move(data));
+}
+
+SetInteractiveDownsampleCommand*
+SetInteractiveDownsampleCommand::parse(ParseableStream* c)
+{
+  SetInteractiveDownsampleCommandD data;
+  data.m_factor = c->parseInt32();
+  return c->commandList().add<SetInteractiveDownsampleCommand>(std::move(data));
+}
+
+SetTemporalReprojectionCommand*
+SetTemporalReprojectionCommand::parse(ParseableStream* c)
+{
+  SetTemporalReprojectionCommandD data;
+  data.m_enabled = c->parseInt32();
+  return c->commandList().add<SetTemporalReprojectionCommand>(std::move(data));
+}
+
+SetDenoiseCommand*
+SetDenoiseCommand::parse(ParseableStream* c)
+{
+  SetDenoiseCommandD data;
+  data.m_enabled = c->parseInt32();
+  return c->commandList().add<SetDenoiseCommand>(std::move(data));
+}
+
+SetTiledRenderingCommand*
+SetTiledRenderingCommand::parse(ParseableStream* c)
+{
+  SetTiledRenderingCommandD data;
+  data.m_tileSize = c->parseInt32();
+  data.m_samples = c->parseInt32();
+  return c->commandList().add<SetTiledRenderingCommand>(std::move(data));
+}
+
+SetStreamCodecCommand*
+SetStreamCodecCommand::parse(ParseableStream* c)
+{
+  SetStreamCodecCommandD data;
+  data.m_codec = c->parseString();
+  data.m_quality = c->parseInt32();
+  return c->commandList().add<SetStreamCodecCommand>(std::move(data));
+}
+
+SetFrameDiffCommand*
+SetFrameDiffCommand::parse(ParseableStream* c)
+{
+  SetFrameDiffCommandD data;
+  data.m_enabled = c->parseInt32();
+  data.m_threshold = c->parseFloat32();
+  return c->commandList().add<SetFrameDiffCommand>(std::move(data));
+}
+
+SetStreamPacingCommand*
+SetStreamPacingCommand::parse(ParseableStream* c)
+{
+  SetStreamPacingCommandD data;
+  data.m_fps = c->parseInt32();
+  data.m_latency = c->parseInt32();
+  return c->commandList().add<SetStreamPacingCommand>(std::move(data));
+}
+
+BatchRenderCommand*
+BatchRenderCommand::parse(ParseableStream* c)
+{
+  BatchRenderCommandD data;
+  data.m_path = c->parseInt32();
+  data.m_frames = c->parseInt32();
+  data.m_iterations = c->parseInt32();
+  data.m_angle = c->parseFloat32();
+  data.m_keyframes = c->parseFloat32Array();
+  data.m_outputDirectory = c->parseString();
+  return c->commandList().add<BatchRenderCommand>(std::move(data));
+}
+
+SetHalfFloatAccumulationCommand*
+SetHalfFloatAccumulationCommand::parse(ParseableStream* c)
+{
+  SetHalfFloatAccumulationCommandD data;
+  data.m_enabled = c->parseInt32();
+  return c->commandList().add<SetHalfFloatAccumulationCommand>(std::move(data));
+}
+
+SetGpuVolumeBudgetCommand*
+SetGpuVolumeBudgetCommand::parse(ParseableStream* c)
+{
+  SetGpuVolumeBudgetCommandD data;
+  data.m_megabytes = c->parseInt32();
+  return c->commandList().add<SetGpuVolumeBudgetCommand>(std::move(data));
 }
 
 std::string
@@ -1414,3 +1649,130 @@ TrackballCameraCommand::toPythonString() const
   ss << ")";
   return ss.str();
 }
+
+std::string
+SetVolumeCropCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << m_data.m_on;
+  ss << ")";
+  return ss.str();
+}
+
+std::string
+SetErrorTargetCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << m_data.m_target;
+  ss << ")";
+  return ss.str();
+}
+
+std::string
+SetInteractiveDownsampleCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << m_data.m_factor;
+  ss << ")";
+  return ss.str();
+}
+
+std::string
+SetTemporalReprojectionCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << m_data.m_enabled;
+  ss << ")";
+  return ss.str();
+}
+
+std::string
+SetDenoiseCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << m_data.m_enabled;
+  ss << ")";
+  return ss.str();
+}
+
+std::string
+SetTiledRenderingCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << m_data.m_tileSize << ", " << m_data.m_samples;
+  ss << ")";
+  return ss.str();
+}
+
+std::string
+SetStreamCodecCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << "\"" << m_data.m_codec << "\"" << ", " << m_data.m_quality;
+  ss << ")";
+  return ss.str();
+}
+
+std::string
+SetFrameDiffCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << m_data.m_enabled << ", " << m_data.m_threshold;
+  ss << ")";
+  return ss.str();
+}
+
+std::string
+SetStreamPacingCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << m_data.m_fps << ", " << m_data.m_latency;
+  ss << ")";
+  return ss.str();
+}
+
+std::string
+BatchRenderCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << m_data.m_path << ", " << m_data.m_frames << ", " << m_data.m_iterations << ", " << m_data.m_angle << ", [";
+  // insert comma delimited but no comma after the last entry
+  if (!m_data.m_keyframes.empty()) {
+    std::copy(
+      m_data.m_keyframes.begin(), std::prev(m_data.m_keyframes.end()), std::ostream_iterator<float>(ss, ", "));
+    ss << m_data.m_keyframes.back();
+  }
+  ss << "], \"" << m_data.m_outputDirectory << "\"";
+  ss << ")";
+  return ss.str();
+}
+
+std::string
+SetHalfFloatAccumulationCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << m_data.m_enabled;
+  ss << ")";
+  return ss.str();
+}
+
+std::string
+SetGpuVolumeBudgetCommand::toPythonString() const
+{
+  std::ostringstream ss;
+  ss << PythonName() << "(";
+  ss << m_data.m_megabytes;
+  ss << ")";
+  return ss.str();
+}
@@ -4,6 +4,7 @@
 #include <vector>
 
 class CCamera;
+class CommandList;
 class Renderer;
 class RenderSettings;
 class Scene;
@@ -12,7 +13,22 @@ class RendererCommandInterface
 {
 public:
   virtual void setStreamMode(int32_t mode) = 0;
+  // codec is one of "jpeg", "png", "webp", "raw"; quality 0-100 applies to the lossy ones
+  virtual void setStreamCodec(const std::string& codec, int32_t quality) = 0;
+  // threshold is the mean luma change, in 8 bit levels, below which a tile is not sent again
+  virtual void setFrameDiff(bool enabled, float threshold) = 0;
   virtual void resizeGL(int x, int y) = 0;
+  // tileSize 0 renders the whole image at once
+  virtual void setTiledRendering(int32_t tileSize, int32_t samples) = 0;
+  // fps 0 = no limit; latencyMs 0 = the default number of frames in flight
+  virtual void setStreamPacing(int32_t fps, int32_t latencyMs) = 0;
+  // render and save an animation, see BatchRenderCommand; path is a CameraPath
+  virtual void batchRender(int32_t path,
+                           int32_t frames,
+                           int32_t iterations,
+                           float angle,
+                           const std::vector<float>& keyframes,
+                           const std::string& outputDirectory) = 0;
 };
 
 class ParseableStream
@@ -22,6 +38,8 @@ public:
   virtual float parseFloat32() = 0;
   virtual std::vector<float> parseFloat32Array() = 0;
   virtual std::string parseString() = 0;
+  // where parsed commands are placed, see CommandStream.h
+  virtual CommandList& commandList() = 0;
 };
 
 enum class CommandArgType
@@ -429,3 +447,92 @@ struct TrackballCameraCommandD
   float m_phi;
 };
 CMDDECL(TrackballCameraCommand, 43, "trackball_camera", CMD_ARGS({ CommandArgType::F32, CommandArgType::F32 }));
+
+struct SetVolumeCropCommandD
+{
+  int32_t m_on;
+};
+CMDDECL(SetVolumeCropCommand, 44, "set_volume_crop", CMD_ARGS({ CommandArgType::I32 }));
+
+struct SetErrorTargetCommandD
+{
+  float m_target;
+};
+CMDDECL(SetErrorTargetCommand, 45, "set_error_target", CMD_ARGS({ CommandArgType::F32 }));
+
+struct SetInteractiveDownsampleCommandD
+{
+  int32_t m_factor;
+};
+CMDDECL(SetInteractiveDownsampleCommand, 46, "set_interactive_downsample", CMD_ARGS({ CommandArgType::I32 }));
+
+struct SetTemporalReprojectionCommandD
+{
+  int32_t m_enabled;
+};
+CMDDECL(SetTemporalReprojectionCommand, 47, "set_temporal_reprojection", CMD_ARGS({ CommandArgType::I32 }));
+
+struct SetDenoiseCommandD
+{
+  int32_t m_enabled;
+};
+CMDDECL(SetDenoiseCommand, 48, "set_denoise", CMD_ARGS({ CommandArgType::I32 }));
+
+struct SetTiledRenderingCommandD
+{
+  int32_t m_tileSize;
+  int32_t m_samples;
+};
+CMDDECL(SetTiledRenderingCommand, 49, "set_tiled_rendering", CMD_ARGS({ CommandArgType::I32, CommandArgType::I32 }));
+
+struct SetStreamCodecCommandD
+{
+  std::string m_codec;
+  int32_t m_quality;
+};
+CMDDECL(SetStreamCodecCommand, 50, "set_stream_codec", CMD_ARGS({ CommandArgType::STR, CommandArgType::I32 }));
+
+struct SetFrameDiffCommandD
+{
+  int32_t m_enabled;
+  float m_threshold;
+};
+CMDDECL(SetFrameDiffCommand, 51, "set_frame_diff", CMD_ARGS({ CommandArgType::I32, CommandArgType::F32 }));
+
+struct SetStreamPacingCommandD
+{
+  int32_t m_fps;
+  int32_t m_latency;
+};
+CMDDECL(SetStreamPacingCommand, 52, "set_stream_pacing", CMD_ARGS({ CommandArgType::I32, CommandArgType::I32 }));
+
+struct BatchRenderCommandD
+{
+  int32_t m_path;
+  int32_t m_frames;
+  int32_t m_iterations;
+  float m_angle;
+  std::vector<float> m_keyframes;
+  std::string m_outputDirectory;
+};
+CMDDECL(BatchRenderCommand,
+        53,
+        "batch_render",
+        CMD_ARGS({ CommandArgType::I32,
+                   CommandArgType::I32,
+                   CommandArgType::I32,
+                   CommandArgType::F32,
+                   CommandArgType::F32A,
+                   CommandArgType::STR }));
+
+struct SetHalfFloatAccumulationCommandD
+{
+  int32_t m_enabled;
+};
+CMDDECL(SetHalfFloatAccumulationCommand, 54, "set_half_float_accumulation", CMD_ARGS({ CommandArgType::I32 }));
+
+struct SetGpuVolumeBudgetCommandD
+{
+  int32_t m_megabytes;
+};
+CMDDECL(SetGpuVolumeBudgetCommand, 55, "set_gpu_volume_budget", CMD_ARGS({ CommandArgType::I32 }));
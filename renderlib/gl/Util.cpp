@@ -6,11 +6,26 @@
 
 #include "glm.h"
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <iostream>
 
 static bool GL_ERROR_CHECKS_ENABLED = true;
 
+size_t
+queryFreeVideoMemory()
+{
+  GLint kb[4] = { 0, 0, 0, 0 };
+  if (GLAD_GL_NVX_gpu_memory_info) {
+    glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, kb);
+  } else if (GLAD_GL_ATI_meminfo) {
+    // the first value is the total free in the texture pool
+    glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, kb);
+  }
+  return (size_t)std::max(kb[0], 0) * 1024;
+}
+
 bool
 check_glfb(std::string const& message)
 {
@@ -555,6 +570,127 @@ GLFramebufferObject::toImage(void* pixels)
   }
 }
 
+GLPixelReadback::GLPixelReadback(int numBuffers)
+  : m_buffers(std::max(numBuffers, 1), 0)
+  , m_fences(std::max(numBuffers, 1), nullptr)
+  , m_next(0)
+  , m_pending(0)
+  , m_flipped(nullptr)
+  , m_width(0)
+  , m_height(0)
+{
+  glGenBuffers((GLsizei)m_buffers.size(), m_buffers.data());
+}
+
+GLPixelReadback::~GLPixelReadback()
+{
+  clear();
+  delete m_flipped;
+  glDeleteBuffers((GLsizei)m_buffers.size(), m_buffers.data());
+}
+
+void
+GLPixelReadback::resize(int width, int height)
+{
+  clear();
+  delete m_flipped;
+  m_flipped = new GLFramebufferObject(width, height, GL_RGBA8);
+  m_width = width;
+  m_height = height;
+
+  const GLsizeiptr size = (GLsizeiptr)width * (GLsizeiptr)height * 4;
+  for (GLuint buffer : m_buffers) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void
+GLPixelReadback::start(GLFramebufferObject* fbo)
+{
+  if (fbo->width() != m_width || fbo->height() != m_height) {
+    resize(fbo->width(), fbo->height());
+  }
+  if (m_pending == (int)m_buffers.size()) {
+    release();
+  }
+
+  GLuint prevFbo = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, (GLint*)&prevFbo);
+
+  // the flip costs one blit on the gpu instead of a pass over the pixels on the cpu
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo->id());
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_flipped->id());
+  glBlitFramebuffer(0, 0, m_width, m_height, 0, m_height, m_width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_flipped->id());
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[m_next]);
+  // returns right away; the copy into the buffer happens when the gpu gets to it
+  glReadPixels(0, 0, m_width, m_height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  m_fences[m_next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
+
+  m_next = (m_next + 1) % (int)m_buffers.size();
+  m_pending++;
+}
+
+bool
+GLPixelReadback::finish(void* pixels, bool wait)
+{
+  if (m_pending == 0) {
+    return false;
+  }
+  const int slot = (m_next - m_pending + (int)m_buffers.size()) % (int)m_buffers.size();
+
+  GLenum status = glClientWaitSync(m_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  while (wait && status == GL_TIMEOUT_EXPIRED) {
+    // one second at a time
+    status = glClientWaitSync(m_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+  }
+  if (status == GL_TIMEOUT_EXPIRED) {
+    return false;
+  }
+  if (status == GL_WAIT_FAILED) {
+    LOG_ERROR << "Pixel readback fence wait failed";
+  }
+
+  const size_t size = (size_t)m_width * (size_t)m_height * 4;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[slot]);
+  void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+  if (mapped) {
+    memcpy(pixels, mapped, size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  } else {
+    LOG_ERROR << "Could not map pixel readback buffer";
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  release();
+  return mapped != nullptr;
+}
+
+void
+GLPixelReadback::clear()
+{
+  while (m_pending > 0) {
+    release();
+  }
+}
+
+// forget the oldest frame in flight
+void
+GLPixelReadback::release()
+{
+  const int slot = (m_next - m_pending + (int)m_buffers.size()) % (int)m_buffers.size();
+  glDeleteSync(m_fences[slot]);
+  m_fences[slot] = nullptr;
+  m_pending--;
+}
+
 GLShader::GLShader(GLenum shaderType)
 {
   m_isCompiled = false;
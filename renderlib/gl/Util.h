@@ -6,6 +6,7 @@
 #include "Logging.h"
 
 #include <string>
+#include <vector>
 
 /**
  * Check OpenGL status.
@@ -20,6 +21,14 @@ check_gl(std::string const& message);
 extern bool
 check_glfb(std::string const& message);
 
+/**
+ * Video memory free on the device of the current context, in bytes.
+ *
+ * Reported by GL_NVX_gpu_memory_info or GL_ATI_meminfo; 0 when the driver supports neither (e.g. Mesa, Apple).
+ */
+extern size_t
+queryFreeVideoMemory();
+
 class GLImageShader2DnoLut;
 class RectImage2D
 {
@@ -100,6 +109,7 @@ public:
   void release();
   int width() const;
   int height() const;
+  GLuint id() const { return m_fbo; }
 
   // pixels must be preallocated with 32bits per pixel, ASSUMING RGBA internal format
   void toImage(void* pixels);
@@ -112,6 +122,44 @@ private:
   int m_height;
 };
 
+// Asynchronous readback of a GLFramebufferObject through a ring of pixel pack buffers, so that reading one frame
+// overlaps rendering the next. Frames come out in the order they were started, flipped so that the first row is the
+// top of the image.
+// RAII; must have a current gl context at creation time.
+class GLPixelReadback
+{
+public:
+  GLPixelReadback(int numBuffers = 3);
+  ~GLPixelReadback();
+
+  // Queue a read of the fbo color buffer, ASSUMING RGBA internal format. When the ring is full the oldest frame is
+  // dropped. A change of size drops every frame in flight.
+  void start(GLFramebufferObject* fbo);
+  // Copy the oldest frame in flight into pixels, preallocated with 32bits per pixel at width() x height().
+  // Returns false if there is no frame, or if wait is false and its read has not completed.
+  bool finish(void* pixels, bool wait);
+  // drop every frame in flight
+  void clear();
+
+  int pending() const { return m_pending; }
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+
+private:
+  void resize(int width, int height);
+  void release();
+
+  std::vector<GLuint> m_buffers;
+  std::vector<GLsync> m_fences;
+  // ring slot of the next start
+  int m_next;
+  int m_pending;
+  // receives the flipped blit that the buffers are read from
+  GLFramebufferObject* m_flipped;
+  int m_width;
+  int m_height;
+};
+
 class GLShader
 {
 public:
@@ -149,6 +197,8 @@ public:
   bool bind();
   void release();
 
+  GLuint id() const { return m_program; }
+
   std::string log() { return m_log; }
 
 private:
@@ -0,0 +1,167 @@
+#include "glad/glad.h"
+
+#include "GLDenoiseShader.h"
+
+#include "AtrousFilter.h"
+#include "Logging.h"
+
+#include <gl/Util.h>
+#include <glm.h>
+
+GLDenoiseShader::GLDenoiseShader()
+  : GLShaderProgram()
+  , m_vshader()
+  , m_fshader()
+{
+  m_vshader = new GLShader(GL_VERTEX_SHADER);
+  m_vshader->compileSourceCode(R"(
+#version 400 core
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec2 uv;
+
+out vec2 vUv;
+
+void main()
+{
+  vUv = uv;
+  gl_Position = vec4( position, 1.0 );
+}
+	)");
+
+  if (!m_vshader->isCompiled()) {
+    LOG_ERROR << "GLDenoiseShader: Failed to compile vertex shader\n" << m_vshader->log();
+  }
+
+  // keep in sync with AtrousFilter.cpp
+  m_fshader = new GLShader(GL_FRAGMENT_SHADER);
+  m_fshader->compileSourceCode(R"(
+#version 400 core
+
+uniform sampler2D tColor;
+uniform sampler2D tNormals;
+uniform sampler2D tAlbedoDepth;
+uniform sampler2D tOriginal;
+uniform int uStepWidth;
+uniform float uColorSigma;
+uniform float uNormalPower;
+uniform float uDepthSigma;
+uniform float uAlbedoSigma;
+uniform float uLerpC;
+in vec2 vUv;
+out vec4 out_FragColor;
+
+const float KERNEL[5] = float[5](1.0 / 16.0, 1.0 / 4.0, 3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+
+struct Features {
+  vec3 color;
+  vec3 normal;
+  vec3 albedo;
+  float depth;
+  bool hit;
+};
+
+Features getFeatures(ivec2 p)
+{
+  Features f;
+  vec3 c = texelFetch(tColor, p, 0).rgb;
+  f.color = c / (1.0 + max(c, 0.0));
+  vec4 n = texelFetch(tNormals, p, 0);
+  vec4 ad = texelFetch(tAlbedoDepth, p, 0);
+  f.hit = n.w > 0.0;
+  float inv = f.hit ? 1.0 / n.w : 0.0;
+  f.normal = n.xyz * inv;
+  f.albedo = ad.rgb * inv;
+  f.depth = ad.w * inv;
+  return f;
+}
+
+float edgeStoppingWeight(Features p, Features q)
+{
+  // volume and empty space do not mix
+  if (p.hit != q.hit) {
+    return 0.0;
+  }
+  vec3 dc = p.color - q.color;
+  float w = exp(-dot(dc, dc) / (uColorSigma * uColorSigma));
+  if (!p.hit) {
+    return w;
+  }
+  // averaged normals of inconsistent gradients are short and say little about the surface
+  float lp = length(p.normal);
+  float lq = length(q.normal);
+  if (lp > 0.1 && lq > 0.1) {
+    w *= pow(max(dot(p.normal, q.normal) / (lp * lq), 0.0), uNormalPower);
+  }
+  float depthScale = uDepthSigma * float(uStepWidth) * max(max(p.depth, q.depth), 1e-4);
+  w *= exp(-abs(p.depth - q.depth) / depthScale);
+  vec3 da = p.albedo - q.albedo;
+  w *= exp(-dot(da, da) / (uAlbedoSigma * uAlbedoSigma));
+  return w;
+}
+
+void main()
+{
+  ivec2 size = textureSize(tColor, 0);
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
+  Features p = getFeatures(pixel);
+
+  vec4 sum = vec4(0.0);
+  float sumWeights = 0.0;
+  for (int ky = 0; ky < 5; ++ky) {
+    for (int kx = 0; kx < 5; ++kx) {
+      ivec2 q = pixel + ivec2(kx - 2, ky - 2) * uStepWidth;
+      if (any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size))) {
+        continue;
+      }
+      float weight = KERNEL[kx] * KERNEL[ky] * edgeStoppingWeight(p, getFeatures(q));
+      sum += weight * texelFetch(tColor, q, 0);
+      sumWeights += weight;
+    }
+  }
+  vec4 filtered = sum / sumWeights;
+  out_FragColor = (uLerpC > 0.0) ? mix(filtered, texelFetch(tOriginal, pixel, 0), uLerpC) : filtered;
+}
+    )");
+
+  if (!m_fshader->isCompiled()) {
+    LOG_ERROR << "GLDenoiseShader: Failed to compile fragment shader\n" << m_fshader->log();
+  }
+
+  addShader(m_vshader);
+  addShader(m_fshader);
+  link();
+
+  if (!isLinked()) {
+    LOG_ERROR << "GLDenoiseShader: Failed to link shader program\n" << log();
+  }
+
+  m_uStepWidth = uniformLocation("uStepWidth");
+  m_uColorSigma = uniformLocation("uColorSigma");
+  m_uNormalPower = uniformLocation("uNormalPower");
+  m_uDepthSigma = uniformLocation("uDepthSigma");
+  m_uAlbedoSigma = uniformLocation("uAlbedoSigma");
+  m_uLerpC = uniformLocation("uLerpC");
+
+  // sampler units never change
+  bind();
+  glUniform1i(uniformLocation("tColor"), 0);
+  glUniform1i(uniformLocation("tNormals"), 1);
+  glUniform1i(uniformLocation("tAlbedoDepth"), 2);
+  glUniform1i(uniformLocation("tOriginal"), 3);
+  release();
+}
+
+GLDenoiseShader::~GLDenoiseShader() {}
+
+void
+GLDenoiseShader::setShadingUniforms(const AtrousFilterParams& params, int pass, float lerpC)
+{
+  const int stepWidth = 1 << pass;
+  glUniform1i(m_uStepWidth, stepWidth);
+  glUniform1f(m_uColorSigma, params.m_colorSigma / (float)stepWidth);
+  glUniform1f(m_uNormalPower, params.m_normalPower);
+  glUniform1f(m_uDepthSigma, params.m_depthSigma);
+  glUniform1f(m_uAlbedoSigma, params.m_albedoSigma);
+  glUniform1f(m_uLerpC, lerpC);
+}
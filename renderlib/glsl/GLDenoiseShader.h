@@ -0,0 +1,36 @@
+#pragma once
+
+#include "gl/Util.h"
+
+#include <glm.h>
+
+struct AtrousFilterParams;
+
+/**
+ * One pass of the edge avoiding a-trous filter of AtrousFilter.h.
+ * Reads the color from texture unit 0, the normals from unit 1, the albedo and depth from unit 2
+ * and, in the last pass, the unfiltered color from unit 3.
+ */
+class GLDenoiseShader : public GLShaderProgram
+{
+
+public:
+  /**
+   * Constructor.
+   */
+  explicit GLDenoiseShader();
+
+  /// Destructor.
+  ~GLDenoiseShader();
+
+  // lerpC is the weight of the unfiltered color; only the last pass should pass a nonzero value.
+  void setShadingUniforms(const AtrousFilterParams& params, int pass, float lerpC);
+
+private:
+  /// The vertex shader.
+  GLShader* m_vshader;
+  /// The fragment shader.
+  GLShader* m_fshader;
+
+  int m_uStepWidth, m_uColorSigma, m_uNormalPower, m_uDepthSigma, m_uAlbedoSigma, m_uLerpC;
+};
@@ -11,10 +11,112 @@
 #include <gl/Util.h>
 #include <glm.h>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
-GLPTVolumeShader::GLPTVolumeShader()
+// std140 layouts of the uniform blocks in the fragment shader.
+// A vec3 takes 16 bytes unless a scalar is packed into its last 4; arrays have a 16 byte stride.
+struct CameraBlock
+{
+  glm::vec4 m_from;
+  glm::vec4 m_U;
+  glm::vec4 m_V;
+  glm::vec4 m_N;
+  glm::vec4 m_screen;
+  glm::vec2 m_invScreen;
+  float m_focalDistance;
+  float m_apertureSize;
+  float m_isPerspective;
+  float m_pad[3];
+};
+static_assert(sizeof(CameraBlock) == 112, "CameraBlock must match the std140 layout");
+
+struct LightBlock
+{
+  float m_theta;
+  float m_phi;
+  float m_width;
+  float m_halfWidth;
+  float m_height;
+  float m_halfHeight;
+  float m_distance;
+  float m_skyRadius;
+  glm::vec4 m_P;
+  glm::vec4 m_target;
+  glm::vec4 m_N;
+  glm::vec4 m_U;
+  glm::vec3 m_V;
+  float m_area;
+  float m_areaPdf;
+  float m_pad0[3];
+  glm::vec4 m_color;
+  glm::vec4 m_colorTop;
+  glm::vec4 m_colorMiddle;
+  glm::vec3 m_colorBottom;
+  int32_t m_T;
+};
+static_assert(sizeof(LightBlock) == 192, "LightBlock must match the std140 layout");
+
+struct RenderParamsBlock
+{
+  glm::vec3 m_clippedAaBbMin;
+  float m_densityScale;
+  glm::vec3 m_clippedAaBbMax;
+  float m_stepSize;
+  glm::vec3 m_invAaBbSize;
+  float m_stepSizeShadow;
+  glm::vec3 m_gradientDeltaX;
+  float m_invGradientDelta;
+  glm::vec3 m_gradientDeltaY;
+  float m_gradientFactor;
+  glm::vec3 m_gradientDeltaZ;
+  float m_showLights;
+  glm::vec3 m_volumeTexScale;
+  int32_t m_shadingType;
+  glm::vec3 m_volumeTexOffset;
+  int32_t m_bricked;
+  glm::vec3 m_brickVolumeSize;
+  float m_brickSize;
+  glm::vec3 m_brickGridSize;
+  float m_pad0;
+  glm::vec3 m_invBrickPoolSize;
+  float m_pad1;
+  glm::vec2 m_resolution;
+  float m_pad2[2];
+};
+static_assert(sizeof(RenderParamsBlock) == 192, "RenderParamsBlock must match the std140 layout");
+
+struct MaterialBlock
+{
+  glm::vec4 m_intensityMax;
+  glm::vec4 m_intensityMin;
+  // only x is used in the float arrays, only xyz in the vec3 arrays
+  glm::vec4 m_opacity[4];
+  glm::vec4 m_emissive[4];
+  glm::vec4 m_diffuse[4];
+  glm::vec4 m_specular[4];
+  glm::vec4 m_roughness[4];
+  int32_t m_nChannels;
+  int32_t m_pad[3];
+};
+static_assert(sizeof(MaterialBlock) == 368, "MaterialBlock must match the std140 layout");
+
+// uniform block binding points
+enum UniformBlockBinding
+{
+  CAMERA_BLOCK_BINDING = 0,
+  LIGHTS_BLOCK_BINDING,
+  RENDER_PARAMS_BLOCK_BINDING,
+  MATERIAL_BLOCK_BINDING,
+  PREVIOUS_CAMERA_BLOCK_BINDING
+};
+
+// texture units of the precomputed gradients of each channel; 10 and 11 hold the transmittance and history
+static const int GRADIENT_TEXTURE_UNITS[4] = { 9, 12, 13, 14 };
+
+GLPTVolumeShader::GLPTVolumeShader(const GLPTVolumeShaderVariant& variant)
   : GLShaderProgram()
   , m_vshader()
   , m_fshader()
@@ -56,8 +158,32 @@ const int ShaderType_Brdf = 0;
 const int ShaderType_Phase = 1;
 
 in vec2 vUv;
-out vec4 out_FragColor;
-
+layout(location = 0) out vec4 out_FragColor;
+// brick paging feedback: x = 1 + index of a brick that was needed but not resident, y = 1 + index of a resident
+// brick that was used. 0 means none.
+layout(location = 1) out vec4 out_BrickFeedback;
+#if ADAPTIVE_SAMPLING
+// per pixel running mean of the luminance, mean of its square, sample count, and 1 once converged
+layout(location = 2) out vec4 out_Moments;
+uniform sampler2D tPreviousMoments;
+uniform float uErrorTarget;
+// do not trust the variance estimate before this many samples
+const float ADAPTIVE_MIN_SAMPLES = 16.0;
+#endif
+#if TEMPORAL_REPROJECTION
+// x = mean of coverage times view depth of the first scattering event, y = mean coverage, z = per pixel sample count
+layout(location = 3) out vec4 out_History;
+uniform sampler2D tPreviousHistory;
+#endif
+#if DENOISE_FEATURES
+// first scattering event features that guide the denoiser, summed over the iterations by additive blending.
+// See AtrousFilter.h for the layout.
+layout(location = 4) out vec4 out_DenoiseNormal;
+layout(location = 5) out vec4 out_DenoiseAlbedoDepth;
+#endif
+
+// Scene parameters live in std140 uniform blocks that are only re-uploaded when they change.
+// The matching C++ structs are at the top of this file; keep the two in sync.
 struct Camera {
   vec3 m_from;
   vec3 m_U, m_V, m_N;
@@ -68,7 +194,9 @@ struct Camera {
   float m_isPerspective;
 };
 
-uniform Camera gCamera;
+layout(std140) uniform CameraBlock {
+  Camera gCamera;
+};
 
 struct Light {
   float   m_theta;
@@ -93,38 +221,70 @@ struct Light {
   int     m_T;
 };
 const int NUM_LIGHTS = 2;
-uniform Light gLights[2];
+layout(std140) uniform LightsBlock {
+  Light gLights[2];
+};
+
+layout(std140) uniform RenderParamsBlock {
+  vec3 gClippedAaBbMin;
+  float gDensityScale;
+  vec3 gClippedAaBbMax;
+  float gStepSize;
+  vec3 gInvAaBbSize;
+  float gStepSizeShadow;
+  vec3 gGradientDeltaX;
+  float gInvGradientDelta;
+  vec3 gGradientDeltaY;
+  float gGradientFactor;
+  vec3 gGradientDeltaZ;
+  float uShowLights;
+  // maps whole volume texture coordinates into volumeTexture when it only holds a cropped region
+  vec3 gVolumeTexScale;
+  int gShadingType;
+  vec3 gVolumeTexOffset;
+  // bricked volume paging. volumeTexture holds a low resolution stand-in for bricks that are not resident.
+  int gBricked;
+  vec3 gBrickVolumeSize;  // voxels
+  float gBrickSize;  // voxels per brick, not counting the apron
+  vec3 gBrickGridSize;  // bricks
+  vec3 gInvBrickPoolSize;  // 1/voxels of the pool texture
+  vec2 uResolution;
+};
 
-uniform vec3 gClippedAaBbMin;
-uniform vec3 gClippedAaBbMax;
-uniform float gDensityScale;
-uniform float gStepSize;
-uniform float gStepSizeShadow;
 uniform sampler3D volumeTexture;
-uniform vec3 gInvAaBbSize;
-uniform int g_nChannels;
-uniform int gShadingType;
-uniform vec3 gGradientDeltaX;
-uniform vec3 gGradientDeltaY;
-uniform vec3 gGradientDeltaZ;
-uniform float gInvGradientDelta;
-uniform float gGradientFactor;
-uniform float uShowLights;
+uniform sampler3D gBrickPool;
+uniform usampler3D gBrickPageTable;
+#if CACHED_TRANSMITTANCE
+// low resolution grid over the whole volume. r = transmittance toward light 0, g = toward light 1
+uniform sampler3D gTransmittanceTexture;
+#endif
+#if PRECOMPUTED_GRADIENT
+// one texture per channel, over the same region as volumeTexture. xyz = unit gradient, w = magnitude
+uniform sampler3D gGradientTexture[NUM_CHANNELS];
+#endif
+float gMissingBrick = 0.0;
+float gUsedBrick = 0.0;
+float gFirstScatterDepth = 0.0;
+float gFeatureHit = 0.0;
+vec3 gFeatureNormal = vec3(0.0);
+vec3 gFeatureAlbedo = vec3(0.0);
 
 // per channel
 uniform sampler2D g_lutTexture[4];
-uniform vec4 g_intensityMax;
-uniform vec4 g_intensityMin;
-uniform float g_opacity[4];
-uniform vec3 g_emissive[4];
-uniform vec3 g_diffuse[4];
-uniform vec3 g_specular[4];
-uniform float g_roughness[4];
+layout(std140) uniform MaterialBlock {
+  vec4 g_intensityMax;
+  vec4 g_intensityMin;
+  float g_opacity[4];
+  vec3 g_emissive[4];
+  vec3 g_diffuse[4];
+  vec3 g_specular[4];
+  float g_roughness[4];
+  int g_nChannels;
+};
 
 // compositing / progressive render
 uniform float uFrameCounter;
 uniform float uSampleCounter;
-uniform vec2 uResolution;
 uniform sampler2D tPreviousTexture;
 
 // from iq https://www.shadertoy.com/view/4tXyWN
@@ -265,15 +425,14 @@ Ray GenerateCameraRay(in Camera cam, in vec2 Pixel, in vec2 ApertureRnd)
   ScreenPoint.y = cam.m_screen.z + (cam.m_invScreen.y * Pixel.y);
 
   vec3 RayO = cam.m_from;
-  if (cam.m_isPerspective == 0.0) {
-    RayO += (ScreenPoint.x * cam.m_U) + (ScreenPoint.y * cam.m_V);
-  }
+#if PERSPECTIVE_PROJECTION
   // negating ScreenPoint.y flips the up/down direction. depends on whether you want pixel 0 at top or bottom
   // we could also have flipped m_screen and m_invScreen, or cam.m_V?
   vec3 RayD = normalize(cam.m_N + (ScreenPoint.x * cam.m_U) + (ScreenPoint.y * cam.m_V));
-  if (cam.m_isPerspective == 0.0) {
-    RayD = cam.m_N;
-  }
+#else
+  RayO += (ScreenPoint.x * cam.m_U) + (ScreenPoint.y * cam.m_V);
+  vec3 RayD = cam.m_N;
+#endif
 
   if (cam.m_apertureSize != 0.0f)
   {
@@ -309,21 +468,51 @@ vec3 PtoVolumeTex(vec3 p) {
   return p * gInvAaBbSize;
 }
 
+vec4 SampleVolume(vec3 uvw)
+{
+  if (gBricked == 0) {
+    return texture(volumeTexture, uvw * gVolumeTexScale + gVolumeTexOffset);
+  }
+
+  // voxel space, relative to voxel centers
+  vec3 voxel = clamp(uvw * gBrickVolumeSize - 0.5, vec3(0.0), gBrickVolumeSize - 1.0);
+  vec3 brick = min(floor(voxel / gBrickSize), gBrickGridSize - 1.0);
+  float brickIndex = 1.0 + brick.x + gBrickGridSize.x * (brick.y + gBrickGridSize.y * brick.z);
+  uvec4 entry = texelFetch(gBrickPageTable, ivec3(brick), 0);
+  if (entry.w == 0u) {
+    if (gMissingBrick == 0.0) {
+      gMissingBrick = brickIndex;
+    }
+    return texture(volumeTexture, uvw);
+  }
+  gUsedBrick = brickIndex;
+
+  // skip the one voxel apron, and go back to texel centers
+  vec3 poolVoxel = vec3(entry.xyz) * (gBrickSize + 2.0) + 1.0 + (voxel - brick * gBrickSize) + 0.5;
+  return texture(gBrickPool, poolVoxel * gInvBrickPoolSize);
+}
+
 const float UINT16_MAX = 65535.0;
 float GetNormalizedIntensityMax4ch(in vec3 P, out int ch)
 {
-  vec4 intensity = UINT16_MAX * texture(volumeTexture, PtoVolumeTex(P));
+  vec4 intensity = UINT16_MAX * SampleVolume(PtoVolumeTex(P));
 
   float maxIn = 0.0;
   ch = 0;
 
   intensity = (intensity - g_intensityMin) / (g_intensityMax - g_intensityMin);
   intensity.x = texture(g_lutTexture[0], vec2(intensity.x, 0.5)).x;
+#if NUM_CHANNELS > 1
   intensity.y = texture(g_lutTexture[1], vec2(intensity.y, 0.5)).x;
+#endif
+#if NUM_CHANNELS > 2
   intensity.z = texture(g_lutTexture[2], vec2(intensity.z, 0.5)).x;
+#endif
+#if NUM_CHANNELS > 3
   intensity.w = texture(g_lutTexture[3], vec2(intensity.w, 0.5)).x;
+#endif
 
-  for (int i = 0; i < min(g_nChannels, 4); ++i) {
+  for (int i = 0; i < NUM_CHANNELS; ++i) {
     if (intensity[i] > maxIn) {
       maxIn = intensity[i];
       ch = i;
@@ -334,7 +523,7 @@ float GetNormalizedIntensityMax4ch(in vec3 P, out int ch)
 
 float GetNormalizedIntensity(in vec3 P, in int ch)
 {
-  float intensity = UINT16_MAX * texture(volumeTexture, PtoVolumeTex(P))[ch];
+  float intensity = UINT16_MAX * SampleVolume(PtoVolumeTex(P))[ch];
   intensity = (intensity - g_intensityMin[ch]) / (g_intensityMax[ch] - g_intensityMin[ch]);
   intensity = texture(g_lutTexture[ch], vec2(intensity, 0.5)).x;
   return intensity;
@@ -342,7 +531,7 @@ float GetNormalizedIntensity(in vec3 P, in int ch)
 
 float GetNormalizedIntensity4ch(vec3 P, int ch)
 {
-  vec4 intensity = UINT16_MAX * texture(volumeTexture, PtoVolumeTex(P));
+  vec4 intensity = UINT16_MAX * SampleVolume(PtoVolumeTex(P));
   // select channel
   float intensityf = intensity[ch];
   intensityf = (intensityf - g_intensityMin[ch]) / (g_intensityMax[ch] - g_intensityMin[ch]);
@@ -351,6 +540,15 @@ float GetNormalizedIntensity4ch(vec3 P, int ch)
   return intensityf;
 }
 
+#if PRECOMPUTED_GRADIENT
+vec3 Gradient4ch(vec3 P, int ch)
+{
+  vec3 uvw = PtoVolumeTex(P) * gVolumeTexScale + gVolumeTexOffset;
+  vec4 g = texture(gGradientTexture[ch], uvw);
+  // stored per unit of raw intensity; scale to the normalized intensity range like GetNormalizedIntensity4ch
+  return g.xyz * (g.w * UINT16_MAX / (g_intensityMax[ch] - g_intensityMin[ch]));
+}
+#else
 // note that gInvGradientDelta is maxpixeldim of volume
 // gGradientDeltaX,Y,Z is 1/X,Y,Z of volume
 vec3 Gradient4ch(vec3 P, int ch)
@@ -363,6 +561,7 @@ vec3 Gradient4ch(vec3 P, int ch)
 
   return Gradient;
 }
+#endif
 
 
 float GetOpacity(float NormalizedIntensity, int ch)
@@ -853,6 +1052,55 @@ bool FreePathRM(inout Ray R, inout uvec2 seed)
   return true;
 }
 
+// shadow ray R toward gLights[lightIndex], ending at Pe: true if it is blocked.
+bool ShadowRayBlocked(inout Ray R, int lightIndex, in vec3 Pe, inout uvec2 seed)
+{
+#if CACHED_TRANSMITTANCE
+  // same probability as FreePathRM, taken from the cache
+  return rand(seed) >= texture(gTransmittanceTexture, PtoVolumeTex(Pe))[lightIndex];
+#else
+  return FreePathRM(R, seed);
+#endif
+}
+
+// deterministic counterpart of FreePathRM: the probability that the shadow ray R gets through
+float TransmittanceRM(in Ray R)
+{
+  float MinT;
+  float MaxT;
+
+  if (!IntersectBox(R, MinT, MaxT))
+    return 1.0;
+
+  MinT = max(MinT, R.m_MinT);
+  MaxT = min(MaxT, R.m_MaxT);
+
+  float Sum = 0.0;
+  int ch = 0;
+  // FreePathRM stops at a sum of -log(rand)/gDensityScale; beyond 10/gDensityScale nothing gets through anyway
+  for (float t = MinT + 0.5 * gStepSizeShadow; t < MaxT && Sum * gDensityScale < 10.0; t += gStepSizeShadow)
+  {
+    float intensity = GetNormalizedIntensityMax4ch(rayAt(R, t), ch);
+    Sum += gDensityScale * GetOpacity(intensity, ch) * gStepSizeShadow;
+  }
+  return exp(-Sum * gDensityScale);
+}
+
+float LightTransmittance(in Light light, in vec3 P)
+{
+  if (light.m_T == 0) {
+    // toward the center of the area light
+    return TransmittanceRM(Ray(light.m_P, normalize(P - light.m_P), 0.0, length(P - light.m_P)));
+  }
+  // the sky light surrounds the volume: average over the axis directions
+  const vec3 dirs[6] = vec3[6](vec3(1,0,0), vec3(-1,0,0), vec3(0,1,0), vec3(0,-1,0), vec3(0,0,1), vec3(0,0,-1));
+  float T = 0.0;
+  for (int i = 0; i < 6; ++i) {
+    T += TransmittanceRM(Ray(P - 2.0 * dirs[i], dirs[i], 0.0, 2.0));
+  }
+  return T / 6.0;
+}
+
 
 int NearestLight(Ray R, out vec3 LightColor, out vec3 Pl, out float oPdf)
 {
@@ -879,8 +1127,9 @@ int NearestLight(Ray R, out vec3 LightColor, out vec3 Pl, out float oPdf)
 }
 
 // return a XYZ color
-vec3 EstimateDirectLight(int shaderType, float Density, int ch, in Light light, in CLightingSample LS, in vec3 Wo, in vec3 Pe, in vec3 N, inout uvec2 seed)
+vec3 EstimateDirectLight(int shaderType, float Density, int ch, int lightIndex, in CLightingSample LS, in vec3 Wo, in vec3 Pe, in vec3 N, inout uvec2 seed)
 {
+  Light light = gLights[lightIndex];
   vec3 Ld = BLACK, Li = BLACK, F = BLACK;
 
   vec3 diffuse = GetDiffuseN(Density, ch);
@@ -903,7 +1152,7 @@ vec3 EstimateDirectLight(int shaderType, float Density, int ch, in Light light,
 
   ShaderPdf = Shader_Pdf(Shader, Wo, Wi);
 
-  if (!IsBlack(Li) && (ShaderPdf > 0.0f) && (LightPdf > 0.0f) && !FreePathRM(Rl, seed))
+  if (!IsBlack(Li) && (ShaderPdf > 0.0f) && (LightPdf > 0.0f) && !ShadowRayBlocked(Rl, lightIndex, Pe, seed))
   {
     float WeightMIS = PowerHeuristic(1.0f, LightPdf, 1.0f, ShaderPdf);
 
@@ -929,7 +1178,7 @@ vec3 EstimateDirectLight(int shaderType, float Density, int ch, in Light light,
 
       if ((LightPdf > 0.0f) && !IsBlack(Li)) {
         Ray rr = Ray(Pl, normalize(Pe - Pl), 0.0f, length(Pe - Pl));
-        if (!FreePathRM(rr, seed))
+        if (!ShadowRayBlocked(rr, n, Pe, seed))
         {
           float WeightMIS = PowerHeuristic(1.0f, ShaderPdf, 1.0f, LightPdf);
 
@@ -962,9 +1211,7 @@ vec3 UniformSampleOneLight(int shaderType, float Density, int ch, in vec3 Wo, in
 
   int WhichLight = int(floor(LS.m_LightNum * float(NUM_LIGHTS)));
 
-  Light light = gLights[WhichLight];
-
-  return float(NUM_LIGHTS) * EstimateDirectLight(shaderType, Density, ch, light, LS, Wo, Pe, N, seed);
+  return float(NUM_LIGHTS) * EstimateDirectLight(shaderType, Density, ch, WhichLight, LS, Wo, Pe, N, seed);
 
 }
 
@@ -1069,7 +1316,7 @@ vec2 OwenScrambledSobol(uint iter) {
     return vec2(ip) / float(0xffffffffu);
 }
 
-vec4 CalculateRadiance(inout uvec2 seed) {
+vec4 CalculateRadiance(inout uvec2 seed, float sampleIndex) {
   float r = rand(seed);
   //return vec4(r,0,0,1);
 
@@ -1077,7 +1324,7 @@ vec4 CalculateRadiance(inout uvec2 seed) {
 
   //Ray Re = Ray(vec3(0,0,0), vec3(0,0,1), 0.0, 1500000.0);
   //vec2 pixSample = vec2(rand(seed), rand(seed));
-  vec2 pixSample = OwenScrambledSobol(uint(uSampleCounter));
+  vec2 pixSample = OwenScrambledSobol(uint(sampleIndex));
 
   vec2 UV = vUv*uResolution + pixSample;
 
@@ -1098,6 +1345,7 @@ vec4 CalculateRadiance(inout uvec2 seed) {
   if (SampleDistanceRM(Re, seed, Pe))
   {
     alpha = 1.0;
+    gFirstScatterDepth = dot(Pe - gCamera.m_from, gCamera.m_N);
       //return vec4(1.0, 1.0, 1.0, 1.0);
 
     // is there a light between Re.m_O and Pe? (ray's maxT is distance to Pe)
@@ -1116,40 +1364,29 @@ vec4 CalculateRadiance(inout uvec2 seed) {
     Lv += RGBtoXYZ(GetEmissionN(D, ch));
 
     vec3 gradient = Gradient4ch(Pe, ch);
+    gFeatureHit = 1.0;
+    gFeatureNormal = (length(gradient) > 0.0) ? normalize(gradient) : vec3(0.0);
+    gFeatureAlbedo = GetDiffuseN(D, ch);
     // send ray out from Pe toward light
-    switch (gShadingType)
-    {
-      case 0:
-      {
-        Lv += UniformSampleOneLight(ShaderType_Brdf, D, ch, normalize(-Re.m_D), Pe, normalize(gradient), seed);
-        break;
-      }
-
-      case 1:
-      {
-        Lv += 0.5f * UniformSampleOneLight(ShaderType_Phase, D, ch, normalize(-Re.m_D), Pe, normalize(gradient), seed);
-        break;
-      }
-
-      case 2:
-      {
-        //const float GradMag = GradientMagnitude(Pe, volumedata.gradientVolumeTexture[ch]) * (1.0/volumedata.intensityMax[ch]);
-        float GradMag = length(gradient);
-        float PdfBrdf = (1.0f - exp(-gGradientFactor * GradMag));
-
-        vec3 cls; // xyz color
-        if (rand(seed) < PdfBrdf) {
-          cls = UniformSampleOneLight(ShaderType_Brdf, D, ch, normalize(-Re.m_D), Pe, normalize(gradient), seed);
-        }
-        else {
-          cls = 0.5f * UniformSampleOneLight(ShaderType_Phase, D, ch, normalize(-Re.m_D), Pe, normalize(gradient), seed);
-        }
-
-        Lv += cls;
-
-        break;
-      }
+#if SHADING_TYPE == 0
+    Lv += UniformSampleOneLight(ShaderType_Brdf, D, ch, normalize(-Re.m_D), Pe, normalize(gradient), seed);
+#elif SHADING_TYPE == 1
+    Lv += 0.5f * UniformSampleOneLight(ShaderType_Phase, D, ch, normalize(-Re.m_D), Pe, normalize(gradient), seed);
+#else
+    //const float GradMag = GradientMagnitude(Pe, volumedata.gradientVolumeTexture[ch]) * (1.0/volumedata.intensityMax[ch]);
+    float GradMag = length(gradient);
+    float PdfBrdf = (1.0f - exp(-gGradientFactor * GradMag));
+
+    vec3 cls; // xyz color
+    if (rand(seed) < PdfBrdf) {
+      cls = UniformSampleOneLight(ShaderType_Brdf, D, ch, normalize(-Re.m_D), Pe, normalize(gradient), seed);
+    }
+    else {
+      cls = 0.5f * UniformSampleOneLight(ShaderType_Phase, D, ch, normalize(-Re.m_D), Pe, normalize(gradient), seed);
     }
+
+    Lv += cls;
+#endif
   }
   else
   {
@@ -1175,25 +1412,174 @@ vec4 CumulativeMovingAverage(vec4 A, vec4 Ax, float N)
    return A + ((Ax - A) / max((N), 1.0f));
 }
 
+#if TRANSMITTANCE_PASS
+uniform float uTransmittanceSlice;
+
 void main()
 {
-  // seed for rand(seed) function
-  uvec2 seed = uvec2(uFrameCounter, uFrameCounter + 1.0) * uvec2(gl_FragCoord);
+  // texel center of the transmittance volume, in scene space (the volume bounds start at the origin)
+  vec3 P = vec3(vUv, uTransmittanceSlice) / gInvAaBbSize;
+  out_FragColor = vec4(LightTransmittance(gLights[0], P), LightTransmittance(gLights[1], P), 0.0, 1.0);
+  out_BrickFeedback = vec4(0.0);
+}
+#elif REPROJECTION_PASS
+// the camera that rendered tPreviousTexture and tPreviousHistory
+layout(std140) uniform PreviousCameraBlock {
+  Camera gPreviousCamera;
+};
+// at most this many reprojected samples are kept per pixel, so that resampling blur fades out quickly
+const float REPROJECTION_MAX_HISTORY = 32.0;
+// reprojection error in pixels at which the history is dropped entirely
+const float REPROJECTION_MAX_ERROR = 1.0;
 
-  // perform path tracing and get resulting pixel color
-  vec4 pixelColor = CalculateRadiance( seed );
+// scene point at view depth d seen through a pixel, ignoring the lens
+vec3 UnprojectPixel(in Camera cam, vec2 pixel, float d)
+{
+  vec2 s = cam.m_screen.xz + cam.m_invScreen * pixel;
+  vec3 offset = s.x * cam.m_U + s.y * cam.m_V;
+#if PERSPECTIVE_PROJECTION
+  return cam.m_from + d * (cam.m_N + offset);
+#else
+  return cam.m_from + offset + d * cam.m_N;
+#endif
+}
 
+// inverse of UnprojectPixel
+vec2 ProjectPoint(in Camera cam, vec3 P)
+{
+  vec3 rel = P - cam.m_from;
+  vec2 s = vec2(dot(rel, cam.m_U) / dot(cam.m_U, cam.m_U), dot(rel, cam.m_V) / dot(cam.m_V, cam.m_V));
+#if PERSPECTIVE_PROJECTION
+  s /= max(dot(rel, cam.m_N), 1e-6);
+#endif
+  return (s - cam.m_screen.xz) / cam.m_invScreen;
+}
+
+void main()
+{
+  vec2 pixel = vUv * uResolution;
+  out_BrickFeedback = vec4(0.0);
+#if DENOISE_FEATURES
+  out_DenoiseNormal = vec4(0.0);
+  out_DenoiseAlbedoDepth = vec4(0.0);
+#endif
+
+  // Find the previous pixel that saw the same first scattering point. Start from the depth stored at this pixel
+  // and refine it with the depth found where that lands in the previous image.
+  vec4 history = texture(tPreviousHistory, vUv);
+  float depth = (history.y > 0.0) ? history.x / history.y
+                                  : dot(0.5 * (gClippedAaBbMin + gClippedAaBbMax) - gCamera.m_from, gCamera.m_N);
+  vec2 previousUv = vUv;
+  vec3 P = UnprojectPixel(gCamera, pixel, depth);
+  for (int i = 0; i < 3; ++i) {
+    previousUv = ProjectPoint(gPreviousCamera, P) / uResolution;
+    history = texture(tPreviousHistory, previousUv);
+    if (history.y <= 0.0) {
+      break;
+    }
+    P = UnprojectPixel(gPreviousCamera, previousUv * uResolution, history.x / history.y);
+    depth = dot(P - gCamera.m_from, gCamera.m_N);
+  }
+
+  float confidence = 0.0;
+  if (all(greaterThanEqual(previousUv, vec2(0.0))) && all(lessThanEqual(previousUv, vec2(1.0)))) {
+    if (history.y > 0.0) {
+      // the point must land back on this pixel, or it is hidden or was never visible
+      float error = length(ProjectPoint(gCamera, P) - pixel);
+      confidence = clamp(1.0 - error / REPROJECTION_MAX_ERROR, 0.0, 1.0) * history.y;
+    }
+    else {
+      // empty space stays empty as long as the new ray misses the volume too
+      vec3 O = UnprojectPixel(gCamera, pixel, 0.0);
+      float tNear, tFar;
+      confidence = IntersectBox(newRay(O, normalize(UnprojectPixel(gCamera, pixel, 1.0) - O)), tNear, tFar) ? 0.0 : 1.0;
+    }
+  }
+
+  // the next path trace iteration weighs the history by its sample count, so a rejected pixel starts over
+  out_FragColor = texture(tPreviousTexture, previousUv);
+  out_History = vec4(depth * history.y, history.y, floor(confidence * min(history.z, REPROJECTION_MAX_HISTORY)), 0.0);
+}
+#else
+void main()
+{
   vec4 previousColor = texture(tPreviousTexture, vUv);
   if (uSampleCounter < 1.0) {
     previousColor = vec4(0,0,0,0);
   }
 
+#if ADAPTIVE_SAMPLING
+  vec4 moments = (uSampleCounter < 1.0) ? vec4(0.0) : texture(tPreviousMoments, vUv);
+  if (moments.w > 0.0) {
+    // converged, keep the pixel as it is
+    out_FragColor = previousColor;
+    out_Moments = moments;
+    out_BrickFeedback = vec4(0.0);
+#if DENOISE_FEATURES
+    out_DenoiseNormal = vec4(0.0);
+    out_DenoiseAlbedoDepth = vec4(0.0);
+#endif
+    return;
+  }
+  // pixels stop at different times, so each keeps its own count
+  float sampleCounter = moments.z;
+#elif TEMPORAL_REPROJECTION
+  vec4 history = (uSampleCounter < 1.0) ? vec4(0.0) : texture(tPreviousHistory, vUv);
+  // reprojected pixels start out with different counts
+  float sampleCounter = history.z;
+#else
+  float sampleCounter = uSampleCounter;
+#endif
+
+  // seed for rand(seed) function
+  uvec2 seed = uvec2(uFrameCounter, uFrameCounter + 1.0) * uvec2(gl_FragCoord);
+
+  // perform path tracing and get resulting pixel color
+  vec4 pixelColor = CalculateRadiance( seed, sampleCounter );
+
+#if ADAPTIVE_SAMPLING
+  float n = sampleCounter + 1.0;
+  out_FragColor = CumulativeMovingAverage(previousColor, pixelColor, n);
+  // pixelColor is xyz, so y is the luminance
+  moments.xy += (vec2(pixelColor.y, pixelColor.y * pixelColor.y) - moments.xy) / n;
+  moments.z = n;
+  // relative standard error of the mean. Dark pixels are measured against a floor so they can converge too.
+  float stdError = sqrt(max(moments.y - moments.x * moments.x, 0.0) / n);
+  moments.w = (n >= ADAPTIVE_MIN_SAMPLES && stdError <= uErrorTarget * max(moments.x, 0.01)) ? 1.0 : 0.0;
+  out_Moments = moments;
+#elif TEMPORAL_REPROJECTION
+  float n = sampleCounter + 1.0;
+  out_FragColor = CumulativeMovingAverage(previousColor, pixelColor, n);
+  history.xy += (vec2(gFirstScatterDepth * pixelColor.a, pixelColor.a) - history.xy) / n;
+  history.z = n;
+  out_History = history;
+#else
   out_FragColor = CumulativeMovingAverage(previousColor, pixelColor, uSampleCounter);
-}
+#endif
+  out_BrickFeedback = vec4(gMissingBrick, gUsedBrick, 0.0, 0.0);
+#if DENOISE_FEATURES
+  out_DenoiseNormal = vec4(gFeatureNormal, gFeatureHit);
+  out_DenoiseAlbedoDepth = vec4(gFeatureAlbedo, gFirstScatterDepth) * gFeatureHit;
+#endif
+}
+#endif
 )";
 
-  m_fshader->compileSourceCode(
-    (std::string(fsPiece1) + std::string(fsPiece2) + std::string(fsPiece3) + std::string(fsPiece4)).c_str());
+  std::string fsSource = std::string(fsPiece1) + std::string(fsPiece2) + std::string(fsPiece3) + std::string(fsPiece4);
+  // the specialization has to follow the #version line
+  std::ostringstream defines;
+  defines << "#define NUM_CHANNELS " << variant.m_numChannels << "\n"
+          << "#define SHADING_TYPE " << variant.m_shadingType << "\n"
+          << "#define PERSPECTIVE_PROJECTION " << (variant.m_perspective ? 1 : 0) << "\n"
+          << "#define PRECOMPUTED_GRADIENT " << (variant.m_precomputedGradient ? 1 : 0) << "\n"
+          << "#define CACHED_TRANSMITTANCE " << (variant.m_cachedTransmittance ? 1 : 0) << "\n"
+          << "#define TRANSMITTANCE_PASS " << (variant.m_transmittancePass ? 1 : 0) << "\n"
+          << "#define ADAPTIVE_SAMPLING " << (variant.m_adaptiveSampling ? 1 : 0) << "\n"
+          << "#define TEMPORAL_REPROJECTION " << (variant.m_reprojection ? 1 : 0) << "\n"
+          << "#define REPROJECTION_PASS " << (variant.m_reprojectionPass ? 1 : 0) << "\n"
+          << "#define DENOISE_FEATURES " << (variant.m_denoiseFeatures ? 1 : 0) << "\n";
+  fsSource.insert(fsSource.find('\n', fsSource.find("#version")) + 1, defines.str());
+  m_fshader->compileSourceCode(fsSource.c_str());
   if (!m_fshader->isCompiled()) {
     LOG_ERROR << "GLPTVolumeShader: Failed to compile fragment shader\n" << m_fshader->log();
   }
@@ -1206,307 +1592,429 @@ void main()
     LOG_ERROR << "GLPTVolumeShader: Failed to link shader program\n" << log();
   }
 
-  m_volumeTexture = uniformLocation("volumeTexture");
-
-  m_tPreviousTexture = uniformLocation("tPreviousTexture");
-  m_uSampleCounter = uniformLocation("uSampleCounter"); // 0
-  m_uFrameCounter = uniformLocation("uFrameCounter");   // 1
-
-  m_uResolution = uniformLocation("uResolution"); // : { type : "v2", value : new THREE.Vector2() },
-
-  ///////////////////////////
-  m_gClippedAaBbMin = uniformLocation("gClippedAaBbMin"); // : { type : "v3", value : new THREE.Vector3(0, 0, 0) },
-  m_gClippedAaBbMax = uniformLocation("gClippedAaBbMax"); // : { type : "v3", value : new THREE.Vector3(1, 1, 1) },
-  m_gDensityScale = uniformLocation("gDensityScale");     // : { type : "f", value : 50.0 },
-  m_gStepSize = uniformLocation("gStepSize");             // : { type : "f", value : 1.0 },
-  m_gStepSizeShadow = uniformLocation("gStepSizeShadow"); // : { type : "f", value : 1.0 },
-  m_gInvAaBbSize = uniformLocation("gInvAaBbSize");       // : { type : "v3", value : new THREE.Vector3() },
-  m_g_nChannels = uniformLocation("g_nChannels");         // : { type : "i", value : 1 },
-  m_gShadingType = uniformLocation("gShadingType");       // : { type : "i", value : 2 },
-  m_gGradientDeltaX = uniformLocation("gGradientDeltaX"); // : { type : "v3", value : new THREE.Vector3(0.01, 0, 0) },
-  m_gGradientDeltaY = uniformLocation("gGradientDeltaY"); // : { type : "v3", value : new THREE.Vector3(0, 0.01, 0) },
-  m_gGradientDeltaZ = uniformLocation("gGradientDeltaZ"); // : { type : "v3", value : new THREE.Vector3(0, 0, 0.01) },
-  m_gInvGradientDelta = uniformLocation("gInvGradientDelta"); // : { type : "f", value : 0.0 },
-  m_gGradientFactor = uniformLocation("gGradientFactor");     // : { type : "f", value : 0.5 },
-
-  m_cameraFrom = uniformLocation("gCamera.m_from");
-  m_cameraU = uniformLocation("gCamera.m_U");
-  m_cameraV = uniformLocation("gCamera.m_V");
-  m_cameraN = uniformLocation("gCamera.m_N");
-  m_cameraScreen = uniformLocation("gCamera.m_screen");
-  m_cameraInvScreen = uniformLocation("gCamera.m_invScreen");
-  m_cameraFocalDistance = uniformLocation("gCamera.m_focalDistance");
-  m_cameraApertureSize = uniformLocation("gCamera.m_apertureSize");
-  m_cameraProjectionMode = uniformLocation("gCamera.m_isPerspective");
-
-  // Camera struct
-  //          m_from : new THREE.Vector3(),
-  //          m_U : new THREE.Vector3(),
-  //          m_V : new THREE.Vector3(),
-  //          m_N : new THREE.Vector3(),
-  //          m_screen : new THREE.Vector4(),    // left, right, bottom, top
-  //          m_invScreen : new THREE.Vector2(), // 1/w, 1/h
-  //          m_focalDistance : 0.0,
-  //          m_apertureSize : 0.0
-
-  m_light0theta = uniformLocation("gLights[0].m_theta");
-  m_light0phi = uniformLocation("gLights[0].m_phi");
-  m_light0width = uniformLocation("gLights[0].m_width");
-  m_light0halfWidth = uniformLocation("gLights[0].m_halfWidth");
-  m_light0height = uniformLocation("gLights[0].m_height");
-  m_light0halfHeight = uniformLocation("gLights[0].m_halfHeight");
-  m_light0distance = uniformLocation("gLights[0].m_distance");
-  m_light0skyRadius = uniformLocation("gLights[0].m_skyRadius");
-  m_light0P = uniformLocation("gLights[0].m_P");
-  m_light0target = uniformLocation("gLights[0].m_target");
-  m_light0N = uniformLocation("gLights[0].m_N");
-  m_light0U = uniformLocation("gLights[0].m_U");
-  m_light0V = uniformLocation("gLights[0].m_V");
-  m_light0area = uniformLocation("gLights[0].m_area");
-  m_light0areaPdf = uniformLocation("gLights[0].m_areaPdf");
-  m_light0color = uniformLocation("gLights[0].m_color");
-  m_light0colorTop = uniformLocation("gLights[0].m_colorTop");
-  m_light0colorMiddle = uniformLocation("gLights[0].m_colorMiddle");
-  m_light0colorBottom = uniformLocation("gLights[0].m_colorBottom");
-  m_light0T = uniformLocation("gLights[0].m_T");
-
-  m_light1theta = uniformLocation("gLights[1].m_theta");
-  m_light1phi = uniformLocation("gLights[1].m_phi");
-  m_light1width = uniformLocation("gLights[1].m_width");
-  m_light1halfWidth = uniformLocation("gLights[1].m_halfWidth");
-  m_light1height = uniformLocation("gLights[1].m_height");
-  m_light1halfHeight = uniformLocation("gLights[1].m_halfHeight");
-  m_light1distance = uniformLocation("gLights[1].m_distance");
-  m_light1skyRadius = uniformLocation("gLights[1].m_skyRadius");
-  m_light1P = uniformLocation("gLights[1].m_P");
-  m_light1target = uniformLocation("gLights[1].m_target");
-  m_light1N = uniformLocation("gLights[1].m_N");
-  m_light1U = uniformLocation("gLights[1].m_U");
-  m_light1V = uniformLocation("gLights[1].m_V");
-  m_light1area = uniformLocation("gLights[1].m_area");
-  m_light1areaPdf = uniformLocation("gLights[1].m_areaPdf");
-  m_light1color = uniformLocation("gLights[1].m_color");
-  m_light1colorTop = uniformLocation("gLights[1].m_colorTop");
-  m_light1colorMiddle = uniformLocation("gLights[1].m_colorMiddle");
-  m_light1colorBottom = uniformLocation("gLights[1].m_colorBottom");
-  m_light1T = uniformLocation("gLights[1].m_T");
-
-  // per channel
-
-  m_lutTexture0 = uniformLocation("g_lutTexture[0]");
-  m_lutTexture1 = uniformLocation("g_lutTexture[1]");
-  m_lutTexture2 = uniformLocation("g_lutTexture[2]");
-  m_lutTexture3 = uniformLocation("g_lutTexture[3]");
-  m_intensityMax = uniformLocation("g_intensityMax");
-  m_intensityMin = uniformLocation("g_intensityMin");
-  m_opacity = uniformLocation("g_opacity");
-  m_emissive0 = uniformLocation("g_emissive[0]");
-  m_emissive1 = uniformLocation("g_emissive[1]");
-  m_emissive2 = uniformLocation("g_emissive[2]");
-  m_emissive3 = uniformLocation("g_emissive[3]");
-  m_diffuse0 = uniformLocation("g_diffuse[0]");
-  m_diffuse1 = uniformLocation("g_diffuse[1]");
-  m_diffuse2 = uniformLocation("g_diffuse[2]");
-  m_diffuse3 = uniformLocation("g_diffuse[3]");
-  m_specular0 = uniformLocation("g_specular[0]");
-  m_specular1 = uniformLocation("g_specular[1]");
-  m_specular2 = uniformLocation("g_specular[2]");
-  m_specular3 = uniformLocation("g_specular[3]");
-  m_roughness = uniformLocation("g_roughness");
-  m_uShowLights = uniformLocation("uShowLights");
+  bindUniformBlock("CameraBlock", CAMERA_BLOCK_BINDING);
+  bindUniformBlock("LightsBlock", LIGHTS_BLOCK_BINDING);
+  bindUniformBlock("RenderParamsBlock", RENDER_PARAMS_BLOCK_BINDING);
+  bindUniformBlock("MaterialBlock", MATERIAL_BLOCK_BINDING);
+  if (variant.m_reprojectionPass) {
+    bindUniformBlock("PreviousCameraBlock", PREVIOUS_CAMERA_BLOCK_BINDING);
+  }
+
+  m_uFrameCounter = uniformLocation("uFrameCounter");
+  m_uSampleCounter = uniformLocation("uSampleCounter");
+  m_uTransmittanceSlice = uniformLocation("uTransmittanceSlice");
+  m_uErrorTarget = uniformLocation("uErrorTarget");
+
+  // sampler units never change
+  bind();
+  glUniform1i(uniformLocation("volumeTexture"), 0);
+  glUniform1i(uniformLocation("tPreviousTexture"), 1);
+  glUniform1i(uniformLocation("g_lutTexture[0]"), 3);
+  glUniform1i(uniformLocation("g_lutTexture[1]"), 4);
+  glUniform1i(uniformLocation("g_lutTexture[2]"), 5);
+  glUniform1i(uniformLocation("g_lutTexture[3]"), 6);
+  glUniform1i(uniformLocation("gBrickPool"), 7);
+  glUniform1i(uniformLocation("gBrickPageTable"), 8);
+  if (variant.m_precomputedGradient) {
+    for (int i = 0; i < variant.m_numChannels; ++i) {
+      glUniform1i(uniformLocation(("gGradientTexture[" + std::to_string(i) + "]").c_str()), GRADIENT_TEXTURE_UNITS[i]);
+    }
+  }
+  if (variant.m_cachedTransmittance) {
+    glUniform1i(uniformLocation("gTransmittanceTexture"), 10);
+  }
+  if (variant.m_adaptiveSampling) {
+    glUniform1i(uniformLocation("tPreviousMoments"), 2);
+  }
+  if (variant.m_reprojection) {
+    glUniform1i(uniformLocation("tPreviousHistory"), 11);
+  }
+  release();
+  check_gl("pathtrace shader setup");
 }
 
 GLPTVolumeShader::~GLPTVolumeShader() {}
 
+void
+GLPTVolumeShader::bindUniformBlock(const char* name, GLuint binding)
+{
+  GLuint index = glGetUniformBlockIndex(id(), name);
+  if (index == GL_INVALID_INDEX) {
+    LOG_ERROR << "GLPTVolumeShader: no uniform block " << name;
+    return;
+  }
+  glUniformBlockBinding(id(), index, binding);
+}
+
+GLPTVolumeUniforms::GLPTVolumeUniforms()
+  : m_valid(false)
+{
+  m_cameraUbo = createUniformBuffer(sizeof(CameraBlock));
+  m_lightsUbo = createUniformBuffer(2 * sizeof(LightBlock));
+  m_renderParamsUbo = createUniformBuffer(sizeof(RenderParamsBlock));
+  m_materialUbo = createUniformBuffer(sizeof(MaterialBlock));
+  m_previousCameraUbo = createUniformBuffer(sizeof(CameraBlock));
+  check_gl("create pathtrace uniform buffers");
+}
+
+GLPTVolumeUniforms::~GLPTVolumeUniforms()
+{
+  GLuint buffers[5] = { m_cameraUbo, m_lightsUbo, m_renderParamsUbo, m_materialUbo, m_previousCameraUbo };
+  glDeleteBuffers(5, buffers);
+}
+
+GLuint
+GLPTVolumeUniforms::createUniformBuffer(size_t size)
+{
+  GLuint ubo = 0;
+  glGenBuffers(1, &ubo);
+  glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+  glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  return ubo;
+}
+
+void
+GLPTVolumeUniforms::uploadCamera(const CCamera& cam)
+{
+  CameraBlock block;
+  memset(&block, 0, sizeof(block));
+  block.m_from = glm::vec4(cam.m_From, 0.0f);
+  block.m_U = glm::vec4(cam.m_U, 0.0f);
+  block.m_V = glm::vec4(cam.m_V, 0.0f);
+  block.m_N = glm::vec4(cam.m_N, 0.0f);
+  block.m_screen = glm::vec4(
+    cam.m_Film.m_Screen[0][0], cam.m_Film.m_Screen[0][1], cam.m_Film.m_Screen[1][0], cam.m_Film.m_Screen[1][1]);
+  block.m_invScreen = cam.m_Film.m_InvScreen;
+  block.m_focalDistance = cam.m_Focus.m_FocalDistance;
+  block.m_apertureSize = cam.m_Aperture.m_Size;
+  block.m_isPerspective = (cam.m_Projection == PERSPECTIVE) ? 1.0f : 0.0f;
+
+  glBindBuffer(GL_UNIFORM_BUFFER, m_cameraUbo);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+}
+
+void
+GLPTVolumeUniforms::uploadLights(const Scene* scene)
+{
+  LightBlock blocks[2];
+  memset(blocks, 0, sizeof(blocks));
+  for (int i = 0; i < 2; ++i) {
+    const Light& l = scene->m_lighting.m_Lights[i];
+    LightBlock& b = blocks[i];
+    b.m_theta = l.m_Theta;
+    b.m_phi = l.m_Phi;
+    b.m_width = l.m_Width;
+    b.m_halfWidth = l.m_HalfWidth;
+    b.m_height = l.m_Height;
+    b.m_halfHeight = l.m_HalfHeight;
+    b.m_distance = l.m_Distance;
+    b.m_skyRadius = l.m_SkyRadius;
+    b.m_P = glm::vec4(l.m_P, 0.0f);
+    b.m_target = glm::vec4(l.m_Target, 0.0f);
+    b.m_N = glm::vec4(l.m_N, 0.0f);
+    b.m_U = glm::vec4(l.m_U, 0.0f);
+    b.m_V = l.m_V;
+    b.m_area = l.m_Area;
+    b.m_areaPdf = l.m_AreaPdf;
+    b.m_color = glm::vec4(l.m_Color * l.m_ColorIntensity, 0.0f);
+    b.m_colorTop = glm::vec4(l.m_ColorTop * l.m_ColorTopIntensity, 0.0f);
+    b.m_colorMiddle = glm::vec4(l.m_ColorMiddle * l.m_ColorMiddleIntensity, 0.0f);
+    b.m_colorBottom = l.m_ColorBottom * l.m_ColorBottomIntensity;
+    b.m_T = l.m_T;
+  }
+
+  glBindBuffer(GL_UNIFORM_BUFFER, m_lightsUbo);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(blocks), blocks);
+}
+
+void
+GLPTVolumeUniforms::uploadRenderParams(const Scene* scene,
+                                       const CBoundingBox& clipped_bbox,
+                                       const PathTraceRenderSettings& renderSettings,
+                                       int w,
+                                       int h,
+                                       const ImageGpu& imggpu)
+{
+  RenderParamsBlock block;
+  memset(&block, 0, sizeof(block));
+  block.m_clippedAaBbMin = clipped_bbox.GetMinP();
+  block.m_clippedAaBbMax = clipped_bbox.GetMaxP();
+  block.m_densityScale = renderSettings.m_DensityScale;
+  block.m_stepSize = renderSettings.m_StepSizeFactor * renderSettings.m_GradientDelta;
+  block.m_stepSizeShadow = renderSettings.m_StepSizeFactorShadow * renderSettings.m_GradientDelta;
+  block.m_invAaBbSize = scene->m_boundingBox.GetInverseExtent();
+  block.m_shadingType = renderSettings.m_ShadingType;
+
+  const float GradientDelta = 1.0f * renderSettings.m_GradientDelta;
+  block.m_gradientDeltaX = glm::vec3(GradientDelta, 0.0f, 0.0f);
+  block.m_gradientDeltaY = glm::vec3(0.0f, GradientDelta, 0.0f);
+  block.m_gradientDeltaZ = glm::vec3(0.0f, 0.0f, GradientDelta);
+  block.m_invGradientDelta = 1.0f / GradientDelta;
+  block.m_gradientFactor = renderSettings.m_GradientFactor;
+  block.m_showLights = 0.0f;
+  block.m_resolution = glm::vec2((float)w, (float)h);
+
+  // brick paging
+  if (imggpu.m_bricks) {
+    const BrickPoolGpu& bricks = *imggpu.m_bricks;
+    const BrickLayout& layout = bricks.m_layout;
+    const float padded = (float)layout.paddedBrickSize();
+    block.m_bricked = 1;
+    block.m_brickVolumeSize = glm::vec3(layout.m_volumeSize[0], layout.m_volumeSize[1], layout.m_volumeSize[2]);
+    block.m_brickGridSize = glm::vec3(layout.m_gridSize[0], layout.m_gridSize[1], layout.m_gridSize[2]);
+    block.m_brickSize = (float)layout.m_brickSize;
+    block.m_invBrickPoolSize = glm::vec3(1.0f / (padded * bricks.m_poolSlots[0]),
+                                         1.0f / (padded * bricks.m_poolSlots[1]),
+                                         1.0f / (padded * bricks.m_poolSlots[2]));
+  }
+
+  // volume texture may hold only a sub-region of the image
+  block.m_volumeTexScale = glm::vec3(1.0f);
+  block.m_volumeTexOffset = glm::vec3(0.0f);
+  if (!imggpu.m_bricks && scene->m_volume) {
+    const glm::vec3 fullSize(scene->m_volume->sizeX(), scene->m_volume->sizeY(), scene->m_volume->sizeZ());
+    const glm::vec3 texSize(
+      imggpu.m_volumeTextureSize[0], imggpu.m_volumeTextureSize[1], imggpu.m_volumeTextureSize[2]);
+    const glm::vec3 texOrigin(
+      imggpu.m_volumeTextureOffset[0], imggpu.m_volumeTextureOffset[1], imggpu.m_volumeTextureOffset[2]);
+    if (texSize.x > 0 && texSize.y > 0 && texSize.z > 0) {
+      block.m_volumeTexScale = fullSize / texSize;
+      block.m_volumeTexOffset = -texOrigin / texSize;
+    }
+  }
+
+  glBindBuffer(GL_UNIFORM_BUFFER, m_renderParamsUbo);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+}
+
+void
+GLPTVolumeUniforms::uploadMaterial(const Scene* scene)
+{
+  MaterialBlock block;
+  memset(&block, 0, sizeof(block));
+  block.m_intensityMax = glm::vec4(1.0f);
+  block.m_intensityMin = glm::vec4(0.0f);
+  for (int i = 0; i < MAX_GL_CHANNELS; ++i) {
+    block.m_opacity[i] = glm::vec4(1.0f);
+    block.m_diffuse[i] = glm::vec4(1.0f);
+  }
+
+  int NC = scene->m_volume->sizeC();
+  int activeChannel = 0;
+  for (int i = 0; i < NC; ++i) {
+    if (scene->m_material.m_enabled[i] && activeChannel < MAX_GL_CHANNELS) {
+      block.m_intensityMax[activeChannel] = scene->m_volume->channel(i)->m_max;
+      block.m_intensityMin[activeChannel] = scene->m_volume->channel(i)->m_min;
+      block.m_diffuse[activeChannel] = glm::vec4(scene->m_material.m_diffuse[i * 3 + 0],
+                                                 scene->m_material.m_diffuse[i * 3 + 1],
+                                                 scene->m_material.m_diffuse[i * 3 + 2],
+                                                 0.0f);
+      block.m_specular[activeChannel] = glm::vec4(scene->m_material.m_specular[i * 3 + 0],
+                                                  scene->m_material.m_specular[i * 3 + 1],
+                                                  scene->m_material.m_specular[i * 3 + 2],
+                                                  0.0f);
+      block.m_emissive[activeChannel] = glm::vec4(scene->m_material.m_emissive[i * 3 + 0],
+                                                  scene->m_material.m_emissive[i * 3 + 1],
+                                                  scene->m_material.m_emissive[i * 3 + 2],
+                                                  0.0f);
+      block.m_roughness[activeChannel].x = scene->m_material.m_roughness[i];
+      block.m_opacity[activeChannel].x = scene->m_material.m_opacity[i];
+
+      activeChannel++;
+    }
+  }
+  block.m_nChannels = activeChannel;
+
+  glBindBuffer(GL_UNIFORM_BUFFER, m_materialUbo);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+}
+
+void
+GLPTVolumeUniforms::update(const Scene* scene,
+                           const CCamera& cam,
+                           const CBoundingBox& clipped_bbox,
+                           const PathTraceRenderSettings& renderSettings,
+                           int w,
+                           int h,
+                           const ImageGpu& imggpu,
+                           long dirtyFlags)
+{
+  // the buffers start out empty
+  if (!m_valid) {
+    dirtyFlags = ~0L;
+    m_valid = true;
+  }
+  if (dirtyFlags & (CameraDirty | FilmResolutionDirty)) {
+    // keep the camera of the last image around for reprojecting it
+    glBindBuffer(GL_COPY_READ_BUFFER, m_cameraUbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_previousCameraUbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(CameraBlock));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    uploadCamera(cam);
+  }
+  if (dirtyFlags & (LightsDirty | VolumeDirty)) {
+    uploadLights(scene);
+  }
+  if (dirtyFlags & (RenderParamsDirty | RoiDirty | VolumeDirty | VolumeDataDirty | FilmResolutionDirty)) {
+    uploadRenderParams(scene, clipped_bbox, renderSettings, w, h, imggpu);
+  }
+  // material colors are flagged as render params
+  if (dirtyFlags & (RenderParamsDirty | TransferFunctionDirty | VolumeDirty | VolumeDataDirty)) {
+    uploadMaterial(scene);
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  check_gl("pathtrace uniform buffer upload");
+}
+
+void
+GLPTVolumeUniforms::bind()
+{
+  glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, m_cameraUbo);
+  glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTS_BLOCK_BINDING, m_lightsUbo);
+  glBindBufferBase(GL_UNIFORM_BUFFER, RENDER_PARAMS_BLOCK_BINDING, m_renderParamsUbo);
+  glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, m_materialUbo);
+  glBindBufferBase(GL_UNIFORM_BUFFER, PREVIOUS_CAMERA_BLOCK_BINDING, m_previousCameraUbo);
+  check_gl("pathtrace shader uniform buffers");
+}
+
 void
 GLPTVolumeShader::setShadingUniforms(const Scene* scene,
-                                     const DenoiseParams& denoise,
-                                     const CCamera& cam,
-                                     const CBoundingBox& clipped_bbox,
-                                     const PathTraceRenderSettings& renderSettings,
                                      int numIterations,
                                      int randSeed,
-                                     int w,
-                                     int h,
                                      const ImageGpu& imggpu,
                                      GLuint accumulationTexture)
 {
   check_gl("before pathtrace shader uniform binding");
 
-  glUniform1i(m_volumeTexture, 0);
-  check_gl("post vol textures");
+  // the only values that change every iteration
+  glUniform1f(m_uSampleCounter, (float)numIterations);
+  glUniform1f(m_uFrameCounter, (float)(randSeed + 1));
 
   glActiveTexture(GL_TEXTURE0);
-  check_gl("post vol textures");
   glBindTexture(GL_TEXTURE_2D, 0);
-  check_gl("post vol textures");
   glBindTexture(GL_TEXTURE_3D, imggpu.m_VolumeGLTexture);
   check_gl("post vol textures");
 
-  glUniform1i(m_tPreviousTexture, 1);
   glActiveTexture(GL_TEXTURE0 + 1);
   glBindTexture(GL_TEXTURE_2D, accumulationTexture);
   check_gl("post accum textures");
 
-  glUniform1f(m_uSampleCounter, (float)numIterations);
-  glUniform1f(m_uFrameCounter, (float)(randSeed + 1));
-  // glUniform1f(m_uFrameCounter, 1.0f);
-
-  glUniform2f(m_uResolution, (float)w, (float)h);
-  glUniform3fv(m_gClippedAaBbMax, 1, glm::value_ptr(clipped_bbox.GetMaxP()));
-  glUniform3fv(m_gClippedAaBbMin, 1, glm::value_ptr(clipped_bbox.GetMinP()));
-
-  ///////////////////////////
-  glUniform1f(m_gDensityScale, renderSettings.m_DensityScale);
-  glUniform1f(m_gStepSize, renderSettings.m_StepSizeFactor * renderSettings.m_GradientDelta);
-  glUniform1f(m_gStepSizeShadow, renderSettings.m_StepSizeFactorShadow * renderSettings.m_GradientDelta);
-  glUniform3fv(m_gInvAaBbSize, 1, glm::value_ptr(scene->m_boundingBox.GetInverseExtent()));
-  glUniform1i(m_gShadingType, renderSettings.m_ShadingType);
-
-  const float GradientDelta = 1.0f * renderSettings.m_GradientDelta;
-  const float invGradientDelta = 1.0f / GradientDelta;
-  const glm::vec3 GradientDeltaX(GradientDelta, 0.0f, 0.0f);
-  const glm::vec3 GradientDeltaY(0.0f, GradientDelta, 0.0f);
-  const glm::vec3 GradientDeltaZ(0.0f, 0.0f, GradientDelta);
-
-  glUniform3fv(m_gGradientDeltaX, 1, glm::value_ptr(GradientDeltaX));
-  glUniform3fv(m_gGradientDeltaY, 1, glm::value_ptr(GradientDeltaY));
-  glUniform3fv(m_gGradientDeltaZ, 1, glm::value_ptr(GradientDeltaZ));
-  glUniform1f(m_gInvGradientDelta, invGradientDelta);
-  glUniform1f(m_gGradientFactor, renderSettings.m_GradientFactor);
-
-  glUniform3fv(m_cameraFrom, 1, glm::value_ptr(cam.m_From));
-  glUniform3fv(m_cameraU, 1, glm::value_ptr(cam.m_U));
-  glUniform3fv(m_cameraV, 1, glm::value_ptr(cam.m_V));
-  glUniform3fv(m_cameraN, 1, glm::value_ptr(cam.m_N));
-  glUniform4fv(m_cameraScreen, 1, (float*)cam.m_Film.m_Screen);
-  glUniform2fv(m_cameraInvScreen, 1, glm::value_ptr(cam.m_Film.m_InvScreen));
-  glUniform1f(m_cameraFocalDistance, cam.m_Focus.m_FocalDistance);
-  glUniform1f(m_cameraApertureSize, cam.m_Aperture.m_Size);
-  glUniform1f(m_cameraProjectionMode, (cam.m_Projection == PERSPECTIVE) ? 1.0f : 0.0f);
-  check_gl("pre lights");
-
-  const Light& l = scene->m_lighting.m_Lights[0];
-  glUniform1f(m_light0theta, l.m_Theta);
-  glUniform1f(m_light0phi, l.m_Phi);
-  glUniform1f(m_light0width, l.m_Width);
-  glUniform1f(m_light0halfWidth, l.m_HalfWidth);
-  glUniform1f(m_light0height, l.m_Height);
-  glUniform1f(m_light0halfHeight, l.m_HalfHeight);
-  glUniform1f(m_light0distance, l.m_Distance);
-  glUniform1f(m_light0skyRadius, l.m_SkyRadius);
-  glUniform3fv(m_light0P, 1, glm::value_ptr(l.m_P));
-  glUniform3fv(m_light0target, 1, glm::value_ptr(l.m_Target));
-  glUniform3fv(m_light0N, 1, glm::value_ptr(l.m_N));
-  glUniform3fv(m_light0U, 1, glm::value_ptr(l.m_U));
-  glUniform3fv(m_light0V, 1, glm::value_ptr(l.m_V));
-  glUniform1f(m_light0area, l.m_Area);
-  glUniform1f(m_light0areaPdf, l.m_AreaPdf);
-  glUniform3fv(m_light0color, 1, glm::value_ptr(l.m_Color * l.m_ColorIntensity));
-  glUniform3fv(m_light0colorTop, 1, glm::value_ptr(l.m_ColorTop * l.m_ColorTopIntensity));
-  glUniform3fv(m_light0colorMiddle, 1, glm::value_ptr(l.m_ColorMiddle * l.m_ColorMiddleIntensity));
-  glUniform3fv(m_light0colorBottom, 1, glm::value_ptr(l.m_ColorBottom * l.m_ColorBottomIntensity));
-  glUniform1i(m_light0T, l.m_T);
-
-  const Light& l1 = scene->m_lighting.m_Lights[1];
-  glUniform1f(m_light1theta, l1.m_Theta);
-  glUniform1f(m_light1phi, l1.m_Phi);
-  glUniform1f(m_light1width, l1.m_Width);
-  glUniform1f(m_light1halfWidth, l1.m_HalfWidth);
-  glUniform1f(m_light1height, l1.m_Height);
-  glUniform1f(m_light1halfHeight, l1.m_HalfHeight);
-  glUniform1f(m_light1distance, l1.m_Distance);
-  glUniform1f(m_light1skyRadius, l1.m_SkyRadius);
-  glUniform3fv(m_light1P, 1, glm::value_ptr(l1.m_P));
-  glUniform3fv(m_light1target, 1, glm::value_ptr(l1.m_Target));
-  glUniform3fv(m_light1N, 1, glm::value_ptr(l1.m_N));
-  glUniform3fv(m_light1U, 1, glm::value_ptr(l1.m_U));
-  glUniform3fv(m_light1V, 1, glm::value_ptr(l1.m_V));
-  glUniform1f(m_light1area, l1.m_Area);
-  glUniform1f(m_light1areaPdf, l1.m_AreaPdf);
-  glUniform3fv(m_light1color, 1, glm::value_ptr(l1.m_Color * l1.m_ColorIntensity));
-  glUniform3fv(m_light1colorTop, 1, glm::value_ptr(l1.m_ColorTop * l1.m_ColorTopIntensity));
-  glUniform3fv(m_light1colorMiddle, 1, glm::value_ptr(l1.m_ColorMiddle * l1.m_ColorMiddleIntensity));
-  glUniform3fv(m_light1colorBottom, 1, glm::value_ptr(l1.m_ColorBottom * l1.m_ColorBottomIntensity));
-  glUniform1i(m_light1T, l1.m_T);
-
-  // per channel
   int NC = scene->m_volume->sizeC();
-
   int activeChannel = 0;
-  int luttex[4] = { 0, 0, 0, 0 };
-  float intensitymax[4] = { 1, 1, 1, 1 };
-  float intensitymin[4] = { 0, 0, 0, 0 };
-  float diffuse[3 * 4] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
-  float specular[3 * 4] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-  float emissive[3 * 4] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-  float roughness[4] = { 0, 0, 0, 0 };
-  float opacity[4] = { 1, 1, 1, 1 };
+  GLuint luttex[MAX_GL_CHANNELS] = { 0, 0, 0, 0 };
   for (int i = 0; i < NC; ++i) {
     if (scene->m_material.m_enabled[i] && activeChannel < MAX_GL_CHANNELS) {
       luttex[activeChannel] = imggpu.m_channels[i].m_VolumeLutGLTexture;
-      intensitymax[activeChannel] = scene->m_volume->channel(i)->m_max;
-      intensitymin[activeChannel] = scene->m_volume->channel(i)->m_min;
-      diffuse[activeChannel * 3 + 0] = scene->m_material.m_diffuse[i * 3 + 0];
-      diffuse[activeChannel * 3 + 1] = scene->m_material.m_diffuse[i * 3 + 1];
-      diffuse[activeChannel * 3 + 2] = scene->m_material.m_diffuse[i * 3 + 2];
-      specular[activeChannel * 3 + 0] = scene->m_material.m_specular[i * 3 + 0];
-      specular[activeChannel * 3 + 1] = scene->m_material.m_specular[i * 3 + 1];
-      specular[activeChannel * 3 + 2] = scene->m_material.m_specular[i * 3 + 2];
-      emissive[activeChannel * 3 + 0] = scene->m_material.m_emissive[i * 3 + 0];
-      emissive[activeChannel * 3 + 1] = scene->m_material.m_emissive[i * 3 + 1];
-      emissive[activeChannel * 3 + 2] = scene->m_material.m_emissive[i * 3 + 2];
-      roughness[activeChannel] = scene->m_material.m_roughness[i];
-      opacity[activeChannel] = scene->m_material.m_opacity[i];
-
       activeChannel++;
     }
   }
-  glUniform1i(m_g_nChannels, activeChannel);
-  check_gl("pre lut textures");
-
-  glUniform1i(m_lutTexture0, 3);
-  glActiveTexture(GL_TEXTURE0 + 3);
-  glBindTexture(GL_TEXTURE_2D, luttex[0]);
-  check_gl("lut 0");
-
-  glUniform1i(m_lutTexture1, 4);
-  glActiveTexture(GL_TEXTURE0 + 4);
-  glBindTexture(GL_TEXTURE_2D, luttex[1]);
-  check_gl("lut 1");
-
-  glUniform1i(m_lutTexture2, 5);
-  glActiveTexture(GL_TEXTURE0 + 5);
-  glBindTexture(GL_TEXTURE_2D, luttex[2]);
-  check_gl("lut 2");
-
-  glUniform1i(m_lutTexture3, 6);
-  glActiveTexture(GL_TEXTURE0 + 6);
-  glBindTexture(GL_TEXTURE_2D, luttex[3]);
-  check_gl("lut 3");
-
-  glUniform4fv(m_intensityMax, 1, intensitymax);
-  glUniform4fv(m_intensityMin, 1, intensitymin);
-  glUniform1fv(m_opacity, 4, opacity);
-  glUniform3fv(m_emissive0, 1, emissive + 0);
-  glUniform3fv(m_emissive1, 1, emissive + 3);
-  glUniform3fv(m_emissive2, 1, emissive + 6);
-  glUniform3fv(m_emissive3, 1, emissive + 9);
-  glUniform3fv(m_diffuse0, 1, diffuse + 0);
-  glUniform3fv(m_diffuse1, 1, diffuse + 3);
-  glUniform3fv(m_diffuse2, 1, diffuse + 6);
-  glUniform3fv(m_diffuse3, 1, diffuse + 9);
-  glUniform3fv(m_specular0, 1, specular + 0);
-  glUniform3fv(m_specular1, 1, specular + 3);
-  glUniform3fv(m_specular2, 1, specular + 6);
-  glUniform3fv(m_specular3, 1, specular + 9);
-  glUniform1fv(m_roughness, 4, roughness);
-
-  glUniform1i(m_uShowLights, 0);
+  for (int i = 0; i < MAX_GL_CHANNELS; ++i) {
+    glActiveTexture(GL_TEXTURE0 + 3 + i);
+    glBindTexture(GL_TEXTURE_2D, luttex[i]);
+  }
+  check_gl("lut textures");
+
+  if (imggpu.m_bricks) {
+    glActiveTexture(GL_TEXTURE0 + 7);
+    glBindTexture(GL_TEXTURE_3D, imggpu.m_bricks->m_poolTexture);
+    glActiveTexture(GL_TEXTURE0 + 8);
+    glBindTexture(GL_TEXTURE_3D, imggpu.m_bricks->m_pageTableTexture);
+    check_gl("brick textures");
+  }
+
+  for (int i = 0; i < imggpu.m_gradientChannels; ++i) {
+    glActiveTexture(GL_TEXTURE0 + GRADIENT_TEXTURE_UNITS[i]);
+    glBindTexture(GL_TEXTURE_3D, imggpu.m_GradientGLTextures[i]);
+    check_gl("gradient texture");
+  }
 
   check_gl("pathtrace shader uniform binding");
 }
 
+void
+GLPTVolumeShader::setTransmittanceSlice(float z)
+{
+  glUniform1f(m_uTransmittanceSlice, z);
+}
+
+void
+GLPTVolumeShader::setAdaptiveSampling(float errorTarget, GLuint momentsTexture)
+{
+  glUniform1f(m_uErrorTarget, errorTarget);
+  glActiveTexture(GL_TEXTURE0 + 2);
+  glBindTexture(GL_TEXTURE_2D, momentsTexture);
+  check_gl("adaptive sampling uniforms");
+}
+
+void
+GLPTVolumeShader::setTemporalReprojection(GLuint historyTexture)
+{
+  glActiveTexture(GL_TEXTURE0 + 11);
+  glBindTexture(GL_TEXTURE_2D, historyTexture);
+  check_gl("temporal reprojection uniforms");
+}
+
+GLPTVolumeShaderVariant
+GLPTVolumeShaderVariant::select(const Scene* scene, const CCamera& cam, const PathTraceRenderSettings& renderSettings)
+{
+  GLPTVolumeShaderVariant variant;
+  variant.m_numChannels = 0;
+  for (uint32_t i = 0; i < scene->m_volume->sizeC() && variant.m_numChannels < MAX_GL_CHANNELS; ++i) {
+    if (scene->m_material.m_enabled[i]) {
+      variant.m_numChannels++;
+    }
+  }
+  variant.m_shadingType = std::min(std::max(renderSettings.m_ShadingType, 0), 2);
+  variant.m_perspective = (cam.m_Projection == PERSPECTIVE);
+  variant.m_adaptiveSampling = (renderSettings.m_ErrorTarget > 0.0f);
+  // adaptive sampling keeps its own per pixel counts, which reprojection would have to carry over too
+  variant.m_reprojection = renderSettings.m_TemporalReprojection && !variant.m_adaptiveSampling;
+  return variant;
+}
+
+GLPTVolumeShaderCache::~GLPTVolumeShaderCache()
+{
+  clear();
+}
+
+GLPTVolumeShader*
+GLPTVolumeShaderCache::get(const GLPTVolumeShaderVariant& variant)
+{
+  int key = variant.m_numChannels | (variant.m_shadingType << 4) | ((variant.m_perspective ? 1 : 0) << 8) |
+            ((variant.m_precomputedGradient ? 1 : 0) << 9) | ((variant.m_cachedTransmittance ? 1 : 0) << 10) |
+            ((variant.m_transmittancePass ? 1 : 0) << 11) | ((variant.m_adaptiveSampling ? 1 : 0) << 12) |
+            ((variant.m_reprojection ? 1 : 0) << 13) | ((variant.m_reprojectionPass ? 1 : 0) << 14) |
+            ((variant.m_denoiseFeatures ? 1 : 0) << 15);
+  auto it = m_shaders.find(key);
+  if (it != m_shaders.end()) {
+    return it->second;
+  }
+
+  LOG_DEBUG << "Compiling path trace shader for " << variant.m_numChannels << " channels, shading type "
+            << variant.m_shadingType << (variant.m_perspective ? ", perspective" : ", orthographic")
+            << (variant.m_precomputedGradient ? ", precomputed gradients" : "")
+            << (variant.m_cachedTransmittance ? ", cached shadows" : "")
+            << (variant.m_transmittancePass ? ", transmittance pass" : "")
+            << (variant.m_adaptiveSampling ? ", adaptive sampling" : "")
+            << (variant.m_reprojection ? ", temporal reprojection" : "")
+            << (variant.m_reprojectionPass ? ", reprojection pass" : "")
+            << (variant.m_denoiseFeatures ? ", denoise features" : "");
+  GLPTVolumeShader* shader = new GLPTVolumeShader(variant);
+  m_shaders[key] = shader;
+  return shader;
+}
+
+void
+GLPTVolumeShaderCache::clear()
+{
+  for (auto& it : m_shaders) {
+    delete it.second;
+  }
+  m_shaders.clear();
+}
+
 void
 GLPTVolumeShader::setTransformUniforms(const CCamera& camera, const glm::mat4& modelMatrix)
 {
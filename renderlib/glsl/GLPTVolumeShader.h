@@ -7,6 +7,8 @@
 
 #include <glm.h>
 
+#include <map>
+
 #define MAX_GL_CHANNELS 4
 
 class DenoiseParams;
@@ -14,6 +16,34 @@ struct PathTraceRenderSettings;
 struct ImageGpu;
 class Scene;
 
+// Compile time specialization of the path trace fragment shader.
+struct GLPTVolumeShaderVariant
+{
+  // enabled channels in the volume texture, 0..MAX_GL_CHANNELS
+  int m_numChannels = 1;
+  // PathTraceRenderSettings::m_ShadingType: 0 brdf, 1 phase function, 2 mixed by gradient magnitude
+  int m_shadingType = 2;
+  bool m_perspective = true;
+  // read shading gradients from ImageGpu::m_GradientGLTextures instead of differencing the volume
+  bool m_precomputedGradient = false;
+  // approximate shadow rays with a lookup into a cached transmittance volume instead of marching them
+  bool m_cachedTransmittance = false;
+  // instead of path tracing, fill one slice of the transmittance volume
+  bool m_transmittancePass = false;
+  // track per pixel luminance moments and stop sampling pixels that reached the error target
+  bool m_adaptiveSampling = false;
+  // track per pixel first scattering depth and sample counts so the accumulation can follow camera moves
+  bool m_reprojection = false;
+  // instead of path tracing, warp the previous accumulation into the current camera. Requires m_reprojection.
+  bool m_reprojectionPass = false;
+  // sum up the first scattering features that guide the denoiser
+  bool m_denoiseFeatures = false;
+
+  static GLPTVolumeShaderVariant select(const Scene* scene,
+                                        const CCamera& cam,
+                                        const PathTraceRenderSettings& renderSettings);
+};
+
 class GLPTVolumeShader : public GLShaderProgram
 {
 
@@ -21,26 +51,27 @@ public:
   /**
    * Constructor.
    *
-   * @param parent the parent of this object.
+   * @param variant the specialization to compile.
    */
-  explicit GLPTVolumeShader();
+  explicit GLPTVolumeShader(const GLPTVolumeShaderVariant& variant);
 
   /// Destructor.
   ~GLPTVolumeShader();
 
   void setTransformUniforms(const CCamera& camera, const glm::mat4& modelMatrix);
 
+  // per iteration state. Everything else comes from the uniform blocks of GLPTVolumeUniforms.
   void setShadingUniforms(const Scene* scene,
-                          const DenoiseParams& denoise,
-                          const CCamera& cam,
-                          const CBoundingBox& clipped_bbox,
-                          const PathTraceRenderSettings& renderSettings,
                           int numIterations,
                           int randSeed,
-                          int w,
-                          int h,
                           const ImageGpu& imggpu,
                           GLuint accumulationTexture);
+  // transmittance pass only: z texture coordinate of the slice being rendered
+  void setTransmittanceSlice(float z);
+  // adaptive sampling only: relative error at which a pixel is converged, and the previous moments buffer
+  void setAdaptiveSampling(float errorTarget, GLuint momentsTexture);
+  // temporal reprojection only: the previous depth and sample count buffer
+  void setTemporalReprojection(GLuint historyTexture);
 
 private:
   /// The vertex shader.
@@ -48,21 +79,60 @@ private:
   /// The fragment shader.
   GLShader* m_fshader;
 
-  int m_volumeTexture;
-  int m_tPreviousTexture, m_uSampleCounter, m_uFrameCounter, m_uResolution, m_gClippedAaBbMin, m_gClippedAaBbMax,
-    m_gDensityScale, m_gStepSize, m_gStepSizeShadow, m_gInvAaBbSize, m_g_nChannels, m_gShadingType, m_gGradientDeltaX,
-    m_gGradientDeltaY, m_gGradientDeltaZ, m_gInvGradientDelta, m_gGradientFactor;
-  int m_cameraFrom, m_cameraU, m_cameraV, m_cameraN, m_cameraScreen, m_cameraInvScreen, m_cameraFocalDistance,
-    m_cameraApertureSize, m_cameraProjectionMode;
-
-  int m_light0theta, m_light0phi, m_light0width, m_light0halfWidth, m_light0height, m_light0halfHeight,
-    m_light0distance, m_light0skyRadius, m_light0P, m_light0target, m_light0N, m_light0U, m_light0V, m_light0area,
-    m_light0areaPdf, m_light0color, m_light0colorTop, m_light0colorMiddle, m_light0colorBottom, m_light0T;
-  int m_light1theta, m_light1phi, m_light1width, m_light1halfWidth, m_light1height, m_light1halfHeight,
-    m_light1distance, m_light1skyRadius, m_light1P, m_light1target, m_light1N, m_light1U, m_light1V, m_light1area,
-    m_light1areaPdf, m_light1color, m_light1colorTop, m_light1colorMiddle, m_light1colorBottom, m_light1T;
-
-  int m_lutTexture0, m_lutTexture1, m_lutTexture2, m_lutTexture3, m_intensityMax, m_intensityMin, m_opacity,
-    m_emissive0, m_emissive1, m_emissive2, m_emissive3, m_diffuse0, m_diffuse1, m_diffuse2, m_diffuse3, m_specular0,
-    m_specular1, m_specular2, m_specular3, m_roughness, m_uShowLights;
+  void bindUniformBlock(const char* name, GLuint binding);
+
+  int m_uSampleCounter, m_uFrameCounter, m_uTransmittanceSlice, m_uErrorTarget;
+};
+
+// The std140 uniform blocks of the path trace shader, shared by all of its variants.
+class GLPTVolumeUniforms
+{
+public:
+  GLPTVolumeUniforms();
+  ~GLPTVolumeUniforms();
+
+  // dirtyFlags are the EDirty flags that changed since the last call; only the blocks that depend on them
+  // are re-uploaded.
+  void update(const Scene* scene,
+              const CCamera& cam,
+              const CBoundingBox& clipped_bbox,
+              const PathTraceRenderSettings& renderSettings,
+              int w,
+              int h,
+              const ImageGpu& imggpu,
+              long dirtyFlags);
+  // attach the buffers to the block binding points
+  void bind();
+
+private:
+  GLuint createUniformBuffer(size_t size);
+
+  void uploadCamera(const CCamera& cam);
+  void uploadLights(const Scene* scene);
+  void uploadRenderParams(const Scene* scene,
+                          const CBoundingBox& clipped_bbox,
+                          const PathTraceRenderSettings& renderSettings,
+                          int w,
+                          int h,
+                          const ImageGpu& imggpu);
+  void uploadMaterial(const Scene* scene);
+
+  GLuint m_cameraUbo, m_lightsUbo, m_renderParamsUbo, m_materialUbo;
+  // copy of the camera block before its last change
+  GLuint m_previousCameraUbo;
+  // false until every buffer has been uploaded once
+  bool m_valid;
+};
+
+// Path trace shader variants, compiled the first time they are used.
+class GLPTVolumeShaderCache
+{
+public:
+  ~GLPTVolumeShaderCache();
+
+  GLPTVolumeShader* get(const GLPTVolumeShaderVariant& variant);
+  void clear();
+
+private:
+  std::map<int, GLPTVolumeShader*> m_shaders;
 };
@@ -4,6 +4,11 @@
 #include "ImageXyzcGpu.h"
 #include "Logging.h"
 
+#include "gl/Util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
 #include <string>
 
 #if HAS_EGL
@@ -15,15 +20,29 @@ static bool renderLibInitialized = false;
 
 static bool renderLibHeadless = false;
 #if HAS_EGL
-static EGLDisplay eglDpy = NULL;
+// one display per device in the renderer pool. A device may be listed more than once, e.g. to spread sessions over
+// several software renderers when testing without gpus.
+static std::vector<EGLDisplay> eglDisplays;
+// every headless context shares textures with the root context of its device
+static std::vector<EGLContext> eglShareCtxs;
 #endif
 
+// The dummy contexts live until cleanup as the root of the gl share group, so that gpu images
+// preloaded in them can be read by every renderer context.
 static QOpenGLContext* dummyContext = nullptr;
 static QOffscreenSurface* dummySurface = nullptr;
+static std::vector<HeadlessGLContext*> dummyHeadlessContexts;
+
+// video memory free on each device when it was initialized, in bytes; 0 where the driver does not report it
+static std::vector<size_t> deviceFreeMemory(1, 0);
+// the device of the context that is current on this thread
+static thread_local int currentDeviceIndex = 0;
 
 static QOpenGLDebugLogger* logger = nullptr;
 
-std::map<std::shared_ptr<ImageXYZC>, std::shared_ptr<ImageGpu>> renderlib::sGpuImageCache;
+std::map<std::pair<int, std::shared_ptr<ImageXYZC>>, std::shared_ptr<ImageGpu>> renderlib::sGpuImageCache;
+// renderers look up the cache from their own threads
+static std::mutex sGpuImageCacheMutex;
 
 static const struct
 {
@@ -63,6 +82,9 @@ renderlib::createOpenGLContext()
 {
   QOpenGLContext* context = new QOpenGLContext();
   context->setFormat(getQSurfaceFormat()); // ...and set the format on the context too
+  if (dummyContext) {
+    context->setShareContext(dummyContext);
+  }
 
   bool createdOk = context->create();
   if (!createdOk) {
@@ -94,13 +116,15 @@ getEGLDefaultDisplay()
 {
   EGLint lastError = EGL_SUCCESS;
   EGLDisplay eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
-  LOG_INFO << "eglGetDisplay returns " << eglDpy;
+  LOG_INFO << "eglGetDisplay returns " << eglDisplay;
   checkEGLError("Failed eglGetDisplay");
   return eglDisplay;
 }
 
-EGLDisplay
-initEGLDisplay(int selectedGpu)
+// One display per selected device index. No indices selects every device, leaving out software renderers
+// when there is real hardware.
+std::vector<EGLDisplay>
+initEGLDisplays(const std::vector<int>& selectedGpus)
 {
   PFNEGLQUERYDEVICESEXTPROC eglQueryDevicesEXT = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
   checkEGLError("Failed to get EGLEXT: eglQueryDevicesEXT");
@@ -115,7 +139,7 @@ initEGLDisplay(int selectedGpu)
   checkEGLError("Failed to get EGLEXT: eglQueryDeviceStringEXT");
 
   if (!eglQueryDevicesEXT || !eglGetPlatformDisplayEXT || !eglQueryDeviceAttribEXT || !eglQueryDeviceStringEXT) {
-    return getEGLDefaultDisplay();
+    return { getEGLDefaultDisplay() };
   }
 
   EGLint numberDevices;
@@ -134,6 +158,7 @@ initEGLDisplay(int selectedGpu)
       LOG_ERROR << "Failed to get devices. Bad parameter suspected";
     }
     checkEGLError("Error getting number of devices: eglQueryDevicesEXT");
+    std::vector<int> hardwareDevices;
     for (int i = 0; i < numberDevices; ++i) {
       LOG_INFO << "Device " << i << ":";
 #ifdef EGL_VENDOR
@@ -156,24 +181,46 @@ initEGLDisplay(int selectedGpu)
       if (extensionsstring) {
         LOG_INFO << "  Extensions: " << extensionsstring;
       }
+      if (!extensionsstring || !strstr(extensionsstring, "EGL_MESA_device_software")) {
+        hardwareDevices.push_back(i);
+      }
+#else
+      hardwareDevices.push_back(i);
 #endif
     }
-    if (selectedGpu >= numberDevices || selectedGpu < 0) {
-      LOG_WARNING << "Invalid GPU " << selectedGpu << " requested. Using default gpu.";
-      return getEGLDefaultDisplay();
+
+    std::vector<int> devices = selectedGpus;
+    if (devices.empty()) {
+      devices = hardwareDevices;
     }
-    // select device by index
-    EGLDisplay eglDisplay = eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, eglDevs[selectedGpu], 0);
-    checkEGLError("Error getting Platform Display: eglGetPlatformDisplayEXT");
-    return eglDisplay;
+    if (devices.empty()) {
+      for (int i = 0; i < numberDevices; ++i) {
+        devices.push_back(i);
+      }
+    }
+
+    std::vector<EGLDisplay> displays;
+    for (int selectedGpu : devices) {
+      if (selectedGpu >= numberDevices || selectedGpu < 0) {
+        LOG_WARNING << "Invalid GPU " << selectedGpu << " requested. Using default gpu.";
+        displays.push_back(getEGLDefaultDisplay());
+        continue;
+      }
+      // select device by index
+      EGLDisplay eglDisplay = eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, eglDevs[selectedGpu], 0);
+      checkEGLError("Error getting Platform Display: eglGetPlatformDisplayEXT");
+      displays.push_back(eglDisplay);
+    }
+    delete[] eglDevs;
+    return displays;
   } else {
-    return getEGLDefaultDisplay();
+    return { getEGLDefaultDisplay() };
   }
 }
 #endif
 
 int
-renderlib::initialize(bool headless, bool listDevices, int selectedGpu)
+renderlib::initialize(bool headless, bool listDevices, const std::vector<int>& selectedGpus)
 {
   if (renderLibInitialized) {
     return 1;
@@ -194,8 +241,6 @@ renderlib::initialize(bool headless, bool listDevices, int selectedGpu)
   QSurfaceFormat format = getQSurfaceFormat();
   QSurfaceFormat::setDefaultFormat(format);
 
-  HeadlessGLContext* dummyHeadlessContext = nullptr;
-
   if (headless) {
 #if HAS_EGL
 
@@ -204,20 +249,22 @@ renderlib::initialize(bool headless, bool listDevices, int selectedGpu)
     EGLint lastError = EGL_SUCCESS;
 
     // 1. Initialize EGL
-    eglDpy = initEGLDisplay(selectedGpu);
+    eglDisplays = initEGLDisplays(selectedGpus);
 
     if (listDevices) {
       return 0;
     }
 
-    EGLint major, minor;
+    for (EGLDisplay eglDpy : eglDisplays) {
+      EGLint major, minor;
 
-    EGLBoolean init_ok = eglInitialize(eglDpy, &major, &minor);
-    if (init_ok == EGL_FALSE) {
-      LOG_ERROR << "renderlib::initialize, eglInitialize failed";
-    }
-    if ((lastError = eglGetError()) != EGL_SUCCESS) {
-      LOG_ERROR << "eglGetError " << lastError;
+      EGLBoolean init_ok = eglInitialize(eglDpy, &major, &minor);
+      if (init_ok == EGL_FALSE) {
+        LOG_ERROR << "renderlib::initialize, eglInitialize failed";
+      }
+      if ((lastError = eglGetError()) != EGL_SUCCESS) {
+        LOG_ERROR << "eglGetError " << lastError;
+      }
     }
     // 2. Bind the API
     EGLBoolean bindapi_ok = eglBindAPI(EGL_OPENGL_API);
@@ -227,8 +274,13 @@ renderlib::initialize(bool headless, bool listDevices, int selectedGpu)
     if ((lastError = eglGetError()) != EGL_SUCCESS) {
       LOG_ERROR << "eglGetError " << lastError;
     }
-    dummyHeadlessContext = new HeadlessGLContext();
-    dummyHeadlessContext->makeCurrent();
+    eglShareCtxs.assign(eglDisplays.size(), EGL_NO_CONTEXT);
+    deviceFreeMemory.assign(eglDisplays.size(), 0);
+    for (int i = 0; i < (int)eglDisplays.size(); ++i) {
+      dummyHeadlessContexts.push_back(new HeadlessGLContext(i));
+      eglShareCtxs[i] = dummyHeadlessContexts[i]->eglContext();
+    }
+    dummyHeadlessContexts[0]->makeCurrent();
 #else
     LOG_ERROR << "Headless operation without EGL support is not available";
 #endif
@@ -267,10 +319,21 @@ renderlib::initialize(bool headless, bool listDevices, int selectedGpu)
     return status;
   }
 
-  LOG_INFO << "GL_VENDOR: " << std::string((char*)glGetString(GL_VENDOR));
-  LOG_INFO << "GL_RENDERER: " << std::string((char*)glGetString(GL_RENDERER));
+  // the gl entry points dispatch on the current context, so one load serves every device
+  for (int i = 0; i < deviceCount(); ++i) {
+    if (headless) {
+      dummyHeadlessContexts[i]->makeCurrent();
+    }
+    LOG_INFO << "Device " << i << " GL_VENDOR: " << std::string((char*)glGetString(GL_VENDOR));
+    LOG_INFO << "Device " << i << " GL_RENDERER: " << std::string((char*)glGetString(GL_RENDERER));
+
+    deviceFreeMemory[i] = queryFreeVideoMemory();
+    LOG_INFO << "Device " << i << " free memory: " << (deviceFreeMemory[i] / (1024 * 1024)) << " MB";
+  }
+  if (headless) {
+    dummyHeadlessContexts[0]->makeCurrent();
+  }
 
-  delete dummyHeadlessContext;
   return status;
 }
 
@@ -278,7 +341,12 @@ void
 renderlib::clearGpuVolumeCache()
 {
   // clean up the shared gpu buffer cache
+  std::lock_guard<std::mutex> lock(sGpuImageCacheMutex);
   for (auto i : sGpuImageCache) {
+    // the textures belong to the root context of their device
+    if (renderLibHeadless && i.first.first != currentDevice()) {
+      makeDeviceCurrent(i.first.first);
+    }
     i.second->deallocGpu();
   }
   sGpuImageCache.clear();
@@ -303,7 +371,18 @@ renderlib::cleanup()
 
   if (renderLibHeadless) {
 #if HAS_EGL
-    eglTerminate(eglDpy);
+    for (HeadlessGLContext* ctx : dummyHeadlessContexts) {
+      delete ctx;
+    }
+    dummyHeadlessContexts.clear();
+    eglShareCtxs.clear();
+    // devices listed more than once share their display
+    std::sort(eglDisplays.begin(), eglDisplays.end());
+    eglDisplays.erase(std::unique(eglDisplays.begin(), eglDisplays.end()), eglDisplays.end());
+    for (EGLDisplay eglDpy : eglDisplays) {
+      eglTerminate(eglDpy);
+    }
+    eglDisplays.clear();
 #endif
   }
   renderLibInitialized = false;
@@ -312,37 +391,97 @@ renderlib::cleanup()
 std::shared_ptr<ImageGpu>
 renderlib::imageAllocGPU(std::shared_ptr<ImageXYZC> image, bool do_cache)
 {
-  auto cached = sGpuImageCache.find(image);
+  std::lock_guard<std::mutex> lock(sGpuImageCacheMutex);
+  auto key = std::make_pair(currentDevice(), image);
+  auto cached = sGpuImageCache.find(key);
   if (cached != sGpuImageCache.end()) {
     return cached->second;
   }
 
   ImageGpu* cimg = new ImageGpu;
-  cimg->allocGpuInterleaved(image.get());
+  if (ImageGpu::needsBricking(image.get(), 0)) {
+    cimg->allocGpuBricked(image.get(), ImageGpu::DEFAULT_BRICK_POOL_BYTES);
+  } else {
+    cimg->allocGpuInterleaved(image.get());
+  }
   std::shared_ptr<ImageGpu> shared(cimg);
 
   if (do_cache) {
-    sGpuImageCache[image] = shared;
+    sGpuImageCache[key] = shared;
   }
 
   return shared;
 }
 
+std::shared_ptr<ImageGpu>
+renderlib::findCachedGpuImage(std::shared_ptr<ImageXYZC> image)
+{
+  std::lock_guard<std::mutex> lock(sGpuImageCacheMutex);
+  auto cached = sGpuImageCache.find(std::make_pair(currentDevice(), image));
+  if (cached != sGpuImageCache.end()) {
+    return cached->second;
+  }
+  return nullptr;
+}
+
+size_t
+renderlib::gpuCacheBytes(int device)
+{
+  std::lock_guard<std::mutex> lock(sGpuImageCacheMutex);
+  size_t bytes = 0;
+  for (auto i : sGpuImageCache) {
+    if (i.first.first == device) {
+      bytes += i.second->m_gpuBytes;
+    }
+  }
+  return bytes;
+}
+
+int
+renderlib::deviceCount()
+{
+  return (int)deviceFreeMemory.size();
+}
+
+size_t
+renderlib::deviceFreeMemoryBytes(int device)
+{
+  return (device >= 0 && device < deviceCount()) ? deviceFreeMemory[device] : 0;
+}
+
+int
+renderlib::currentDevice()
+{
+  return currentDeviceIndex;
+}
+
+void
+renderlib::makeDeviceCurrent(int device)
+{
+  if (device < 0 || device >= (int)dummyHeadlessContexts.size()) {
+    return;
+  }
+  dummyHeadlessContexts[device]->makeCurrent();
+}
+
 void
 renderlib::imageDeallocGPU(std::shared_ptr<ImageXYZC> image)
 {
-  auto cached = sGpuImageCache.find(image);
+  std::lock_guard<std::mutex> lock(sGpuImageCacheMutex);
+  auto cached = sGpuImageCache.find(std::make_pair(currentDevice(), image));
   if (cached != sGpuImageCache.end()) {
     // cached->second is a ImageGpu.
     // outstanding shared refs to cached->second will be deallocated!?!?!?!
     cached->second->deallocGpu();
-    sGpuImageCache.erase(image);
+    sGpuImageCache.erase(cached);
   }
 }
 
-HeadlessGLContext::HeadlessGLContext()
+HeadlessGLContext::HeadlessGLContext(int device)
+  : m_device(device)
 {
 #if HAS_EGL
+  EGLDisplay eglDpy = eglDisplays[m_device];
   EGLint lastError = EGL_SUCCESS;
 
   // Bind the API
@@ -387,7 +526,7 @@ HeadlessGLContext::HeadlessGLContext()
   static const EGLint contextAttribs[] = {
     EGL_CONTEXT_MAJOR_VERSION, AICS_GL_VERSION.major, EGL_CONTEXT_MINOR_VERSION, AICS_GL_VERSION.minor, EGL_NONE
   };
-  EGLContext eglCtx = eglCreateContext(eglDpy, eglCfg, EGL_NO_CONTEXT, contextAttribs);
+  EGLContext eglCtx = eglCreateContext(eglDpy, eglCfg, eglShareCtxs[m_device], contextAttribs);
   if (eglCtx == EGL_NO_CONTEXT) {
     LOG_ERROR << "renderlib::initialize, eglCreateContext failed";
   } else {
@@ -404,7 +543,7 @@ HeadlessGLContext::HeadlessGLContext()
 HeadlessGLContext::~HeadlessGLContext()
 {
 #if HAS_EGL
-  eglDestroyContext(eglDpy, m_eglCtx);
+  eglDestroyContext(eglDisplays[m_device], m_eglCtx);
 #endif
 }
 
@@ -413,15 +552,16 @@ HeadlessGLContext::makeCurrent()
 {
 #if HAS_EGL
   LOG_INFO << "pre-eglMakeCurrent";
-  eglMakeCurrent(eglDpy, EGL_NO_SURFACE, EGL_NO_SURFACE, m_eglCtx);
+  eglMakeCurrent(eglDisplays[m_device], EGL_NO_SURFACE, EGL_NO_SURFACE, m_eglCtx);
   LOG_INFO << "post-eglMakeCurrent";
 #endif
+  currentDeviceIndex = m_device;
 }
 
 void
 HeadlessGLContext::doneCurrent()
 {
 #if HAS_EGL
-  eglMakeCurrent(eglDpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglMakeCurrent(eglDisplays[m_device], EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
 #endif
 }
@@ -11,6 +11,8 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #if defined(__APPLE__) || defined(_WIN32)
 #define HAS_EGL false
@@ -26,7 +28,10 @@ typedef void* EGLContext; // Forward declaration from EGL.h.
 class renderlib
 {
 public:
-  static int initialize(bool headless = false, bool listDevices = false, int selectedGpu = 0);
+  // In headless mode, selectedGpus lists the EGL devices to render on; empty selects all of them.
+  static int initialize(bool headless = false,
+                        bool listDevices = false,
+                        const std::vector<int>& selectedGpus = std::vector<int>(1, 0));
   static void clearGpuVolumeCache();
   static void cleanup();
 
@@ -47,23 +52,43 @@ public:
   //    load new image or shutdown
   static std::shared_ptr<ImageGpu> imageAllocGPU(std::shared_ptr<ImageXYZC> image, bool do_cache = true);
   static void imageDeallocGPU(std::shared_ptr<ImageXYZC> image);
+  // the cached gpu image, or nullptr. Its textures can be read from any renderer context, which all share
+  // objects with the context that was current during preloading.
+  static std::shared_ptr<ImageGpu> findCachedGpuImage(std::shared_ptr<ImageXYZC> image);
+  // gpu memory held by the cached images of a device
+  static size_t gpuCacheBytes(int device);
+
+  // Devices are numbered in the order they were selected at initialize. Without EGL there is one device.
+  // The gpu cache is kept per device: images are cached on the device of the context current on the calling thread.
+  static int deviceCount();
+  // video memory that was free on the device when it was initialized, before any volume or session was placed on
+  // it; 0 when the driver does not report it
+  static size_t deviceFreeMemoryBytes(int device);
+  static int currentDevice();
+  // make the root context of a headless device current, e.g. to preload images on it
+  static void makeDeviceCurrent(int device);
 
   static QSurfaceFormat getQSurfaceFormat(bool enableDebug = false);
   static QOpenGLContext* createOpenGLContext();
 
 private:
-  static std::map<std::shared_ptr<ImageXYZC>, std::shared_ptr<ImageGpu>> sGpuImageCache;
+  static std::map<std::pair<int, std::shared_ptr<ImageXYZC>>, std::shared_ptr<ImageGpu>> sGpuImageCache;
 };
 
 class HeadlessGLContext
 {
 public:
-  HeadlessGLContext();
+  HeadlessGLContext(int device = 0);
   ~HeadlessGLContext();
   void makeCurrent();
   void doneCurrent();
+#if HAS_EGL
+  EGLContext eglContext() const { return m_eglCtx; }
+#endif
+  int device() const { return m_device; }
 
 private:
+  int m_device;
 #if HAS_EGL
   EGLContext m_eglCtx;
 #endif
@@ -0,0 +1,167 @@
+#include "catch.hpp"
+
+#include "renderlib/AccumulationParking.h"
+#include "renderlib/Enumerations.h"
+#include "renderlib/RenderSettings.h"
+
+namespace {
+
+const long SWAP_FLAGS = CameraDirty | LightsDirty | RenderParamsDirty | TransferFunctionDirty | RoiDirty;
+
+// The accumulation bookkeeping of RenderGLPT::swapScene and doRender, with the gpu copies left out
+struct SwappingRenderer
+{
+  AccumulationParking m_parking;
+  RenderSettings* m_current = nullptr;
+
+  void swapScene(RenderSettings* rs)
+  {
+    if (m_current && AccumulationParking::worthParking(*m_current)) {
+      ParkedAccumulation parked;
+      parked.m_iterations = m_current->GetNoIterations();
+      m_parking.park(m_current, parked);
+    }
+    m_current = rs;
+    m_parking.swapIn(SWAP_FLAGS);
+  }
+
+  void render()
+  {
+    const bool resume = m_parking.beginFrame(*m_current);
+    ParkedAccumulation parked;
+    const bool hadParked = m_parking.take(m_current, parked);
+    if (m_current->m_DirtyFlags.Get() != 0) {
+      m_current->SetNoIterations(0);
+    }
+    if (resume) {
+      REQUIRE(hadParked);
+      m_current->SetNoIterations(parked.m_iterations);
+    }
+    m_current->m_DirtyFlags.ClearAllFlags();
+    m_current->SetNoIterations(m_current->GetNoIterations() + 1);
+  }
+};
+
+} // namespace
+
+TEST_CASE("Only images with samples and no pending changes are parked", "[accumulationParking]")
+{
+  RenderSettings rs;
+  rs.m_DirtyFlags.ClearAllFlags();
+  rs.SetNoIterations(0);
+  REQUIRE_FALSE(AccumulationParking::worthParking(rs));
+  rs.SetNoIterations(10);
+  REQUIRE(AccumulationParking::worthParking(rs));
+  rs.m_DirtyFlags.SetFlag(CameraDirty);
+  REQUIRE_FALSE(AccumulationParking::worthParking(rs));
+}
+
+TEST_CASE("A parked accumulation only fits the same buffers", "[accumulationParking]")
+{
+  ParkedAccumulation parked;
+  parked.m_w = 64;
+  parked.m_h = 32;
+  parked.m_format = 1;
+  parked.m_textures[0] = 7;
+  parked.m_textures[2] = 8;
+
+  const uint32_t same[ParkedAccumulation::NUM_TARGETS] = { 1, 0, 2, 0, 0, 0 };
+  const uint32_t moreTargets[ParkedAccumulation::NUM_TARGETS] = { 1, 0, 2, 0, 3, 4 };
+  const uint32_t fewerTargets[ParkedAccumulation::NUM_TARGETS] = { 1, 0, 0, 0, 0, 0 };
+  REQUIRE(parked.fits(64, 32, 1, same));
+  REQUIRE_FALSE(parked.fits(64, 64, 1, same));
+  REQUIRE_FALSE(parked.fits(64, 32, 2, same));
+  REQUIRE_FALSE(parked.fits(64, 32, 1, moreTargets));
+  REQUIRE_FALSE(parked.fits(64, 32, 1, fewerTargets));
+}
+
+TEST_CASE("A scene swapped back in continues unless it changed", "[accumulationParking]")
+{
+  RenderSettings a, b;
+  a.m_DirtyFlags.ClearAllFlags();
+  b.m_DirtyFlags.ClearAllFlags();
+  a.SetNoIterations(0);
+  b.SetNoIterations(0);
+  SwappingRenderer renderer;
+
+  SECTION("Unchanged")
+  {
+    renderer.swapScene(&a);
+    renderer.render();
+    renderer.render();
+    renderer.swapScene(&b);
+    renderer.render();
+    renderer.swapScene(&a);
+    renderer.render();
+    REQUIRE(a.GetNoIterations() == 3);
+    REQUIRE(b.GetNoIterations() == 1);
+  }
+
+  SECTION("Changed after it was swapped back in")
+  {
+    renderer.swapScene(&a);
+    renderer.render();
+    renderer.render();
+    renderer.swapScene(&b);
+    renderer.render();
+    renderer.swapScene(&a);
+    a.m_DirtyFlags.SetFlag(CameraDirty);
+    renderer.render();
+    REQUIRE(a.GetNoIterations() == 1);
+  }
+
+  SECTION("No frame between swaps")
+  {
+    renderer.swapScene(&a);
+    renderer.render();
+    renderer.swapScene(&b);
+    renderer.swapScene(&a);
+    renderer.render();
+    REQUIRE(a.GetNoIterations() == 2);
+  }
+
+  SECTION("Nothing left behind once it is taken back")
+  {
+    renderer.swapScene(&a);
+    renderer.render();
+    renderer.swapScene(&b);
+    ParkedAccumulation parked;
+    REQUIRE(renderer.m_parking.take(&a, parked));
+    REQUIRE_FALSE(renderer.m_parking.take(&a, parked));
+    REQUIRE(renderer.m_parking.takeAll().empty());
+  }
+}
+
+TEST_CASE("Two streaming sessions on one renderer both converge", "[accumulationParking]")
+{
+  // the stream mode stop condition in Renderer::processRequest
+  const int CONVERGED_ITERATIONS = 500;
+  // frames per time slice
+  const int SLICE_FRAMES = 20;
+
+  RenderSettings a, b;
+  a.m_DirtyFlags.SetFlag(CameraDirty);
+  b.m_DirtyFlags.SetFlag(CameraDirty);
+  a.SetNoIterations(0);
+  b.SetNoIterations(0);
+  SwappingRenderer renderer;
+
+  int slices = 0;
+  for (; slices < 1000; ++slices) {
+    RenderSettings* session = (slices % 2 == 0) ? &a : &b;
+    if (session->GetNoIterations() >= CONVERGED_ITERATIONS) {
+      if (a.GetNoIterations() >= CONVERGED_ITERATIONS && b.GetNoIterations() >= CONVERGED_ITERATIONS) {
+        break;
+      }
+      continue;
+    }
+    renderer.swapScene(session);
+    for (int i = 0; i < SLICE_FRAMES && session->GetNoIterations() < CONVERGED_ITERATIONS; ++i) {
+      renderer.render();
+    }
+  }
+  REQUIRE(a.GetNoIterations() >= CONVERGED_ITERATIONS);
+  REQUIRE(b.GetNoIterations() >= CONVERGED_ITERATIONS);
+  // no more slices than it takes to render both one after the other
+  REQUIRE(slices <= 2 * (CONVERGED_ITERATIONS / SLICE_FRAMES) + 2);
+}
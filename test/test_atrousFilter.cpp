@@ -0,0 +1,118 @@
+#include "catch.hpp"
+
+#include "renderlib/AtrousFilter.h"
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+const uint32_t W = 32;
+const uint32_t H = 16;
+
+// a volume facing the camera at depth 2 in the left half, empty space in the right half
+void
+makeFeatures(std::vector<float>& normals, std::vector<float>& albedoDepth)
+{
+  normals.assign(W * H * 4, 0.0f);
+  albedoDepth.assign(W * H * 4, 0.0f);
+  for (uint32_t y = 0; y < H; ++y) {
+    for (uint32_t x = 0; x < W / 2; ++x) {
+      const size_t i = 4 * (x + y * W);
+      // four scattering events per pixel
+      normals[i + 2] = 4.0f;
+      normals[i + 3] = 4.0f;
+      albedoDepth[i + 0] = albedoDepth[i + 1] = albedoDepth[i + 2] = 4.0f * 0.5f;
+      albedoDepth[i + 3] = 4.0f * 2.0f;
+    }
+  }
+}
+
+float
+variance(const std::vector<float>& img, uint32_t x0, uint32_t x1)
+{
+  double sum = 0.0, sum2 = 0.0;
+  size_t n = 0;
+  for (uint32_t y = 0; y < H; ++y) {
+    for (uint32_t x = x0; x < x1; ++x) {
+      const double v = img[4 * (x + y * W)];
+      sum += v;
+      sum2 += v * v;
+      n++;
+    }
+  }
+  const double mean = sum / n;
+  return (float)(sum2 / n - mean * mean);
+}
+} // namespace
+
+TEST_CASE("A-trous filter removes noise but keeps edges", "[atrousFilter]")
+{
+  std::vector<float> normals, albedoDepth;
+  makeFeatures(normals, albedoDepth);
+  AtrousFilterParams params;
+
+  std::vector<float> noisy(W * H * 4, 0.0f);
+  srand(1);
+  for (uint32_t y = 0; y < H; ++y) {
+    for (uint32_t x = 0; x < W / 2; ++x) {
+      const float v = 0.5f + 0.2f * ((float)rand() / (float)RAND_MAX - 0.5f);
+      const size_t i = 4 * (x + y * W);
+      noisy[i + 0] = noisy[i + 1] = noisy[i + 2] = v;
+      noisy[i + 3] = 1.0f;
+    }
+  }
+  std::vector<float> out(noisy.size());
+
+  SECTION("Constant image is unchanged")
+  {
+    std::vector<float> flat(W * H * 4, 0.25f);
+    atrousFilter(flat.data(), normals.data(), albedoDepth.data(), W, H, params, 0.0f, out.data());
+    for (float v : out) {
+      REQUIRE(v == Approx(0.25f));
+    }
+  }
+
+  SECTION("Noise in the volume is reduced")
+  {
+    atrousFilter(noisy.data(), normals.data(), albedoDepth.data(), W, H, params, 0.0f, out.data());
+    REQUIRE(variance(out, 0, W / 2) < 0.25f * variance(noisy, 0, W / 2));
+  }
+
+  SECTION("Volume does not bleed into empty space")
+  {
+    atrousFilter(noisy.data(), normals.data(), albedoDepth.data(), W, H, params, 0.0f, out.data());
+    for (uint32_t y = 0; y < H; ++y) {
+      for (uint32_t x = W / 2; x < W; ++x) {
+        REQUIRE(out[4 * (x + y * W)] == 0.0f);
+        REQUIRE(out[4 * (x + y * W) + 3] == 0.0f);
+      }
+    }
+  }
+
+  SECTION("Depth discontinuities are edges")
+  {
+    // the right half is volume too, but much farther away
+    for (uint32_t y = 0; y < H; ++y) {
+      for (uint32_t x = W / 2; x < W; ++x) {
+        const size_t i = 4 * (x + y * W);
+        normals[i + 2] = normals[i + 3] = 4.0f;
+        albedoDepth[i + 0] = albedoDepth[i + 1] = albedoDepth[i + 2] = 4.0f * 0.5f;
+        albedoDepth[i + 3] = 4.0f * 8.0f;
+        noisy[i + 0] = noisy[i + 1] = noisy[i + 2] = 0.1f;
+        noisy[i + 3] = 1.0f;
+      }
+    }
+    atrousFilter(noisy.data(), normals.data(), albedoDepth.data(), W, H, params, 0.0f, out.data());
+    for (uint32_t y = 0; y < H; ++y) {
+      REQUIRE(out[4 * (W / 2 + y * W)] == Approx(0.1f).margin(0.01f));
+    }
+  }
+
+  SECTION("lerpC 1 keeps the unfiltered image")
+  {
+    atrousFilter(noisy.data(), normals.data(), albedoDepth.data(), W, H, params, 1.0f, out.data());
+    for (size_t i = 0; i < out.size(); ++i) {
+      REQUIRE(out[i] == Approx(noisy[i]));
+    }
+  }
+}
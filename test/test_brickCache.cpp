@@ -0,0 +1,127 @@
+#include "catch.hpp"
+
+#include "renderlib/BrickCache.h"
+
+#include <vector>
+
+TEST_CASE("Brick layout covers the volume", "[brickCache]")
+{
+  SECTION("Partial bricks at the far edges")
+  {
+    BrickLayout layout(100, 64, 1, 32);
+    REQUIRE(layout.m_gridSize[0] == 4);
+    REQUIRE(layout.m_gridSize[1] == 2);
+    REQUIRE(layout.m_gridSize[2] == 1);
+    REQUIRE(layout.brickCount() == 8);
+    REQUIRE(layout.paddedBrickSize() == 34);
+  }
+
+  SECTION("Brick index round trips")
+  {
+    BrickLayout layout(300, 200, 100, 32);
+    for (uint32_t i = 0; i < layout.brickCount(); ++i) {
+      uint32_t bx, by, bz;
+      layout.brickCoords(i, bx, by, bz);
+      REQUIRE(layout.brickIndex(bx, by, bz) == i);
+    }
+    uint32_t x, y, z;
+    layout.brickOrigin(layout.brickIndex(2, 1, 3), x, y, z);
+    REQUIRE(x == 64);
+    REQUIRE(y == 32);
+    REQUIRE(z == 96);
+  }
+}
+
+TEST_CASE("Brick residency is least recently used", "[brickCache]")
+{
+  BrickResidencyManager mgr;
+  mgr.init(16, 4);
+  std::vector<BrickResidencyManager::SlotAssignment> assigned;
+  std::vector<uint32_t> evicted;
+
+  SECTION("Free slots are used before evicting")
+  {
+    mgr.request({ 0, 1, 2, 3 }, 100, assigned, evicted);
+    REQUIRE(assigned.size() == 4);
+    REQUIRE(evicted.empty());
+    REQUIRE(mgr.numResident() == 4);
+    for (uint32_t i = 0; i < 4; ++i) {
+      REQUIRE(mgr.isResident(i));
+    }
+  }
+
+  SECTION("Duplicates and resident bricks are skipped")
+  {
+    mgr.request({ 5, 5, 6 }, 100, assigned, evicted);
+    REQUIRE(assigned.size() == 2);
+    assigned.clear();
+    mgr.request({ 5, 6 }, 100, assigned, evicted);
+    REQUIRE(assigned.empty());
+  }
+
+  SECTION("Least recently used brick is evicted")
+  {
+    mgr.request({ 0, 1, 2, 3 }, 100, assigned, evicted);
+    mgr.touch(0);
+    mgr.touch(2);
+    assigned.clear();
+    mgr.request({ 8, 9 }, 100, assigned, evicted);
+    REQUIRE(assigned.size() == 2);
+    REQUIRE(evicted.size() == 2);
+    REQUIRE(mgr.isResident(0));
+    REQUIRE(mgr.isResident(2));
+    REQUIRE(!mgr.isResident(1));
+    REQUIRE(!mgr.isResident(3));
+    // evicted slots are reused
+    REQUIRE(mgr.slotOf(8) >= 0);
+    REQUIRE(mgr.slotOf(8) != mgr.slotOf(0));
+    REQUIRE(mgr.slotOf(8) != mgr.slotOf(2));
+  }
+
+  SECTION("Bricks touched this frame are not evicted")
+  {
+    mgr.request({ 0, 1, 2, 3 }, 100, assigned, evicted);
+    REQUIRE(mgr.isFull());
+    mgr.beginFrame();
+    mgr.touch(0);
+    mgr.touch(1);
+    mgr.touch(2);
+    mgr.touch(3);
+    assigned.clear();
+    mgr.request({ 8, 9 }, 100, assigned, evicted);
+    REQUIRE(assigned.empty());
+    REQUIRE(evicted.empty());
+    for (uint32_t i = 0; i < 4; ++i) {
+      REQUIRE(mgr.isResident(i));
+    }
+
+    // only the bricks touched in the next frame stay pinned
+    mgr.beginFrame();
+    mgr.touch(1);
+    mgr.request({ 8, 9, 10, 11 }, 100, assigned, evicted);
+    REQUIRE(assigned.size() == 3);
+    REQUIRE(evicted.size() == 3);
+    REQUIRE(mgr.isResident(1));
+    REQUIRE(!mgr.isResident(11));
+  }
+
+  SECTION("Assignments per request are limited")
+  {
+    mgr.request({ 0, 1, 2, 3, 4, 5, 6, 7 }, 2, assigned, evicted);
+    REQUIRE(assigned.size() == 2);
+    assigned.clear();
+    // never more than the pool can hold
+    mgr.request({ 8, 9, 10, 11, 12, 13, 14, 15 }, 100, assigned, evicted);
+    REQUIRE(assigned.size() == 4);
+    REQUIRE(mgr.numResident() == 4);
+  }
+
+  SECTION("Clear frees every slot")
+  {
+    mgr.request({ 0, 1 }, 100, assigned, evicted);
+    mgr.clear();
+    REQUIRE(mgr.numResident() == 0);
+    REQUIRE(!mgr.isResident(0));
+    REQUIRE(mgr.slotOf(1) == BrickResidencyManager::NOT_RESIDENT);
+  }
+}
@@ -0,0 +1,72 @@
+#include "catch.hpp"
+
+#include "renderlib/CameraPath.h"
+
+#include <vector>
+
+TEST_CASE("Camera paths orbit like the python client's batch renders", "[cameraPath]")
+{
+  SECTION("A turntable turns by equal steps and stops one step short of the full turn")
+  {
+    REQUIRE(cameraPathAngle(CameraPath::TURNTABLE, 0, 90, 360.0f) == 0.0f);
+    REQUIRE(cameraPathAngle(CameraPath::TURNTABLE, 1, 90, 360.0f) == Approx(4.0f));
+    REQUIRE(cameraPathAngle(CameraPath::TURNTABLE, 89, 90, 360.0f) == Approx(356.0f));
+    REQUIRE(cameraPathAngle(CameraPath::TURNTABLE, 45, 90, -360.0f) == Approx(-180.0f));
+  }
+
+  SECTION("A rocker swings out to the angle, over to minus the angle and back")
+  {
+    const int n = 8;
+    std::vector<float> angles;
+    for (int i = 0; i < n; ++i) {
+      angles.push_back(cameraPathAngle(CameraPath::ROCKER, i, n, 30.0f));
+    }
+    REQUIRE(angles == std::vector<float>({ 0.0f, 15.0f, 30.0f, 15.0f, 0.0f, -15.0f, -30.0f, -15.0f }));
+    // the frame after the last is the first again
+    REQUIRE(cameraPathAngle(CameraPath::ROCKER, n, n, 30.0f) == Approx(0.0f));
+  }
+
+  SECTION("Keyframes don't orbit")
+  {
+    REQUIRE(cameraPathAngle(CameraPath::KEYFRAMES, 3, 8, 30.0f) == 0.0f);
+  }
+}
+
+TEST_CASE("Keyframes are interpolated over the animation", "[cameraPath]")
+{
+  // eye moves along x from 0 to 2, target and up stay put
+  std::vector<float> keys = { 0, 0, 5, 0, 0, 0, 0, 1, 0, 1, 0, 5, 0, 0, 0, 0, 1, 0, 2, 0, 5, 0, 0, 0, 0, 1, 0 };
+  float pose[CAMERA_KEYFRAME_SIZE];
+
+  SECTION("The first and last frames are the first and last keyframes")
+  {
+    REQUIRE(keyframePose(keys, 0, 5, pose));
+    REQUIRE(pose[0] == 0.0f);
+    REQUIRE(keyframePose(keys, 4, 5, pose));
+    REQUIRE(pose[0] == Approx(2.0f));
+    REQUIRE(pose[2] == 5.0f);
+    REQUIRE(pose[7] == 1.0f);
+  }
+
+  SECTION("Frames between keyframes are blended")
+  {
+    REQUIRE(keyframePose(keys, 1, 5, pose));
+    REQUIRE(pose[0] == Approx(0.5f));
+    REQUIRE(keyframePose(keys, 3, 5, pose));
+    REQUIRE(pose[0] == Approx(1.5f));
+  }
+
+  SECTION("One keyframe holds the camera still")
+  {
+    std::vector<float> one(keys.begin(), keys.begin() + CAMERA_KEYFRAME_SIZE);
+    REQUIRE(keyframePose(one, 3, 5, pose));
+    REQUIRE(pose[0] == 0.0f);
+  }
+
+  SECTION("Partial keyframes are rejected")
+  {
+    keys.pop_back();
+    REQUIRE_FALSE(keyframePose(keys, 0, 5, pose));
+    REQUIRE_FALSE(keyframePose(std::vector<float>(), 0, 5, pose));
+  }
+}
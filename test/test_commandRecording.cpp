@@ -0,0 +1,69 @@
+#include "catch.hpp"
+
+#include "renderlib/CommandRecording.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace {
+std::vector<uint8_t>
+readFile(const char* path)
+{
+  std::ifstream f(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+}
+
+TEST_CASE("Recorded command messages read back in order", "[commandRecording]")
+{
+  const char* path = "test_commandRecording.agvr";
+  const std::vector<uint8_t> first = { 'A', 'G', 'V', 'C', 0, 0, 0, 1, 0, 0, 0, 4, 0, 0, 0, 15 };
+  const std::vector<uint8_t> second = { 1, 2, 3 };
+  {
+    CommandRecorder recorder(path);
+    REQUIRE(recorder.isOpen());
+    recorder.record(7, first.data(), first.size());
+    recorder.record(8, second.data(), second.size());
+    recorder.endSession(7);
+  }
+  std::vector<uint8_t> file = readFile(path);
+  std::remove(path);
+  REQUIRE(isCommandRecording(file.data(), file.size()));
+
+  SECTION("Messages keep their session, bytes and order of arrival")
+  {
+    std::vector<RecordedMessage> messages;
+    std::string error;
+    REQUIRE(readCommandRecording(file.data(), file.size(), messages, error));
+    REQUIRE(messages.size() == 3);
+    REQUIRE(messages[0].m_session == 7);
+    REQUIRE(messages[0].m_data == first);
+    REQUIRE(messages[1].m_session == 8);
+    REQUIRE(messages[1].m_data == second);
+    REQUIRE(messages[2].m_session == 7);
+    REQUIRE(messages[2].m_data.empty());
+    REQUIRE(messages[0].m_timeUs <= messages[1].m_timeUs);
+    REQUIRE(messages[1].m_timeUs <= messages[2].m_timeUs);
+  }
+
+  SECTION("A cut off recording keeps the messages before the cut")
+  {
+    std::vector<RecordedMessage> messages;
+    std::string error;
+    file.resize(COMMAND_RECORDING_HEADER_SIZE + RECORDED_MESSAGE_HEADER_SIZE + first.size() + 4);
+    REQUIRE_FALSE(readCommandRecording(file.data(), file.size(), messages, error));
+    REQUIRE_FALSE(error.empty());
+    REQUIRE(messages.size() == 1);
+  }
+
+  SECTION("Unknown versions are rejected")
+  {
+    std::vector<RecordedMessage> messages;
+    std::string error;
+    file[7] = 2;
+    REQUIRE_FALSE(readCommandRecording(file.data(), file.size(), messages, error));
+    REQUIRE(messages.empty());
+  }
+}
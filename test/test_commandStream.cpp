@@ -0,0 +1,199 @@
+#include "catch.hpp"
+
+#include "renderlib/CommandStream.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+struct CountedCommand : public Command
+{
+  CountedCommand(int id, int& live)
+    : m_id(id)
+    , m_live(live)
+  {
+    ++m_live;
+  }
+  ~CountedCommand() { --m_live; }
+  virtual void execute(ExecutionContext*) {}
+  virtual std::string toPythonString() const { return ""; }
+
+  int m_id;
+  int& m_live;
+};
+
+void
+putInt32(std::vector<uint8_t>& b, int32_t v)
+{
+  b.push_back((uint8_t)((uint32_t)v >> 24));
+  b.push_back((uint8_t)((uint32_t)v >> 16));
+  b.push_back((uint8_t)((uint32_t)v >> 8));
+  b.push_back((uint8_t)v);
+}
+
+void
+putFloat32(std::vector<uint8_t>& b, float f)
+{
+  uint32_t v;
+  memcpy(&v, &f, sizeof(v));
+  b.push_back((uint8_t)v);
+  b.push_back((uint8_t)(v >> 8));
+  b.push_back((uint8_t)(v >> 16));
+  b.push_back((uint8_t)(v >> 24));
+}
+
+std::vector<uint8_t>
+withHeader(const std::vector<uint8_t>& payload, uint32_t version = COMMAND_MESSAGE_VERSION)
+{
+  std::vector<uint8_t> b = { 'A', 'G', 'V', 'C' };
+  putInt32(b, (int32_t)version);
+  putInt32(b, (int32_t)payload.size());
+  b.insert(b.end(), payload.begin(), payload.end());
+  return b;
+}
+}
+
+TEST_CASE("Command messages are framed by an optional header", "[commandStream]")
+{
+  std::vector<uint8_t> payload;
+  putInt32(payload, 15);
+  size_t offset = 0, length = 0;
+  std::string error;
+
+  SECTION("Messages without a header are all commands")
+  {
+    REQUIRE(findCommandPayload(payload.data(), payload.size(), offset, length, error));
+    REQUIRE(offset == 0);
+    REQUIRE(length == payload.size());
+  }
+
+  SECTION("The header is skipped")
+  {
+    std::vector<uint8_t> b = withHeader(payload);
+    REQUIRE(findCommandPayload(b.data(), b.size(), offset, length, error));
+    REQUIRE(offset == COMMAND_MESSAGE_HEADER_SIZE);
+    REQUIRE(length == payload.size());
+  }
+
+  SECTION("Unknown versions are rejected")
+  {
+    std::vector<uint8_t> b = withHeader(payload, COMMAND_MESSAGE_VERSION + 1);
+    REQUIRE_FALSE(findCommandPayload(b.data(), b.size(), offset, length, error));
+    REQUIRE_FALSE(error.empty());
+  }
+
+  SECTION("Lengths that do not match the message are rejected")
+  {
+    std::vector<uint8_t> b = withHeader(payload);
+    b.pop_back();
+    REQUIRE_FALSE(findCommandPayload(b.data(), b.size(), offset, length, error));
+    b.resize(6);
+    REQUIRE_FALSE(findCommandPayload(b.data(), b.size(), offset, length, error));
+  }
+
+  SECTION("Recorded messages are split at their headers")
+  {
+    std::vector<uint8_t> b = withHeader(payload);
+    std::vector<uint8_t> second = withHeader({});
+    b.insert(b.end(), second.begin(), second.end());
+    REQUIRE(commandMessageSize(b.data(), b.size()) == COMMAND_MESSAGE_HEADER_SIZE + payload.size());
+    REQUIRE(commandMessageSize(second.data(), second.size()) == COMMAND_MESSAGE_HEADER_SIZE);
+    REQUIRE(commandMessageSize(payload.data(), payload.size()) == payload.size());
+    REQUIRE(commandMessageSize(b.data(), COMMAND_MESSAGE_HEADER_SIZE + 2) == 0);
+  }
+}
+
+TEST_CASE("Command arguments are read within bounds", "[commandStream]")
+{
+  CommandList commands;
+
+  SECTION("Values are read in the byte order the clients write")
+  {
+    std::vector<uint8_t> b;
+    putInt32(b, -2);
+    putFloat32(b, 1.5f);
+    putInt32(b, 3);
+    b.push_back('a');
+    b.push_back('b');
+    b.push_back('c');
+    putInt32(b, 2);
+    putFloat32(b, 0.25f);
+    putFloat32(b, -4.0f);
+    // read from an odd address
+    b.insert(b.begin(), 0);
+
+    CommandReader reader(b.data() + 1, b.size() - 1, commands);
+    REQUIRE(reader.parseInt32() == -2);
+    REQUIRE(reader.parseFloat32() == 1.5f);
+    REQUIRE(reader.parseString() == "abc");
+    REQUIRE(reader.parseFloat32Array() == std::vector<float>({ 0.25f, -4.0f }));
+    REQUIRE(reader.end());
+  }
+
+  SECTION("Reads past the end throw")
+  {
+    std::vector<uint8_t> b = { 0, 0, 1 };
+    CommandReader reader(b.data(), b.size(), commands);
+    REQUIRE(reader.remaining() == 3);
+    REQUIRE_THROWS_AS(reader.parseInt32(), std::out_of_range);
+  }
+
+  SECTION("Counts that do not fit in the message throw")
+  {
+    std::vector<uint8_t> b;
+    putInt32(b, 3);
+    putFloat32(b, 1.0f);
+    putFloat32(b, 2.0f);
+    CommandReader reader(b.data(), b.size(), commands);
+    REQUIRE_THROWS_AS(reader.parseFloat32Array(), std::out_of_range);
+
+    std::vector<uint8_t> negative;
+    putInt32(negative, -1);
+    CommandReader reader2(negative.data(), negative.size(), commands);
+    REQUIRE_THROWS_AS(reader2.parseString(), std::out_of_range);
+  }
+}
+
+TEST_CASE("Command lists own their commands", "[commandStream]")
+{
+  int live = 0;
+
+  SECTION("Commands keep their order across blocks and are destroyed with the list")
+  {
+    {
+      CommandList commands;
+      for (int i = 0; i < 1000; ++i) {
+        commands.add<CountedCommand>(i, live);
+      }
+      REQUIRE(live == 1000);
+      REQUIRE(commands.size() == 1000);
+      for (int i = 0; i < 1000; ++i) {
+        REQUIRE(static_cast<CountedCommand*>(commands.commands()[i])->m_id == i);
+      }
+    }
+    REQUIRE(live == 0);
+  }
+
+  SECTION("Moving and appending hand the commands over")
+  {
+    CommandList a;
+    a.add<CountedCommand>(0, live);
+    CommandList b;
+    b.add<CountedCommand>(1, live);
+    b.add<CountedCommand>(2, live);
+
+    CommandList c(std::move(a));
+    REQUIRE(a.empty());
+    c.append(std::move(b));
+    REQUIRE(b.empty());
+    c.add<CountedCommand>(3, live);
+    REQUIRE(live == 4);
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE(static_cast<CountedCommand*>(c.commands()[i])->m_id == i);
+    }
+
+    c.clear();
+    REQUIRE(live == 0);
+  }
+}
@@ -0,0 +1,72 @@
+#include "catch.hpp"
+
+#include "renderlib/DeviceLoad.h"
+
+#include <vector>
+
+namespace {
+DeviceLoad
+makeLoad(uint32_t sessions, uint32_t queued, size_t gpuBytes = 0, size_t freeMemoryBytes = 0)
+{
+  DeviceLoad d;
+  d.m_sessions = sessions;
+  d.m_queuedRequests = queued;
+  d.m_gpuBytes = gpuBytes;
+  d.m_freeMemoryBytes = freeMemoryBytes;
+  return d;
+}
+}
+
+TEST_CASE("Sessions are placed on the least loaded device", "[deviceLoad]")
+{
+  SECTION("No devices")
+  {
+    REQUIRE(leastLoadedDevice({}) == -1);
+  }
+
+  SECTION("Idle devices are filled in order")
+  {
+    std::vector<DeviceLoad> devices(3);
+    REQUIRE(leastLoadedDevice(devices) == 0);
+    devices[0].m_sessions = 1;
+    REQUIRE(leastLoadedDevice(devices) == 1);
+    devices[1].m_sessions = 1;
+    REQUIRE(leastLoadedDevice(devices) == 2);
+  }
+
+  SECTION("Queued requests count as load")
+  {
+    std::vector<DeviceLoad> devices = { makeLoad(1, 5), makeLoad(2, 0) };
+    REQUIRE(leastLoadedDevice(devices) == 1);
+  }
+
+  SECTION("Rendering time breaks ties")
+  {
+    std::vector<DeviceLoad> devices = { makeLoad(1, 0), makeLoad(1, 0) };
+    devices[0].m_queueDurationMs = 500;
+    devices[1].m_queueDurationMs = 100;
+    REQUIRE(leastLoadedDevice(devices) == 1);
+  }
+
+  SECTION("Memory use is weighed in when the driver reports it")
+  {
+    const size_t GB = 1024 * 1024 * 1024;
+    std::vector<DeviceLoad> devices = { makeLoad(1, 0, 7 * GB, 8 * GB), makeLoad(2, 0, 1 * GB, 8 * GB) };
+    REQUIRE(leastLoadedDevice(devices) == 1);
+  }
+
+  SECTION("Full devices are avoided")
+  {
+    const size_t GB = 1024 * 1024 * 1024;
+    std::vector<DeviceLoad> devices = { makeLoad(0, 0, 8 * GB, 8 * GB), makeLoad(3, 2, 1 * GB, 8 * GB) };
+    REQUIRE(leastLoadedDevice(devices) == 1);
+    devices[1].m_gpuBytes = 9 * GB;
+    REQUIRE(leastLoadedDevice(devices) == 0);
+  }
+
+  SECTION("Unknown memory sizes fall back to the least memory held")
+  {
+    std::vector<DeviceLoad> devices = { makeLoad(1, 0, 2000), makeLoad(1, 0, 1000) };
+    REQUIRE(leastLoadedDevice(devices) == 1);
+  }
+}
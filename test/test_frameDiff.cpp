@@ -0,0 +1,79 @@
+#include "catch.hpp"
+
+#include "renderlib/FrameDiff.h"
+
+#include <vector>
+
+namespace {
+
+void
+fill(std::vector<uint8_t>& frame, uint32_t w, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint8_t value)
+{
+  for (uint32_t y = y0; y < y1; ++y) {
+    for (uint32_t x = x0; x < x1; ++x) {
+      for (int c = 0; c < 3; ++c) {
+        frame[(y * w + x) * 4 + c] = value;
+      }
+    }
+  }
+}
+
+} // namespace
+
+TEST_CASE("Frame diff finds the changed tiles", "[frameDiff]")
+{
+  const uint32_t w = 100;
+  const uint32_t h = 70;
+  FrameDiffParams params;
+  params.m_tileSize = 32;
+  std::vector<uint8_t> reference(w * h * 4, 128);
+  std::vector<ImageTile> changed;
+
+  SECTION("Identical frames")
+  {
+    diffFrameTiles(reference.data(), reference.data(), w, h, params, changed);
+    REQUIRE(changed.empty());
+  }
+
+  SECTION("Noise below the mean threshold is ignored")
+  {
+    std::vector<uint8_t> frame = reference;
+    // every other pixel one level brighter: a mean change of half a level
+    for (uint32_t i = 0; i < w * h; i += 2) {
+      for (int c = 0; c < 3; ++c) {
+        frame[i * 4 + c] = 129;
+      }
+    }
+    params.m_meanThreshold = 0.6f;
+    diffFrameTiles(frame.data(), reference.data(), w, h, params, changed);
+    REQUIRE(changed.empty());
+
+    params.m_meanThreshold = 0.4f;
+    diffFrameTiles(frame.data(), reference.data(), w, h, params, changed);
+    REQUIRE(changed.size() == makeImageTiles(w, h, params.m_tileSize).size());
+  }
+
+  SECTION("A small bright change marks only its tile")
+  {
+    std::vector<uint8_t> frame = reference;
+    fill(frame, w, 70, 40, 72, 42, 255);
+    diffFrameTiles(frame.data(), reference.data(), w, h, params, changed);
+    REQUIRE(changed.size() == 1);
+    REQUIRE(changed[0].m_x == 64);
+    REQUIRE(changed[0].m_y == 32);
+    REQUIRE(changed[0].m_w == 32);
+    REQUIRE(changed[0].m_h == 32);
+  }
+
+  SECTION("Edge tiles are clipped to the frame")
+  {
+    std::vector<uint8_t> frame = reference;
+    fill(frame, w, 96, 64, 100, 70, 0);
+    diffFrameTiles(frame.data(), reference.data(), w, h, params, changed);
+    REQUIRE(changed.size() == 1);
+    REQUIRE(changed[0].m_x == 96);
+    REQUIRE(changed[0].m_y == 64);
+    REQUIRE(changed[0].m_w == 4);
+    REQUIRE(changed[0].m_h == 6);
+  }
+}
@@ -0,0 +1,192 @@
+#include "catch.hpp"
+
+#include "renderlib/CCamera.h"
+#include "renderlib/TiledRender.h"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Orthographic ray march through a synthetic 16^3 volume holding a soft sphere, using the same screen window
+// mapping as the path trace shader: screen point = window origin + per pixel step * (pixel + 0.5).
+const int VOLUME_SIZE = 16;
+
+float
+sphereDensity(float x, float y, float z)
+{
+  float r = std::sqrt(x * x + y * y + z * z);
+  return std::max(0.0f, 1.0f - r / 0.8f);
+}
+
+std::vector<float>
+makeVolume()
+{
+  std::vector<float> volume(VOLUME_SIZE * VOLUME_SIZE * VOLUME_SIZE);
+  for (int z = 0; z < VOLUME_SIZE; ++z) {
+    for (int y = 0; y < VOLUME_SIZE; ++y) {
+      for (int x = 0; x < VOLUME_SIZE; ++x) {
+        float px = 2.0f * (x + 0.5f) / VOLUME_SIZE - 1.0f;
+        float py = 2.0f * (y + 0.5f) / VOLUME_SIZE - 1.0f;
+        float pz = 2.0f * (z + 0.5f) / VOLUME_SIZE - 1.0f;
+        volume[x + VOLUME_SIZE * (y + VOLUME_SIZE * z)] = sphereDensity(px, py, pz);
+      }
+    }
+  }
+  return volume;
+}
+
+float
+sampleVolume(const std::vector<float>& volume, float x, float y, float z)
+{
+  int ix = (int)std::floor((x + 1.0f) * 0.5f * VOLUME_SIZE);
+  int iy = (int)std::floor((y + 1.0f) * 0.5f * VOLUME_SIZE);
+  int iz = (int)std::floor((z + 1.0f) * 0.5f * VOLUME_SIZE);
+  if (ix < 0 || iy < 0 || iz < 0 || ix >= VOLUME_SIZE || iy >= VOLUME_SIZE || iz >= VOLUME_SIZE) {
+    return 0.0f;
+  }
+  return volume[ix + VOLUME_SIZE * (iy + VOLUME_SIZE * iz)];
+}
+
+// render a w x h target whose screen window is screen, writing one byte per pixel
+void
+renderTarget(const std::vector<float>& volume,
+             const float screen[2][2],
+             const float invScreen[2],
+             uint32_t w,
+             uint32_t h,
+             std::vector<uint8_t>& pixels)
+{
+  pixels.assign(w * h, 0);
+  for (uint32_t j = 0; j < h; ++j) {
+    for (uint32_t i = 0; i < w; ++i) {
+      float sx = screen[0][0] + invScreen[0] * (i + 0.5f);
+      float sy = screen[1][0] + invScreen[1] * (j + 0.5f);
+      float transmittance = 1.0f;
+      for (int s = 0; s < 64; ++s) {
+        float z = -1.0f + (s + 0.5f) * 2.0f / 64.0f;
+        transmittance *= std::exp(-sampleVolume(volume, sx, sy, z) * 0.2f);
+      }
+      pixels[j * w + i] = (uint8_t)std::lround(255.0f * (1.0f - transmittance));
+    }
+  }
+}
+
+} // namespace
+
+TEST_CASE("Image tiles cover the image", "[tiledRender]")
+{
+  std::vector<ImageTile> tiles = makeImageTiles(17, 13, 5);
+  REQUIRE(tiles.size() == 4 * 3);
+  REQUIRE(tiles.back().m_x == 15);
+  REQUIRE(tiles.back().m_y == 10);
+  REQUIRE(tiles.back().m_w == 2);
+  REQUIRE(tiles.back().m_h == 3);
+
+  std::vector<int> covered(17 * 13, 0);
+  for (const ImageTile& t : tiles) {
+    for (uint32_t y = t.m_y; y < t.m_y + t.m_h; ++y) {
+      for (uint32_t x = t.m_x; x < t.m_x + t.m_w; ++x) {
+        covered[y * 17 + x]++;
+      }
+    }
+  }
+  for (int c : covered) {
+    REQUIRE(c == 1);
+  }
+
+  REQUIRE(makeImageTiles(17, 13, 0).empty());
+  REQUIRE(makeImageTiles(4, 4, 64).size() == 1);
+}
+
+TEST_CASE("Tiled rendering matches untiled rendering", "[tiledRender]")
+{
+  const uint32_t w = 17;
+  const uint32_t h = 13;
+  const uint32_t tileSize = 5;
+  std::vector<float> volume = makeVolume();
+
+  // same layout as Film::m_Screen: y runs from the top of the window downward
+  const float aspect = (float)h / (float)w;
+  const float screen[2][2] = { { -1.0f, 1.0f }, { aspect, -aspect } };
+  const float invScreen[2] = { (screen[0][1] - screen[0][0]) / w, (screen[1][1] - screen[1][0]) / h };
+
+  std::vector<uint8_t> untiled;
+  renderTarget(volume, screen, invScreen, w, h, untiled);
+
+  // every tile is rendered with a full tileSize target; edge tiles are cropped on the way into the image
+  std::vector<uint8_t> tiled(w * h, 0);
+  std::vector<uint8_t> tilePixels;
+  for (const ImageTile& tile : makeImageTiles(w, h, tileSize)) {
+    float tileScreen[2][2];
+    tileScreenWindow(screen, invScreen, tile, tileSize, tileSize, tileScreen);
+    REQUIRE(tileScreen[0][1] - tileScreen[0][0] == Approx(invScreen[0] * tileSize));
+    renderTarget(volume, tileScreen, invScreen, tileSize, tileSize, tilePixels);
+    copyTileToImage(tilePixels.data(), tileSize, tile, 1, tiled.data(), w);
+  }
+
+  int nonEmpty = 0;
+  for (size_t i = 0; i < untiled.size(); ++i) {
+    // tile origins add float rounding to the screen position, which may flip the last bit of a pixel
+    REQUIRE(std::abs((int)tiled[i] - (int)untiled[i]) <= 1);
+    nonEmpty += untiled[i] > 0 ? 1 : 0;
+  }
+  // the sphere must actually show up, or the comparison proves nothing
+  REQUIRE(nonEmpty > 20);
+  REQUIRE(nonEmpty < (int)(w * h));
+}
+
+TEST_CASE("Film tiles see the pixels of the whole film", "[tiledRender]")
+{
+  const int w = 17;
+  const int h = 13;
+  const int tileSize = 5;
+
+  CCamera camera;
+  camera.m_Film.m_Resolution.SetResX(w);
+  camera.m_Film.m_Resolution.SetResY(h);
+  SECTION("Perspective") { camera.m_Projection = PERSPECTIVE; }
+  SECTION("Orthographic") { camera.m_Projection = ORTHOGRAPHIC; }
+  camera.Update();
+  const Film& film = camera.m_Film;
+
+  for (const ImageTile& tile : makeImageTiles(w, h, tileSize)) {
+    // edge tiles are rendered with a full size target too
+    const Film t = film.Tile(tile, tileSize, tileSize);
+    REQUIRE(t.GetWidth() == tileSize);
+    REQUIRE(t.GetHeight() == tileSize);
+    REQUIRE(t.m_InvScreen.x == film.m_InvScreen.x);
+    REQUIRE(t.m_InvScreen.y == film.m_InvScreen.y);
+    // the window spans the whole target, past the image edge for edge tiles
+    REQUIRE(t.m_Screen[0][1] - t.m_Screen[0][0] == Approx(film.m_InvScreen.x * tileSize));
+    REQUIRE(t.m_Screen[1][1] - t.m_Screen[1][0] == Approx(film.m_InvScreen.y * tileSize));
+
+    // pixel centers of the tile are the pixel centers of the whole film, as the shader computes them
+    for (uint32_t j = 0; j < tile.m_h; ++j) {
+      for (uint32_t i = 0; i < tile.m_w; ++i) {
+        const float tx = t.m_Screen[0][0] + t.m_InvScreen.x * (i + 0.5f);
+        const float ty = t.m_Screen[1][0] + t.m_InvScreen.y * (j + 0.5f);
+        const float fx = film.m_Screen[0][0] + film.m_InvScreen.x * (tile.m_x + i + 0.5f);
+        const float fy = film.m_Screen[1][0] + film.m_InvScreen.y * (tile.m_y + j + 0.5f);
+        REQUIRE(tx == Approx(fx).margin(1e-6));
+        REQUIRE(ty == Approx(fy).margin(1e-6));
+      }
+    }
+
+    // the last pixels of the image end where the film's window ends
+    if (tile.m_x + tile.m_w == (uint32_t)w) {
+      REQUIRE(t.m_Screen[0][0] + t.m_InvScreen.x * tile.m_w == Approx(film.m_Screen[0][1]).margin(1e-6));
+    }
+    if (tile.m_y + tile.m_h == (uint32_t)h) {
+      REQUIRE(t.m_Screen[1][0] + t.m_InvScreen.y * tile.m_h == Approx(film.m_Screen[1][1]).margin(1e-6));
+    }
+  }
+
+  // a tile that covers the whole image is the film itself
+  const ImageTile whole = { 0, 0, (uint32_t)w, (uint32_t)h };
+  const Film t = film.Tile(whole, w, h);
+  REQUIRE(t.m_Screen[0][0] == Approx(film.m_Screen[0][0]));
+  REQUIRE(t.m_Screen[0][1] == Approx(film.m_Screen[0][1]));
+  REQUIRE(t.m_Screen[1][0] == Approx(film.m_Screen[1][0]));
+  REQUIRE(t.m_Screen[1][1] == Approx(film.m_Screen[1][1]));
+}
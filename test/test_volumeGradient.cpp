@@ -0,0 +1,54 @@
+#include "catch.hpp"
+
+#include "renderlib/VolumeGradient.h"
+
+#include <vector>
+
+TEST_CASE("Precomputed volume gradients", "[volumeGradient]")
+{
+  const uint32_t size[3] = { 8, 6, 4 };
+  const float spacing[3] = { 0.125f, 0.125f, 0.125f };
+  // intensity ramps along x by 100 per voxel
+  std::vector<uint16_t> data(size[0] * size[1] * size[2]);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = (uint16_t)(100 * (i % size[0]));
+  }
+  const float expected = 100.0f / 65535.0f * 2.0f / spacing[0];
+
+  SECTION("Linear ramp has a constant gradient along x")
+  {
+    const uint32_t boxMin[3] = { 0, 0, 0 };
+    std::vector<float> out(data.size() * 4);
+    computeGradientVolume(data.data(), size, spacing, boxMin, size, out.data());
+    for (size_t i = 0; i < data.size(); ++i) {
+      // one sided differences at the faces see the same slope
+      REQUIRE(out[4 * i + 0] == Approx(1.0f));
+      REQUIRE(out[4 * i + 1] == Approx(0.0f));
+      REQUIRE(out[4 * i + 2] == Approx(0.0f));
+      REQUIRE(out[4 * i + 3] == Approx(expected));
+    }
+  }
+
+  SECTION("A sub box reads neighbors outside of it")
+  {
+    const uint32_t boxMin[3] = { 2, 1, 1 };
+    const uint32_t boxMax[3] = { 5, 3, 2 };
+    std::vector<float> out(3 * 2 * 1 * 4);
+    computeGradientVolume(data.data(), size, spacing, boxMin, boxMax, out.data());
+    for (size_t i = 0; i < out.size() / 4; ++i) {
+      REQUIRE(out[4 * i + 0] == Approx(1.0f));
+      REQUIRE(out[4 * i + 3] == Approx(expected));
+    }
+  }
+
+  SECTION("Flat volume has no gradient")
+  {
+    std::vector<uint16_t> flat(data.size(), 1000);
+    const uint32_t boxMin[3] = { 0, 0, 0 };
+    std::vector<float> out(data.size() * 4);
+    computeGradientVolume(flat.data(), size, spacing, boxMin, size, out.data());
+    for (float v : out) {
+      REQUIRE(v == 0.0f);
+    }
+  }
+}
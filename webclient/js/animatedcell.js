@@ -24,6 +24,9 @@ var _stream_mode = false;
 var _stream_mode_suspended = false;
 var enqueued_image_data = null;
 var waiting_for_image = false;
+// the previous frame, which the tiles of delta frames are painted over
+var delta_canvas = null;
+var delta_chain = Promise.resolve();
 
 /**
  * switches the supplied element to (in)visible
@@ -989,6 +992,14 @@ function binarysocket(channelnumber = 0) {
       return;
     }
 
+    // acknowledge the frame, so that the server paces stream mode to this link
+    binarysocket0.send(JSON.stringify({ msgtype: 3 }));
+
+    if (isDeltaFrame(evt.data)) {
+      applyDeltaFrame(evt.data);
+      return;
+    }
+
     // new data will be used to obliterate the previous data if it exists.
     // in this way, two consecutive images between redraws, will not both be drawn.
     // TODO:enqueue this...?
@@ -1037,6 +1048,97 @@ function binarysocket(channelnumber = 0) {
     console.log("error", evt);
   };
 }
+
+/**
+ * a frame of changed tiles, sent when frame diff mode is on (see SET_FRAME_DIFF)
+ * @param buffer ArrayBuffer
+ */
+function isDeltaFrame(buffer) {
+  var magic = new Uint8Array(buffer, 0, Math.min(4, buffer.byteLength));
+  return String.fromCharCode.apply(null, magic) === "AGVD";
+}
+
+/**
+ * decode one tile: an encoded image, or 8 bytes of little endian width and
+ * height followed by RGBA pixels
+ * @param bytes Uint8Array
+ */
+function decodeTile(bytes) {
+  var jpeg = bytes[0] === 0xff && bytes[1] === 0xd8;
+  var png = bytes[0] === 0x89 && bytes[1] === 0x50;
+  var webp = bytes[0] === 0x52 && bytes[1] === 0x49;
+  if (jpeg || png || webp) {
+    return createImageBitmap(new Blob([bytes]));
+  }
+  var view = new DataView(bytes.buffer, bytes.byteOffset, 8);
+  var w = view.getUint32(0, true);
+  var h = view.getUint32(4, true);
+  var pixels = new Uint8ClampedArray(
+    bytes.buffer,
+    bytes.byteOffset + 8,
+    w * h * 4
+  );
+  return Promise.resolve(new ImageData(pixels, w, h));
+}
+
+/**
+ * paint the tiles of a delta frame over the previous frame and queue the
+ * result for drawing. tiles decode in parallel, frames are applied in the
+ * order they arrived.
+ * @param buffer ArrayBuffer
+ */
+function applyDeltaFrame(buffer) {
+  var view = new DataView(buffer);
+  var width = view.getUint32(4, true);
+  var height = view.getUint32(8, true);
+  var count = view.getUint32(12, true);
+  var tiles = [];
+  var offset = 16;
+  for (var i = 0; i < count; i++) {
+    var x = view.getUint32(offset, true);
+    var y = view.getUint32(offset + 4, true);
+    var size = view.getUint32(offset + 16, true);
+    offset += 20;
+    var bytes = new Uint8Array(buffer, offset, size);
+    tiles.push({ x: x, y: y, image: decodeTile(bytes) });
+    offset += size;
+  }
+
+  delta_chain = delta_chain
+    .then(function () {
+      return Promise.all(
+        tiles.map(function (t) {
+          return t.image;
+        })
+      );
+    })
+    .then(function (images) {
+      if (
+        !delta_canvas ||
+        delta_canvas.width !== width ||
+        delta_canvas.height !== height
+      ) {
+        delta_canvas = document.createElement("canvas");
+        delta_canvas.width = width;
+        delta_canvas.height = height;
+      }
+      var ctx = delta_canvas.getContext("2d");
+      images.forEach(function (image, i) {
+        if (image instanceof ImageData) {
+          ctx.putImageData(image, tiles[i].x, tiles[i].y);
+        } else {
+          ctx.drawImage(image, tiles[i].x, tiles[i].y);
+        }
+      });
+      // draw() expects the base64 part of a png data url
+      var url = delta_canvas.toDataURL("image/png");
+      enqueued_image_data = url.split(",")[1];
+    })
+    .catch(function (err) {
+      console.warn("could not apply delta frame", err);
+    });
+}
+
 var lastevent;
 var filestructure = {};
 
@@ -72,8 +72,26 @@ var COMMANDS = {
   SET_BOUNDING_BOX_COLOR: [41, "F32", "F32", "F32"],
   SHOW_BOUNDING_BOX: [42, "I32"],
   TRACKBALL_CAMERA: [43, "F32", "F32"],
+  SET_VOLUME_CROP: [44, "I32"],
+  SET_ERROR_TARGET: [45, "F32"],
+  SET_INTERACTIVE_DOWNSAMPLE: [46, "I32"],
+  SET_TEMPORAL_REPROJECTION: [47, "I32"],
+  SET_DENOISE: [48, "I32"],
+  SET_TILED_RENDERING: [49, "I32", "I32"],
+  SET_STREAM_CODEC: [50, "S", "I32"],
+  SET_FRAME_DIFF: [51, "I32", "F32"],
+  SET_STREAM_PACING: [52, "I32", "I32"],
+  BATCH_RENDER: [53, "I32", "I32", "I32", "F32", "F32A", "S"],
+  SET_HALF_FLOAT_ACCUMULATION: [54, "I32"],
+  SET_GPU_VOLUME_BUDGET: [55, "I32"],
 };
 
+// every buffer starts with the bytes "AGVC", then the big endian uint32 format
+// version and byte length of the commands that follow
+var HEADER_MAGIC = "AGVC";
+var HEADER_VERSION = 1;
+var HEADER_SIZE = 12;
+
 // strategy: add elements to prebuffer, and then traverse prebuffer to convert
 // to binary before sending?
 function commandBuffer() {
@@ -129,9 +147,14 @@ commandBuffer.prototype = {
       }
     }
     // allocate arraybuffer and then fill it.
-    this.buffer = new ArrayBuffer(bytesize);
+    this.buffer = new ArrayBuffer(HEADER_SIZE + bytesize);
     var dataview = new DataView(this.buffer);
-    var offset = 0;
+    for (var m = 0; m < HEADER_MAGIC.length; ++m) {
+      dataview.setUint8(m, HEADER_MAGIC.charCodeAt(m));
+    }
+    dataview.setUint32(4, HEADER_VERSION);
+    dataview.setUint32(8, bytesize);
+    var offset = HEADER_SIZE;
     var LITTLE_ENDIAN = true;
     for (var i = 0; i < this.prebuffer.length; ++i) {
       var cmd = this.prebuffer[i];